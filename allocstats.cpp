@@ -0,0 +1,275 @@
+#include "allocstats.h"
+#include "platform.h"
+#include "logging.h"
+#include "common.h"
+#include <cstdio>
+#include <cstring>
+
+
+namespace allocstats
+{
+
+static mem::FallbackAllocator snapshot_allocator;
+
+
+void take_snapshot(AllocSnapshot *snapshot, mem::IAllocator *allocator)
+{
+    if (!allocator)
+    {
+        allocator = mem::default_allocator();
+    }
+
+    if (!snapshot->sites.allocator)
+    {
+        dynarray::init(&snapshot->sites, 256, &snapshot_allocator);
+    }
+
+    // New sites can appear between asking for the count and copying
+    for (;;)
+    {
+        size_t site_count = allocator->site_stats(snapshot->sites.data, snapshot->sites.capacity);
+        if (site_count <= snapshot->sites.capacity)
+        {
+            snapshot->sites.count = DYNARRAY_COUNT(site_count);
+            break;
+        }
+        dynarray::ensure_capacity(&snapshot->sites, DYNARRAY_COUNT(site_count + 64));
+    }
+
+    snapshot->totals = allocator->stats();
+    snapshot->abstime = query_abstime();
+}
+
+
+void free_snapshot(AllocSnapshot *snapshot)
+{
+    if (snapshot->sites.allocator)
+    {
+        dynarray::deinit(&snapshot->sites);
+    }
+    mem::zero_ptr(snapshot);
+}
+
+
+static bool same_group(const AllocStatsRow *row, const mem::AllocationSiteStats *site, AllocGroup::Tag group)
+{
+    // Compared by text, the literals in headers are duplicated in every
+    // file that includes them
+    if (group == AllocGroup::Site
+        && 0 != std::strcmp(row->sourceline, site->sourceline))
+    {
+        return false;
+    }
+    return 0 == std::strcmp(row->category, site->category);
+}
+
+
+static AllocStatsRow *find_or_add_row(DynArray<AllocStatsRow> *rows, const mem::AllocationSiteStats *site,
+                                      AllocGroup::Tag group)
+{
+    for (DynArrayCount i = 0; i < rows->count; ++i)
+    {
+        if (same_group(&(*rows)[i], site, group))
+        {
+            return &(*rows)[i];
+        }
+    }
+
+    AllocStatsRow *row = dynarray::append(rows);
+    mem::zero_ptr(row);
+    row->sourceline = group == AllocGroup::Site ? site->sourceline : nullptr;
+    row->category = site->category;
+    return row;
+}
+
+
+struct RowLiveBytesGreater
+{
+    bool operator()(const AllocStatsRow &a, const AllocStatsRow &b) const
+    {
+        return a.live_bytes > b.live_bytes;
+    }
+};
+
+
+void build_rows(DynArray<AllocStatsRow> *rows,
+                const AllocSnapshot *current, const AllocSnapshot *baseline,
+                AllocGroup::Tag group)
+{
+    dynarray::clear(rows);
+
+    for (DynArrayCount i = 0; i < current->sites.count; ++i)
+    {
+        const mem::AllocationSiteStats *site = &current->sites[i];
+        AllocStatsRow *row = find_or_add_row(rows, site, group);
+
+        row->live_bytes += site->live_bytes;
+        row->live_count += site->live_count;
+        row->allocations += site->total_count;
+        for (size_t b = 0; b < ALLOC_HISTOGRAM_BUCKETS; ++b)
+        {
+            row->size_histogram[b] += site->size_histogram[b];
+        }
+    }
+
+    if (baseline && has_snapshot(baseline))
+    {
+        for (DynArrayCount i = 0; i < rows->count; ++i)
+        {
+            AllocStatsRow *row = &(*rows)[i];
+            row->delta_bytes = (s64)row->live_bytes;
+            row->delta_count = (s64)row->live_count;
+        }
+
+        // Site counters are never dropped, so every baseline site is in
+        // current too and the totals only go up
+        for (DynArrayCount i = 0; i < baseline->sites.count; ++i)
+        {
+            const mem::AllocationSiteStats *site = &baseline->sites[i];
+            AllocStatsRow *row = find_or_add_row(rows, site, group);
+            row->delta_bytes -= (s64)site->live_bytes;
+            row->delta_count -= (s64)site->live_count;
+            row->allocations -= site->total_count;
+        }
+
+        double seconds = seconds_since(current->abstime, baseline->abstime);
+        for (DynArrayCount i = 0; seconds > 0 && i < rows->count; ++i)
+        {
+            AllocStatsRow *row = &(*rows)[i];
+            row->allocs_per_sec = (double)row->allocations / seconds;
+        }
+    }
+
+    dynarray::sort_unstable(rows, RowLiveBytesGreater());
+}
+
+
+void format_bytes(char *buffer, size_t buffer_size, s64 bytes, bool show_sign)
+{
+    static const char *units[] = {"B", "KB", "MB", "GB"};
+
+    const char *sign = bytes < 0 ? "-" : show_sign ? "+" : "";
+    double value = bytes < 0 ? -(double)bytes : (double)bytes;
+    size_t unit = 0;
+    while (value >= 1024.0 && unit + 1 < COUNTOF(units))
+    {
+        value /= 1024.0;
+        ++unit;
+    }
+
+    if (unit == 0)
+    {
+        snprintf(buffer, buffer_size, "%s%.0f %s", sign, value, units[unit]);
+    }
+    else
+    {
+        snprintf(buffer, buffer_size, "%s%.1f %s", sign, value, units[unit]);
+    }
+}
+
+
+static void log_rows(const DynArray<AllocStatsRow> *rows, u32 max_rows, bool have_baseline)
+{
+    char live[32];
+    char delta[32];
+
+    logf_ln("  %10s %9s %11s %10s %10s  %s",
+            "live", "blocks", have_baseline ? "change" : "", "allocs", have_baseline ? "allocs/s" : "",
+            "where");
+
+    for (DynArrayCount i = 0; i < rows->count && i < max_rows; ++i)
+    {
+        const AllocStatsRow *row = &(*rows)[i];
+        format_bytes(live, sizeof(live), (s64)row->live_bytes);
+        delta[0] = '\0';
+        if (have_baseline)
+        {
+            format_bytes(delta, sizeof(delta), row->delta_bytes, true);
+        }
+
+        if (row->sourceline)
+        {
+            logf_ln("  %10s %9llu %11s %10llu %10.0f  %s [%s]",
+                    live, (unsigned long long)row->live_count, delta,
+                    (unsigned long long)row->allocations, row->allocs_per_sec,
+                    row->sourceline, category_label(row->category));
+        }
+        else
+        {
+            logf_ln("  %10s %9llu %11s %10llu %10.0f  %s",
+                    live, (unsigned long long)row->live_count, delta,
+                    (unsigned long long)row->allocations, row->allocs_per_sec,
+                    category_label(row->category));
+        }
+    }
+
+    if (rows->count > max_rows)
+    {
+        logf_ln("  ... %u more", rows->count - max_rows);
+    }
+}
+
+
+void log_report(const AllocSnapshot *current, const AllocSnapshot *baseline, u32 max_sites)
+{
+    bool have_baseline = baseline && has_snapshot(baseline);
+    char live[32];
+    char peak[32];
+    format_bytes(live, sizeof(live), (s64)current->totals.bytes_allocated);
+    format_bytes(peak, sizeof(peak), (s64)current->totals.peak_bytes_allocated);
+
+    logf_ln("%s live in %llu blocks, peak %s, %llu allocations since startup",
+            live, (unsigned long long)current->totals.live_allocations, peak,
+            (unsigned long long)current->totals.total_allocations);
+
+    if (have_baseline)
+    {
+        char delta[32];
+        format_bytes(delta, sizeof(delta),
+                     (s64)current->totals.bytes_allocated - (s64)baseline->totals.bytes_allocated, true);
+        double seconds = seconds_since(current->abstime, baseline->abstime);
+        u64 allocations = current->totals.total_allocations - baseline->totals.total_allocations;
+        logf_ln("Since the snapshot %.1fs ago: %s, %+lld blocks, %llu allocations (%.0f/s)",
+                seconds, delta,
+                (long long)current->totals.live_allocations - (long long)baseline->totals.live_allocations,
+                (unsigned long long)allocations, seconds > 0 ? (double)allocations / seconds : 0.0);
+    }
+
+    DynArray<AllocStatsRow> rows = dynarray::init<AllocStatsRow>(64);
+
+    logln("By category:");
+    build_rows(&rows, current, baseline, AllocGroup::Category);
+    log_rows(&rows, rows.count, have_baseline);
+
+    logf_ln("By call site, top %u:", max_sites);
+    build_rows(&rows, current, baseline, AllocGroup::Site);
+    log_rows(&rows, max_sites, have_baseline);
+
+    u64 histogram[ALLOC_HISTOGRAM_BUCKETS] = {};
+    for (DynArrayCount i = 0; i < rows.count; ++i)
+    {
+        for (size_t b = 0; b < ALLOC_HISTOGRAM_BUCKETS; ++b)
+        {
+            histogram[b] += rows[i].size_histogram[b];
+        }
+    }
+
+    logln("Live blocks by size:");
+    for (size_t b = 0; b < ALLOC_HISTOGRAM_BUCKETS; ++b)
+    {
+        if (!histogram[b])
+        {
+            continue;
+        }
+        // the last bucket has no limit, it's everything past the one before
+        size_t limit = mem::histogram_bucket_limit(b);
+        char limit_text[32];
+        format_bytes(limit_text, sizeof(limit_text),
+                     (s64)(limit ? limit : mem::histogram_bucket_limit(b - 1)));
+        logf_ln("  %s %-9s %llu", limit ? "<=" : " >", limit_text, (unsigned long long)histogram[b]);
+    }
+
+    dynarray::deinit(&rows);
+}
+
+}
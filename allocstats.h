@@ -0,0 +1,89 @@
+// -*- c++ -*-
+
+#ifndef ALLOCSTATS_H
+
+#include "memory.h"
+#include "dynarray.h"
+#include "numeric_types.h"
+
+
+/*
+Allocation accounting on top of the allocator's per call site counters.
+A snapshot copies every site at one point in time. Rows group a snapshot
+by call site or by category, and against an earlier snapshot carry the
+change since then and the allocation rate in between, which is how a
+load that bloats memory gets traced back to the lines responsible.
+*/
+
+namespace AllocGroup
+{
+
+enum Tag
+{
+    Site,
+    Category
+};
+
+}
+
+
+struct AllocSnapshot
+{
+    // 0 until the first snapshot is taken
+    u64 abstime;
+    mem::AllocatorStats totals;
+    DynArray<mem::AllocationSiteStats> sites;
+};
+
+
+struct AllocStatsRow
+{
+    // null when grouped by category
+    const char *sourceline;
+    const char *category;
+    u64 live_bytes;
+    u64 live_count;
+    // change since the baseline, 0 without one
+    s64 delta_bytes;
+    s64 delta_count;
+    // blocks made since the baseline, or since startup without one
+    u64 allocations;
+    double allocs_per_sec;
+    u64 size_histogram[ALLOC_HISTOGRAM_BUCKETS];
+};
+
+
+namespace allocstats
+{
+
+// Snapshot memory comes from malloc directly and doesn't show up in the counts
+void take_snapshot(AllocSnapshot *snapshot, mem::IAllocator *allocator = nullptr);
+void free_snapshot(AllocSnapshot *snapshot);
+
+inline bool has_snapshot(const AllocSnapshot *snapshot)
+{
+    return snapshot->abstime != 0;
+}
+
+// Biggest live bytes first. baseline may be null.
+void build_rows(DynArray<AllocStatsRow> *rows,
+                const AllocSnapshot *current, const AllocSnapshot *baseline,
+                AllocGroup::Tag group);
+
+// Totals, the category breakdown, the top max_sites call sites and the
+// size histogram, to the log
+void log_report(const AllocSnapshot *current, const AllocSnapshot *baseline, u32 max_sites);
+
+// "12.3 MB", with a sign if show_sign
+void format_bytes(char *buffer, size_t buffer_size, s64 bytes, bool show_sign = false);
+
+inline const char *category_label(const char *category)
+{
+    return category && category[0] ? category : "(none)";
+}
+
+}
+
+
+#define ALLOCSTATS_H
+#endif
@@ -0,0 +1,252 @@
+// -*- c++ -*-
+#ifndef ATOMICS_H
+
+#include "numeric_types.h"
+#include "common.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+Just enough atomics to get by without C++11.
+
+clang and gcc get the __atomic builtins, MSVC gets the Interlocked
+intrinsics (plain volatile loads/stores are acquire/release there).
+*/
+
+namespace atomic
+{
+
+#if defined(__clang__) || defined(__GNUC__)
+
+inline u32 load_relaxed(const volatile u32 *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+inline u32 load_acquire(const volatile u32 *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+inline void store_release(volatile u32 *ptr, u32 value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+// returns the value before the add
+inline u32 fetch_add(volatile u32 *ptr, u32 value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+inline bool compare_exchange(volatile u32 *ptr, u32 expected, u32 desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+inline u64 load_acquire(const volatile u64 *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+inline void store_release(volatile u64 *ptr, u64 value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+inline u64 fetch_add(volatile u64 *ptr, u64 value)
+{
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+inline bool compare_exchange(volatile u64 *ptr, u64 expected, u64 desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+inline T *load_acquire(T *const volatile *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+inline void store_release(T *volatile *ptr, T *value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+inline bool compare_exchange(T *volatile *ptr, T *expected, T *desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Keeps plain reads before it from moving after later loads
+inline void fence_acquire()
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+inline void cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+#elif defined(_MSC_VER)
+
+inline u32 load_relaxed(const volatile u32 *ptr)
+{
+    return *ptr;
+}
+
+inline u32 load_acquire(const volatile u32 *ptr)
+{
+    u32 result = *ptr;
+    _ReadWriteBarrier();
+    return result;
+}
+
+inline void store_release(volatile u32 *ptr, u32 value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
+}
+
+inline u32 fetch_add(volatile u32 *ptr, u32 value)
+{
+    return (u32)_InterlockedExchangeAdd((volatile long *)ptr, (long)value);
+}
+
+inline bool compare_exchange(volatile u32 *ptr, u32 expected, u32 desired)
+{
+    return (u32)_InterlockedCompareExchange((volatile long *)ptr, (long)desired, (long)expected) == expected;
+}
+
+inline u64 load_acquire(const volatile u64 *ptr)
+{
+    u64 result = *ptr;
+    _ReadWriteBarrier();
+    return result;
+}
+
+inline void store_release(volatile u64 *ptr, u64 value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
+}
+
+inline u64 fetch_add(volatile u64 *ptr, u64 value)
+{
+    return (u64)_InterlockedExchangeAdd64((volatile __int64 *)ptr, (__int64)value);
+}
+
+inline bool compare_exchange(volatile u64 *ptr, u64 expected, u64 desired)
+{
+    return (u64)_InterlockedCompareExchange64((volatile __int64 *)ptr, (__int64)desired, (__int64)expected) == expected;
+}
+
+template <typename T>
+inline T *load_acquire(T *const volatile *ptr)
+{
+    T *result = *ptr;
+    _ReadWriteBarrier();
+    return result;
+}
+
+template <typename T>
+inline void store_release(T *volatile *ptr, T *value)
+{
+    _ReadWriteBarrier();
+    *ptr = value;
+}
+
+template <typename T>
+inline bool compare_exchange(T *volatile *ptr, T *expected, T *desired)
+{
+    return _InterlockedCompareExchangePointer((void *volatile *)ptr, desired, expected) == expected;
+}
+
+inline void fence_acquire()
+{
+    _ReadWriteBarrier();
+}
+
+inline void cpu_relax()
+{
+    _mm_pause();
+}
+
+#else
+    #error Need atomics for compiler
+#endif
+
+}
+
+
+// For short critical sections only, there's no backoff to the OS
+struct SpinLock
+{
+    volatile u32 locked;
+};
+
+
+namespace spinlock
+{
+
+inline bool try_acquire(SpinLock *lock)
+{
+    return atomic::compare_exchange(&lock->locked, 0, 1);
+}
+
+inline void acquire(SpinLock *lock)
+{
+    while (!try_acquire(lock))
+    {
+        while (atomic::load_relaxed(&lock->locked))
+        {
+            atomic::cpu_relax();
+        }
+    }
+}
+
+inline void release(SpinLock *lock)
+{
+    assert(atomic::load_relaxed(&lock->locked));
+    atomic::store_release(&lock->locked, 0);
+}
+
+}
+
+
+class SpinLockGuard
+{
+public:
+    explicit SpinLockGuard(SpinLock *lock_)
+        : lock(lock_)
+    {
+        spinlock::acquire(lock);
+    }
+
+    ~SpinLockGuard()
+    {
+        spinlock::release(lock);
+    }
+
+private:
+    SpinLock *lock;
+
+    SpinLockGuard(const SpinLockGuard &);
+    SpinLockGuard &operator=(const SpinLockGuard &);
+};
+
+
+#define ATOMICS_H
+#endif
@@ -0,0 +1,329 @@
+#include "benchutil.h"
+#include "datagen.h"
+#include "programstate.h"
+#include "typesys.h"
+#include "typesys_json.h"
+#include "logging.h"
+#include "formatbuffer.h"
+#include "platform.h"
+#include "memory.h"
+#include "common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+/*
+Benchmarks for the load and typing pipeline over a directory of json.
+
+  jsoneditor_bench gen DIR [generator options]
+  jsoneditor_bench run DIR [--iterations N] [--json] [--generate [generator options]]
+
+Build with CMAKE_BUILD_TYPE=Release for numbers worth comparing, debug
+builds spend most of their time in allocator validation.
+*/
+
+
+static void print_usage(const char *program)
+{
+    std::printf("usage:\n"
+                "  %s gen DIR [generator options]\n"
+                "  %s run DIR [--iterations N] [--json] [--generate] [generator options]\n"
+                "\n"
+                "generator options:\n"
+                "  --files N          files to write (default 200)\n"
+                "  --depth N          nesting depth below the top object (default 3)\n"
+                "  --keys N           distinct object keys (default 32)\n"
+                "  --fields N         fields per object (default 8)\n"
+                "  --array-max N      longest array (default 8)\n"
+                "  --union-pct N      percent of arrays with mixed element types (default 20)\n"
+                "  --optional-pct N   percent chance a field is left out of a record (default 10)\n"
+                "  --strlen MIN:MAX   string lengths (default 4:32)\n"
+                "  --strlen-skew F    1 is uniform, higher favors short strings (default 1)\n"
+                "  --seed N           (default 1)\n",
+                program, program);
+}
+
+
+struct BenchOptions
+{
+    const char *mode;
+    const char *dir;
+    u32 iterations;
+    bool generate;
+    BenchFormat::Tag format;
+    DataGenParams gen;
+};
+
+
+static bool parse_u32(const char *text, u32 *out)
+{
+    char *end = nullptr;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value > UINT32_MAX)
+    {
+        return false;
+    }
+    *out = (u32)value;
+    return true;
+}
+
+
+static bool parse_options(BenchOptions *options, int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return false;
+    }
+
+    options->mode = argv[1];
+    options->dir = argv[2];
+    options->iterations = 10;
+    options->generate = 0 == std::strcmp(options->mode, "gen");
+    options->format = BenchFormat::Text;
+    options->gen = datagen::default_params();
+
+    if (0 != std::strcmp(options->mode, "gen") && 0 != std::strcmp(options->mode, "run"))
+    {
+        return false;
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (0 == std::strcmp(arg, "--json"))
+        {
+            options->format = BenchFormat::Json;
+            continue;
+        }
+        if (0 == std::strcmp(arg, "--generate"))
+        {
+            options->generate = true;
+            continue;
+        }
+
+        if (!value)
+        {
+            std::printf("%s needs a value\n", arg);
+            return false;
+        }
+        ++i;
+
+        if      (0 == std::strcmp(arg, "--iterations"))   ok = parse_u32(value, &options->iterations);
+        else if (0 == std::strcmp(arg, "--files"))        ok = parse_u32(value, &options->gen.file_count);
+        else if (0 == std::strcmp(arg, "--depth"))        ok = parse_u32(value, &options->gen.max_depth);
+        else if (0 == std::strcmp(arg, "--keys"))         ok = parse_u32(value, &options->gen.key_cardinality);
+        else if (0 == std::strcmp(arg, "--fields"))       ok = parse_u32(value, &options->gen.fields_per_object);
+        else if (0 == std::strcmp(arg, "--array-max"))    ok = parse_u32(value, &options->gen.max_array_length);
+        else if (0 == std::strcmp(arg, "--union-pct"))    ok = parse_u32(value, &options->gen.union_array_pct);
+        else if (0 == std::strcmp(arg, "--optional-pct")) ok = parse_u32(value, &options->gen.optional_field_pct);
+        else if (0 == std::strcmp(arg, "--strlen-skew"))  options->gen.strlen_skew = (float)std::atof(value);
+        else if (0 == std::strcmp(arg, "--seed"))
+        {
+            unsigned long long seed;
+            ok = 1 == std::sscanf(value, "%llu", &seed);
+            options->gen.seed = seed;
+        }
+        else if (0 == std::strcmp(arg, "--strlen"))
+        {
+            unsigned int lo, hi;
+            ok = 2 == std::sscanf(value, "%u:%u", &lo, &hi);
+            options->gen.strlen_min = lo;
+            options->gen.strlen_max = hi;
+        }
+        else
+        {
+            std::printf("Unknown option '%s'\n", arg);
+            return false;
+        }
+
+        if (!ok)
+        {
+            std::printf("Bad value for %s: '%s'\n", arg, value);
+            return false;
+        }
+    }
+
+    return options->iterations > 0;
+}
+
+
+static u64 json_bytes_in_dir(const char *dir)
+{
+    u64 result = 0;
+    DirLister dirlist(dir);
+    while (dirlist.next())
+    {
+        if (dirlist.current.is_file && str_endswith_ignorecase(dirlist.current.name, ".json"))
+        {
+            result += dirlist.current.filesize;
+        }
+    }
+    return result;
+}
+
+
+static Collection *bench_load(ProgramState *prgstate, const char *dir)
+{
+    LoadJsonDirResult load_result = load_json_dir(prgstate, dir, std::strlen(dir));
+    if (load_result.error_kind != LoadJsonDirResult::NoError || !load_result.collection)
+    {
+        std::printf("Failed to load '%s'\n", dir);
+        load_result.release();
+        std::exit(1);
+    }
+    return load_result.collection;
+}
+
+
+static void bench_drop(ProgramState *prgstate, Collection *collection)
+{
+    drop_collection(prgstate, bucketarray::bucketindex_of(&prgstate->collections, collection));
+}
+
+
+static void run_benchmarks(const BenchOptions *options)
+{
+    ProgramState prgstate;
+    prgstate_init(&prgstate);
+    load_base_type_descriptors(&prgstate);
+
+    const char *dir = options->dir;
+    u64 dir_bytes = json_bytes_in_dir(dir);
+    BenchFormat::Tag format = options->format;
+    BenchRun run;
+    BenchResult result;
+
+    bench::print_header(format);
+
+    // The first load fills the type table, later ones find their types in it
+    bench::begin_run(&run);
+    bench::begin_iteration(&run);
+    Collection *collection = bench_load(&prgstate, dir);
+    bench::end_iteration(&run);
+    u64 record_count = collection->value.array_value.elements.count;
+    result = bench::finish_run(&run, "load_json_dir", "cold", record_count, dir_bytes);
+    bench::print_result(&result, format);
+
+    bench::begin_run(&run);
+    for (u32 i = 0; i < options->iterations; ++i)
+    {
+        bench_drop(&prgstate, collection);
+        bench::begin_iteration(&run);
+        collection = bench_load(&prgstate, dir);
+        bench::end_iteration(&run);
+    }
+    result = bench::finish_run(&run, "load_json_dir", "warm", record_count, dir_bytes);
+    bench::print_result(&result, format);
+
+    const DynArray<Value> &records = collection->value.array_value.elements;
+
+    bench::begin_run(&run);
+    for (u32 i = 0; i < options->iterations; ++i)
+    {
+        bench::begin_iteration(&run);
+        merge_each_type(&prgstate, records);
+        bench::end_iteration(&run);
+    }
+    result = bench::finish_run(&run, "merge_each_type", "records", record_count, 0);
+    bench::print_result(&result, format);
+
+    // Every lookup hits, it's the whole table
+    u64 type_count = prgstate.type_descriptors.count;
+    bench::begin_run(&run);
+    for (u32 i = 0; i < options->iterations; ++i)
+    {
+        bench::begin_iteration(&run);
+        for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(&prgstate.type_descriptors);
+             bucketarray::next(&it);)
+        {
+            TypeDescriptor *found = find_equiv_typedesc(&prgstate, it.elem);
+            ASSERT(found);
+        }
+        bench::end_iteration(&run);
+    }
+    result = bench::finish_run(&run, "find_equiv_typedesc", "all types", type_count, 0);
+    bench::print_result(&result, format);
+
+    BenchRun clone_run;
+    BenchRun equal_run;
+    BenchRun free_run;
+    bench::begin_run(&clone_run);
+    bench::begin_run(&equal_run);
+    bench::begin_run(&free_run);
+    for (u32 i = 0; i < options->iterations; ++i)
+    {
+        bench::begin_iteration(&clone_run);
+        Value copy = clone(&collection->value);
+        bench::end_iteration(&clone_run);
+
+        bench::begin_iteration(&equal_run);
+        bool equal = value_equal(collection->value, copy);
+        bench::end_iteration(&equal_run);
+        ASSERT(equal);
+
+        bench::begin_iteration(&free_run);
+        value_free_components(&copy);
+        bench::end_iteration(&free_run);
+    }
+    result = bench::finish_run(&clone_run, "clone", "collection", record_count, 0);
+    bench::print_result(&result, format);
+    result = bench::finish_run(&equal_run, "value_equal", "collection vs clone", record_count, 0);
+    bench::print_result(&result, format);
+    result = bench::finish_run(&free_run, "value_free_components", "clone", record_count, 0);
+    bench::print_result(&result, format);
+
+    if (format == BenchFormat::Text)
+    {
+        std::printf("\n%llu records, %llu bytes, %llu type descriptors\n",
+                    (unsigned long long)record_count, (unsigned long long)dir_bytes,
+                    (unsigned long long)prgstate.type_descriptors.count);
+    }
+}
+
+
+static void discard_log_write(void *userdata, const char *buffer, size_t length)
+{
+    UNUSED(userdata);
+    UNUSED(buffer);
+    UNUSED(length);
+}
+
+
+int main(int argc, char **argv)
+{
+    mem::memory_init(logf_with_userdata, nullptr);
+    // Keep pretty printers and the like from writing into the results
+    FormatBuffer::set_default_flush_fn(discard_log_write, nullptr);
+
+    BenchOptions options = {};
+    if (!parse_options(&options, argc, argv))
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    if (options.generate)
+    {
+        s64 bytes = datagen::generate_json_dir(options.dir, &options.gen);
+        if (bytes < 0)
+        {
+            return 1;
+        }
+        if (options.format == BenchFormat::Text)
+        {
+            std::printf("Wrote %u files, %lld bytes to %s\n",
+                        options.gen.file_count, (long long)bytes, options.dir);
+        }
+    }
+
+    if (0 == std::strcmp(options.mode, "run"))
+    {
+        run_benchmarks(&options);
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "benchutil.h"
+#include "platform.h"
+#include "common.h"
+#include <algorithm>
+#include <cstdio>
+
+
+namespace bench
+{
+
+void begin_run(BenchRun *run)
+{
+    mem::zero_ptr(run);
+    dynarray::init(&run->samples_ms, 16);
+}
+
+
+void begin_iteration(BenchRun *run)
+{
+    mem::IAllocator *allocator = mem::default_allocator();
+    allocator->reset_peak();
+    run->stats_at_start = allocator->stats();
+    run->iteration_start = query_abstime();
+}
+
+
+void end_iteration(BenchRun *run)
+{
+    u64 end = query_abstime();
+    mem::AllocatorStats stats = mem::default_allocator()->stats();
+
+    dynarray::append(&run->samples_ms, milliseconds_since(end, run->iteration_start));
+    run->allocations += stats.total_allocations - run->stats_at_start.total_allocations;
+    run->peak_bytes = max(run->peak_bytes,
+                          (u64)(stats.peak_bytes_allocated - run->stats_at_start.bytes_allocated));
+}
+
+
+BenchResult finish_run(BenchRun *run, const char *name, const char *variant, u64 items, u64 bytes)
+{
+    BenchResult result = {};
+    result.name = name;
+    result.variant = variant;
+    result.items = items;
+    result.bytes = bytes;
+    result.iterations = run->samples_ms.count;
+
+    if (run->samples_ms.count > 0)
+    {
+        double *samples = run->samples_ms.data;
+        DynArrayCount count = run->samples_ms.count;
+        std::sort(samples, samples + count);
+
+        double sum = 0;
+        for (DynArrayCount i = 0; i < count; ++i)
+        {
+            sum += samples[i];
+        }
+
+        result.min_ms = samples[0];
+        result.median_ms = (count & 1)
+            ? samples[count / 2]
+            : (samples[count / 2 - 1] + samples[count / 2]) * 0.5;
+        result.mean_ms = sum / count;
+        result.allocations = run->allocations / count;
+        result.peak_bytes = run->peak_bytes;
+    }
+
+    dynarray::deinit(&run->samples_ms);
+    return result;
+}
+
+
+void print_header(BenchFormat::Tag format)
+{
+    if (format == BenchFormat::Text)
+    {
+        std::printf("%-26s %-24s %6s %11s %11s %13s %10s %10s %12s\n",
+                    "benchmark", "variant", "iters", "min ms", "median ms",
+                    "items/s", "MB/s", "allocs", "peak bytes");
+    }
+}
+
+
+void print_result(const BenchResult *result, BenchFormat::Tag format)
+{
+    // throughput from the median so one lucky run doesn't skew it
+    double seconds = result->median_ms * 0.001;
+    double items_per_sec = result->items && seconds > 0 ? (double)result->items / seconds : 0;
+    double mb_per_sec = result->bytes && seconds > 0 ? (double)result->bytes / (1024.0 * 1024.0) / seconds : 0;
+
+    if (format == BenchFormat::Json)
+    {
+        std::printf("{\"name\":\"%s\",\"variant\":\"%s\",\"iterations\":%u,"
+                    "\"min_ms\":%.6f,\"median_ms\":%.6f,\"mean_ms\":%.6f,"
+                    "\"items\":%llu,\"items_per_sec\":%.1f,\"bytes\":%llu,\"mb_per_sec\":%.3f,"
+                    "\"allocations\":%llu,\"peak_bytes\":%llu}\n",
+                    result->name, result->variant, result->iterations,
+                    result->min_ms, result->median_ms, result->mean_ms,
+                    (unsigned long long)result->items, items_per_sec,
+                    (unsigned long long)result->bytes, mb_per_sec,
+                    (unsigned long long)result->allocations,
+                    (unsigned long long)result->peak_bytes);
+        return;
+    }
+
+    char items_column[32] = "-";
+    char mb_column[32] = "-";
+    if (result->items)
+    {
+        snprintf(items_column, sizeof(items_column), "%.0f", items_per_sec);
+    }
+    if (result->bytes)
+    {
+        snprintf(mb_column, sizeof(mb_column), "%.2f", mb_per_sec);
+    }
+
+    std::printf("%-26s %-24s %6u %11.3f %11.3f %13s %10s %10llu %12llu\n",
+                result->name, result->variant, result->iterations,
+                result->min_ms, result->median_ms, items_column, mb_column,
+                (unsigned long long)result->allocations,
+                (unsigned long long)result->peak_bytes);
+}
+
+}
@@ -0,0 +1,73 @@
+// -*- c++ -*-
+
+#ifndef BENCHUTIL_H
+
+#include "numeric_types.h"
+#include "dynarray.h"
+#include "memory.h"
+
+
+/*
+Timing and reporting shared by the benchmark executables. A BenchRun
+collects one sample per iteration along with allocator counts, and
+finish_run boils them down to a BenchResult. Results print either as a
+text table or as one json object per line for scripts to diff.
+*/
+
+namespace BenchFormat
+{
+
+enum Tag
+{
+    Text,
+    Json
+};
+
+}
+
+
+struct BenchResult
+{
+    const char *name;
+    // what was varied for this run, e.g. "cold" or "n=1000 load=0.5"
+    const char *variant;
+    u32 iterations;
+    double min_ms;
+    double median_ms;
+    double mean_ms;
+    // work done per iteration, 0 to leave the throughput column out
+    u64 items;
+    u64 bytes;
+    // per iteration, from the default allocator
+    u64 allocations;
+    u64 peak_bytes;
+};
+
+
+struct BenchRun
+{
+    DynArray<double> samples_ms;
+    u64 iteration_start;
+    mem::AllocatorStats stats_at_start;
+    u64 allocations;
+    u64 peak_bytes;
+};
+
+
+namespace bench
+{
+
+void begin_run(BenchRun *run);
+void begin_iteration(BenchRun *run);
+void end_iteration(BenchRun *run);
+// Frees the samples, the strings must outlive the result
+BenchResult finish_run(BenchRun *run, const char *name, const char *variant, u64 items, u64 bytes);
+
+void print_header(BenchFormat::Tag format);
+void print_result(const BenchResult *result, BenchFormat::Tag format);
+
+}
+
+
+#define BENCHUTIL_H
+#endif
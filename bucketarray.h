@@ -8,72 +8,22 @@
 #include "platform.h" // uggggghhhhh
 
 
-/*
-TODO(mike): unit test with doctest or something
-
-    const int test_amount = 25;
-
-    BucketArray<TypeDescriptor, 9> typedesc_bucket;
-    bucketarray_init(&typedesc_bucket);
-    u32 typeids = 0;
-    for (int i = 0; i < test_amount; ++i)
-    {
-        TypeDescriptor tdtest = {};
-        tdtest.type_id = typeids;
-        ++typeids;
-        *bucketarray_add(&typedesc_bucket).elem = tdtest;
-    }
-
-    for (int i = 0; i < test_amount; ++i)
-    {
-        if (i % 2 == 0)
-        {
-            bucketarray_remove(&typedesc_bucket, i);
-        }
-    }
-    {
-        TypeDescriptor tdtest = {};
-        tdtest.type_id = typeids;
-        *bucketarray_add(&typedesc_bucket).elem = tdtest;
-    }
-
-    DynArray<u32> test;
-    dynarray::init(&test, test_amount);
-    test.count = test_amount;
-    for (int i = test_amount - 1; i >= 0; --i)
-    {
-        TypeDescriptor *td;
-        if (bucketarray_get_if_not_empty(&typedesc_bucket, i, &td))
-        {
-            test[DYNARRAY_COUNT(i)] = td->type_id;
-        }
-    }
-
-    for (DynArrayCount i = 0, e = test.count; i < e; ++i)
-    {
-        logf_ln("%i: %u", i, test[i]);
-    }
-
-    for (int i = 0; i < test_amount; ++i)
-    {
-        TypeDescriptor *td = &typedesc_bucket[i];
-        BucketIndex idx = bucketarray_bucketindex_of_ptr(&typedesc_bucket, td);
-        s32 indexified = bucketarray_indexify(&typedesc_bucket, idx);
-        ASSERT(i == indexified);
-    }
-
-    return 0;
-
- */
-
-
 typedef u32 BucketItemCount;
 #define BUCKETITEMCOUNT(n) U32(n)
 
+#define BUCKET_OCCUPANCY_WORDS(item_count) (((item_count) + 63) / 64)
+
+/*
+Occupancy is a bitmask, so finding free slots and iterating only
+touches one word per 64 items and skips empty runs with ctz.
+
+The buckets are also kept sorted by address, so the bucket owning an
+item pointer is a binary search away.
+*/
 template<typename T, BucketItemCount ItemCount>
 struct Bucket
 {
-    u8 occupied[ItemCount];
+    u64 occupied[BUCKET_OCCUPANCY_WORDS(ItemCount)];
     T items[ItemCount];
     size_t count;
     DynArrayCount index;
@@ -100,12 +50,19 @@ struct IndexElemPair
 };
 
 
+template <typename T, BucketItemCount ItemCount>
+struct BucketArrayIterator;
+
 
 template <typename T, BucketItemCount ItemCount = 64>
 struct BucketArray
 {
+    typedef BucketArrayIterator<T, ItemCount> Iterator;
+
     DynArray<Bucket<T, ItemCount> *> all_buckets;
     DynArray<Bucket<T, ItemCount> *> vacancy_buckets;
+    // all_buckets sorted by address, for bucketindex_of
+    DynArray<Bucket<T, ItemCount> *> buckets_by_address;
     BucketItemCount count;
     BucketItemCount capacity;
 
@@ -131,6 +88,29 @@ struct BucketArray
 };
 
 
+/*
+Visits only occupied items:
+
+    for (BucketArray<Foo>::Iterator it = bucketarray::iterate(&foos); bucketarray::next(&it);)
+    {
+        Foo *foo = it.elem;
+    }
+*/
+template <typename T, BucketItemCount ItemCount>
+struct BucketArrayIterator
+{
+    const BucketArray<T, ItemCount> *ba;
+    DynArrayCount bucket_index;
+    u32 word_index;
+    // Occupied bits in the current word not visited yet
+    u64 remaining;
+
+    T *elem;
+    BucketIndex bidx;
+    BucketItemCount index;
+};
+
+
 namespace bucketarray
 {
 
@@ -147,8 +127,47 @@ void init(BucketArray<T, ItemCount> *ba,
     ba->allocator = allocator;
     ba->count = 0;
     ba->capacity = 0;
+
     dynarray::init(&ba->all_buckets, initial_bucket_capacity, allocator);
     dynarray::init(&ba->vacancy_buckets, initial_bucket_capacity, allocator);
+    dynarray::init(&ba->buckets_by_address, initial_bucket_capacity, allocator);
+}
+
+
+template<typename T, BucketItemCount ItemCount>
+void deinit(BucketArray<T, ItemCount> *ba)
+{
+    for (DynArrayCount i = 0; i < ba->all_buckets.count; ++i)
+    {
+        ba->allocator->dealloc(ba->all_buckets[i]);
+    }
+    dynarray::deinit(&ba->all_buckets);
+    dynarray::deinit(&ba->vacancy_buckets);
+    dynarray::deinit(&ba->buckets_by_address);
+    ba->count = 0;
+    ba->capacity = 0;
+}
+
+
+template<typename T, BucketItemCount ItemCount>
+inline bool is_occupied(const Bucket<T, ItemCount> *bucket, s32 item_index)
+{
+    return (bucket->occupied[item_index / 64] >> (item_index % 64)) & 1;
+}
+
+
+template<typename T, BucketItemCount ItemCount>
+inline void set_occupied(Bucket<T, ItemCount> *bucket, s32 item_index, bool occupied)
+{
+    u64 bit = u64(1) << (item_index % 64);
+    if (occupied)
+    {
+        bucket->occupied[item_index / 64] |= bit;
+    }
+    else
+    {
+        bucket->occupied[item_index / 64] &= ~bit;
+    }
 }
 
 
@@ -158,14 +177,20 @@ BucketIndex translate_index(const BucketArray<T, ItemCount> *ba, BucketItemCount
     ASSERT(index >= 0);
     BucketIndex result;
     DynArrayCount dacidx = DYNARRAY_COUNT(index);
-    result.bucket_index = dacidx / ItemCount;
+    result.bucket_index = S32(dacidx / ItemCount);
     ASSERT(DYNARRAY_COUNT(result.bucket_index) < ba->all_buckets.count);
-    result.item_index = dacidx % ItemCount;
-    ASSERT(DYNARRAY_COUNT(result.bucket_index) <= ItemCount);
+    result.item_index = S32(dacidx % ItemCount);
     return result;
 }
 
 
+template<typename T, BucketItemCount ItemCount>
+BucketItemCount flat_index(BucketIndex bidx)
+{
+    return BUCKETITEMCOUNT(bidx.bucket_index) * ItemCount + BUCKETITEMCOUNT(bidx.item_index);
+}
+
+
 template<typename T, BucketItemCount ItemCount>
 bool exists(OUTPARAM BucketIndex *out_bidx, BucketArray<T, ItemCount> *ba, BucketItemCount index)
 {
@@ -176,20 +201,15 @@ bool exists(OUTPARAM BucketIndex *out_bidx, BucketArray<T, ItemCount> *ba, Bucke
 
     BucketIndex bidx = translate_index(ba, index);
     *out_bidx = bidx;
-    return ba->all_buckets[bidx.bucket_index]->occupied[bidx.item_index];
+    return is_occupied(ba->all_buckets[DYNARRAY_COUNT(bidx.bucket_index)], bidx.item_index);
 }
 
 
 template<typename T, BucketItemCount ItemCount>
 bool exists(BucketArray<T, ItemCount> *ba, BucketItemCount index)
 {
-    if (index >= ba->capacity)
-    {
-        return false;
-    }
-
-    BucketIndex bidx = translate_index(ba, index);
-    return ba->all_buckets[bidx.bucket_index]->occupied[bidx.item_index];
+    BucketIndex bidx;
+    return exists(&bidx, ba, index);
 }
 
 
@@ -215,6 +235,7 @@ bool exists(BucketArray<T, ItemCount> *ba, s32 index)
 }
 
 
+// elem must point into one of ba's buckets
 template<typename T, BucketItemCount ItemCount>
 BucketIndex bucketindex_of(BucketArray<T, ItemCount> *ba, T *elem)
 {
@@ -222,18 +243,33 @@ BucketIndex bucketindex_of(BucketArray<T, ItemCount> *ba, T *elem)
     result.bucket_index = -1;
     result.item_index = -1;
 
-    intptr_t ptr = reinterpret_cast<intptr_t>(elem);
-    for (BucketItemCount i = 0, e = u32(ba->all_buckets.count); i < e; ++i)
+    // The last bucket starting at or below elem
+    uintptr_t ptr = reinterpret_cast<uintptr_t>(elem);
+    DynArrayCount lo = 0;
+    DynArrayCount hi = ba->buckets_by_address.count;
+    while (lo < hi)
     {
-        intptr_t bucket_items = reinterpret_cast<intptr_t>(ba->all_buckets[DYNARRAY_COUNT(i)]->items);
-        intptr_t past_bucketitems_end = bucket_items + static_cast<intptr_t>(ItemCount * sizeof(T));
-        if ((ptr >= bucket_items) && (ptr < past_bucketitems_end))
+        DynArrayCount mid = lo + (hi - lo) / 2;
+        if (reinterpret_cast<uintptr_t>(ba->buckets_by_address[mid]) <= ptr)
         {
-            intptr_t diff = ptr - bucket_items;
-            result.bucket_index = S32(i);
-            intptr_t itemidx = diff / INTPTR_T(sizeof(T));
-            result.item_index = S32(itemidx);
-            break;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    ASSERT(lo > 0);
+    if (lo > 0)
+    {
+        Bucket<T, ItemCount> *bucket = ba->buckets_by_address[lo - 1];
+        uintptr_t items = reinterpret_cast<uintptr_t>(bucket->items);
+        ASSERT(ptr >= items && ptr < items + ItemCount * sizeof(T));
+        if (ptr >= items && ptr < items + ItemCount * sizeof(T))
+        {
+            result.bucket_index = S32(bucket->index);
+            result.item_index = S32((ptr - items) / sizeof(T));
         }
     }
 
@@ -244,12 +280,24 @@ BucketIndex bucketindex_of(BucketArray<T, ItemCount> *ba, T *elem)
 template<typename T, BucketItemCount ItemCount>
 Bucket<T, ItemCount> *addbucket(BucketArray<T, ItemCount> *ba)
 {
-    Bucket<T, ItemCount> *bucket = MAKE_OBJ(ba->allocator, Bucket<T, ItemCount>);
+    Bucket<T, ItemCount> *bucket = MAKE_OBJ_CAT(ba->allocator, "bucketarray", Bucket<T, ItemCount>);
     bucket->index = ba->all_buckets.count;
     bucket->count = 0;
     ba->capacity += ItemCount;
     mem::zero_obj(bucket->occupied);
     dynarray::append(&ba->all_buckets, bucket);
+
+    // Buckets are few and added rarely, shifting the tail is fine
+    DynArray<Bucket<T, ItemCount> *> *by_address = &ba->buckets_by_address;
+    dynarray::append(by_address, bucket);
+    DynArrayCount slot = by_address->count - 1;
+    while (slot > 0 && reinterpret_cast<uintptr_t>((*by_address)[slot - 1]) > reinterpret_cast<uintptr_t>(bucket))
+    {
+        (*by_address)[slot] = (*by_address)[slot - 1];
+        --slot;
+    }
+    (*by_address)[slot] = bucket;
+
     return *dynarray::append(&ba->vacancy_buckets, bucket);
 }
 
@@ -258,11 +306,17 @@ template<typename T, BucketItemCount ItemCount>
 bool remove_at(BucketArray<T, ItemCount> *ba, BucketIndex bidx)
 {
     Bucket<T, ItemCount> *b = ba->all_buckets[DynArrayCount(bidx.bucket_index)];
-    if (!b->occupied[bidx.item_index]) {
+    if (!is_occupied(b, bidx.item_index)) {
         return false;
     }
 
-    b->occupied[bidx.item_index] = false;
+    // A full bucket isn't in the vacancy list, now it has room again
+    if (b->count == ItemCount)
+    {
+        dynarray::append(&ba->vacancy_buckets, b);
+    }
+
+    set_occupied(b, bidx.item_index, false);
     --b->count;
     --ba->count;
     return true;
@@ -272,8 +326,8 @@ bool remove_at(BucketArray<T, ItemCount> *ba, BucketIndex bidx)
 template<typename T, BucketItemCount ItemCount>
 bool remove_at(BucketArray<T, ItemCount> *ba, s32 index)
 {
-    BucketIndex bidx = bucketarray::translate_index(ba, index);
-    return remove(ba, bidx);
+    BucketIndex bidx = bucketarray::translate_index(ba, BUCKETITEMCOUNT(index));
+    return remove_at(ba, bidx);
 }
 
 
@@ -297,6 +351,55 @@ BucketIndex remove(BucketArray<T, ItemCount> *ba, T *item)
 }
 
 
+// Frees the buckets with nothing in them. Items don't move, but the flat
+// indices of those in later buckets change.
+template<typename T, BucketItemCount ItemCount>
+DynArrayCount release_empty_buckets(BucketArray<T, ItemCount> *ba)
+{
+    // Filtering keeps the address order
+    DynArrayCount kept_by_address = 0;
+    for (DynArrayCount i = 0; i < ba->buckets_by_address.count; ++i)
+    {
+        Bucket<T, ItemCount> *bucket = ba->buckets_by_address[i];
+        if (bucket->count)
+        {
+            ba->buckets_by_address[kept_by_address++] = bucket;
+        }
+    }
+    ba->buckets_by_address.count = kept_by_address;
+
+    DynArrayCount released = 0;
+    DynArrayCount kept = 0;
+    for (DynArrayCount i = 0; i < ba->all_buckets.count; ++i)
+    {
+        Bucket<T, ItemCount> *bucket = ba->all_buckets[i];
+        if (bucket->count == 0)
+        {
+            ba->allocator->dealloc(bucket);
+            ba->capacity -= ItemCount;
+            ++released;
+            continue;
+        }
+        bucket->index = kept;
+        ba->all_buckets[kept++] = bucket;
+    }
+    ba->all_buckets.count = kept;
+
+    if (released)
+    {
+        dynarray::clear(&ba->vacancy_buckets);
+        for (DynArrayCount i = 0; i < ba->all_buckets.count; ++i)
+        {
+            if (ba->all_buckets[i]->count < ItemCount)
+            {
+                dynarray::append(&ba->vacancy_buckets, ba->all_buckets[i]);
+            }
+        }
+    }
+    return released;
+}
+
+
 template<typename T, BucketItemCount ItemCount>
 IndexElemPair<T> add(BucketArray<T, ItemCount> *ba)
 {
@@ -310,24 +413,30 @@ IndexElemPair<T> add(BucketArray<T, ItemCount> *ba)
     else
     {
         bucket = bucketarray::addbucket(ba);
+        vacant_bucket_count = ba->vacancy_buckets.count;
     }
 
     ASSERT(bucket);
     ASSERT(bucket->count < ItemCount);
 
     s32 selected_index = -1;
-    for (s32 i = 0, e = ItemCount; i < e; ++i)
+    for (u32 w = 0; w < BUCKET_OCCUPANCY_WORDS(ItemCount); ++w)
     {
-        if (!bucket->occupied[i])
+        u64 vacant = ~bucket->occupied[w];
+        if (vacant)
         {
-            bucket->occupied[i] = true;
-            selected_index = i;
+            s32 candidate = S32(w * 64 + count_trailing_zeros(vacant));
+            if (candidate < S32(ItemCount))
+            {
+                selected_index = candidate;
+            }
             break;
         }
     }
 
     ASSERT(selected_index >= 0);
 
+    set_occupied(bucket, selected_index, true);
     ++bucket->count;
 
     if (bucket->count == ItemCount)
@@ -337,7 +446,7 @@ IndexElemPair<T> add(BucketArray<T, ItemCount> *ba)
 
     ++ba->count;
 
-    IndexElemPair<T> result = {S32(bucket->index) + selected_index, &bucket->items[selected_index]};
+    IndexElemPair<T> result = {S32(bucket->index * ItemCount) + selected_index, &bucket->items[selected_index]};
     return result;
 }
 
@@ -346,7 +455,7 @@ template <typename T, BucketItemCount ItemCount>
 bool get_if_not_empty(OUTPARAM T **output, const BucketArray<T, ItemCount> *ba, BucketIndex bidx)
 {
     Bucket<T, ItemCount> *b = ba->all_buckets[DYNARRAY_COUNT(bidx.bucket_index)];
-    bool found = b->occupied[bidx.item_index];
+    bool found = is_occupied(b, bidx.item_index);
     if (output) *output = found ? &b->items[bidx.item_index] : nullptr;
     return found;
 }
@@ -359,6 +468,67 @@ bool get_if_not_empty(OUTPARAM T **output, const BucketArray<T, ItemCount> *ba,
     return get_if_not_empty(output, ba, bidx);
 }
 
+
+template <typename T, BucketItemCount ItemCount>
+BucketArrayIterator<T, ItemCount> iterate(const BucketArray<T, ItemCount> *ba)
+{
+    BucketArrayIterator<T, ItemCount> it;
+    it.ba = ba;
+    it.bucket_index = 0;
+    it.word_index = 0;
+    it.remaining = ba->all_buckets.count ? ba->all_buckets[0]->occupied[0] : 0;
+    it.elem = nullptr;
+    it.bidx.bucket_index = -1;
+    it.bidx.item_index = -1;
+    it.index = 0;
+    return it;
+}
+
+
+// Advances to the next occupied item, returns false when there are none left.
+// Buckets with nothing in them are skipped without looking at their bits.
+template <typename T, BucketItemCount ItemCount>
+bool next(BucketArrayIterator<T, ItemCount> *it)
+{
+    const BucketArray<T, ItemCount> *ba = it->ba;
+
+    while (it->bucket_index < ba->all_buckets.count)
+    {
+        Bucket<T, ItemCount> *bucket = ba->all_buckets[it->bucket_index];
+
+        if (bucket->count)
+        {
+            while (it->remaining == 0 && it->word_index + 1 < BUCKET_OCCUPANCY_WORDS(ItemCount))
+            {
+                ++it->word_index;
+                it->remaining = bucket->occupied[it->word_index];
+            }
+
+            if (it->remaining)
+            {
+                u32 bit = count_trailing_zeros(it->remaining);
+                it->remaining &= it->remaining - 1;
+
+                s32 item_index = S32(it->word_index * 64 + bit);
+                it->bidx.bucket_index = S32(it->bucket_index);
+                it->bidx.item_index = item_index;
+                it->index = flat_index<T, ItemCount>(it->bidx);
+                it->elem = &bucket->items[item_index];
+                return true;
+            }
+        }
+
+        ++it->bucket_index;
+        it->word_index = 0;
+        it->remaining = it->bucket_index < ba->all_buckets.count
+            ? ba->all_buckets[it->bucket_index]->occupied[0]
+            : 0;
+    }
+
+    it->elem = nullptr;
+    return false;
+}
+
 }
 
 
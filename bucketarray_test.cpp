@@ -0,0 +1,171 @@
+#include "bucketarray.h"
+#include "common.h"
+
+
+struct BucketArrayTestItem
+{
+    u32 value;
+    u32 pad_[3];
+};
+
+
+static s32 check_iteration(BucketArray<BucketArrayTestItem, 9> *ba, const DynArray<bool> *expect_present)
+{
+    s32 fails = 0;
+    BucketItemCount visited = 0;
+    BucketItemCount last_index = 0;
+
+    for (BucketArray<BucketArrayTestItem, 9>::Iterator it = bucketarray::iterate(ba); bucketarray::next(&it);)
+    {
+        if (visited > 0 && it.index <= last_index)
+        {
+            printf_ln("Iteration went backwards: %u after %u", it.index, last_index);
+            ++fails;
+        }
+        if (it.elem->value != it.index || !(*expect_present)[it.index])
+        {
+            printf_ln("Iterated unexpected item at %u (value %u)", it.index, it.elem->value);
+            ++fails;
+        }
+
+        BucketIndex bidx = bucketarray::bucketindex_of(ba, it.elem);
+        if (bidx.bucket_index != it.bidx.bucket_index || bidx.item_index != it.bidx.item_index)
+        {
+            printf_ln("bucketindex_of mismatch at %u: [%i, %i] vs [%i, %i]", it.index,
+                      bidx.bucket_index, bidx.item_index, it.bidx.bucket_index, it.bidx.item_index);
+            ++fails;
+        }
+
+        last_index = it.index;
+        ++visited;
+    }
+
+    if (visited != ba->count)
+    {
+        printf_ln("Iterated %u items, BucketArray has %u", visited, ba->count);
+        ++fails;
+    }
+
+    return fails;
+}
+
+
+s32 run_bucketarray_tests()
+{
+    const s32 test_amount = 100;
+    s32 fails = 0;
+
+    // Odd bucket size so occupancy words have bits past the end
+    BucketArray<BucketArrayTestItem, 9> ba;
+    bucketarray::init(&ba);
+
+    DynArray<bool> present;
+    dynarray::init(&present, test_amount);
+
+    for (s32 i = 0; i < test_amount; ++i)
+    {
+        IndexElemPair<BucketArrayTestItem> added = bucketarray::add(&ba);
+        added.elem->value = BUCKETITEMCOUNT(added.index);
+        dynarray::append(&present, true);
+
+        if (added.index != i)
+        {
+            printf_ln("Added item %i got index %i", i, added.index);
+            ++fails;
+        }
+    }
+
+    fails += check_iteration(&ba, &present);
+
+    // Empty out whole buckets and leave holes in others
+    for (s32 i = 0; i < test_amount; ++i)
+    {
+        if (i % 3 == 0 || (i >= 18 && i < 45))
+        {
+            bool removed = bucketarray::remove_at(&ba, i);
+            if (!removed)
+            {
+                printf_ln("Failed to remove item %i", i);
+                ++fails;
+            }
+            present[DYNARRAY_COUNT(i)] = false;
+        }
+    }
+
+    fails += check_iteration(&ba, &present);
+
+    // Refilling should reuse the holes, including in buckets that were full
+    BucketItemCount capacity_before = ba.capacity;
+    BucketItemCount vacant = ba.capacity - ba.count;
+    for (BucketItemCount i = 0; i < vacant; ++i)
+    {
+        IndexElemPair<BucketArrayTestItem> added = bucketarray::add(&ba);
+        added.elem->value = BUCKETITEMCOUNT(added.index);
+        if (DYNARRAY_COUNT(added.index) >= present.count)
+        {
+            dynarray::append(&present, true);
+        }
+        else
+        {
+            present[DYNARRAY_COUNT(added.index)] = true;
+        }
+    }
+
+    if (ba.capacity != capacity_before)
+    {
+        printf_ln("BucketArray grew from %u to %u while refilling holes", capacity_before, ba.capacity);
+        ++fails;
+    }
+
+    fails += check_iteration(&ba, &present);
+
+    // Emptied buckets can be given back, what's left doesn't move
+    for (s32 i = 18; i < 45; ++i)
+    {
+        bucketarray::remove_at(&ba, i);
+    }
+    BucketItemCount count_before = ba.count;
+    s32 survivor_index = 60;
+    BucketArrayTestItem *survivor = &ba[survivor_index];
+    u32 survivor_value = survivor->value;
+
+    DynArrayCount released = bucketarray::release_empty_buckets(&ba);
+    if (released != 3 || ba.capacity != capacity_before - 27 || ba.count != count_before)
+    {
+        printf_ln("Releasing empty buckets: released %u, capacity %u, count %u",
+                  released, ba.capacity, ba.count);
+        ++fails;
+    }
+
+    BucketIndex survivor_bidx = bucketarray::bucketindex_of(&ba, survivor);
+    if (!survivor_bidx.is_valid() || &ba[survivor_bidx] != survivor || survivor->value != survivor_value)
+    {
+        println("Item moved or lost its bucket when empty buckets were released");
+        ++fails;
+    }
+
+    BucketItemCount visited = 0;
+    for (BucketArray<BucketArrayTestItem, 9>::Iterator it = bucketarray::iterate(&ba); bucketarray::next(&it);)
+    {
+        ++visited;
+    }
+    if (visited != ba.count)
+    {
+        printf_ln("Iterated %u items after releasing buckets, BucketArray has %u", visited, ba.count);
+        ++fails;
+    }
+
+    dynarray::deinit(&present);
+    bucketarray::deinit(&ba);
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i BucketArray test failures", fails);
+    }
+    else
+    {
+        println("No failures in BucketArray tests");
+    }
+
+    return fails;
+}
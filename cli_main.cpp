@@ -0,0 +1,134 @@
+#include "console.h"
+#include "clicommands.h"
+#include "programstate.h"
+#include "typesys.h"
+#include "logging.h"
+#include "formatbuffer.h"
+#include "memory.h"
+#include "common.h"
+#include <cstring>
+#include <cstdio>
+
+
+/*
+Headless front end: same program state and console commands as the
+editor, no SDL or GL. Commands come from -c arguments and --script
+files, in the order given. With neither, it runs the interactive prompt.
+*/
+
+s32 run_tests();
+
+
+static void print_usage(const char *program)
+{
+    printf_ln("usage: %s [options]\n"
+              "  -c, --command CMD    run a console command\n"
+              "  -s, --script FILE    run each line of FILE as a console command\n"
+              "  -i, --interactive    start the prompt after running commands\n"
+              "  -k, --keep-going     keep running commands after one fails\n"
+              "      --test           run the self tests and exit\n"
+              "  -h, --help           show this message",
+              program);
+}
+
+
+// The editor shows the log in its console, here stdout is the console
+static void cli_write_with_userdata(void *userdata, const char *buffer, size_t length)
+{
+    UNUSED(userdata);
+    append_log(buffer, length);
+    fwrite(buffer, 1, length, stdout);
+}
+
+
+static bool arg_is(const char *arg, const char *short_form, const char *long_form)
+{
+    return (short_form && 0 == std::strcmp(arg, short_form))
+        || (long_form && 0 == std::strcmp(arg, long_form));
+}
+
+
+int main(int argc, char **argv)
+{
+    mem::memory_init(logf_with_userdata, nullptr);
+    FormatBuffer::set_default_flush_fn(cli_write_with_userdata, nullptr);
+
+    bool interactive = false;
+    bool keep_going = false;
+    bool ran_any = false;
+
+    // Check the args before doing any work
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (arg_is(arg, "-h", "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg_is(arg, nullptr, "--test"))
+        {
+            return run_tests() == 0 ? 0 : 1;
+        }
+        else if (arg_is(arg, "-i", "--interactive"))
+        {
+            interactive = true;
+        }
+        else if (arg_is(arg, "-k", "--keep-going"))
+        {
+            keep_going = true;
+        }
+        else if (arg_is(arg, "-c", "--command") || arg_is(arg, "-s", "--script"))
+        {
+            if (i + 1 >= argc)
+            {
+                printf_ln("%s needs an argument", arg);
+                print_usage(argv[0]);
+                return 2;
+            }
+            ++i;
+        }
+        else
+        {
+            printf_ln("Unknown option '%s'", arg);
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    ProgramState prgstate;
+    prgstate_init(&prgstate);
+
+    load_base_type_descriptors(&prgstate);
+    init_cli_commands(&prgstate);
+
+    s32 fail_count = 0;
+
+    for (int i = 1; i < argc && (keep_going || fail_count == 0); ++i)
+    {
+        const char *arg = argv[i];
+        if (arg_is(arg, "-c", "--command"))
+        {
+            ran_any = true;
+            const char *command = argv[++i];
+            logf_ln(">> %s", command);
+            if (!process_console_input(&prgstate, str_slice(command)))
+            {
+                ++fail_count;
+            }
+        }
+        else if (arg_is(arg, "-s", "--script"))
+        {
+            ran_any = true;
+            s32 script_fails = run_console_script(&prgstate, argv[++i], keep_going);
+            fail_count += script_fails < 0 ? 1 : script_fails;
+        }
+    }
+
+    if (interactive || !ran_any)
+    {
+        run_terminal_json_cli(&prgstate);
+    }
+
+    return fail_count == 0 ? 0 : 1;
+}
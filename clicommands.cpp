@@ -10,18 +10,26 @@
 #include "typesys.h"
 #include "typesys_json.h"
 #include "memory.h"
-
-void exec_command(ProgramState *prgstate, StrSlice name, DynArray<Value> args)
+#include "profiler.h"
+#include "allocstats.h"
+#include "footprint.h"
+#include "jobs.h"
+#include "schema.h"
+#include "groupby.h"
+#include <algorithm>
+
+bool exec_command(ProgramState *prgstate, StrSlice name, DynArray<Value> args)
 {
     CliCommand *cmd = ht_find(&prgstate->command_map, name);
 
     if (!cmd)
     {
-        logf_ln("Command '%s' not found", name.data);
-        return;
+        logf_ln("Command '%.*s' not found", (int)name.length, name.data);
+        return false;
     }
 
-    cmd->fn(prgstate, cmd->userdata, args);
+    ProfZone zone(cmd->name, ProfCategory::Command);
+    return cmd->fn(prgstate, cmd->userdata, args);
 }
 
 
@@ -29,12 +37,12 @@ void exec_command(ProgramState *prgstate, StrSlice name, DynArray<Value> args)
 void register_command(ProgramState *prgstate, StrSlice name, CliCommandFn *fnptr, void *userdata)
 {
     assert(fnptr);
-    CliCommand cmd = {fnptr, userdata};
-    Str allocated_name = str(name);
-    if (ht_set(&prgstate->command_map, str_slice(allocated_name), cmd))
+    // The key needs storage that outlives this call, the nametable has that
+    StrSlice interned_name = nameref::str_slice(nametable::find_or_add(&prgstate->names, name));
+    CliCommand cmd = {interned_name.data, fnptr, userdata};
+    if (ht_set(&prgstate->command_map, interned_name, cmd))
     {
-        logf_ln("Warning, overriding command: %s", allocated_name.data);
-        str_free(&allocated_name);
+        logf_ln("Warning, overriding command: %s", interned_name.data);
     }
 }
 
@@ -52,6 +60,8 @@ CLI_COMMAND_FN_SIG(say_hello)
     UNUSED(args);
 
     logln("You are calling the say_hello command");
+
+    return true;
 }
 
 
@@ -61,6 +71,8 @@ CLI_COMMAND_FN_SIG(cls)
     UNUSED(userdata);
     UNUSED(args);
     clear_concatenated_log();
+
+    return true;
 }
 
 
@@ -72,7 +84,7 @@ CLI_COMMAND_FN_SIG(curdir)
     if (args.count != 0)
     {
         logln("Usage: curdir");
-        return;
+        return false;
     }
 
     Str str = {};
@@ -80,14 +92,16 @@ CLI_COMMAND_FN_SIG(curdir)
 
     if (error.is_error())
     {
-        logf_ln("Error getting current directory: %s", error.message.data);
+        logf_ln("Error getting current directory: %s", str_data(error.message));
     }
     else
     {
-        logf_ln("Current directory is %s", str.data);
+        logf_ln("Current directory is %s", str_data(str));
     }
 
+    bool ok = !error.is_error();
     error.release();
+    return ok;
 }
 
 
@@ -99,7 +113,7 @@ CLI_COMMAND_FN_SIG(listdir)
     if (args.count == 0 || (args[0].typedesc)->type_id != TypeID::String)
     {
         logln("Usage: listdir \"path/to/directory\"");
-        return;
+        return false;
     }
 
     DirLister dirlister(str_slice(args[0].str_val));
@@ -111,13 +125,16 @@ CLI_COMMAND_FN_SIG(listdir)
              dirlister.stream_loc,
              (dirlister.current.is_file ? "F" : "D"),
              dirlister.current.name.data,
-             dirlister.current.access_path.data);
+             str_data(dirlister.current.access_path));
     }
 
     if (dirlister.has_error())
     {
-        logf_ln("Error listing directories: %s", dirlister.error.message.data);
+        logf_ln("Error listing directories: %s", str_data(dirlister.error.message));
+        return false;
     }
+
+    return true;
 }
 
 
@@ -129,19 +146,22 @@ CLI_COMMAND_FN_SIG(changedir)
     if (args.count == 0 || (args[0].typedesc)->type_id != TypeID::String)
     {
         logln("Usage: listdir \"path/to/directory\"");
-        return;
+        return false;
     }
 
     PlatformError error = change_dir(args[0].str_val);
 
     if (error.is_error())
     {
-        logf_ln("Error changing directories: %s", error.message.data);
+        logf_ln("Error changing directories: %s", str_data(error.message));
+        return false;
     }
     else
     {
         logln("Ok");
     }
+
+    return true;
 }
 
 
@@ -152,6 +172,8 @@ CLI_COMMAND_FN_SIG(loaddir)
     UNUSED(args);
 
     logln("not implemented yet");
+
+    return true;
 }
 
 
@@ -163,6 +185,8 @@ CLI_COMMAND_FN_SIG(list_allocs)
 
     mem::IAllocator *allocator = mem::default_allocator();
     allocator->log_allocations();
+
+    return true;
 }
 
 
@@ -173,7 +197,7 @@ CLI_COMMAND_FN_SIG(checktype)
     if (args.count != 2)
     {
         logf_ln("Error: expected 2 arguments, got %i instead", args.count);
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -182,14 +206,14 @@ CLI_COMMAND_FN_SIG(checktype)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(type_desc->type_id));
-        return;
+        return false;
     }
 
     TypeDescriptor *typedesc = find_typedesc_by_name(prgstate, name_arg->str_val);
     if (!typedesc)
     {
-        logf_ln("No value bound to name: '%s'", name_arg->str_val.data);
-        return;
+        logf_ln("No value bound to name: '%s'", str_data(name_arg->str_val));
+        return false;
     }
 
     Value *value = &args[1];
@@ -212,6 +236,8 @@ CLI_COMMAND_FN_SIG(checktype)
         fmtbuf.write("\nInput value's type: ");
         pretty_print(value->typedesc, &fmtbuf, 0);
     }
+
+    return check.passed;
 }
 
 
@@ -222,7 +248,7 @@ CLI_COMMAND_FN_SIG(print_type)
     if (args.count != 1)
     {
         logf_ln("Error: expected 1 argument, got %i instead", args.count);
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -231,17 +257,19 @@ CLI_COMMAND_FN_SIG(print_type)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(type_desc->type_id));
-        return;
+        return false;
     }
 
     TypeDescriptor *typedesc = find_typedesc_by_name(prgstate, name_arg->str_val);
     if (!typedesc)
     {
-        logf_ln("No value bound to name: '%s'", name_arg->str_val.data);
-        return;
+        logf_ln("No value bound to name: '%s'", str_data(name_arg->str_val));
+        return false;
     }
 
     pretty_print(typedesc);
+
+    return true;
 }
 
 
@@ -252,7 +280,7 @@ CLI_COMMAND_FN_SIG(bindinfer)
     if (args.count != 2)
     {
         logf_ln("Error: expected 2 arguments, got %i instead", args.count);
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -262,16 +290,19 @@ CLI_COMMAND_FN_SIG(bindinfer)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(namearg_type_desc->type_id));
-        return;
+        return false;
     }
 
-    TypeDescriptor *type_desc = args[1].typedesc;
-    bind_typedesc_name(prgstate, name_arg->str_val.data, type_desc);
+    // Outlives the argument's type scratch
+    TypeDescriptor *type_desc = promote_typedesc(prgstate, args[1].typedesc);
+    bind_typedesc_name(prgstate, str_data(name_arg->str_val), type_desc);
 
     FormatBuffer fbuf;
     fbuf.flush_on_destruct();
-    fbuf.writef("Bound '%s' to type: ", name_arg->str_val.data);
+    fbuf.writef("Bound '%s' to type: ", str_data(name_arg->str_val));
     pretty_print( type_desc, &fbuf);
+
+    return true;
 }
 
 
@@ -283,7 +314,7 @@ CLI_COMMAND_FN_SIG(print_values)
     if (args.count < 1)
     {
         logln("No arguments");
-        return;
+        return false;
     }
 
     FormatBuffer fmt_buf;
@@ -298,6 +329,8 @@ CLI_COMMAND_FN_SIG(print_values)
         fmt_buf.writef("Parsed value's type: %p ", value->typedesc);
         pretty_print(value->typedesc, &fmt_buf);
     }
+
+    return true;
 }
 
 
@@ -308,7 +341,7 @@ CLI_COMMAND_FN_SIG(get_value_type)
     if (args.count < 1)
     {
         logln("Error: expected 1 argument");
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -317,20 +350,19 @@ CLI_COMMAND_FN_SIG(get_value_type)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(type_desc->type_id));
-        return;
+        return false;
     }
 
     Value *value = ht_find(&prgstate->value_map, str_slice(name_arg->str_val));
-    if (value)
+    if (!value)
     {
-        pretty_print(value->typedesc);
-    }
-    else
-    {
-        logf_ln("No value bound to name: '%s'", name_arg->str_val.data);
+        logf_ln("No value bound to name: '%s'", str_data(name_arg->str_val));
+        return false;
     }
 
+    pretty_print(value->typedesc);
 
+    return true;
 }
 
 
@@ -341,7 +373,7 @@ CLI_COMMAND_FN_SIG(get_value)
     if (args.count < 1)
     {
         logln("Error: expected 1 argument");
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -350,18 +382,19 @@ CLI_COMMAND_FN_SIG(get_value)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(type_desc->type_id));
-        return;
+        return false;
     }
 
     Value *value = ht_find(&prgstate->value_map, str_slice(name_arg->str_val));
-    if (value)
-    {
-        pretty_print(value);
-    }
-    else
+    if (!value)
     {
-        logf_ln("No value bound to name: '%s'", name_arg->str_val.data);
+        logf_ln("No value bound to name: '%s'", str_data(name_arg->str_val));
+        return false;
     }
+
+    pretty_print(value);
+
+    return true;
 }
 
 
@@ -372,7 +405,7 @@ CLI_COMMAND_FN_SIG(set_value)
     if (args.count < 2)
     {
         logf_ln("Error: expected 2 arguments, got %i instead", args.count);
-        return;
+        return false;
     }
 
     Value *name_arg = &args[0];
@@ -382,7 +415,7 @@ CLI_COMMAND_FN_SIG(set_value)
     {
         logf_ln("Error: first argument must be a string, got a %s instead",
                   TypeID::to_string(type_desc->type_id));
-        return;
+        return false;
     }
 
     // This is maybe a bit too manual, but I want everything to be POD, no destructors
@@ -391,16 +424,18 @@ CLI_COMMAND_FN_SIG(set_value)
     if (!was_occupied)
     {
         // allocate dedicated space
-        Str allocated = str(entry->key);
-        entry->key = str_slice(allocated);
+        entry->key = nameref::str_slice(nametable::find_or_add(&prgstate->names, entry->key));
     }
 
     entry->value = clone(&args[1]);
+    promote_value_types(prgstate, &entry->value);
 
     FormatBuffer fbuf;
     fbuf.flush_on_destruct();
     fbuf.writeln("Storing value:");
     pretty_print(&entry->value, &fbuf);
+
+    return true;
 }
 
 
@@ -411,7 +446,7 @@ CLI_COMMAND_FN_SIG(find_type)
     if (args.count == 0)
     {
         logf_ln("Expected one argument, got zero instead");
-        return;
+        return false;
     }
 
     Value *arg = &args[0];
@@ -421,18 +456,19 @@ CLI_COMMAND_FN_SIG(find_type)
         TypeDescriptor *argtype = (arg->typedesc);
         logf_ln("Argument must be a string, got a %s intead",
                   TypeID::to_string(argtype->type_id));
-        return;
+        return false;
     }
 
     TypeDescriptor *typedesc = find_typedesc_by_name(prgstate, arg->str_val);
-    if (typedesc)
-    {
-        pretty_print(typedesc);
-    }
-    else
+    if (!typedesc)
     {
-        logf_ln("Type not found: %s", arg->str_val.data);
+        logf_ln("Type not found: %s", str_data(arg->str_val));
+        return false;
     }
+
+    pretty_print(typedesc);
+
+    return true;
 }
 
 
@@ -448,6 +484,8 @@ CLI_COMMAND_FN_SIG(list_args)
         pretty_print(val->typedesc);
         pretty_print(val);
     }
+
+    return true;
 }
 
 
@@ -459,22 +497,24 @@ CLI_COMMAND_FN_SIG(catfile)
     if (args.count != 1 || (args[0].typedesc)->type_id != TypeID::String)
     {
         logln("Usage: catfile \"<filename>\"");
-        return;
+        return false;
     }
 
     Str dest = {};
-    FileReadResult rr = read_text_file(&dest, args[0].str_val.data);
+    FileReadResult rr = read_text_file(&dest, str_data(args[0].str_val));
 
     if (rr.error_kind != FileReadResult::NoError)
     {
-        logf_ln("Failed to read file '%s': %s", args[0].str_val.data, rr.platform_error.message.data);
+        logf_ln("Failed to read file '%s': %s", str_data(args[0].str_val), str_data(rr.platform_error.message));
     }
     else
     {
-        logln(dest.data);
+        logln(str_data(dest));
     }
 
+    bool ok = rr.error_kind == FileReadResult::NoError;
     rr.release();
+    return ok;
 }
 
 
@@ -489,76 +529,349 @@ CLI_COMMAND_FN_SIG(abspath)
         if ((args[i].typedesc)->type_id != TypeID::String)
         {
             logf("Argument %i was a string\n Expected usage: abspath \"<path1\" [, \"<path2>\"]...", i);
+            return false;
         }
     }
 
+    bool ok = true;
     Str dest = {};
     for (DynArrayCount i = 0; i < args.count; ++i)
     {
-        PlatformError err = resolve_path(OUTPARAM &dest, args[i].str_val.data);
+        PlatformError err = resolve_path(OUTPARAM &dest, str_data(args[i].str_val));
         if (err.is_error())
         {
-            logf("Error resolving path %s: %s", args[i].str_val.data, err.message.data);
+            logf("Error resolving path %s: %s", str_data(args[i].str_val), str_data(err.message));
+            ok = false;
         }
         else
         {
-            log(dest.data);
+            log(str_data(dest));
         }
         err.release();
     }
+
+    return ok;
 }
 
 
-CLI_COMMAND_FN_SIG(loadjson)
+struct LoadJsonJob
 {
-    UNUSED(prgstate);
-    UNUSED(userdata);
-    UNUSED(args);
+    Str path;
+    bool open_editor;
+    ParsedJsonDir parsed;
+    LoadJsonDirResult result;
+    bool publish_started;
+    u32 types_before;
+};
 
-    if (args.count != 1)
+
+#define LOAD_SUMMARY_TOP_FILES 5
+
+
+struct FileSlower
+{
+    const ParsedJsonDir *parsed;
+
+    u64 total_ns(DynArrayCount i) const
     {
-        logln("Usage: loadjson \"<path/to/directory/with/json/files>\"");
+        const ParsedJsonFile *file = &parsed->files[i];
+        return file->read_ns + file->parse_ns + file->value_ns;
+    }
+
+    bool operator()(DynArrayCount a, DynArrayCount b) const
+    {
+        return total_ns(a) > total_ns(b);
+    }
+};
+
+
+struct FileLarger
+{
+    const ParsedJsonDir *parsed;
+
+    bool operator()(DynArrayCount a, DynArrayCount b) const
+    {
+        return parsed->files[a].size > parsed->files[b].size;
     }
+};
+
+
+static void log_load_summary_files(const char *heading, const ParsedJsonDir *parsed, const DynArray<DynArrayCount> *order)
+{
+    logln(heading);
+    for (DynArrayCount i = 0; i < order->count && i < LOAD_SUMMARY_TOP_FILES; ++i)
+    {
+        const ParsedJsonFile *file = &parsed->files[(*order)[i]];
+        char size_text[32];
+        allocstats::format_bytes(size_text, sizeof(size_text), (s64)file->size);
+        logf_ln("  %8.2f ms %10s  %s",
+                (double)(file->read_ns + file->parse_ns + file->value_ns) * 1e-6,
+                size_text, str_data(file->access_path));
+    }
+}
 
-    LoadJsonDirResult load_result = load_json_dir(prgstate, args[0].str_val.data, args[0].str_val.length);
-    Collection *collection = load_result.collection;
 
-    if (load_result.collection)
+// Instead of every record, which for a big directory is more log than the
+// load is worth. printcoll shows records when they're wanted.
+static void log_load_summary(ProgramState *prgstate, const ParsedJsonDir *parsed, Collection *collection,
+                             u32 types_before)
+{
+    char bytes_text[32];
+    allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)parsed->bytes_listed);
+
+    if (!collection)
     {
-        FormatBuffer fmt_buf;
-        fmt_buf.flush_on_destruct();
+        logf_ln("Loaded nothing from '%s', %u json files (%s)",
+                str_data(parsed->path), parsed->files_listed, bytes_text);
+        return;
+    }
 
-        collection_assert_invariants(collection);
-        for (DynArrayCount i = 0; i < collection->info.count; ++i)
+    s32 coll_idx = -1;
+    for (BucketArray<Collection>::Iterator it = bucketarray::iterate(&prgstate->collections);
+         bucketarray::next(&it);)
+    {
+        if (it.elem == collection)
         {
-            fmt_buf.write('\n');
-            RecordInfo *record_info = &collection->info[i];
-            fmt_buf.write("Path: ");
-            fmt_buf.write(record_info->fullpath.data);
-            fmt_buf.write("\nValue: ");
-            Value *value = &collection->value.array_value.elements[i];
-            pretty_print(value, &fmt_buf);
-            fmt_buf.writef("Parsed value's type: %p ", value->typedesc);
-            pretty_print(value->typedesc, &fmt_buf);
-            fmt_buf.flush_to_log();
+            coll_idx = (s32)it.index;
         }
     }
 
-    switch (load_result.error_kind)
+    logf_ln("Loaded %u of %u json files (%s) from '%s' as collection %i",
+            collection->info.count, parsed->files_listed, bytes_text, str_data(parsed->path), coll_idx);
+
+    const DynArray<Value> *records = &collection->value.array_value.elements;
+    DynArray<TypeDescriptor *> record_types = dynarray::init<TypeDescriptor *>(records->count);
+    for (DynArrayCount i = 0; i < records->count; ++i)
+    {
+        dynarray::append(&record_types, (*records)[i].typedesc);
+    }
+    std::sort(record_types.data, record_types.data + record_types.count);
+    DynArrayCount distinct_types = DYNARRAY_COUNT(std::unique(record_types.data, record_types.data + record_types.count)
+                                                  - record_types.data);
+    dynarray::deinit(&record_types);
+
+    logf_ln("  %u records of %u distinct types, %u new type descriptors",
+            records->count, distinct_types, prgstate->type_descriptors.count - types_before);
+    if (parsed->files_typed_by_known_type)
+    {
+        logf_ln("  %u of %u files had a type that was already known, no inference needed",
+                parsed->files_typed_by_known_type, collection->info.count);
+    }
+
+    const LoadJsonDirTimings *timings = &parsed->timings;
+    logf_ln("  list %.2f ms, read %.2f ms, parse %.2f ms, make values %.2f ms, collection %.2f ms",
+            (double)timings->list_ns * 1e-6, (double)timings->read_ns * 1e-6, (double)timings->parse_ns * 1e-6,
+            (double)timings->values_ns * 1e-6, (double)timings->collection_ns * 1e-6);
+
+    if (parsed->files.count > 1)
+    {
+        DynArray<DynArrayCount> order = dynarray::init<DynArrayCount>(parsed->files.count);
+        for (DynArrayCount i = 0; i < parsed->files.count; ++i)
+        {
+            dynarray::append(&order, i);
+        }
+
+        FileSlower slower = {parsed};
+        std::sort(order.data, order.data + order.count, slower);
+        log_load_summary_files("  Slowest:", parsed, &order);
+
+        FileLarger larger = {parsed};
+        std::sort(order.data, order.data + order.count, larger);
+        log_load_summary_files("  Largest:", parsed, &order);
+
+        dynarray::deinit(&order);
+    }
+
+    logf_ln("Run printcoll %i to see the records", coll_idx);
+}
+
+
+static void log_load_error(const LoadJsonDirResult *load_result)
+{
+    switch (load_result->error_kind)
     {
         case LoadJsonDirResult::NoError:
             break;
 
         case LoadJsonDirResult::FileError:
-            logf_ln("[loadjson] File error: %s", load_result.file_error.message.data);
+            logf_ln("[loadjson] File error: %s", str_data(load_result->file_error.message));
             break;
 
         case LoadJsonDirResult::ParseError:
-            logf_ln("[loadjson] Parse error: %s", load_result.parse_error.error_desc.data);
+            logf_ln("[loadjson] Parse error: %s", str_data(load_result->parse_error.error_desc));
             break;
     }
+}
+
+
+static void loadjson_job_work(Job *job)
+{
+    LoadJsonJob *load = (LoadJsonJob *)job->data;
+    load->result = parse_json_dir(&load->parsed, str_data(load->path), str_length(load->path), &job->progress);
+}
+
+
+static bool loadjson_job_publish(ProgramState *prgstate, Job *job, u64 deadline)
+{
+    LoadJsonJob *load = (LoadJsonJob *)job->data;
+
+    if (!load->publish_started)
+    {
+        load->publish_started = true;
+        load->types_before = prgstate->type_descriptors.count;
+    }
+
+    // A file at a time, a big directory takes a few frames
+    while (!make_parsed_json_values(prgstate, &load->parsed, 1))
+    {
+        if (query_abstime() >= deadline)
+        {
+            return false;
+        }
+    }
+
+    Collection *collection = add_parsed_json_collection(prgstate, &load->parsed);
+    if (collection && load->open_editor)
+    {
+        dynarray::append(&prgstate->editing_collections, collection);
+    }
+
+    log_load_summary(prgstate, &load->parsed, collection, load->types_before);
+    log_load_error(&load->result);
+    return true;
+}
+
+
+static void loadjson_job_free(Job *job)
+{
+    LoadJsonJob *load = (LoadJsonJob *)job->data;
+    parsed_json_dir_free(&load->parsed);
+    load->result.release();
+    str_free(&load->path);
+    mem::default_allocator()->dealloc(load);
+}
+
+
+static const JobFunctions loadjson_job_fns = {
+    loadjson_job_work,
+    loadjson_job_publish,
+    loadjson_job_free
+};
+
+
+Job *start_loadjson_job(ProgramState *prgstate, StrSlice path, bool open_editor)
+{
+    LoadJsonJob *load = MAKE_OBJ_CAT(mem::default_allocator(), "jobs", LoadJsonJob);
+    mem::zero_ptr(load);
+    load->path = str(path);
+    load->open_editor = open_editor;
+
+    Str description = str("loadjson \"");
+    str_append(&description, path);
+    str_append(&description, '"');
+    Job *job = jobs::start(prgstate, str_slice(description), &loadjson_job_fns, load);
+    str_free(&description);
+
+    return job;
+}
 
+
+CLI_COMMAND_FN_SIG(loadjson)
+{
+    UNUSED(userdata);
+
+    if (args.count != 1 || args[0].typedesc->type_id != TypeID::String)
+    {
+        logln("Usage: loadjson \"<path/to/directory/with/json/files>\"");
+        return false;
+    }
+
+    if (prgstate->async_commands)
+    {
+        start_loadjson_job(prgstate, str_slice(args[0].str_val), false);
+        return true;
+    }
+
+    u32 types_before = prgstate->type_descriptors.count;
+    ParsedJsonDir parsed;
+    LoadJsonDirResult load_result = load_json_dir(prgstate, str_data(args[0].str_val), str_length(args[0].str_val),
+                                                  &parsed);
+
+    log_load_summary(prgstate, &parsed, load_result.collection, types_before);
+    log_load_error(&load_result);
+
+    bool ok = load_result.error_kind == LoadJsonDirResult::NoError;
+    parsed_json_dir_free(&parsed);
     load_result.release();
+    return ok;
+}
+
+
+CLI_COMMAND_FN_SIG(printcoll)
+{
+    UNUSED(userdata);
+
+    s32 first = 0;
+    s32 count = 10;
+    bool args_ok = args.count >= 1 && args.count <= 3;
+    for (DynArrayCount i = 0; args_ok && i < args.count; ++i)
+    {
+        args_ok = vIS_INT(&args[i]) && args[i].s64_val >= 0 && args[i].s64_val <= INT32_MAX;
+    }
+    if (args_ok && args.count >= 2)
+    {
+        first = (s32)args[1].s64_val;
+    }
+    if (args_ok && args.count == 3)
+    {
+        count = (s32)args[2].s64_val;
+    }
+
+    if (!args_ok)
+    {
+        logln("usage: printcoll <collection index> [first record] [record count]\n"
+              "Prints records with their types, 10 at a time unless told otherwise");
+        return false;
+    }
+
+    s32 coll_idx = (s32)args[0].s64_val;
+
+    BucketIndex bidx;
+    if (!bucketarray::exists(&bidx, &prgstate->collections, BUCKETITEMCOUNT(coll_idx)))
+    {
+        logf_ln("Index %i out of range [0, %i] or slot empty",
+                coll_idx, prgstate->collections.count);
+        return false;
+    }
+
+    Collection *collection = &prgstate->collections[bidx];
+    collection_assert_invariants(collection);
+
+    // Both are at most INT32_MAX, the sum could overflow an s32
+    DynArrayCount end = (DynArrayCount)min((u64)first + (u64)count, (u64)collection->info.count);
+
+    // A record at a time goes to the log, nothing builds up
+    FormatBuffer fmt_buf;
+    for (DynArrayCount i = (DynArrayCount)first; i < end; ++i)
+    {
+        fmt_buf.write('\n');
+        RecordInfo *record_info = &collection->info[i];
+        fmt_buf.writef("[%u] Path: ", i);
+        fmt_buf.write(str_data(record_info->fullpath));
+        fmt_buf.write("\nValue: ");
+        Value *value = &collection->value.array_value.elements[i];
+        pretty_print(value, &fmt_buf);
+        fmt_buf.writef("Parsed value's type: %p ", value->typedesc);
+        pretty_print(value->typedesc, &fmt_buf);
+        fmt_buf.flush_to_log();
+    }
+
+    if (end < collection->info.count)
+    {
+        logf_ln("%u more, printcoll %i %u for the next ones", collection->info.count - end, coll_idx, end);
+    }
+
+    return true;
 }
 
 
@@ -572,20 +885,22 @@ CLI_COMMAND_FN_SIG(dropcoll)
     {
         logln("usage: drop <collection index>");
         logln("Run lscollections to see collection indexes");
-        return;
+        return false;
     }
 
-    s32 coll_idx = args[0].s32_val;
+    s32 coll_idx = (s32)args[0].s64_val;
 
     BucketIndex bidx;
     if (!bucketarray::exists(&bidx, &prgstate->collections, BUCKETITEMCOUNT(coll_idx)))
     {
         logf_ln("Index %i out of range [0, %i] or slot empty",
                 coll_idx, prgstate->collections.count);
-        return;
+        return false;
     }
 
     drop_collection(prgstate, bidx);
+
+    return true;
 }
 
 
@@ -596,14 +911,13 @@ CLI_COMMAND_FN_SIG(lscollections)
 
     logf_ln("%i loaded collections", prgstate->collections.count);
 
-    for (BucketItemCount i = 0; i < prgstate->collections.capacity; ++i)
+    for (BucketArray<Collection>::Iterator it = bucketarray::iterate(&prgstate->collections);
+         bucketarray::next(&it);)
     {
-        Collection *collection;
-        if (bucketarray::get_if_not_empty(&collection, &prgstate->collections, i))
-        {
-            logf_ln("[%i] %s", i, collection->load_path.data);
-        }
+        logf_ln("[%i] %s", it.index, str_data(it.elem->load_path));
     }
+
+    return true;
 }
 
 
@@ -615,42 +929,188 @@ CLI_COMMAND_FN_SIG(edit)
     {
         logln("usage: edit <collection index>");
         logln("Run lscollections to see collection indexes");
-        return;
+        return false;
     }
 
-    s32 coll_idx = args[0].s32_val;
+    s32 coll_idx = (s32)args[0].s64_val;
 
     if (!bucketarray::exists(&prgstate->collections, coll_idx))
     {
         logf_ln("Index %i out of range [0, %i] or slot empty",
                 coll_idx, prgstate->collections.count);
-        return;
+        return false;
     }
 
     Collection *coll = &prgstate->collections[coll_idx];
     Collection **already_editing = dynarray::find(&prgstate->editing_collections, coll);
     if (already_editing)
     {
-        logf_ln("Already editing '%s'", coll->load_path.data);
+        logf_ln("Already editing '%s'", str_data(coll->load_path));
     }
     else
     {
         dynarray::append(&prgstate->editing_collections, coll);
-        logf_ln("Now editing '%s'", coll->load_path.data);
+        logf_ln(coll->read_only ? "Now viewing '%s', it's read-only" : "Now editing '%s'",
+                str_data(coll->load_path));
     }
+
+    return true;
 }
 
 
 
 CLI_COMMAND_FN_SIG(memstats)
 {
-    UNUSED(prgstate);
+    UNUSED(userdata);
+
+    u32 max_sites = 20;
+    if (args.count == 1 && args[0].typedesc->type_id == TypeID::Int && args[0].s64_val > 0)
+    {
+        max_sites = (u32)args[0].s64_val;
+    }
+    else if (args.count != 0)
+    {
+        logln("Usage: memstats [max_sites]\n"
+              "Live memory by category and call site, with changes since the last memsnap");
+        return false;
+    }
+
+    AllocSnapshot current = {};
+    allocstats::take_snapshot(&current);
+    allocstats::log_report(&current, &prgstate->alloc_baseline, max_sites);
+    allocstats::free_snapshot(&current);
+
+    return true;
+}
+
+
+CLI_COMMAND_FN_SIG(memsnap)
+{
     UNUSED(userdata);
     UNUSED(args);
 
-    mem::IAllocator *default_allocator = mem::default_allocator();
+    allocstats::take_snapshot(&prgstate->alloc_baseline);
+    logf_ln("Took an allocation snapshot of %u call sites, memstats now shows changes since it",
+            prgstate->alloc_baseline.sites.count);
+
+    return true;
+}
+
+
+CLI_COMMAND_FN_SIG(collsize)
+{
+    UNUSED(userdata);
+
+    if (args.count == 0)
+    {
+        logf_ln("%i loaded collections", prgstate->collections.count);
+        for (BucketArray<Collection>::Iterator it = bucketarray::iterate(&prgstate->collections);
+             bucketarray::next(&it);)
+        {
+            FootprintReport report;
+            footprint::init(&report);
+            footprint::add_collection(&report, it.elem);
+
+            char bytes_text[32];
+            allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)footprint::total_bytes(&report));
+            logf_ln("[%i] %10s in %llu values  %s", it.index, bytes_text,
+                    (unsigned long long)report.total.value_count, str_data(it.elem->load_path));
+
+            footprint::deinit(&report);
+        }
+        return true;
+    }
+
+    u32 max_rows = 20;
+    if (args.count == 2 && vIS_INT(&args[1]) && args[1].s64_val > 0)
+    {
+        max_rows = (u32)args[1].s64_val;
+    }
+    else if (args.count != 1)
+    {
+        max_rows = 0;
+    }
+
+    if (!max_rows || !vIS_INT(&args[0]))
+    {
+        logln("usage: collsize [<collection index> [max_rows]]\n"
+              "Heap bytes held by a collection by kind, type and member path, without arguments a line per collection");
+        return false;
+    }
+
+    s32 coll_idx = (s32)args[0].s64_val;
+
+    BucketIndex bidx;
+    if (!bucketarray::exists(&bidx, &prgstate->collections, BUCKETITEMCOUNT(coll_idx)))
+    {
+        logf_ln("Index %i out of range [0, %i] or slot empty",
+                coll_idx, prgstate->collections.count);
+        return false;
+    }
+
+    Collection *coll = &prgstate->collections[bidx];
+    logf_ln("Footprint of '%s'", str_data(coll->load_path));
+
+    FootprintReport report;
+    footprint::init(&report);
+    footprint::add_collection(&report, coll);
+    footprint::log_report(prgstate, &report, max_rows);
+    footprint::deinit(&report);
+
+    return true;
+}
+
+
+CLI_COMMAND_FN_SIG(lsjobs)
+{
+    UNUSED(userdata);
+    UNUSED(args);
+
+    logf_ln("%u jobs running", prgstate->jobs.count);
+
+    char status[256];
+    for (DynArrayCount i = 0; i < prgstate->jobs.count; ++i)
+    {
+        jobs::format_status(status, sizeof(status), prgstate->jobs[i]);
+        logln(status);
+    }
+
+    return true;
+}
+
+
+CLI_COMMAND_FN_SIG(canceljob)
+{
+    UNUSED(userdata);
+
+    if (args.count == 0)
+    {
+        for (DynArrayCount i = 0; i < prgstate->jobs.count; ++i)
+        {
+            jobs::cancel(prgstate->jobs[i]);
+        }
+        logf_ln("Cancelling %u jobs", prgstate->jobs.count);
+        return true;
+    }
+
+    if (args.count != 1 || !vIS_INT(&args[0]))
+    {
+        logln("usage: canceljob [<job id>]\n"
+              "Cancels the job, or every job without an id. Run lsjobs to see job ids");
+        return false;
+    }
+
+    Job *job = jobs::find(prgstate, (u32)args[0].s64_val);
+    if (!job)
+    {
+        logf_ln("No job %lli running", (long long)args[0].s64_val);
+        return false;
+    }
+
+    jobs::cancel(job);
+    logf_ln("Cancelling job %u", job->id);
 
-    logf_ln("%lu bytes allocated", default_allocator->bytes_allocated());
+    return true;
 }
 
 
@@ -660,10 +1120,165 @@ CLI_COMMAND_FN_SIG(lsnames)
     UNUSED(userdata);
     UNUSED(args);
 
-    for (NameRef name = nametable::first(&prgstate->names); name.offset; name = nametable::next(name))
+    for (NameRef name = nametable::first(&prgstate->names); name.handle; name = nametable::next(name))
     {
         logf_ln("%s", nameref::str_slice(name).data);
     }
+
+    return true;
+}
+
+
+CLI_COMMAND_FN_SIG(validate)
+{
+    UNUSED(userdata);
+
+    u32 thread_count = processor_count();
+    if (args.count == 3 && vIS_INT(&args[2]) && args[2].s64_val > 0)
+    {
+        thread_count = (u32)args[2].s64_val;
+    }
+    else if (args.count != 2)
+    {
+        thread_count = 0;
+    }
+
+    if (!thread_count || !vIS_STRING(&args[0]) || !vIS_STRING(&args[1]))
+    {
+        logln("usage: validate \"path/to/directory\" \"type name\" [threads]\n"
+              "Checks every .json file in the directory against the type without loading it");
+        return false;
+    }
+
+    TypeDescriptor *typedesc = find_typedesc_by_name(prgstate, args[1].str_val);
+    if (!typedesc)
+    {
+        logf_ln("No type bound to name: '%s'", str_data(args[1].str_val));
+        return false;
+    }
+
+    CompiledSchema compiled;
+    schema::compile(&compiled, typedesc);
+
+    SchemaDirResult result;
+    PlatformError list_error;
+    if (!schema::validate_dir(&result, &list_error, &compiled, str_data(args[0].str_val),
+                              str_length(args[0].str_val), thread_count))
+    {
+        logf_ln("Error listing '%s': %s", str_data(args[0].str_val), str_data(list_error.message));
+        list_error.release();
+        schema::dir_result_free(&result);
+        schema::deinit(&compiled);
+        return false;
+    }
+
+    u32 empty = 0;
+    for (DynArrayCount i = 0; i < result.files.count; ++i)
+    {
+        const SchemaFileResult *file = &result.files[i];
+        if (file->status == SchemaStatus::Empty)
+        {
+            ++empty;
+        }
+        else if (file->status == SchemaStatus::ReadFailed)
+        {
+            logf_ln("%s: %s", str_data(file->access_path), file->error.message);
+        }
+        else if (file->status == SchemaStatus::Failed)
+        {
+            logf_ln("%s:%zu:%zu: %s", str_data(file->access_path),
+                    file->error.line, file->error.column, file->error.message);
+        }
+    }
+
+    char bytes_text[32];
+    allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)result.bytes);
+    logf_ln("%u passed, %u failed, %u empty of %u files (%s) on %u threads in %.2f ms, listing took %.2f ms",
+            result.files.count - result.failed - empty, result.failed, empty, result.files.count,
+            bytes_text, result.thread_count, (double)result.validate_ns / 1000000.0,
+            (double)result.list_ns / 1000000.0);
+
+    // One bad file fails the command, that's all a CI script looks at
+    bool ok = result.failed == 0;
+    schema::dir_result_free(&result);
+    schema::deinit(&compiled);
+    return ok;
+}
+
+
+CLI_COMMAND_FN_SIG(group_by)
+{
+    UNUSED(userdata);
+
+    // A trailing int is the thread count
+    u32 thread_count = 0;
+    DynArrayCount arg_count = args.count;
+    if (arg_count > 2 && vIS_INT(&args[arg_count - 1]) && args[arg_count - 1].s64_val > 0)
+    {
+        thread_count = (u32)args[arg_count - 1].s64_val;
+        --arg_count;
+    }
+
+    bool args_ok = arg_count >= 2 && vIS_INT(&args[0]);
+    for (DynArrayCount i = 1; args_ok && i < arg_count; ++i)
+    {
+        args_ok = vIS_STRING(&args[i]);
+    }
+
+    if (!args_ok)
+    {
+        logln("usage: group_by <collection index> \"key.path\" [\"agg(path)\"...] [threads]\n"
+              "Makes a read-only collection with a record per distinct key. "
+              "The aggregates are count, sum, min, max and avg.");
+        return false;
+    }
+
+    s32 coll_idx = (s32)args[0].s64_val;
+
+    BucketIndex bidx;
+    if (!bucketarray::exists(&bidx, &prgstate->collections, BUCKETITEMCOUNT(coll_idx)))
+    {
+        logf_ln("Index %i out of range [0, %i] or slot empty",
+                coll_idx, prgstate->collections.count);
+        return false;
+    }
+
+    GroupBySpec spec;
+    groupby::init(&spec);
+
+    bool spec_ok = groupby::set_key(&spec, prgstate, str_slice(args[1].str_val));
+    for (DynArrayCount i = 2; spec_ok && i < arg_count; ++i)
+    {
+        spec_ok = groupby::add_aggregate(&spec, prgstate, str_slice(args[i].str_val));
+    }
+
+    if (spec_ok)
+    {
+        GroupByStats stats;
+        Collection *result = groupby::run(&stats, prgstate, &prgstate->collections[bidx], &spec, thread_count);
+
+        s32 result_idx = -1;
+        for (BucketArray<Collection>::Iterator it = bucketarray::iterate(&prgstate->collections);
+             bucketarray::next(&it);)
+        {
+            if (it.elem == result)
+            {
+                result_idx = (s32)it.index;
+            }
+        }
+
+        logf_ln("%u groups from %u rows on %u threads in %.2f ms "
+                "(grouping %.2f ms, reducing %.2f ms, building %.2f ms)",
+                stats.group_count, stats.row_count, stats.thread_count,
+                (double)(stats.group_ns + stats.reduce_ns + stats.collection_ns) / 1000000.0,
+                (double)stats.group_ns / 1000000.0, (double)stats.reduce_ns / 1000000.0,
+                (double)stats.collection_ns / 1000000.0);
+        logf_ln("Added '%s' as collection %i, it's read-only", str_data(result->load_path), result_idx);
+        logf_ln("Run printcoll %i or edit %i to see the groups", result_idx, result_idx);
+    }
+
+    groupby::deinit(&spec);
+    return spec_ok;
 }
 
 
@@ -672,10 +1287,38 @@ CLI_COMMAND_FN_SIG(lsnames)
 //     UNUSED(prgstate);
 //     UNUSED(userdata);
 //     UNUSED(args);
+//     return true;
 // }
 
 
 
+CLI_COMMAND_FN_SIG(profdump)
+{
+    UNUSED(prgstate);
+    UNUSED(userdata);
+
+    if (args.count != 1 || (args[0].typedesc)->type_id != TypeID::String)
+    {
+        logln("Usage: profdump \"<trace.json>\"\n"
+              "Writes recorded profiler zones as Chrome trace-event json");
+        return false;
+    }
+
+    s64 event_count = profiler::write_chrome_trace(str_data(args[0].str_val));
+    if (event_count < 0)
+    {
+        logf_ln("Failed to open '%s' for writing", str_data(args[0].str_val));
+        return false;
+    }
+    else
+    {
+        logf_ln("Wrote %lli profiler events to %s", (long long)event_count, str_data(args[0].str_val));
+    }
+
+    return true;
+}
+
+
 void init_cli_commands(ProgramState *prgstate)
 {
     REGISTER_COMMAND(prgstate, say_hello, nullptr);
@@ -695,10 +1338,18 @@ void init_cli_commands(ProgramState *prgstate)
     REGISTER_COMMAND(prgstate, cls, nullptr);
     REGISTER_COMMAND(prgstate, catfile, nullptr);
     REGISTER_COMMAND(prgstate, loadjson, nullptr);
+    REGISTER_COMMAND(prgstate, printcoll, nullptr);
     REGISTER_COMMAND(prgstate, abspath, nullptr);
     REGISTER_COMMAND(prgstate, dropcoll, nullptr);
     REGISTER_COMMAND(prgstate, lscollections, nullptr);
     REGISTER_COMMAND(prgstate, edit, nullptr);
     REGISTER_COMMAND(prgstate, memstats, nullptr);
+    REGISTER_COMMAND(prgstate, memsnap, nullptr);
+    REGISTER_COMMAND(prgstate, collsize, nullptr);
+    REGISTER_COMMAND(prgstate, lsjobs, nullptr);
+    REGISTER_COMMAND(prgstate, canceljob, nullptr);
     REGISTER_COMMAND(prgstate, lsnames, nullptr);
+    REGISTER_COMMAND(prgstate, validate, nullptr);
+    REGISTER_COMMAND(prgstate, group_by, nullptr);
+    REGISTER_COMMAND(prgstate, profdump, nullptr);
 }
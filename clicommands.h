@@ -8,15 +8,16 @@
 
 struct ProgramState;
 
-#define CLI_COMMAND_FN_SIG(name) void name(ProgramState *prgstate, void *userdata, DynArray<Value> args)
-typedef CLI_COMMAND_FN_SIG(CliCommandFn);
-
-#define CLI_COMMAND_FN_SIG(name) void name(ProgramState *prgstate, void *userdata, DynArray<Value> args)
+// Commands return false when they fail: bad usage, a missing name, an
+// error from what they ran. Scripts stop at the first one.
+#define CLI_COMMAND_FN_SIG(name) bool name(ProgramState *prgstate, void *userdata, DynArray<Value> args)
 typedef CLI_COMMAND_FN_SIG(CliCommandFn);
 
 
 struct CliCommand
 {
+    // interned, lives as long as the nametable
+    const char *name;
     CliCommandFn *fn;
     void *userdata;
 };
@@ -27,9 +28,14 @@ void register_command(ProgramState *prgstate, const char *name, CliCommandFn *fn
 #define REGISTER_COMMAND(prgstate, fn_ident, userdata) register_command((prgstate), # fn_ident, &fn_ident, userdata)
 
 
-void exec_command(ProgramState *prgstate, StrSlice name, DynArray<Value> args);
+// Returns false if there is no command with that name or it failed
+bool exec_command(ProgramState *prgstate, StrSlice name, DynArray<Value> args);
 void init_cli_commands(ProgramState *prgstate);
 
+// loadjson as a job, see jobs.h. With open_editor the collection is
+// opened for editing once it's loaded.
+struct Job *start_loadjson_job(ProgramState *prgstate, StrSlice path, bool open_editor);
+
 
 #define CLICOMMANDS_H
 #endif
@@ -0,0 +1,195 @@
+#include "console.h"
+#include "clicommands.h"
+#include "programstate.h"
+#include "typesys_json.h"
+#include "tokenizer.h"
+#include "formatbuffer.h"
+#include "logging.h"
+#include "platform.h"
+#include "linenoise.h"
+#include <cstdlib>
+
+
+void log_parse_error(JsonParseResult pr, StrSlice input, size_t input_offset_from_src)
+{
+    FormatBuffer fmt_buf;
+    fmt_buf.flush_on_destruct();
+
+    fmt_buf.writef("Json parse error: %s\nAt %lu:%lu\n%s\n",
+                   str_data(pr.error_desc),
+                   pr.error_line,
+                   pr.error_column + (pr.error_line > 1 ? 0 : input_offset_from_src),
+                   input.data);
+
+    size_t buffer_offset = pr.error_offset + input_offset_from_src;
+    for (size_t i = 0; i < buffer_offset - 1; ++i) fmt_buf.write("~");
+    fmt_buf.write("^");
+}
+
+
+bool process_console_input(ProgramState *prgstate, StrSlice input_buf)
+{
+    // mem::ALLOC_STACKTRACE = true;
+
+    tokenizer::State tokstate;
+    tokenizer::init(&tokstate, input_buf.data);
+
+    tokenizer::Token first_token = tokenizer::read_string(&tokstate);
+
+    DynArray<Value> cmd_args;
+    dynarray::init(&cmd_args, 10);
+
+    bool error = false;
+
+    // The arguments only live as long as the command, so their types go
+    // in a scratch instead of the global table
+    TypeScratch arg_types;
+    begin_type_scratch(prgstate, &arg_types);
+
+    for (;;)
+    {
+        size_t offset_from_input = (size_t)(tokstate.current - input_buf.data);
+
+        Value parsed_value;
+        StrSlice parse_slice = str_slice(tokstate);
+        JsonParseResult parse_result = try_parse_json_as_value(OUTPARAM &parsed_value, prgstate,
+                                                               parse_slice.data, parse_slice.length);
+
+        switch (parse_result.status)
+        {
+            case JsonParseResult::Failed:
+                log_parse_error(parse_result, parse_slice, offset_from_input);
+                error = true;
+                goto AfterArgParseLoop;
+            case JsonParseResult::Succeeded:
+                dynarray::append(&cmd_args, parsed_value);
+                break;
+            case JsonParseResult::Eof:
+                goto AfterArgParseLoop;
+        }
+
+        tokstate.current += parse_result.parse_offset;
+
+        if (tokenizer::past_end(&tokstate))
+        {
+            goto AfterArgParseLoop;
+        }
+
+    }
+AfterArgParseLoop:
+
+    // Whatever the command itself makes is meant to stay
+    end_type_scratch(prgstate, &arg_types);
+
+    if (!error)
+    {
+        error = !exec_command(prgstate, first_token.text, cmd_args);
+    }
+
+    for (DynArrayCount i = 0; i < cmd_args.count; ++i)
+    {
+        value_free_components(&cmd_args[i]);
+    }
+    dynarray::deinit(&cmd_args);
+    discard_type_scratch(&arg_types);
+
+    // Nothing but the ProgramState holds types between commands
+    collect_types_if_requested(prgstate);
+
+    // mem::ALLOC_STACKTRACE = false;
+
+    return !error;
+}
+
+
+void run_terminal_json_cli(ProgramState *prgstate)
+{
+    for (;;)
+    {
+        char *input = linenoise(">> ");
+
+        if (!input)
+        {
+            break;
+        }
+
+        // void *alloc_probe = mem::default_allocator()->probe();
+        append_log(input);
+
+        tokenizer::State tokstate;
+        tokenizer::init(&tokstate, input);
+
+        tokenizer::Token first_token = tokenizer::read_string(&tokstate);
+
+        if (first_token.type == tokenizer::TokenType::Eof)
+        {
+            std::free(input);
+            continue;
+        }
+
+        process_console_input(prgstate, str_slice(input));
+
+        // mem::default_allocator()->log_allocs_since_probe(alloc_probe);
+
+        std::free(input);
+    }
+}
+
+
+s32 run_console_script(ProgramState *prgstate, const char *filename, bool keep_going)
+{
+    Str script = {};
+    FileReadResult rr = read_text_file(&script, filename);
+    if (rr.error_kind != FileReadResult::NoError)
+    {
+        logf_ln("Failed to read script '%s': %s", filename, str_data(rr.platform_error.message));
+        rr.release();
+        return -1;
+    }
+
+    s32 fail_count = 0;
+    Str line = {};
+    const char *cursor = str_data(script);
+    const char *end = cursor + str_length(script);
+    u32 line_number = 0;
+
+    while (cursor < end)
+    {
+        const char *line_end = cursor;
+        while (line_end < end && *line_end != '\n')
+        {
+            ++line_end;
+        }
+        ++line_number;
+
+        const char *first = cursor;
+        const char *last = line_end;
+        while (first < last && tokenizer::is_whitespace(*first)) ++first;
+        while (last > first && tokenizer::is_whitespace(last[-1])) --last;
+
+        cursor = line_end + 1;
+
+        if (first == last || *first == '#')
+        {
+            continue;
+        }
+
+        // the tokenizer wants a null-terminated string
+        str_overwrite(&line, str_slice(first, last));
+        logf_ln(">> %s", str_data(line));
+
+        if (!process_console_input(prgstate, str_slice(line)))
+        {
+            logf_ln("%s:%u: command failed", filename, line_number);
+            ++fail_count;
+            if (!keep_going)
+            {
+                break;
+            }
+        }
+    }
+
+    str_free(&line);
+    str_free(&script);
+    return fail_count;
+}
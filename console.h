@@ -0,0 +1,26 @@
+// -*- c++ -*-
+
+#ifndef CONSOLE_H
+
+#include "str.h"
+
+struct ProgramState;
+
+
+// Parses a line of the form `command arg arg ...` (args are json values)
+// and runs the command. Returns false if the args didn't parse, the
+// command wasn't found or it failed.
+bool process_console_input(ProgramState *prgstate, StrSlice input_buf);
+
+// Interactive prompt on the terminal, returns at end of input
+void run_terminal_json_cli(ProgramState *prgstate);
+
+// Runs each line of a file as console input. Blank lines and lines
+// starting with '#' are skipped. Stops at the first failed line unless
+// keep_going is set. Returns the number of lines that failed, or -1 if
+// the file couldn't be read.
+s32 run_console_script(ProgramState *prgstate, const char *filename, bool keep_going);
+
+
+#define CONSOLE_H
+#endif
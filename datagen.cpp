@@ -0,0 +1,329 @@
+#include "datagen.h"
+#include "dynarray.h"
+#include "platform.h"
+#include "logging.h"
+#include "common.h"
+#include <cmath>
+#include <cstdio>
+
+
+namespace GenKind
+{
+
+enum Tag
+{
+    String,
+    Int,
+    Float,
+    Bool,
+    Object,
+    Array
+};
+
+}
+
+
+struct GenField
+{
+    u32 key;
+    DynArrayCount node;
+};
+
+
+// Objects own a run of fields, arrays a run of element nodes. Arrays with
+// more than one element node are the union-typed ones.
+struct GenNode
+{
+    GenKind::Tag kind;
+    DynArrayCount first_child;
+    DynArrayCount child_count;
+};
+
+
+struct GenSchema
+{
+    DynArray<GenNode> nodes;
+    DynArray<GenField> fields;
+    DynArray<DynArrayCount> array_elems;
+};
+
+
+// xorshift64*, good enough for test data and the same everywhere
+struct GenRng
+{
+    u64 state;
+};
+
+
+static u64 rng_next(GenRng *rng)
+{
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 2685821657736338717ull;
+}
+
+
+// inclusive
+static u32 rng_range(GenRng *rng, u32 lo, u32 hi)
+{
+    assert(lo <= hi);
+    return lo + (u32)(rng_next(rng) % ((u64)hi - lo + 1));
+}
+
+
+static double rng_unit(GenRng *rng)
+{
+    return (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+static bool rng_chance(GenRng *rng, u32 pct)
+{
+    return rng_range(rng, 0, 99) < pct;
+}
+
+
+static GenKind::Tag random_primitive(GenRng *rng)
+{
+    return (GenKind::Tag)rng_range(rng, GenKind::String, GenKind::Bool);
+}
+
+
+static DynArrayCount add_node(GenSchema *schema, GenKind::Tag kind)
+{
+    GenNode node = {kind, 0, 0};
+    dynarray::append(&schema->nodes, node);
+    return schema->nodes.count - 1;
+}
+
+
+static DynArrayCount make_node(GenSchema *schema, GenRng *rng, const DataGenParams *params, u32 depth, GenKind::Tag kind);
+
+
+static DynArrayCount make_random_node(GenSchema *schema, GenRng *rng, const DataGenParams *params, u32 depth)
+{
+    u32 roll = rng_range(rng, 0, 99);
+    GenKind::Tag kind = depth == 0 || roll < 60 ? random_primitive(rng)
+                      : roll < 80 ? GenKind::Object
+                      : GenKind::Array;
+    return make_node(schema, rng, params, depth, kind);
+}
+
+
+static DynArrayCount make_node(GenSchema *schema, GenRng *rng, const DataGenParams *params, u32 depth, GenKind::Tag kind)
+{
+    DynArrayCount index = add_node(schema, kind);
+
+    if (kind == GenKind::Object)
+    {
+        u32 field_count = min(params->fields_per_object, params->key_cardinality);
+
+        // Partial shuffle of the key pool for distinct keys
+        DynArray<u32> keys = dynarray::init<u32>(params->key_cardinality);
+        for (u32 i = 0; i < params->key_cardinality; ++i)
+        {
+            dynarray::append(&keys, i);
+        }
+        for (u32 i = 0; i < field_count; ++i)
+        {
+            u32 pick = rng_range(rng, i, params->key_cardinality - 1);
+            std::swap(keys[i], keys[pick]);
+        }
+
+        // Children are made first and may append fields of their own, so
+        // this object's fields are collected and appended as one run after
+        DynArray<GenField> own_fields = dynarray::init<GenField>(field_count);
+        for (u32 i = 0; i < field_count; ++i)
+        {
+            GenField field = {keys[i], make_random_node(schema, rng, params, depth > 0 ? depth - 1 : 0)};
+            dynarray::append(&own_fields, field);
+        }
+
+        schema->nodes[index].first_child = schema->fields.count;
+        schema->nodes[index].child_count = field_count;
+        dynarray::append_from(&schema->fields, &own_fields);
+
+        dynarray::deinit(&own_fields);
+        dynarray::deinit(&keys);
+    }
+    else if (kind == GenKind::Array)
+    {
+        u32 elem_kind_count = rng_chance(rng, params->union_array_pct) ? rng_range(rng, 2, 3) : 1;
+
+        DynArray<DynArrayCount> own_elems = dynarray::init<DynArrayCount>(elem_kind_count);
+        for (u32 i = 0; i < elem_kind_count; ++i)
+        {
+            dynarray::append(&own_elems, make_random_node(schema, rng, params, depth > 0 ? depth - 1 : 0));
+        }
+
+        schema->nodes[index].first_child = schema->array_elems.count;
+        schema->nodes[index].child_count = elem_kind_count;
+        dynarray::append_from(&schema->array_elems, &own_elems);
+
+        dynarray::deinit(&own_elems);
+    }
+
+    return index;
+}
+
+
+static void write_string(std::FILE *file, GenRng *rng, const DataGenParams *params)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+
+    double t = std::pow(rng_unit(rng), (double)params->strlen_skew);
+    u32 length = params->strlen_min + (u32)(t * (params->strlen_max - params->strlen_min) + 0.5);
+
+    std::fputc('"', file);
+    for (u32 i = 0; i < length; ++i)
+    {
+        std::fputc(chars[rng_range(rng, 0, sizeof(chars) - 2)], file);
+    }
+    std::fputc('"', file);
+}
+
+
+static void write_node(std::FILE *file, GenRng *rng, const GenSchema *schema, const DataGenParams *params,
+                       DynArrayCount node_index)
+{
+    const GenNode *node = &schema->nodes[node_index];
+
+    switch (node->kind)
+    {
+        case GenKind::String:
+            write_string(file, rng, params);
+            break;
+
+        case GenKind::Int:
+            std::fprintf(file, "%d", (int)rng_range(rng, 0, 2000000) - 1000000);
+            break;
+
+        case GenKind::Float:
+            std::fprintf(file, "%.4f", rng_unit(rng) * 2000.0 - 1000.0);
+            break;
+
+        case GenKind::Bool:
+            std::fputs(rng_chance(rng, 50) ? "true" : "false", file);
+            break;
+
+        case GenKind::Object:
+        {
+            std::fputc('{', file);
+            bool first = true;
+            for (DynArrayCount i = 0; i < node->child_count; ++i)
+            {
+                if (rng_chance(rng, params->optional_field_pct))
+                {
+                    continue;
+                }
+                const GenField *field = &schema->fields[node->first_child + i];
+                std::fprintf(file, first ? "\"key_%u\":" : ",\"key_%u\":", field->key);
+                write_node(file, rng, schema, params, field->node);
+                first = false;
+            }
+            std::fputc('}', file);
+            break;
+        }
+
+        case GenKind::Array:
+        {
+            std::fputc('[', file);
+            // Empty arrays type as [None] and the loader complains about
+            // every one of them, so there's always at least one element
+            u32 length = rng_range(rng, 1, max(params->max_array_length, 1u));
+            for (u32 i = 0; i < length; ++i)
+            {
+                if (i > 0)
+                {
+                    std::fputc(',', file);
+                }
+                DynArrayCount elem = rng_range(rng, 0, node->child_count - 1);
+                write_node(file, rng, schema, params, schema->array_elems[node->first_child + elem]);
+            }
+            std::fputc(']', file);
+            break;
+        }
+    }
+}
+
+
+namespace datagen
+{
+
+DataGenParams default_params()
+{
+    DataGenParams result = {};
+    result.file_count = 200;
+    result.max_depth = 3;
+    result.key_cardinality = 32;
+    result.fields_per_object = 8;
+    result.max_array_length = 8;
+    result.union_array_pct = 20;
+    result.optional_field_pct = 10;
+    result.strlen_min = 4;
+    result.strlen_max = 32;
+    result.strlen_skew = 1.0f;
+    result.seed = 1;
+    return result;
+}
+
+
+s64 generate_json_dir(const char *dir, const DataGenParams *params)
+{
+    if (params->key_cardinality == 0 || params->strlen_min > params->strlen_max)
+    {
+        logln("datagen: key_cardinality must be > 0 and strlen_min <= strlen_max");
+        return -1;
+    }
+
+    PlatformError err = make_dir(dir);
+    if (err.is_error())
+    {
+        logf_ln("datagen: couldn't create '%s': %s", dir, str_data(err.message));
+        err.release();
+        return -1;
+    }
+
+    // xorshift can't start at zero
+    GenRng rng = {params->seed ? params->seed : 0x9E3779B97F4A7C15ull};
+
+    GenSchema schema;
+    dynarray::init(&schema.nodes, 64);
+    dynarray::init(&schema.fields, 64);
+    dynarray::init(&schema.array_elems, 16);
+    make_node(&schema, &rng, params, params->max_depth, GenKind::Object);
+
+    s64 total_bytes = 0;
+    Str path = {};
+    char filename[32];
+
+    for (u32 i = 0; i < params->file_count; ++i)
+    {
+        snprintf(filename, sizeof(filename), "/record_%06u.json", i);
+        str_overwrite(&path, str_slice(dir));
+        str_append(&path, str_slice(filename));
+
+        std::FILE *file = std::fopen(str_data(path), "wb");
+        if (!file)
+        {
+            logf_ln("datagen: couldn't open '%s' for writing", str_data(path));
+            total_bytes = -1;
+            break;
+        }
+
+        write_node(file, &rng, &schema, params, 0);
+        std::fputc('\n', file);
+        total_bytes += std::ftell(file);
+        std::fclose(file);
+    }
+
+    str_free(&path);
+    dynarray::deinit(&schema.nodes);
+    dynarray::deinit(&schema.fields);
+    dynarray::deinit(&schema.array_elems);
+
+    return total_bytes;
+}
+
+}
@@ -0,0 +1,51 @@
+// -*- c++ -*-
+
+#ifndef DATAGEN_H
+
+#include "numeric_types.h"
+
+
+/*
+Deterministic generator for directories of json records, for the
+benchmarks. A random schema is made once from the seed, then each file
+is an instance of it with random values and some fields left out, so
+loading the directory exercises type inference and merging the way a
+real collection does. The same params always write the same bytes.
+*/
+
+struct DataGenParams
+{
+    u32 file_count;
+    // levels of nested objects/arrays below the top-level object
+    u32 max_depth;
+    // size of the pool that object keys are drawn from
+    u32 key_cardinality;
+    u32 fields_per_object;
+    u32 max_array_length;
+    // percent of arrays whose elements are a mix of types
+    u32 union_array_pct;
+    // percent chance that a field is left out of a record
+    u32 optional_field_pct;
+    u32 strlen_min;
+    u32 strlen_max;
+    // 1 is uniform between min and max, higher skews towards short strings
+    float strlen_skew;
+    u64 seed;
+};
+
+
+namespace datagen
+{
+
+DataGenParams default_params();
+
+// Writes params->file_count files named record_NNNNNN.json into dir,
+// creating it if needed. Returns the total bytes written, or -1 on error
+// (which is logged).
+s64 generate_json_dir(const char *dir, const DataGenParams *params);
+
+}
+
+
+#define DATAGEN_H
+#endif
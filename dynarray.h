@@ -60,7 +60,7 @@ void init(DynArray<T> *dynarr, DynArrayCount capacity,
         allocator = mem::default_allocator();
     }
     dynarr->allocator = allocator;
-    dynarr->data = capacity > 0 ? MAKE_ARRAY(dynarr->allocator, capacity, T) : 0;
+    dynarr->data = capacity > 0 ? MAKE_ARRAY_CAT(dynarr->allocator, capacity, "dynarray", T) : 0;
     dynarr->count = 0;
     dynarr->capacity = capacity;
 }
@@ -191,7 +191,7 @@ void ensure_capacity(DynArray<T> *dynarray, DynArrayCount min_capacity)
     if (dynarray->capacity < min_capacity)
     {
         dynarray->capacity = min_capacity;
-        RESIZE_ARRAY(dynarray->allocator, dynarray->data, dynarray->capacity, T);
+        RESIZE_ARRAY_CAT(dynarray->allocator, dynarray->data, dynarray->capacity, "dynarray", T);
     }
 }
 
@@ -216,7 +216,7 @@ T *append(DynArray<T> *dynarray)
     if (dynarray->count == dynarray->capacity)
     {
         DynArrayCount new_capacity = (dynarray->capacity + 1) * 2;
-        RESIZE_ARRAY(dynarray->allocator, dynarray->data, new_capacity, T);
+        RESIZE_ARRAY_CAT(dynarray->allocator, dynarray->data, new_capacity, "dynarray", T);
         dynarray->capacity = new_capacity;
     }
 
@@ -248,6 +248,19 @@ void swappop(DynArray<T> *da, DynArrayCount idx)
     --da->count;
 }
 
+
+// Shifts the rest down, keeping their order
+template <typename T>
+void remove_at(DynArray<T> *da, DynArrayCount idx)
+{
+    assert(idx < da->count);
+    for (DynArrayCount i = idx + 1; i < da->count; ++i)
+    {
+        da->data[i - 1] = da->data[i];
+    }
+    --da->count;
+}
+
 template<typename T>
 void set(DynArray<T> *dynarray, u32 index, T value)
 {
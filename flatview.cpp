@@ -0,0 +1,178 @@
+#include "flatview.h"
+#include "programstate.h"
+#include <algorithm>
+
+
+namespace flatview
+{
+
+void init(FlatView *view, Collection *collection, FlatView *parent_view, NameRef member)
+{
+    view->collection = collection;
+    view->parent_view = parent_view;
+    view->member = member;
+    dynarray::init(&view->row_starts, 64);
+    view->rows_counted = 0;
+    view->all_counted = false;
+    dynarray::init(&view->columns, 8);
+    view->has_plain_elements = false;
+}
+
+
+void deinit(FlatView *view)
+{
+    dynarray::deinit(&view->row_starts);
+    dynarray::deinit(&view->columns);
+}
+
+
+Value *parent_record(FlatView *view, u32 parent)
+{
+    if (!view->parent_view)
+    {
+        DynArray<Value> *records = &view->collection->value.array_value.elements;
+        return parent < records->count ? &(*records)[parent] : nullptr;
+    }
+
+    FlatRow parent_row;
+    if (!locate(&parent_row, view->parent_view, parent))
+    {
+        return nullptr;
+    }
+    return element(view->parent_view, parent_row);
+}
+
+
+static Value *record_array(FlatView *view, Value *record)
+{
+    if (!vIS_COMPOUND(record))
+    {
+        return nullptr;
+    }
+    CompoundValueMember *member = find_member(record, view->member);
+    if (!member || !vIS_ARRAY(&member->value))
+    {
+        return nullptr;
+    }
+    return &member->value;
+}
+
+
+Value *parent_array(FlatView *view, u32 parent)
+{
+    Value *record = parent_record(view, parent);
+    return record ? record_array(view, record) : nullptr;
+}
+
+
+static void add_columns(FlatView *view, TypeDescriptor *elem_type)
+{
+    if (tIS_COMPOUND(elem_type))
+    {
+        DynArray<CompoundTypeMember> *members = &elem_type->compound_type.members;
+        for (DynArrayCount i = 0; i < members->count; ++i)
+        {
+            dynarray::append_if_not_present<NameRef, nameref::Identical>(&view->columns, (*members)[i].name);
+        }
+    }
+    else if (tIS_UNION(elem_type))
+    {
+        for (DynArrayCount i = 0; i < elem_type->union_type.type_cases.count; ++i)
+        {
+            add_columns(view, elem_type->union_type.type_cases[i]);
+        }
+    }
+    // An empty array's elements are None, there's nothing to show for them
+    else if (elem_type->type_id != TypeID::None)
+    {
+        view->has_plain_elements = true;
+    }
+}
+
+
+// Counts parents until row is covered or they run out
+static void count_rows(FlatView *view, u32 row)
+{
+    // Arrays of one type mostly follow each other
+    TypeDescriptor *last_elem_type = nullptr;
+
+    while (!view->all_counted && view->rows_counted <= row)
+    {
+        Value *record = parent_record(view, view->row_starts.count);
+        if (!record)
+        {
+            view->all_counted = true;
+            break;
+        }
+
+        dynarray::append(&view->row_starts, view->rows_counted);
+
+        Value *array = record_array(view, record);
+        if (array)
+        {
+            view->rows_counted += array->array_value.elements.count;
+
+            TypeDescriptor *elem_type = array->typedesc->array_type.elem_type;
+            if (elem_type != last_elem_type)
+            {
+                add_columns(view, elem_type);
+                last_elem_type = elem_type;
+            }
+        }
+    }
+}
+
+
+bool locate(OUTPARAM FlatRow *result, FlatView *view, u32 row)
+{
+    count_rows(view, row);
+    if (row >= view->rows_counted)
+    {
+        return false;
+    }
+
+    // The last parent starting at or before row. Parents with no rows
+    // start where the next one does, so this skips them.
+    const u32 *starts = view->row_starts.data;
+    const u32 *after = std::upper_bound(starts, starts + view->row_starts.count, row);
+    result->parent = (u32)(after - starts) - 1;
+    result->index = row - starts[result->parent];
+    return true;
+}
+
+
+u32 row_count(FlatView *view)
+{
+    count_rows(view, UINT32_MAX);
+    return view->rows_counted;
+}
+
+
+Value *element(FlatView *view, FlatRow row)
+{
+    Value *array = parent_array(view, row.parent);
+    ASSERT(array && row.index < array->array_value.elements.count);
+    return &array->array_value.elements[row.index];
+}
+
+
+void element_changed(FlatView *view, FlatRow row)
+{
+    value_hash_changed(element(view, row));
+    value_hash_changed(parent_array(view, row.parent));
+
+    if (!view->parent_view)
+    {
+        value_hash_changed(parent_record(view, row.parent));
+        value_hash_changed(&view->collection->value);
+        return;
+    }
+
+    // The parent is itself an element of the view above
+    FlatRow parent_row;
+    bool found = locate(&parent_row, view->parent_view, row.parent);
+    ASSERT(found);
+    element_changed(view->parent_view, parent_row);
+}
+
+}
@@ -0,0 +1,80 @@
+// -*- c++ -*-
+
+#ifndef FLATVIEW_H
+
+#include "typesys.h"
+#include "nametable.h"
+#include "dynarray.h"
+#include "numeric_types.h"
+
+
+/*
+A nested array member seen as a table of its own, the relational join
+from DEVLOG.md. Each row is one element of one parent's array, named by
+(parent, index), and is looked up in place, so nothing gets copied. The
+parents are the collection's records, or the rows of another FlatView
+for arrays nested deeper than that.
+
+row_starts has the first row of each parent counted so far. Looking up a
+row counts parents until it's covered, then binary searches. Counting a
+parent only reads its array's length, and the columns are the element
+members of the parents counted.
+
+Counts are never redone, which holds because nothing changes an array's
+length once it's loaded. Whatever starts doing that has to close the
+views over it.
+*/
+
+struct Collection;
+
+
+struct FlatRow
+{
+    u32 parent;
+    u32 index;
+};
+
+
+struct FlatView
+{
+    Collection *collection;
+    // nullptr when the parents are the collection's records
+    FlatView *parent_view;
+    NameRef member;
+
+    DynArray<u32> row_starts;
+    u32 rows_counted;
+    // Set once every parent has been counted
+    bool all_counted;
+
+    DynArray<NameRef> columns;
+    // Some elements aren't compounds, they're a column of their own
+    bool has_plain_elements;
+};
+
+
+namespace flatview
+{
+
+void init(FlatView *view, Collection *collection, FlatView *parent_view, NameRef member);
+void deinit(FlatView *view);
+
+// nullptr past the last parent
+Value *parent_record(FlatView *view, u32 parent);
+// parent's array, nullptr if it has no array by that name
+Value *parent_array(FlatView *view, u32 parent);
+
+// False if there's no such row
+bool locate(OUTPARAM FlatRow *result, FlatView *view, u32 row);
+// Counts any parents that haven't been yet
+u32 row_count(FlatView *view);
+
+Value *element(FlatView *view, FlatRow row);
+// An element was edited, clears cached hashes from it up to the collection
+void element_changed(FlatView *view, FlatRow row);
+
+}
+
+
+#define FLATVIEW_H
+#endif
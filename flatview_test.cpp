@@ -0,0 +1,162 @@
+#include "flatview.h"
+#include "programstate.h"
+#include "typesys_json.h"
+#include "common.h"
+#include <cstring>
+
+
+// Parents with empty arrays and no array at all, at the start, in the
+// middle and at the end. The sub arrays hold their own row numbers.
+static const char *flatview_test_json =
+    "["
+    "  {\"items\": []},"
+    "  {\"items\": [{\"sub\": [0, 1]}, {\"sub\": []}]},"
+    "  {\"name\": \"no items\"},"
+    "  {\"items\": []},"
+    "  {\"items\": [{\"sub\": [2]}, {\"name\": \"no sub\"}, {\"sub\": [3, 4, 5]}]},"
+    "  {\"items\": [{\"sub\": []}]},"
+    "  {\"name\": \"no items\"},"
+    "  {\"items\": []},"
+    "]";
+
+
+struct FlatViewTestRow
+{
+    u32 parent;
+    u32 index;
+};
+
+
+// Rows of the items view, over the records
+static const FlatViewTestRow flatview_test_item_rows[] = {
+    {1, 0}, {1, 1}, {4, 0}, {4, 1}, {4, 2}, {5, 0},
+};
+
+// Rows of the sub view, over the items view's rows
+static const FlatViewTestRow flatview_test_sub_rows[] = {
+    {0, 0}, {0, 1}, {2, 0}, {4, 0}, {4, 1}, {4, 2},
+};
+
+
+static Collection *make_flatview_test_collection(ProgramState *prgstate)
+{
+    Value records;
+    JsonParseResult parse_result = try_parse_json_as_value(&records, prgstate, flatview_test_json,
+                                                           strlen(flatview_test_json));
+    ASSERT(parse_result.status == JsonParseResult::Succeeded);
+
+    Collection *collection = bucketarray::add(&prgstate->collections).elem;
+    mem::zero_ptr(collection);
+    collection->value = records;
+    collection->top_typedesc = records.typedesc->array_type.elem_type;
+    dynarray::init(&collection->info, records.array_value.elements.count);
+    for (DynArrayCount i = 0; i < records.array_value.elements.count; ++i)
+    {
+        RecordInfo record_info = {};
+        record_info.fullpath = str("flatview_test");
+        dynarray::append(&collection->info, record_info);
+    }
+    collection->load_path = str("flatview_test");
+    return collection;
+}
+
+
+// Looks rows up in order, past the end, then counts. locate counts as
+// far as it needs to, so this covers counting a bit at a time.
+static s32 check_view_rows(FlatView *view, const char *view_name, const FlatViewTestRow *expected, u32 expected_count)
+{
+    s32 fails = 0;
+
+    for (u32 row = 0; row <= expected_count; ++row)
+    {
+        FlatRow found;
+        bool located = flatview::locate(&found, view, row);
+        if (row == expected_count)
+        {
+            if (located)
+            {
+                printf_ln("The %s view located row %u past its last", view_name, row);
+                ++fails;
+            }
+        }
+        else if (!located || found.parent != expected[row].parent || found.index != expected[row].index)
+        {
+            printf_ln("The %s view located row %u at (%u, %u), expected (%u, %u)", view_name, row,
+                      located ? found.parent : 0, located ? found.index : 0,
+                      expected[row].parent, expected[row].index);
+            ++fails;
+        }
+    }
+
+    if (flatview::row_count(view) != expected_count)
+    {
+        printf_ln("The %s view has %u rows, expected %u", view_name, flatview::row_count(view), expected_count);
+        ++fails;
+    }
+    return fails;
+}
+
+
+s32 run_flatview_tests()
+{
+    static ProgramState prgstate;
+    prgstate_init(&prgstate);
+    load_base_type_descriptors(&prgstate);
+
+    Collection *collection = make_flatview_test_collection(&prgstate);
+    NameRef items_name = nametable::find(&prgstate.names, "items");
+    NameRef sub_name = nametable::find(&prgstate.names, "sub");
+
+    s32 fails = 0;
+
+    FlatView items;
+    flatview::init(&items, collection, nullptr, items_name);
+    FlatView sub;
+    flatview::init(&sub, collection, &items, sub_name);
+
+    // The child view first, so it counts its parents before they've
+    // been counted themselves
+    fails += check_view_rows(&sub, "sub", flatview_test_sub_rows, COUNTOF(flatview_test_sub_rows));
+    fails += check_view_rows(&items, "items", flatview_test_item_rows, COUNTOF(flatview_test_item_rows));
+
+    for (u32 row = 0; row < COUNTOF(flatview_test_sub_rows); ++row)
+    {
+        FlatRow found;
+        Value *element = flatview::locate(&found, &sub, row) ? flatview::element(&sub, found) : nullptr;
+        if (!element || !vIS_INT(element) || element->s64_val != row)
+        {
+            printf_ln("Row %u of the sub view isn't the element it names", row);
+            ++fails;
+        }
+    }
+
+    // Counting everything up front gives the same rows
+    FlatView counted_items;
+    flatview::init(&counted_items, collection, nullptr, items_name);
+    FlatView counted_sub;
+    flatview::init(&counted_sub, collection, &counted_items, sub_name);
+    if (flatview::row_count(&counted_sub) != COUNTOF(flatview_test_sub_rows)
+        || flatview::row_count(&counted_items) != COUNTOF(flatview_test_item_rows))
+    {
+        println("Counting a view's rows all at once gave a different count");
+        ++fails;
+    }
+    fails += check_view_rows(&counted_sub, "counted sub", flatview_test_sub_rows, COUNTOF(flatview_test_sub_rows));
+
+    flatview::deinit(&counted_sub);
+    flatview::deinit(&counted_items);
+    flatview::deinit(&sub);
+    flatview::deinit(&items);
+    drop_collection(&prgstate, bucketarray::bucketindex_of(&prgstate.collections, collection));
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i flat view test failures", fails);
+    }
+    else
+    {
+        println("No failures in flat view tests");
+    }
+
+    return fails;
+}
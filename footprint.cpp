@@ -0,0 +1,360 @@
+#include "footprint.h"
+#include "programstate.h"
+#include "allocstats.h"
+#include "memory.h"
+#include "logging.h"
+#include "formatbuffer.h"
+#include "str.h"
+#include "common.h"
+#include <algorithm>
+
+
+inline bool hashtable_keys_equal(const FootprintPathKey &lhs, const FootprintPathKey &rhs)
+{
+    return lhs.parent == rhs.parent && lhs.name_handle == rhs.name_handle;
+}
+
+
+namespace FootprintKind
+{
+
+const char *to_string(Tag tag)
+{
+    switch (tag)
+    {
+        case StringText:       return "string text";
+        case StringSlack:      return "string slack";
+        case ElementSlots:     return "array element slots";
+        case ElementSlack:     return "array element slack";
+        case MemberSlots:      return "member slots";
+        case MemberSlack:      return "member slack";
+        case RecordInfo:       return "record info";
+        case AllocatorHeaders: return "allocator headers";
+        case Count:            break;
+    }
+    return "<invalid>";
+}
+
+}
+
+
+namespace footprint
+{
+
+void init(FootprintReport *report)
+{
+    mem::zero_ptr(report);
+    dynarray::init(&report->types, 64);
+    ht_init(&report->type_rows);
+    dynarray::init(&report->paths, 64);
+    ht_init(&report->path_rows);
+
+    FootprintPathRow root = {};
+    dynarray::append(&report->paths, root);
+}
+
+
+void deinit(FootprintReport *report)
+{
+    dynarray::deinit(&report->types);
+    ht_deinit(&report->type_rows);
+    dynarray::deinit(&report->paths);
+    ht_deinit(&report->path_rows);
+}
+
+
+static void add_stats(FootprintStats *into, const FootprintStats *stats)
+{
+    into->value_count += stats->value_count;
+    into->heap_blocks += stats->heap_blocks;
+    into->heap_bytes += stats->heap_bytes;
+    into->slack_bytes += stats->slack_bytes;
+}
+
+
+static DynArrayCount child_path(FootprintReport *report, DynArrayCount parent, NameRef name)
+{
+    FootprintPathKey key = {parent, name.handle};
+    DynArrayCount *row_index;
+    if (!ht_set_if_unset(&row_index, &report->path_rows, key, report->paths.count))
+    {
+        FootprintPathRow row = {};
+        row.parent = parent;
+        row.name = name;
+        dynarray::append(&report->paths, row);
+    }
+    return *row_index;
+}
+
+
+static void count_value(FootprintReport *report, const Value *value, const FootprintStats *stats, DynArrayCount path)
+{
+    DynArrayCount *row_index;
+    if (!ht_set_if_unset(&row_index, &report->type_rows, value->typedesc, report->types.count))
+    {
+        FootprintTypeRow row = {};
+        row.typedesc = value->typedesc;
+        dynarray::append(&report->types, row);
+    }
+
+    add_stats(&report->types[*row_index].stats, stats);
+    add_stats(&report->paths[path].stats, stats);
+    add_stats(&report->total, stats);
+}
+
+
+// The Value itself lives in its parent's element or member array, only
+// the blocks it points to are its own
+// Container storage from value_storage_allocator has the cached hash in
+// front of it
+static u64 hash_slot_bytes(mem::IAllocator *allocator)
+{
+    return allocator == value_storage_allocator() ? sizeof(u64) : 0;
+}
+
+
+static void walk_value(FootprintReport *report, const Value *value, DynArrayCount path)
+{
+    FootprintStats stats = {};
+    stats.value_count = 1;
+    u64 header_bytes = mem::Mallocator::HeaderSize;
+
+    TYPESWITCH (value->typedesc->type_id)
+    {
+        case TypeID::None:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+            break;
+
+        case TypeID::String:
+        {
+            StrLen length = str_length(value->str_val);
+            if (str_is_small(value->str_val))
+            {
+                ++report->small_strings;
+            }
+            else
+            {
+                u64 slack = str_capacity(value->str_val) - length;
+                report->kind_bytes[FootprintKind::StringText] += length;
+                stats.heap_blocks = 1;
+                stats.heap_bytes = str_capacity(value->str_val);
+                stats.slack_bytes = slack;
+                report->kind_bytes[FootprintKind::StringSlack] += slack;
+            }
+            break;
+        }
+
+        case TypeID::Array:
+        {
+            const DynArray<Value> *elements = &value->array_value.elements;
+            u64 slack = (u64)(elements->capacity - elements->count) * sizeof(Value);
+            stats.heap_blocks = elements->capacity > 0;
+            stats.heap_bytes = (u64)elements->capacity * sizeof(Value);
+            header_bytes += hash_slot_bytes(elements->allocator);
+            stats.slack_bytes = slack;
+            report->kind_bytes[FootprintKind::ElementSlots] += (u64)elements->count * sizeof(Value);
+            report->kind_bytes[FootprintKind::ElementSlack] += slack;
+
+            NameRef every_element = {0};
+            DynArrayCount element_path = child_path(report, path, every_element);
+            for (DynArrayCount i = 0; i < elements->count; ++i)
+            {
+                walk_value(report, &(*elements)[i], element_path);
+            }
+            break;
+        }
+
+        case TypeID::Compound:
+        {
+            const DynArray<CompoundValueMember> *members = &value->compound_value.members;
+            u64 slack = (u64)(members->capacity - members->count) * sizeof(CompoundValueMember);
+            stats.heap_blocks = members->capacity > 0;
+            stats.heap_bytes = (u64)members->capacity * sizeof(CompoundValueMember);
+            header_bytes += hash_slot_bytes(members->allocator);
+            stats.slack_bytes = slack;
+            report->kind_bytes[FootprintKind::MemberSlots] += (u64)members->count * sizeof(CompoundValueMember);
+            report->kind_bytes[FootprintKind::MemberSlack] += slack;
+
+            for (DynArrayCount i = 0; i < members->count; ++i)
+            {
+                const CompoundValueMember *member = &(*members)[i];
+                walk_value(report, &member->value, child_path(report, path, member->name));
+            }
+            break;
+        }
+
+        case TypeID::Union:
+            assert(!(bool)"There must never be a value of type Union");
+            break;
+    }
+
+    report->kind_bytes[FootprintKind::AllocatorHeaders] += stats.heap_blocks * header_bytes;
+    count_value(report, value, &stats, path);
+}
+
+
+void add_collection(FootprintReport *report, const Collection *collection)
+{
+    walk_value(report, &collection->value, 0);
+
+    const DynArray<RecordInfo> *info = &collection->info;
+    u64 info_bytes = (u64)info->capacity * sizeof(RecordInfo);
+    u64 info_blocks = info->capacity > 0;
+    for (DynArrayCount i = 0; i < info->count; ++i)
+    {
+        const Str *fullpath = &(*info)[i].fullpath;
+        if (!str_is_small(*fullpath))
+        {
+            info_bytes += str_capacity(*fullpath);
+            ++info_blocks;
+        }
+    }
+    report->kind_bytes[FootprintKind::RecordInfo] += info_bytes;
+    report->kind_bytes[FootprintKind::AllocatorHeaders] += info_blocks * mem::Mallocator::HeaderSize;
+}
+
+
+u64 total_bytes(const FootprintReport *report)
+{
+    u64 result = 0;
+    for (size_t i = 0; i < FootprintKind::Count; ++i)
+    {
+        result += report->kind_bytes[i];
+    }
+    return result;
+}
+
+
+void path_string(Str *out, const FootprintReport *report, DynArrayCount path)
+{
+    // Collect leaf to root, then write root to leaf
+    DynArrayCount chain[64];
+    size_t depth = 0;
+    for (DynArrayCount node = path; node != 0 && depth < COUNTOF(chain); node = report->paths[node].parent)
+    {
+        chain[depth++] = node;
+    }
+
+    str_overwrite(out, str_slice("$"));
+    while (depth > 0)
+    {
+        NameRef name = report->paths[chain[--depth]].name;
+        if (name.handle)
+        {
+            str_append(out, '.');
+            str_append(out, nameref::str_slice(name));
+        }
+        else
+        {
+            str_append(out, str_slice("[]"));
+        }
+    }
+}
+
+
+template <typename TRow>
+struct RowHeapBytesGreater
+{
+    bool operator()(const TRow &a, const TRow &b) const
+    {
+        return a.stats.heap_bytes > b.stats.heap_bytes;
+    }
+};
+
+
+// Paths are sorted by index, rows refer to their parents by position
+struct PathOrder
+{
+    const FootprintReport *report;
+
+    bool operator()(DynArrayCount a, DynArrayCount b) const
+    {
+        return report->paths[a].stats.heap_bytes > report->paths[b].stats.heap_bytes;
+    }
+};
+
+
+static void log_stats_header(const char *what)
+{
+    logf_ln("  %10s %10s %10s %10s  %s", "values", "blocks", "heap", "slack", what);
+}
+
+
+static void log_stats_row(const FootprintStats *stats, StrSlice label)
+{
+    char heap[32];
+    char slack[32];
+    allocstats::format_bytes(heap, sizeof(heap), (s64)stats->heap_bytes);
+    allocstats::format_bytes(slack, sizeof(slack), (s64)stats->slack_bytes);
+    logf_ln("  %10llu %10llu %10s %10s  %.*s",
+            (unsigned long long)stats->value_count, (unsigned long long)stats->heap_blocks,
+            heap, slack, (int)label.length, label.data);
+}
+
+
+void log_report(ProgramState *prgstate, const FootprintReport *report, u32 max_rows)
+{
+    char bytes_text[32];
+    u64 total = total_bytes(report);
+    allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)total);
+    logf_ln("%s in %llu values, %llu heap blocks",
+            bytes_text, (unsigned long long)report->total.value_count,
+            (unsigned long long)report->total.heap_blocks);
+
+    logln("By kind:");
+    for (size_t i = 0; i < FootprintKind::Count; ++i)
+    {
+        allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)report->kind_bytes[i]);
+        double percent = total ? 100.0 * (double)report->kind_bytes[i] / (double)total : 0.0;
+        logf_ln("  %10s %5.1f%%  %s", bytes_text, percent, FootprintKind::to_string((FootprintKind::Tag)i));
+    }
+    logf_ln("  (a Value is %u bytes and a member %u whatever they hold, %llu strings were short enough to fit inside)",
+            (u32)sizeof(Value), (u32)sizeof(CompoundValueMember), (unsigned long long)report->small_strings);
+
+    // Sorting copies, the report stays in walk order
+    DynArray<FootprintTypeRow> types = dynarray::init<FootprintTypeRow>(report->types.count);
+    dynarray::append_from(&types, &report->types);
+    std::sort(types.data, types.data + types.count, RowHeapBytesGreater<FootprintTypeRow>());
+
+    logf_ln("By type, top %u of %u:", min(max_rows, types.count), types.count);
+    log_stats_header("type");
+    FormatBuffer label;
+    for (DynArrayCount i = 0; i < types.count && i < max_rows; ++i)
+    {
+        TypeDescriptor *typedesc = types[i].typedesc;
+        label.clear();
+        label.writef("%-8s @ %p, [", TypeID::to_string(typedesc->type_id), (void *)typedesc);
+        DynArray<NameRef> *names = find_names_of_typedesc(prgstate, typedesc);
+        for (DynArrayCount j = 0; names && j < names->count; ++j)
+        {
+            StrSlice name = nameref::str_slice((*names)[j]);
+            label.writef(j > 0 ? ", %.*s" : "%.*s", (int)name.length, name.data);
+        }
+        label.write("]");
+        log_stats_row(&types[i].stats, str_slice(label.buffer, label.cursor));
+    }
+    dynarray::deinit(&types);
+
+    DynArray<DynArrayCount> order = dynarray::init<DynArrayCount>(report->paths.count);
+    for (DynArrayCount i = 0; i < report->paths.count; ++i)
+    {
+        dynarray::append(&order, i);
+    }
+    PathOrder by_heap_bytes = {report};
+    std::sort(order.data, order.data + order.count, by_heap_bytes);
+
+    logf_ln("By member path, top %u of %u:", min(max_rows, order.count), order.count);
+    log_stats_header("path");
+    Str path_text = {};
+    for (DynArrayCount i = 0; i < order.count && i < max_rows; ++i)
+    {
+        path_string(&path_text, report, order[i]);
+        log_stats_row(&report->paths[order[i]].stats, str_slice(path_text));
+    }
+    str_free(&path_text);
+    dynarray::deinit(&order);
+}
+
+}
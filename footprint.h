@@ -0,0 +1,118 @@
+// -*- c++ -*-
+
+#ifndef FOOTPRINT_H
+
+#include "typesys.h"
+#include "hashtable.h"
+#include "dynarray.h"
+#include "numeric_types.h"
+
+
+/*
+Where a collection's memory goes. Walking the value tree attributes
+every heap block to the value that owns it (a string buffer, an array's
+elements, a compound's members) and sums those by kind, by type and by
+member path. Slack is capacity that was allocated but isn't used.
+*/
+
+struct ProgramState;
+struct Collection;
+
+
+namespace FootprintKind
+{
+
+enum Tag
+{
+    // heap strings only, short ones live inside their Value
+    StringText,
+    // unused string capacity, including the null terminator
+    StringSlack,
+    // array elements, each a whole Value whatever its type
+    ElementSlots,
+    ElementSlack,
+    MemberSlots,
+    MemberSlack,
+    RecordInfo,
+    // not measured, header size times the number of blocks
+    AllocatorHeaders,
+
+    Count
+};
+
+const char *to_string(Tag tag);
+
+}
+
+
+struct FootprintStats
+{
+    u64 value_count;
+    // heap blocks owned directly, not by child values
+    u64 heap_blocks;
+    u64 heap_bytes;
+    u64 slack_bytes;
+};
+
+
+struct FootprintTypeRow
+{
+    TypeDescriptor *typedesc;
+    FootprintStats stats;
+};
+
+
+// Paths are a tree of nodes, name is the member or the null handle for
+// "every element of the array"
+struct FootprintPathRow
+{
+    DynArrayCount parent;
+    NameRef name;
+    FootprintStats stats;
+};
+
+
+struct FootprintPathKey
+{
+    DynArrayCount parent;
+    u32 name_handle;
+};
+
+
+struct FootprintReport
+{
+    u64 kind_bytes[FootprintKind::Count];
+    FootprintStats total;
+    u64 small_strings;
+
+    DynArray<FootprintTypeRow> types;
+    OAHashtable<TypeDescriptor *, DynArrayCount> type_rows;
+
+    // paths[0] is the collection itself
+    DynArray<FootprintPathRow> paths;
+    OAHashtable<FootprintPathKey, DynArrayCount> path_rows;
+};
+
+
+namespace footprint
+{
+
+void init(FootprintReport *report);
+void deinit(FootprintReport *report);
+
+void add_collection(FootprintReport *report, const Collection *collection);
+
+// Total heap bytes attributed, slack and the guessed allocator headers included
+u64 total_bytes(const FootprintReport *report);
+
+// "$[].stats.items[]", $ being the collection
+void path_string(Str *out, const FootprintReport *report, DynArrayCount path);
+
+// Kinds, then the top max_rows types and paths by heap bytes
+void log_report(ProgramState *prgstate, const FootprintReport *report, u32 max_rows);
+
+}
+
+
+#define FOOTPRINT_H
+#endif
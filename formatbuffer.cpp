@@ -92,7 +92,7 @@ static void ensure_formatbuffer_space(FormatBuffer *fb, size_t length)
         {
             fb->capacity = length;
         }
-        fb->buffer = MAKE_ARRAY(fb->allocator, fb->capacity, char);
+        fb->buffer = MAKE_ARRAY_CAT(fb->allocator, fb->capacity, "formatbuffer", char);
     }
     else if (bytes_remaining <= length)
     {
@@ -101,7 +101,7 @@ static void ensure_formatbuffer_space(FormatBuffer *fb, size_t length)
                                    ? fb->capacity + length + 1
                                    : fb->capacity * 2));
 
-        RESIZE_ARRAY(fb->allocator, fb->buffer, new_capacity, char);
+        RESIZE_ARRAY_CAT(fb->allocator, fb->buffer, new_capacity, "formatbuffer", char);
         fb->capacity = new_capacity;
     }
 
@@ -141,7 +141,7 @@ void formatbuffer_v_writef(FormatBuffer *fmt_buf, const char *format, va_list va
 {
     if (!fmt_buf->buffer)
     {
-        fmt_buf->buffer = MAKE_ARRAY(fmt_buf->allocator, fmt_buf->capacity, char);
+        fmt_buf->buffer = MAKE_ARRAY_CAT(fmt_buf->allocator, fmt_buf->capacity, "formatbuffer", char);
     }
 
     size_t bytes_remaining = fmt_buf->capacity - fmt_buf->cursor;
@@ -171,7 +171,7 @@ void formatbuffer_v_writef(FormatBuffer *fmt_buf, const char *format, va_list va
 
         assert(new_capacity < FormatBuffer::MaxCapacity);
 
-        RESIZE_ARRAY(fmt_buf->allocator, fmt_buf->buffer, new_capacity, char);
+        RESIZE_ARRAY_CAT(fmt_buf->allocator, fmt_buf->buffer, new_capacity, "formatbuffer", char);
         fmt_buf->capacity = new_capacity;
 
         int confirm_result = vsnprintf(fmt_buf->buffer + fmt_buf->cursor,
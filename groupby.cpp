@@ -0,0 +1,775 @@
+#include "groupby.h"
+#include "programstate.h"
+#include "platform.h"
+#include "memory.h"
+#include "logging.h"
+#include "profiler.h"
+#include "common.h"
+#include <cstring>
+#include <cfloat>
+
+
+namespace AggregateOp
+{
+
+const char *to_string(Tag tag)
+{
+    switch (tag)
+    {
+        case Count: return "count";
+        case Sum:   return "sum";
+        case Min:   return "min";
+        case Max:   return "max";
+        case Avg:   return "avg";
+    }
+    return "<unknown aggregate>";
+}
+
+}
+
+
+namespace groupby
+{
+
+// Rows gathered at a time, the flat arrays stay in L1
+static const u32 chunk_rows = 1024;
+
+static const char *const row_count_label = "count(*)";
+
+
+void init(GroupBySpec *spec)
+{
+    dynarray::init(&spec->key_path, 4);
+    spec->key_label.handle = 0;
+    dynarray::init(&spec->aggregates, 4);
+    spec->min_rows_per_thread = 8192;
+}
+
+
+void deinit(GroupBySpec *spec)
+{
+    dynarray::deinit(&spec->key_path);
+    for (DynArrayCount i = 0; i < spec->aggregates.count; ++i)
+    {
+        dynarray::deinit(&spec->aggregates[i].path);
+    }
+    dynarray::deinit(&spec->aggregates);
+}
+
+
+static bool parse_path(DynArray<NameRef> *path, ProgramState *prgstate, StrSlice text)
+{
+    dynarray::clear(path);
+
+    const char *start = text.data;
+    const char *end = text.data + text.length;
+    for (const char *cursor = start; ; ++cursor)
+    {
+        if (cursor != end && *cursor != '.')
+        {
+            continue;
+        }
+
+        StrSlice name = str_slice(start, cursor);
+        if (name.length == 0)
+        {
+            logf_ln("Empty member name in path '%.*s'", (int)text.length, text.data);
+            return false;
+        }
+
+        // Anything a record has was added when it loaded
+        NameRef ref = nametable::find(&prgstate->names, name);
+        if (!ref.handle)
+        {
+            logf_ln("No record has a member named '%.*s'", (int)name.length, name.data);
+            return false;
+        }
+        dynarray::append(path, ref);
+
+        if (cursor == end)
+        {
+            return true;
+        }
+        start = cursor + 1;
+    }
+}
+
+
+bool set_key(GroupBySpec *spec, ProgramState *prgstate, StrSlice path_text)
+{
+    if (!parse_path(&spec->key_path, prgstate, path_text))
+    {
+        return false;
+    }
+    spec->key_label = nametable::find_or_add(&prgstate->names, path_text);
+    return true;
+}
+
+
+bool add_aggregate(GroupBySpec *spec, ProgramState *prgstate, StrSlice agg_text)
+{
+    const char *open = (const char *)memchr(agg_text.data, '(', agg_text.length);
+    if (!open || agg_text.length < 2 || agg_text.data[agg_text.length - 1] != ')')
+    {
+        logf_ln("Expected an aggregate like sum(path), got '%.*s'", (int)agg_text.length, agg_text.data);
+        return false;
+    }
+
+    StrSlice op_name = str_slice(agg_text.data, open);
+    StrSlice path_text = str_slice(open + 1, agg_text.data + agg_text.length - 1);
+
+    AggregateOp::Tag ops[] = {AggregateOp::Count, AggregateOp::Sum, AggregateOp::Min,
+                              AggregateOp::Max, AggregateOp::Avg};
+    size_t op_idx = 0;
+    while (op_idx < COUNTOF(ops) && !str_equal_ignorecase(op_name, AggregateOp::to_string(ops[op_idx])))
+    {
+        ++op_idx;
+    }
+    if (op_idx == COUNTOF(ops))
+    {
+        logf_ln("Unknown aggregate '%.*s', expected count, sum, min, max or avg",
+                (int)op_name.length, op_name.data);
+        return false;
+    }
+
+    AggregateSpec agg;
+    agg.op = ops[op_idx];
+    dynarray::init(&agg.path, 4);
+    if (!parse_path(&agg.path, prgstate, path_text))
+    {
+        dynarray::deinit(&agg.path);
+        return false;
+    }
+    agg.label = nametable::find_or_add(&prgstate->names, agg_text);
+
+    // Two members with one name would be a broken compound
+    for (DynArrayCount i = 0; i < spec->aggregates.count; ++i)
+    {
+        if (nameref::identical(spec->aggregates[i].label, agg.label))
+        {
+            logf_ln("Already computing '%.*s'", (int)agg_text.length, agg_text.data);
+            dynarray::deinit(&agg.path);
+            return true;
+        }
+    }
+
+    dynarray::append(&spec->aggregates, agg);
+    return true;
+}
+
+
+static Value *resolve_path(Value *record, const DynArray<NameRef> &path)
+{
+    Value *value = record;
+    for (DynArrayCount i = 0; i < path.count; ++i)
+    {
+        if (!vIS_COMPOUND(value))
+        {
+            return nullptr;
+        }
+        CompoundValueMember *member = find_member(value, path[i]);
+        if (!member)
+        {
+            return nullptr;
+        }
+        value = &member->value;
+    }
+    return value;
+}
+
+
+// Open addressing over group indexes. The keys point into the source
+// collection, nullptr is the group of records missing the key path.
+struct GroupTable
+{
+    // Power of two, kept at most half full. Each is a group index + 1,
+    // 0 is empty.
+    DynArray<u32> slots;
+    DynArray<Value *> keys;
+    DynArray<u64> hashes;
+    DynArray<u32> row_counts;
+};
+
+
+static const u64 missing_key_hash = 0x6A09E667F3BCC908ull;
+
+
+static void group_table_init(GroupTable *table)
+{
+    const DynArrayCount initial_slots = 64;
+    dynarray::init(&table->slots, initial_slots);
+    table->slots.count = initial_slots;
+    memset(table->slots.data, 0, initial_slots * sizeof(u32));
+    dynarray::init(&table->keys, initial_slots / 2);
+    dynarray::init(&table->hashes, initial_slots / 2);
+    dynarray::init(&table->row_counts, initial_slots / 2);
+}
+
+
+static void group_table_deinit(GroupTable *table)
+{
+    dynarray::deinit(&table->slots);
+    dynarray::deinit(&table->keys);
+    dynarray::deinit(&table->hashes);
+    dynarray::deinit(&table->row_counts);
+}
+
+
+static void group_table_grow(GroupTable *table)
+{
+    DynArrayCount slot_count = table->slots.count * 2;
+    dynarray::ensure_capacity(&table->slots, slot_count);
+    table->slots.count = slot_count;
+    memset(table->slots.data, 0, slot_count * sizeof(u32));
+
+    u32 mask = slot_count - 1;
+    for (DynArrayCount group = 0; group < table->hashes.count; ++group)
+    {
+        u32 slot = (u32)table->hashes[group] & mask;
+        while (table->slots[slot])
+        {
+            slot = (slot + 1) & mask;
+        }
+        table->slots[slot] = group + 1;
+    }
+}
+
+
+static u32 find_or_add_group(GroupTable *table, Value *key, u64 hash, u32 rows)
+{
+    if ((table->keys.count + 1) * 2 > table->slots.count)
+    {
+        group_table_grow(table);
+    }
+
+    u32 mask = table->slots.count - 1;
+    for (u32 slot = (u32)hash & mask; ; slot = (slot + 1) & mask)
+    {
+        u32 entry = table->slots[slot];
+        if (!entry)
+        {
+            u32 group = table->keys.count;
+            dynarray::append(&table->keys, key);
+            dynarray::append(&table->hashes, hash);
+            dynarray::append(&table->row_counts, rows);
+            table->slots[slot] = group + 1;
+            return group;
+        }
+
+        u32 group = entry - 1;
+        Value *group_key = table->keys[group];
+        if (table->hashes[group] == hash
+            && (group_key == key || (group_key && key && value_equal(*group_key, *key))))
+        {
+            table->row_counts[group] += rows;
+            return group;
+        }
+    }
+}
+
+
+// Everything every aggregate needs, min and max start at the identities
+struct Accumulator
+{
+    s64 int_sum;
+    f64 float_sum;
+    s64 int_min;
+    s64 int_max;
+    f64 float_min;
+    f64 float_max;
+    u32 int_count;
+    u32 float_count;
+    u32 present_count;
+};
+
+
+static void accumulator_init(Accumulator *acc)
+{
+    acc->int_sum = 0;
+    acc->float_sum = 0.0;
+    acc->int_min = INT64_MAX;
+    acc->int_max = INT64_MIN;
+    acc->float_min = DBL_MAX;
+    acc->float_max = -DBL_MAX;
+    acc->int_count = 0;
+    acc->float_count = 0;
+    acc->present_count = 0;
+}
+
+
+static void accumulator_merge(Accumulator *dest, const Accumulator *src)
+{
+    // Ints wrap rather than trap on overflow, the same as the fold
+    dest->int_sum = (s64)((u64)dest->int_sum + (u64)src->int_sum);
+    dest->float_sum += src->float_sum;
+    dest->int_min = min(dest->int_min, src->int_min);
+    dest->int_max = max(dest->int_max, src->int_max);
+    dest->float_min = min(dest->float_min, src->float_min);
+    dest->float_max = max(dest->float_max, src->float_max);
+    dest->int_count += src->int_count;
+    dest->float_count += src->float_count;
+    dest->present_count += src->present_count;
+}
+
+
+// One chunk of one column, a row's slots hold the identities when the
+// value isn't that kind of number
+struct GatheredChunk
+{
+    u32 groups[chunk_rows];
+    s64 ints[chunk_rows];
+    s64 int_lows[chunk_rows];
+    s64 int_highs[chunk_rows];
+    f64 floats[chunk_rows];
+    f64 float_lows[chunk_rows];
+    f64 float_highs[chunk_rows];
+    u8 is_int[chunk_rows];
+    u8 is_float[chunk_rows];
+    u8 present[chunk_rows];
+};
+
+
+struct GroupByWork
+{
+    const GroupBySpec *spec;
+    Value *records;
+    u32 group_count;
+};
+
+
+// A contiguous run of rows, each one handled by one thread
+struct GroupByPartition
+{
+    GroupByWork *work;
+    u32 first_row;
+    u32 end_row;
+
+    GroupTable table;
+    // Local group of each row, then global once the tables are merged
+    DynArray<u32> row_groups;
+    // Local group index -> global
+    DynArray<u32> global_groups;
+    // aggregate * group_count + group
+    DynArray<Accumulator> accumulators;
+};
+
+
+static void group_partition_rows(void *userdata)
+{
+    GroupByPartition *part = (GroupByPartition *)userdata;
+    const GroupBySpec *spec = part->work->spec;
+
+    for (u32 row = part->first_row; row < part->end_row; ++row)
+    {
+        Value *key = resolve_path(&part->work->records[row], spec->key_path);
+        // Only this thread touches these rows, so caching the hash is safe
+        u64 hash = key ? value_hash(key) : missing_key_hash;
+        dynarray::append(&part->row_groups, find_or_add_group(&part->table, key, hash, 1));
+    }
+}
+
+
+static void gather_chunk(GatheredChunk *chunk, GroupByPartition *part, const AggregateSpec *agg,
+                         u32 first_row, u32 count)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 row = first_row + i;
+        Value *value = resolve_path(&part->work->records[row], agg->path);
+        bool is_int = value && vIS_INT(value);
+        bool is_float = value && vIS_FLOAT(value);
+        s64 int_val = is_int ? value->s64_val : 0;
+        f64 float_val = is_float ? value->f64_val : 0.0;
+
+        chunk->groups[i] = part->row_groups[row - part->first_row];
+        chunk->ints[i] = int_val;
+        chunk->int_lows[i] = is_int ? int_val : INT64_MAX;
+        chunk->int_highs[i] = is_int ? int_val : INT64_MIN;
+        chunk->floats[i] = float_val;
+        chunk->float_lows[i] = is_float ? float_val : DBL_MAX;
+        chunk->float_highs[i] = is_float ? float_val : -DBL_MAX;
+        chunk->is_int[i] = is_int;
+        chunk->is_float[i] = is_float;
+        chunk->present[i] = value != nullptr;
+    }
+}
+
+
+static void fold_chunk(Accumulator *accumulators, const GatheredChunk *chunk, u32 count)
+{
+    // No branches on the data, the compiler turns min and max into selects
+    for (u32 i = 0; i < count; ++i)
+    {
+        Accumulator *acc = &accumulators[chunk->groups[i]];
+        acc->int_sum = (s64)((u64)acc->int_sum + (u64)chunk->ints[i]);
+        acc->float_sum += chunk->floats[i];
+        acc->int_min = min(acc->int_min, chunk->int_lows[i]);
+        acc->int_max = max(acc->int_max, chunk->int_highs[i]);
+        acc->float_min = min(acc->float_min, chunk->float_lows[i]);
+        acc->float_max = max(acc->float_max, chunk->float_highs[i]);
+        acc->int_count += chunk->is_int[i];
+        acc->float_count += chunk->is_float[i];
+        acc->present_count += chunk->present[i];
+    }
+}
+
+
+static void reduce_partition_rows(void *userdata)
+{
+    GroupByPartition *part = (GroupByPartition *)userdata;
+    const GroupBySpec *spec = part->work->spec;
+    u32 group_count = part->work->group_count;
+
+    for (DynArrayCount i = 0; i < part->row_groups.count; ++i)
+    {
+        part->row_groups[i] = part->global_groups[part->row_groups[i]];
+    }
+
+    DynArrayCount acc_count = spec->aggregates.count * group_count;
+    dynarray::ensure_capacity(&part->accumulators, acc_count);
+    part->accumulators.count = acc_count;
+    for (DynArrayCount i = 0; i < acc_count; ++i)
+    {
+        accumulator_init(&part->accumulators[i]);
+    }
+
+    GatheredChunk *chunk = MAKE_OBJ_CAT(mem::default_allocator(), "groupby", GatheredChunk);
+    for (DynArrayCount agg_idx = 0; agg_idx < spec->aggregates.count; ++agg_idx)
+    {
+        const AggregateSpec *agg = &spec->aggregates[agg_idx];
+        Accumulator *accumulators = &part->accumulators[agg_idx * group_count];
+
+        for (u32 row = part->first_row; row < part->end_row; row += chunk_rows)
+        {
+            u32 count = min(chunk_rows, part->end_row - row);
+            gather_chunk(chunk, part, agg, row, count);
+            fold_chunk(accumulators, chunk, count);
+        }
+    }
+    mem::default_allocator()->dealloc(chunk);
+}
+
+
+// The first partition runs on this thread. One whose thread won't start
+// runs here too, after the others are going.
+static void run_partitions(PlatformThreadFn *fn, DynArray<GroupByPartition> *partitions,
+                           OUTPARAM u32 *threads_started)
+{
+    DynArray<PlatformThread> threads = dynarray::init<PlatformThread>(partitions->count);
+    DynArray<GroupByPartition *> inline_parts = dynarray::init<GroupByPartition *>(partitions->count);
+    dynarray::append(&inline_parts, &(*partitions)[0]);
+
+    for (DynArrayCount i = 1; i < partitions->count; ++i)
+    {
+        PlatformThread thread;
+        if (start_thread(&thread, fn, &(*partitions)[i]))
+        {
+            dynarray::append(&threads, thread);
+        }
+        else
+        {
+            dynarray::append(&inline_parts, &(*partitions)[i]);
+        }
+    }
+
+    for (DynArrayCount i = 0; i < inline_parts.count; ++i)
+    {
+        fn(inline_parts[i]);
+    }
+    for (DynArrayCount i = 0; i < threads.count; ++i)
+    {
+        join_thread(&threads[i]);
+    }
+
+    *threads_started = threads.count;
+    dynarray::deinit(&inline_parts);
+    dynarray::deinit(&threads);
+}
+
+
+static Value make_int_value(ProgramState *prgstate, s64 val)
+{
+    Value result;
+    result.typedesc = prgstate->prim_int;
+    result.s64_val = val;
+    return result;
+}
+
+
+static Value make_float_value(ProgramState *prgstate, f64 val)
+{
+    Value result;
+    result.typedesc = prgstate->prim_float;
+    result.f64_val = val;
+    return result;
+}
+
+
+static Value make_none_value(ProgramState *prgstate)
+{
+    Value result;
+    mem::zero_obj(result);
+    result.typedesc = prgstate->prim_none;
+    return result;
+}
+
+
+static Value aggregate_value(ProgramState *prgstate, AggregateOp::Tag op, const Accumulator *acc)
+{
+    u32 number_count = acc->int_count + acc->float_count;
+    bool any_floats = acc->float_count != 0;
+
+    switch (op)
+    {
+        case AggregateOp::Count:
+            return make_int_value(prgstate, acc->present_count);
+
+        case AggregateOp::Sum:
+            if (!any_floats)
+            {
+                return make_int_value(prgstate, acc->int_sum);
+            }
+            return make_float_value(prgstate, (f64)acc->int_sum + acc->float_sum);
+
+        case AggregateOp::Min:
+        case AggregateOp::Max:
+        {
+            bool is_min = op == AggregateOp::Min;
+            if (number_count == 0)
+            {
+                return make_none_value(prgstate);
+            }
+            if (!any_floats)
+            {
+                return make_int_value(prgstate, is_min ? acc->int_min : acc->int_max);
+            }
+            f64 float_result = is_min ? acc->float_min : acc->float_max;
+            if (acc->int_count)
+            {
+                f64 int_result = (f64)(is_min ? acc->int_min : acc->int_max);
+                float_result = is_min ? min(float_result, int_result) : max(float_result, int_result);
+            }
+            return make_float_value(prgstate, float_result);
+        }
+
+        case AggregateOp::Avg:
+            if (number_count == 0)
+            {
+                return make_none_value(prgstate);
+            }
+            return make_float_value(prgstate, ((f64)acc->int_sum + acc->float_sum) / (f64)number_count);
+    }
+
+    return make_none_value(prgstate);
+}
+
+
+static bool record_has_member_types(const TypeDescriptor *typedesc, const DynArray<CompoundValueMember> &members)
+{
+    const DynArray<CompoundTypeMember> *type_members = &typedesc->compound_type.members;
+    if (type_members->count != members.count)
+    {
+        return false;
+    }
+    for (DynArrayCount i = 0; i < members.count; ++i)
+    {
+        if (!nameref::identical((*type_members)[i].name, members[i].name)
+            || (*type_members)[i].typedesc != members[i].value.typedesc)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Records mostly share a few types, record_types holds the ones made so
+// far so each is only looked for among all the type descriptors once
+static Value build_group_record(ProgramState *prgstate, DynArray<TypeDescriptor *> *record_types,
+                                const GroupBySpec *spec, NameRef row_count_name, Value *key, u32 row_count,
+                                const Accumulator *group_accumulators, u32 group_count)
+{
+    DynArrayCount member_count = 2 + spec->aggregates.count;
+    DynArray<CompoundValueMember> members;
+    dynarray::init(&members, member_count, value_storage_allocator());
+
+    CompoundValueMember *key_member = dynarray::append(&members);
+    key_member->name = spec->key_label;
+    key_member->value = key ? clone(key) : make_none_value(prgstate);
+
+    CompoundValueMember *count_member = dynarray::append(&members);
+    count_member->name = row_count_name;
+    count_member->value = make_int_value(prgstate, row_count);
+
+    for (DynArrayCount i = 0; i < spec->aggregates.count; ++i)
+    {
+        const AggregateSpec *agg = &spec->aggregates[i];
+        CompoundValueMember *member = dynarray::append(&members);
+        member->name = agg->label;
+        member->value = aggregate_value(prgstate, agg->op, &group_accumulators[i * group_count]);
+    }
+
+    Value result;
+    result.typedesc = nullptr;
+    for (DynArrayCount i = 0; !result.typedesc && i < record_types->count; ++i)
+    {
+        if (record_has_member_types((*record_types)[i], members))
+        {
+            result.typedesc = (*record_types)[i];
+        }
+    }
+
+    if (!result.typedesc)
+    {
+        TypeDescriptor record_type;
+        mem::zero_obj(record_type);
+        record_type.type_id = TypeID::Compound;
+        dynarray::init(&record_type.compound_type.members, member_count);
+        for (DynArrayCount i = 0; i < members.count; ++i)
+        {
+            CompoundTypeMember type_member = {members[i].name, members[i].value.typedesc};
+            dynarray::append(&record_type.compound_type.members, type_member);
+        }
+
+        bool new_type_added;
+        result.typedesc = find_equiv_typedesc_or_add(prgstate, &record_type, &new_type_added);
+        if (!new_type_added)
+        {
+            free_typedescriptor_components(&record_type);
+        }
+        dynarray::append(record_types, result.typedesc);
+    }
+    result.compound_value.members = members;
+    return result;
+}
+
+
+Collection *run(OUTPARAM GroupByStats *stats, ProgramState *prgstate, Collection *source,
+                const GroupBySpec *spec, u32 thread_count)
+{
+    PROF_FUNCTION();
+
+    collection_assert_invariants(source);
+    mem::zero_ptr(stats);
+
+    u32 row_count = source->value.array_value.elements.count;
+    stats->row_count = row_count;
+
+    if (thread_count == 0)
+    {
+        thread_count = processor_count();
+    }
+    u32 partition_count = min(thread_count, max(row_count / max(spec->min_rows_per_thread, 1u), 1u));
+
+    GroupByWork work;
+    work.spec = spec;
+    work.records = source->value.array_value.elements.data;
+    work.group_count = 0;
+
+    // Group each partition's rows, then merge the tables in row order so
+    // groups stay in the order they first appear
+    u64 group_start = query_abstime();
+
+    DynArray<GroupByPartition> partitions = dynarray::init<GroupByPartition>(partition_count);
+    for (u32 i = 0; i < partition_count; ++i)
+    {
+        GroupByPartition *part = dynarray::append(&partitions);
+        part->work = &work;
+        part->first_row = (u32)((u64)row_count * i / partition_count);
+        part->end_row = (u32)((u64)row_count * (i + 1) / partition_count);
+        group_table_init(&part->table);
+        dynarray::init(&part->row_groups, part->end_row - part->first_row);
+        dynarray::init(&part->global_groups, 0);
+        dynarray::init(&part->accumulators, 0);
+    }
+
+    u32 threads_started;
+    run_partitions(group_partition_rows, &partitions, &threads_started);
+    stats->thread_count = threads_started + 1;
+
+    GroupTable groups;
+    group_table_init(&groups);
+    for (DynArrayCount i = 0; i < partitions.count; ++i)
+    {
+        GroupTable *table = &partitions[i].table;
+        dynarray::ensure_capacity(&partitions[i].global_groups, table->keys.count);
+        for (DynArrayCount group = 0; group < table->keys.count; ++group)
+        {
+            u32 global_group = find_or_add_group(&groups, table->keys[group], table->hashes[group],
+                                                 table->row_counts[group]);
+            dynarray::append(&partitions[i].global_groups, global_group);
+        }
+    }
+    work.group_count = groups.keys.count;
+    stats->group_count = groups.keys.count;
+    stats->group_ns = nanoseconds_since(group_start);
+
+    // Reduce each partition's rows into its own accumulators, then add
+    // them up
+    u64 reduce_start = query_abstime();
+
+    run_partitions(reduce_partition_rows, &partitions, &threads_started);
+
+    DynArray<Accumulator> *totals = &partitions[0].accumulators;
+    for (DynArrayCount i = 1; i < partitions.count; ++i)
+    {
+        for (DynArrayCount acc_idx = 0; acc_idx < totals->count; ++acc_idx)
+        {
+            accumulator_merge(&(*totals)[acc_idx], &partitions[i].accumulators[acc_idx]);
+        }
+    }
+    stats->reduce_ns = nanoseconds_since(reduce_start);
+
+    u64 collection_start = query_abstime();
+
+    NameRef row_count_name = nametable::find_or_add(&prgstate->names, row_count_label);
+    DynArray<Value> records;
+    dynarray::init(&records, groups.keys.count, value_storage_allocator());
+    DynArray<RecordInfo> record_infos = dynarray::init<RecordInfo>(groups.keys.count);
+    DynArray<TypeDescriptor *> record_types = dynarray::init<TypeDescriptor *>(4);
+    for (DynArrayCount group = 0; group < groups.keys.count; ++group)
+    {
+        dynarray::append(&records, build_group_record(prgstate, &record_types, spec, row_count_name,
+                                                      groups.keys[group], groups.row_counts[group],
+                                                      totals->data + group, work.group_count));
+        RecordInfo record_info = {};
+        record_info.fullpath = str(source->load_path);
+        dynarray::append(&record_infos, record_info);
+    }
+
+    Collection *result = bucketarray::add(&prgstate->collections).elem;
+    mem::zero_ptr(result);
+
+    // Merging the distinct types is the same as merging every record's
+    TypeDescriptor array_type = {};
+    array_type.type_id = TypeID::Array;
+    array_type.array_type.elem_type = record_types.count
+        ? merge_each_type(prgstate, record_types)
+        : prgstate->prim_none;
+    init_array_value(&result->value, find_equiv_typedesc_or_add(prgstate, &array_type, nullptr), records);
+    result->top_typedesc = array_type.array_type.elem_type;
+    dynarray::deinit(&record_types);
+    result->info = record_infos;
+    result->load_path = str("groupby(");
+    str_append(&result->load_path, str_slice(source->load_path));
+    str_append(&result->load_path, str_slice(", "));
+    str_append(&result->load_path, nameref::str_slice(spec->key_label));
+    str_append(&result->load_path, ')');
+    result->read_only = true;
+
+    stats->collection_ns = nanoseconds_since(collection_start);
+
+    group_table_deinit(&groups);
+    for (DynArrayCount i = 0; i < partitions.count; ++i)
+    {
+        group_table_deinit(&partitions[i].table);
+        dynarray::deinit(&partitions[i].row_groups);
+        dynarray::deinit(&partitions[i].global_groups);
+        dynarray::deinit(&partitions[i].accumulators);
+    }
+    dynarray::deinit(&partitions);
+
+    return result;
+}
+
+}
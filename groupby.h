@@ -0,0 +1,106 @@
+// -*- c++ -*-
+
+#ifndef GROUPBY_H
+
+#include "typesys.h"
+#include "nametable.h"
+#include "dynarray.h"
+#include "str.h"
+#include "numeric_types.h"
+
+
+/*
+Grouping a collection's records by the value at a member path and
+reducing other paths per group, like SQL's GROUP BY. Keys are matched by
+value_hash and value_equal, so any value can be a key. A record missing
+the key path goes in the group whose key is null.
+
+The records are split between threads. Each thread groups its own rows,
+then the groups are merged. After that each thread reduces its rows a
+column at a time: it gathers a chunk of numbers into flat arrays, then
+folds them into its per-group accumulators in a branch-free loop.
+Those accumulators are summed at the end.
+
+The result is a new collection with one record per group, in the order
+the groups first appear. Each record has the key, its row count as
+"count(*)", and one member per aggregate, named the way it was written,
+e.g. "avg(stats.hp)".
+*/
+
+struct ProgramState;
+struct Collection;
+
+
+namespace AggregateOp
+{
+
+enum Tag
+{
+    // records where the path exists, whatever is there
+    Count,
+    // numbers only, ints stay ints unless a float turns up
+    Sum,
+    Min,
+    Max,
+    // always a float
+    Avg
+};
+
+const char *to_string(Tag tag);
+
+}
+
+
+struct AggregateSpec
+{
+    AggregateOp::Tag op;
+    DynArray<NameRef> path;
+    // name of the member in the result
+    NameRef label;
+};
+
+
+struct GroupBySpec
+{
+    DynArray<NameRef> key_path;
+    NameRef key_label;
+    DynArray<AggregateSpec> aggregates;
+    // Fewer rows than this per thread and starting the thread costs more
+    // than it saves. init sets it, the tests lower it.
+    u32 min_rows_per_thread;
+};
+
+
+struct GroupByStats
+{
+    u32 row_count;
+    u32 group_count;
+    u32 thread_count;
+    u64 group_ns;
+    u64 reduce_ns;
+    u64 collection_ns;
+};
+
+
+namespace groupby
+{
+
+void init(GroupBySpec *spec);
+void deinit(GroupBySpec *spec);
+
+// "stats.hp" is the hp member of the stats member. Logs why and returns
+// false if a name isn't one any record could have.
+bool set_key(GroupBySpec *spec, ProgramState *prgstate, StrSlice path_text);
+// "sum(stats.hp)", "count(name)" and so on, same logging
+bool add_aggregate(GroupBySpec *spec, ProgramState *prgstate, StrSlice agg_text);
+
+// Adds the derived collection, which is read-only. thread_count 0 is one
+// per processor.
+Collection *run(OUTPARAM GroupByStats *stats, ProgramState *prgstate, Collection *source,
+                const GroupBySpec *spec, u32 thread_count);
+
+}
+
+
+#define GROUPBY_H
+#endif
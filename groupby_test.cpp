@@ -0,0 +1,259 @@
+#include "groupby.h"
+#include "programstate.h"
+#include "typesys_json.h"
+#include "common.h"
+#include <cstdio>
+#include <cfloat>
+#include <cstring>
+
+
+// Few enough rows that debug builds don't take long, with a thread
+// minimum low enough that four threads still get a partition each
+static const u32 groupby_test_rows = 1000;
+static const u32 groupby_test_min_rows_per_thread = 100;
+static const u32 groupby_test_thread_counts[] = {1, 4};
+
+// c0 to c3 in turn, then the records missing the key
+static const u32 groupby_test_group_count = 5;
+
+static const char *groupby_test_aggregates[] = {
+    "count(w)",
+    "sum(n)",
+    "min(n)",
+    "max(n)",
+    "avg(n)",
+    "sum(w)",
+    "max(w)",
+};
+
+
+struct ExpectedGroup
+{
+    s64 row_count;
+    s64 w_count;
+    s64 n_sum;
+    s64 n_min;
+    s64 n_max;
+    f64 w_sum;
+    f64 w_max;
+};
+
+
+static bool record_has_key(u32 row)
+{
+    return row % 100 != 7;
+}
+
+
+static bool record_has_w(u32 row)
+{
+    return row % 3 != 2;
+}
+
+
+// Quarters add up exactly in any order
+static f64 record_w(u32 row)
+{
+    return (f64)(row % 10) * 0.25;
+}
+
+
+static u32 record_group(u32 row)
+{
+    return record_has_key(row) ? row % 4 : 4;
+}
+
+
+static Collection *make_groupby_test_collection(ProgramState *prgstate)
+{
+    Str json = str("[");
+    for (u32 row = 0; row < groupby_test_rows; ++row)
+    {
+        char record[128];
+        char *cursor = record;
+        cursor += std::sprintf(cursor, "{\"n\": %u", row);
+        if (record_has_key(row))
+        {
+            cursor += std::sprintf(cursor, ", \"cat\": \"c%u\"", row % 4);
+        }
+        if (record_has_w(row))
+        {
+            cursor += std::sprintf(cursor, ", \"w\": %.2f", record_w(row));
+        }
+        std::sprintf(cursor, "},\n");
+        str_append(&json, str_slice(record));
+    }
+    str_append(&json, ']');
+
+    Value records;
+    JsonParseResult parse_result = try_parse_json_as_value(&records, prgstate, str_data(json), str_length(json));
+    str_free(&json);
+    ASSERT(parse_result.status == JsonParseResult::Succeeded);
+
+    Collection *collection = bucketarray::add(&prgstate->collections).elem;
+    mem::zero_ptr(collection);
+    collection->value = records;
+    collection->top_typedesc = records.typedesc->array_type.elem_type;
+    dynarray::init(&collection->info, records.array_value.elements.count);
+    for (DynArrayCount i = 0; i < records.array_value.elements.count; ++i)
+    {
+        RecordInfo record_info = {};
+        record_info.fullpath = str("groupby_test");
+        dynarray::append(&collection->info, record_info);
+    }
+    collection->load_path = str("groupby_test");
+    return collection;
+}
+
+
+static Value *result_member(ProgramState *prgstate, Value *record, const char *name)
+{
+    CompoundValueMember *member = find_member(record, nametable::find(&prgstate->names, name));
+    return member ? &member->value : nullptr;
+}
+
+
+static s32 expect_int(ProgramState *prgstate, Value *record, u32 group, const char *name, s64 expected)
+{
+    Value *value = result_member(prgstate, record, name);
+    if (!value || !vIS_INT(value) || value->s64_val != expected)
+    {
+        printf_ln("Group %u's %s isn't the integer %lli", group, name, (long long)expected);
+        return 1;
+    }
+    return 0;
+}
+
+
+static s32 expect_float(ProgramState *prgstate, Value *record, u32 group, const char *name, f64 expected)
+{
+    Value *value = result_member(prgstate, record, name);
+    if (!value || !vIS_FLOAT(value) || value->f64_val != expected)
+    {
+        printf_ln("Group %u's %s isn't the float %.17g", group, name, expected);
+        return 1;
+    }
+    return 0;
+}
+
+
+static s32 check_group(ProgramState *prgstate, Value *record, u32 group, const ExpectedGroup *expected)
+{
+    s32 fails = 0;
+
+    Value *key = result_member(prgstate, record, "cat");
+    bool key_ok = key && (group < 4 ? vIS_STRING(key) : key->typedesc->type_id == TypeID::None);
+    if (key_ok && group < 4)
+    {
+        char key_text[4];
+        std::sprintf(key_text, "c%u", group);
+        key_ok = str_equal(str_slice(key->str_val), key_text);
+    }
+    if (!key_ok)
+    {
+        printf_ln("Group %u has the wrong key", group);
+        ++fails;
+    }
+
+    fails += expect_int(prgstate, record, group, "count(*)", expected->row_count);
+    fails += expect_int(prgstate, record, group, "count(w)", expected->w_count);
+    fails += expect_int(prgstate, record, group, "sum(n)", expected->n_sum);
+    fails += expect_int(prgstate, record, group, "min(n)", expected->n_min);
+    fails += expect_int(prgstate, record, group, "max(n)", expected->n_max);
+    fails += expect_float(prgstate, record, group, "avg(n)", (f64)expected->n_sum / (f64)expected->row_count);
+    fails += expect_float(prgstate, record, group, "sum(w)", expected->w_sum);
+    fails += expect_float(prgstate, record, group, "max(w)", expected->w_max);
+    return fails;
+}
+
+
+s32 run_groupby_tests()
+{
+    static ProgramState prgstate;
+    prgstate_init(&prgstate);
+    load_base_type_descriptors(&prgstate);
+
+    Collection *source = make_groupby_test_collection(&prgstate);
+
+    ExpectedGroup expected[groupby_test_group_count];
+    for (u32 group = 0; group < groupby_test_group_count; ++group)
+    {
+        ExpectedGroup *e = &expected[group];
+        e->row_count = 0;
+        e->w_count = 0;
+        e->n_sum = 0;
+        e->n_min = INT64_MAX;
+        e->n_max = INT64_MIN;
+        e->w_sum = 0.0;
+        e->w_max = -DBL_MAX;
+    }
+    for (u32 row = 0; row < groupby_test_rows; ++row)
+    {
+        ExpectedGroup *e = &expected[record_group(row)];
+        ++e->row_count;
+        e->n_sum += row;
+        e->n_min = min<s64>(e->n_min, row);
+        e->n_max = max<s64>(e->n_max, row);
+        if (record_has_w(row))
+        {
+            ++e->w_count;
+            e->w_sum += record_w(row);
+            e->w_max = max(e->w_max, record_w(row));
+        }
+    }
+
+    GroupBySpec spec;
+    groupby::init(&spec);
+    bool spec_ok = groupby::set_key(&spec, &prgstate, str_slice("cat"));
+    for (size_t i = 0; i < COUNTOF(groupby_test_aggregates); ++i)
+    {
+        spec_ok = spec_ok && groupby::add_aggregate(&spec, &prgstate, str_slice(groupby_test_aggregates[i]));
+    }
+    ASSERT(spec_ok);
+    spec.min_rows_per_thread = groupby_test_min_rows_per_thread;
+
+    s32 fails = 0;
+    for (size_t i = 0; i < COUNTOF(groupby_test_thread_counts); ++i)
+    {
+        u32 thread_count = groupby_test_thread_counts[i];
+        GroupByStats stats;
+        Collection *result = groupby::run(&stats, &prgstate, source, &spec, thread_count);
+
+        if (stats.thread_count != thread_count)
+        {
+            printf_ln("Grouping on %u threads used %u", thread_count, stats.thread_count);
+            ++fails;
+        }
+
+        DynArray<Value> *records = &result->value.array_value.elements;
+        if (records->count != groupby_test_group_count)
+        {
+            printf_ln("Grouping on %u threads made %u groups, expected %u",
+                      thread_count, records->count, groupby_test_group_count);
+            ++fails;
+        }
+        else
+        {
+            for (u32 group = 0; group < groupby_test_group_count; ++group)
+            {
+                fails += check_group(&prgstate, &(*records)[group], group, &expected[group]);
+            }
+        }
+
+        drop_collection(&prgstate, bucketarray::bucketindex_of(&prgstate.collections, result));
+    }
+
+    groupby::deinit(&spec);
+    drop_collection(&prgstate, bucketarray::bucketindex_of(&prgstate.collections, source));
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i group by test failures", fails);
+    }
+    else
+    {
+        println("No failures in group by tests");
+    }
+
+    return fails;
+}
@@ -192,7 +192,9 @@ struct OAHashtable
     hash_type bucket_count;
     Bucket *buckets;
     Entry *entries;
+    // live entries, and Removed buckets that still lengthen probes
     u32 count;
+    u32 removed_count;
     mem::IAllocator *allocator;
 };
 
@@ -226,6 +228,7 @@ void ht_init(OAHASH_TYPE *ht,
 
     ht->allocator = allocator;
     ht->count = 0;
+    ht->removed_count = 0;
     ht->bucket_count = initial_bucket_count;
 
     if (initial_bucket_count == 0)
@@ -235,8 +238,8 @@ void ht_init(OAHASH_TYPE *ht,
     }
     else
     {
-        ht->buckets = MAKE_ZEROED_ARRAY(ht->allocator, initial_bucket_count, Bucket);
-        ht->entries = MAKE_ZEROED_ARRAY(ht->allocator, initial_bucket_count, Entry);
+        ht->buckets = MAKE_ZEROED_ARRAY_CAT(ht->allocator, initial_bucket_count, "hashtable", Bucket);
+        ht->entries = MAKE_ZEROED_ARRAY_CAT(ht->allocator, initial_bucket_count, "hashtable", Entry);
     }
 }
 
@@ -252,8 +255,8 @@ void ht_rehash(OAHASH_TYPE *ht, u32 new_bucket_count)
     // don't shrink
     new_bucket_count = std::max(ht->bucket_count, new_bucket_count);
 
-    Bucket *new_buckets = MAKE_ZEROED_ARRAY(ht->allocator, new_bucket_count, Bucket);
-    Entry *new_entries = MAKE_ZEROED_ARRAY(ht->allocator, new_bucket_count, Entry);
+    Bucket *new_buckets = MAKE_ZEROED_ARRAY_CAT(ht->allocator, new_bucket_count, "hashtable", Bucket);
+    Entry *new_entries = MAKE_ZEROED_ARRAY_CAT(ht->allocator, new_bucket_count, "hashtable", Entry);
 
     for (u32 i = 0; i < ht->bucket_count; ++i)
     {
@@ -297,6 +300,7 @@ void ht_rehash(OAHASH_TYPE *ht, u32 new_bucket_count)
     ht->allocator->dealloc(ht->buckets);
     ht->allocator->dealloc(ht->entries);
     ht->bucket_count = new_bucket_count;
+    ht->removed_count = 0;
     ht->buckets = new_buckets;
     ht->entries = new_entries;
 }
@@ -310,14 +314,19 @@ bool ht_find_or_add_entry(typename OAHASH_TYPE::Entry **result, OAHASH_TYPE *ht,
     typename OAHASH_TYPE::KeyEqualFn keys_equal_fn;
     typedef typename OAHASH_TYPE::Entry Entry;;
 
-    if (ht->count * 3 + 1 > ht->bucket_count * 2)
+    if ((ht->count + ht->removed_count) * 3 + 1 > ht->bucket_count * 2)
     {
         const typename OAHASH_TYPE::hash_type min_buckets = 7;
         const typename OAHASH_TYPE::hash_type calculated_buckets = ht->bucket_count * 2 + 1;
-        const typename OAHASH_TYPE::hash_type new_bucket_count =
+        const typename OAHASH_TYPE::hash_type grown_bucket_count =
             min_buckets > calculated_buckets
             ? min_buckets
             : calculated_buckets;
+        // Mostly tombstones, rehashing at the same size clears them
+        const typename OAHASH_TYPE::hash_type new_bucket_count =
+            ht->count * 3 < ht->bucket_count
+            ? ht->bucket_count
+            : grown_bucket_count;
 
         ht_rehash(ht, new_bucket_count);
     }
@@ -327,9 +336,12 @@ bool ht_find_or_add_entry(typename OAHASH_TYPE::Entry **result, OAHASH_TYPE *ht,
     u32 picked_index = 0;
     bool picked = false;
 
-    for (u32 i = bucket_idx, e = ht->bucket_count; i < e; ++i)
+    // The key may live past a tombstone, so keep probing until an empty
+    // bucket, but reuse the first tombstone seen for the insert
+    for (u32 n = 0, i = bucket_idx; n < ht->bucket_count; ++n, i = i + 1 == ht->bucket_count ? 0 : i + 1)
     {
-        if (ht->buckets[i].state == BucketState::Filled)
+        u32 state = ht->buckets[i].state;
+        if (state == BucketState::Filled)
         {
             if (ht->buckets[i].hash == hash
                 && keys_equal_fn(key, ht->entries[i].key))
@@ -340,38 +352,24 @@ bool ht_find_or_add_entry(typename OAHASH_TYPE::Entry **result, OAHASH_TYPE *ht,
         }
         else
         {
-            picked = true;
-            picked_index = i;
-            break;
-        }
-    }
-
-    if (!picked_index)
-    {
-        for (u32 i = 0, e = bucket_idx; i < e; ++i)
-        {
-            if (ht->buckets[i].state == BucketState::Filled)
-            {
-                if (ht->buckets[i].hash == hash
-                    && keys_equal_fn(key, ht->entries[i].key))
-                {
-                    *result = &ht->entries[i];
-                    return true;
-                }
-            }
-            else
+            if (!picked)
             {
                 picked = true;
                 picked_index = i;
+            }
+            if (state == BucketState::Empty)
+            {
                 break;
             }
         }
     }
     assert(picked);
 
-    u32 count_inc = ht->buckets[picked_index].state == BucketState::Empty;
-    assert(count_inc == 0 || count_inc == 1);
-    ht->count += count_inc;
+    if (ht->buckets[picked_index].state == BucketState::Removed)
+    {
+        --ht->removed_count;
+    }
+    ++ht->count;
     ht->buckets[picked_index].hash = hash;
     ht->buckets[picked_index].state = BucketState::Filled;
     ht->entries[picked_index].key = key;
@@ -509,7 +507,7 @@ bool ht_set(OAHASH_TYPE *ht, TKey key, TValue value)
 template OAHASH_TPARAMS
 bool ht_remove(OAHASH_TYPE *ht, TKey key)
 {
-    typedef typename OAHASH_TYPE::BucketState::Tag BucketState;
+    typedef typename OAHASH_TYPE::BucketState BucketState;
 
     typename OAHASH_TYPE::HashFn hashfn;
     typename OAHASH_TYPE::KeyEqualFn keys_equal_fn;
@@ -519,7 +517,7 @@ bool ht_remove(OAHASH_TYPE *ht, TKey key)
 
     for (u32 i = bucket_idx, e = ht->bucket_count; i < e; ++i)
     {
-        switch ((BucketState)ht->buckets[i].state)
+        switch ((typename BucketState::Tag)ht->buckets[i].state)
         {
             case BucketState::Empty:
                 return false;
@@ -530,6 +528,7 @@ bool ht_remove(OAHASH_TYPE *ht, TKey key)
                 {
                     ht->buckets[i].state = BucketState::Removed;
                     --ht->count;
+                    ++ht->removed_count;
                     return true;
                 }
                 break;
@@ -541,7 +540,7 @@ bool ht_remove(OAHASH_TYPE *ht, TKey key)
 
     for (u32 i = 0, e = bucket_idx; i < e; ++i)
     {
-        switch ((BucketState)ht->buckets[i]->state)
+        switch ((typename BucketState::Tag)ht->buckets[i].state)
         {
             case BucketState::Empty:
                 return false;
@@ -552,6 +551,7 @@ bool ht_remove(OAHASH_TYPE *ht, TKey key)
                 {
                     ht->buckets[i].state = BucketState::Removed;
                     --ht->count;
+                    ++ht->removed_count;
                     return true;
                 }
                 break;
@@ -184,6 +184,57 @@ void test_hashtable_set_if_unset(HashtableTest *test)
 }
 
 
+void test_hashtable_remove(HashtableTest *test)
+{
+    const s32 iterations = S32(test->bucket_count);
+
+    OAHashtable<s32, s32> numbas;
+    ht_init(&numbas, test->bucket_count);
+
+    for (s32 i = 0; i < iterations; ++i)
+    {
+        ht_set(&numbas, i, i);
+    }
+
+    test->fail_count = 0;
+    test->begin_abstime = query_abstime();
+    for (s32 i = 0; i < iterations; i += 2)
+    {
+        if (!ht_remove(&numbas, i)) {
+            ++test->fail_count;
+        }
+    }
+    for (s32 i = 0; i < iterations; ++i)
+    {
+        bool removed = i % 2 == 0;
+        if (removed == (ht_find(&numbas, i) != nullptr)) {
+            ++test->fail_count;
+        }
+    }
+    // Odd keys may sit past a tombstone now, they must be found rather
+    // than added again
+    for (s32 i = 0; i < iterations; ++i)
+    {
+        bool removed = i % 2 == 0;
+        bool was_occupied = ht_set_if_unset(&numbas, i, i);
+        if (removed == was_occupied) {
+            ++test->fail_count;
+        }
+    }
+    test->end_abstime = query_abstime();
+
+    if (numbas.count != test->bucket_count) {
+        ++test->fail_count;
+    }
+
+    if (test->fail_count > 0) {
+        printf_ln("\n%i cases failed", test->fail_count);
+    }
+
+    ht_deinit(&numbas);
+}
+
+
 s32 run_hashtable_tests()
 {
     s32 total_fail_count = 0;
@@ -295,6 +346,41 @@ s32 run_hashtable_tests()
         total_fail_count += fails;
     }
 
+    { // Remove
+        const char *testname = "Hashtable Remove";
+        const u32 limit = 100;
+        DynArray<HashtableTest> tests = dynarray::init<HashtableTest>(limit);
+        for (u32 i = 0; i < limit; ++i)
+        {
+            HashtableTest *test = dynarray::append(&tests);
+            test->name = testname;
+            test->bucket_count = i * 1000;
+            test->fail_count = 0;
+        }
+
+        for (u32 i = 0; i < tests.count; ++i)
+        {
+            HashtableTest *test = &tests[i];
+            printf_ln("Running test '%s'   [%i]", test->name, i);
+            test_hashtable_remove(test);
+        }
+
+        u32 fails = 0;
+        printf_ln("Test '%s' Results:", testname);
+        for (u32 i = 0; i < tests.count; ++i)
+        {
+            HashtableTest *test = &tests[i];
+            printf_ln("%i\t%f\tmilliseconds", test->bucket_count, milliseconds_since(test->end_abstime, test->begin_abstime));
+            if (test->fail_count > 0) {
+                printf_ln("FAILED: %i", test->fail_count);
+                fails += test->fail_count;
+            }
+        }
+        printf_ln("There were %i %s test failures", fails, testname);
+        dynarray::deinit(&tests);
+        total_fail_count += fails;
+    }
+
     return total_fail_count;
 }
 
@@ -10,19 +10,19 @@ bool ImGui_InputText(const char *label, Str *str)
 
     if (guictx->ActiveId == control_id)
     {
-        if ((str->capacity - str->length) < 2)
+        if ((str_capacity(*str) - str_length(*str)) < 2)
         {
-            str_ensure_capacity(str, str->capacity + 32);
+            str_ensure_capacity(str, str_capacity(*str) + 32);
             guictx->ActiveId = 0;
             ImGui::SetKeyboardFocusHere(0);
         }
     }
 
-    bool value_changed = ImGui::InputText(label, str->data, str->capacity);
+    bool value_changed = ImGui::InputText(label, str_data(str), str_capacity(*str));
 
     if (value_changed)
     {
-        str->length = STRLEN(std::strlen(str->data));
+        str_set_length(str, STRLEN(std::strlen(str_data(str))));
     }
 
     return value_changed;
@@ -0,0 +1,175 @@
+#include "jobs.h"
+#include "programstate.h"
+#include "atomics.h"
+#include "logging.h"
+#include "profiler.h"
+#include "memory.h"
+#include "allocstats.h"
+#include <cstdio>
+
+
+namespace jobs
+{
+
+static void run_work(void *userdata)
+{
+    Job *job = (Job *)userdata;
+    {
+        PROF_ZONE("job work");
+        job->fns->work(job);
+    }
+    atomic::store_release(&job->work_done, 1u);
+}
+
+
+Job *start(ProgramState *prgstate, StrSlice description, const JobFunctions *fns, void *data)
+{
+    Job *job = MAKE_OBJ_CAT(mem::default_allocator(), "jobs", Job);
+    mem::zero_ptr(job);
+    job->id = ++prgstate->last_job_id;
+    job->description = str(description);
+    job->start_time = query_abstime();
+    job->fns = fns;
+    job->data = data;
+
+    dynarray::append(&prgstate->jobs, job);
+    logf_ln("[job %u] Started %s", job->id, str_data(job->description));
+
+    if (!start_thread(&job->thread, run_work, job))
+    {
+        logf_ln("[job %u] No thread for it, running it now", job->id);
+        run_work(job);
+    }
+
+    return job;
+}
+
+
+static void end(ProgramState *prgstate, DynArrayCount index)
+{
+    Job *job = prgstate->jobs[index];
+    if (job->thread.handle)
+    {
+        join_thread(&job->thread);
+    }
+
+    logf_ln("[job %u] %s %s after %.1f ms", job->id, str_data(job->description),
+            job->progress.cancel ? "cancelled" : "finished", milliseconds_since(job->start_time));
+
+    job->fns->free(job);
+    str_free(&job->description);
+    mem::default_allocator()->dealloc(job);
+
+    // Keeps the order they were started in, for the status bar
+    dynarray::remove_at(&prgstate->jobs, index);
+}
+
+
+void update(ProgramState *prgstate, double budget_ms)
+{
+    u64 deadline = query_abstime() + (u64)(budget_ms * 1000000.0);
+
+    for (DynArrayCount i = 0; i < prgstate->jobs.count;)
+    {
+        Job *job = prgstate->jobs[i];
+        if (!atomic::load_acquire(&job->work_done))
+        {
+            ++i;
+            continue;
+        }
+
+        bool published = true;
+        if (!job->progress.cancel)
+        {
+            PROF_ZONE("job publish");
+            published = job->fns->publish(prgstate, job, deadline);
+        }
+
+        if (published)
+        {
+            end(prgstate, i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Held off while values were being published
+    collect_types_if_requested(prgstate);
+}
+
+
+void cancel(Job *job)
+{
+    atomic::store_release(&job->progress.cancel, 1u);
+}
+
+
+Job *find(ProgramState *prgstate, u32 id)
+{
+    for (DynArrayCount i = 0; i < prgstate->jobs.count; ++i)
+    {
+        if (prgstate->jobs[i]->id == id)
+        {
+            return prgstate->jobs[i];
+        }
+    }
+    return nullptr;
+}
+
+
+void cancel_all(ProgramState *prgstate)
+{
+    for (DynArrayCount i = 0; i < prgstate->jobs.count; ++i)
+    {
+        cancel(prgstate->jobs[i]);
+    }
+    while (prgstate->jobs.count > 0)
+    {
+        end(prgstate, prgstate->jobs.count - 1);
+    }
+}
+
+
+double eta_seconds(const Job *job)
+{
+    u64 bytes_found = atomic::load_acquire(&job->progress.bytes_found);
+    u64 bytes_done = atomic::load_acquire(&job->progress.bytes_done);
+    if (bytes_done == 0 || bytes_found < bytes_done)
+    {
+        return -1.0;
+    }
+
+    double seconds = seconds_since(job->start_time);
+    return seconds * (double)(bytes_found - bytes_done) / (double)bytes_done;
+}
+
+
+void format_status(char *buffer, size_t buffer_size, const Job *job)
+{
+    if (atomic::load_acquire(&job->work_done))
+    {
+        snprintf(buffer, buffer_size, "[job %u] %s: publishing", job->id, str_data(job->description));
+        return;
+    }
+
+    char bytes_done[32];
+    char bytes_found[32];
+    allocstats::format_bytes(bytes_done, sizeof(bytes_done), (s64)atomic::load_acquire(&job->progress.bytes_done));
+    allocstats::format_bytes(bytes_found, sizeof(bytes_found), (s64)atomic::load_acquire(&job->progress.bytes_found));
+
+    char eta[32] = "";
+    double eta_secs = eta_seconds(job);
+    if (eta_secs >= 0)
+    {
+        snprintf(eta, sizeof(eta), ", about %.0fs left", eta_secs);
+    }
+
+    snprintf(buffer, buffer_size, "[job %u] %s: %u of %u files, %s of %s%s%s",
+             job->id, str_data(job->description),
+             atomic::load_acquire(&job->progress.files_done), atomic::load_acquire(&job->progress.files_found),
+             bytes_done, bytes_found, eta, job->progress.cancel ? ", cancelling" : "");
+}
+
+}
@@ -0,0 +1,93 @@
+// -*- c++ -*-
+
+#ifndef JOBS_H
+
+#include "platform.h"
+#include "str.h"
+#include "numeric_types.h"
+
+
+/*
+Long-running commands run as jobs so the frame loop never waits on them.
+A job's work runs on a thread of its own and must not touch the
+ProgramState: it builds its results privately and counts its progress in
+the job as it goes. Once the work is done, jobs::update publishes the
+results on the main thread a slice per frame, which is the only place
+they enter the ProgramState. Cancelling stops the work at its next check
+and throws away whatever was built.
+*/
+
+struct ProgramState;
+struct Job;
+
+
+// Bumped by the work, read from any thread
+struct JobProgress
+{
+    volatile u32 files_found;
+    volatile u32 files_done;
+    volatile u64 bytes_found;
+    volatile u64 bytes_done;
+    // Set from the main thread, the work checks it between steps
+    volatile u32 cancel;
+};
+
+
+struct JobFunctions
+{
+    // On the job's thread
+    void (*work)(Job *job);
+    // On the main thread after work returns, unless cancelled. Returns
+    // true once everything is published, and should return by deadline
+    // (an abstime) either way.
+    bool (*publish)(ProgramState *prgstate, Job *job, u64 deadline);
+    // Whether or not it was published
+    void (*free)(Job *job);
+};
+
+
+struct Job
+{
+    u32 id;
+    Str description;
+    u64 start_time;
+    const JobFunctions *fns;
+    void *data;
+
+    JobProgress progress;
+    PlatformThread thread;
+    // set by the job's thread when work returns
+    volatile u32 work_done;
+};
+
+
+namespace jobs
+{
+
+// Takes ownership of data, it goes to fns->free when the job ends. If no
+// thread can be started the work runs right here.
+Job *start(ProgramState *prgstate, StrSlice description, const JobFunctions *fns, void *data);
+
+// From the frame loop: publishes for at most budget_ms, then ends the
+// jobs that are finished or cancelled
+void update(ProgramState *prgstate, double budget_ms);
+
+void cancel(Job *job);
+
+Job *find(ProgramState *prgstate, u32 id);
+
+// Cancels everything and waits for the threads, for shutting down
+void cancel_all(ProgramState *prgstate);
+
+// Extrapolated from the bytes done so far, negative until there's
+// enough to go on
+double eta_seconds(const Job *job);
+
+// One line for the status bar and lsjobs
+void format_status(char *buffer, size_t buffer_size, const Job *job);
+
+}
+
+
+#define JOBS_H
+#endif
@@ -1,83 +1,155 @@
 // logging
 #include "logging.h"
-#include "dynarray.h"
 #include "str.h"
 #include "memory.h"
 #include "common.h"
+#include "atomics.h"
 #include "formatbuffer.h"
+#include "dynarray.h"
 #include <cstdarg>
 #include <cstdio>
 #include <cstddef>
 
-static DynArray<Str> log_entries = {};
-static char *output_buffer = 0;
-static size_t output_buffer_size = 0;
-// static FormatBuffer *concatenated = 0;
-static DynArrayCount next_log_entry_to_concat = 0;
-static DynArrayCount start_log_entry_index = 0;
-static bool concatenated_dirty = false;
+// Both must be powers of two
+#define LOG_RING_SIZE MEGABYTES(4)
+#define LOG_RECORD_ALIGN 8
+
+// The console view trims its oldest half when it grows past this
+#define LOG_VIEW_MAX_SIZE MEGABYTES(16)
+
+// Longest single record, longer messages are truncated in the ring
+#define LOG_RECORD_MAX_LENGTH (LOG_RING_SIZE / 4)
+
+
+struct LogRecordHeader
+{
+    // Low 32 bits of the record's position in the stream. Written last,
+    // so a reader that sees its expected position knows the bytes are in.
+    volatile u32 tag;
+    u32 length;
+};
+
+// length marking filler from a record's position up to the end of the ring
+static const u32 LogRecordPadding = UINT32_MAX;
+
+
+struct LogRing
+{
+    // total bytes reserved by writers, never wraps
+    volatile u64 write_cursor;
+
+    // reader side, main thread only
+    u64 read_cursor;
+    u64 dropped_count;
+};
+
+
+static union
+{
+    u64 align_;
+    char bytes[LOG_RING_SIZE];
+} log_ring_storage;
+
+static LogRing log_ring = {};
 static Str concatenated = {};
+// offset in concatenated of the start of each line
+static DynArray<u32> line_starts = {};
+static u64 view_generation = 0;
+
 
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
+#pragma clang diagnostic ignored "-Wcast-align"
 #endif
 
 
-void append_log(Str log_entry)
+static u32 record_size(u32 length)
 {
-    dynarray::append(&log_entries, log_entry);
-    concatenated_dirty = true;
+    u32 size = (u32)sizeof(LogRecordHeader) + length;
+    return (size + LOG_RECORD_ALIGN - 1) & ~u32(LOG_RECORD_ALIGN - 1);
 }
 
 
-void append_log(const char *string)
+static LogRecordHeader *record_header_at(u64 position)
 {
-    append_log(str(string));
+    u64 offset = position & (LOG_RING_SIZE - 1);
+    return reinterpret_cast<LogRecordHeader *>(log_ring_storage.bytes + offset);
 }
 
 
 void append_log(const char *string, size_t length)
 {
-    append_log(str(string, STRLEN(length)));
+    u32 record_length = (u32)min(length, size_t(LOG_RECORD_MAX_LENGTH));
+    u32 size = record_size(record_length);
+
+    // Records never straddle the end of the ring. If this one doesn't
+    // fit, reserve the rest of the ring as padding along with it.
+    u64 start;
+    u64 padding;
+    for (;;)
+    {
+        start = atomic::load_acquire(&log_ring.write_cursor);
+        u64 offset = start & (LOG_RING_SIZE - 1);
+        padding = (offset + size > LOG_RING_SIZE) ? LOG_RING_SIZE - offset : 0;
+
+        if (atomic::compare_exchange(&log_ring.write_cursor, start, start + padding + size))
+        {
+            break;
+        }
+    }
+
+    if (padding)
+    {
+        LogRecordHeader *pad_header = record_header_at(start);
+        pad_header->length = LogRecordPadding;
+        atomic::store_release(&pad_header->tag, (u32)start);
+    }
+
+    u64 position = start + padding;
+    LogRecordHeader *header = record_header_at(position);
+    header->length = record_length;
+    std::memcpy(header + 1, string, record_length);
+    atomic::store_release(&header->tag, (u32)position);
+}
+
+
+void append_log(const char *string)
+{
+    append_log(string, std::strlen(string));
 }
 
 
 static void vlogf(const char *format, va_list vargs)
 {
-    mem::IAllocator *allocator = mem::default_allocator();
-    // lazily allocate the output buffer
-    if (!output_buffer)
-    {
-        output_buffer_size = FormatBuffer::DefaultCapacity;
-        output_buffer = MAKE_ARRAY(allocator, output_buffer_size, char);
-    }
+    // Format on the stack so logging doesn't share a buffer between threads
+    char stack_buffer[1024];
+    char *output_buffer = stack_buffer;
 
-    int format_size = vsnprintf(output_buffer, output_buffer_size, format, vargs);
+    va_list vargs_copy;
+    va_copy(vargs_copy, vargs);
+    int format_size = vsnprintf(stack_buffer, sizeof(stack_buffer), format, vargs);
     assert(format_size >= 0);
 
     // format size should always be less than output size, otherwise we risk losing the null terminator
-    if ((size_t)format_size >= output_buffer_size)
+    if ((size_t)format_size >= sizeof(stack_buffer))
     {
-        output_buffer_size = (size_t)format_size + 1;
-        // REALLOC_ARRAY(output_buffer, char, output_buffer_size);
-        RESIZE_ARRAY(allocator, output_buffer, output_buffer_size, char);
-        int confirm_format_size = vsnprintf(output_buffer, output_buffer_size, format, vargs);
+        size_t output_buffer_size = (size_t)format_size + 1;
+        output_buffer = MAKE_ARRAY_CAT(mem::default_allocator(), output_buffer_size, "log", char);
+        int confirm_format_size = vsnprintf(output_buffer, output_buffer_size, format, vargs_copy);
         assert(confirm_format_size == format_size);
+        UNUSED(confirm_format_size);
     }
-
-    // ^ could extract that into a dynamic format buffer class
-
-    if (!log_entries.data)
-    {
-        dynarray::init(&log_entries, 1024);
-    }
-
-    assert(output_buffer_size < STR_LENGTH_MAX);
+    va_end(vargs_copy);
 
     append_log(output_buffer, (size_t)format_size);
 
     println(output_buffer);
+
+    if (output_buffer != stack_buffer)
+    {
+        mem::default_allocator()->dealloc(output_buffer);
+    }
 }
 
 
@@ -106,22 +178,10 @@ void logf_ln(const char *format, ...)
 }
 
 
-u32 log_count()
-{
-    return log_entries.count;
-}
-
-
-Str *get_log(u32 i)
-{
-    return &log_entries[i];
-}
-
-
 void log_write_with_userdata(void *userdata, const char *buffer, size_t length)
 {
     UNUSED(userdata);
-    append_log(str(buffer, STRLEN(length)));
+    append_log(buffer, length);
 }
 
 
@@ -135,62 +195,189 @@ void logf_with_userdata(void *userdata, const char *format, ...)
 }
 
 
-DynArrayCount advance_start_index_to_fit_strlen(
-    DynArrayCount start_index,
-    size_t capacity,
-    const DynArray<Str> *entries
-    )
+u64 log_dropped_count()
+{
+    return log_ring.dropped_count;
+}
+
+
+// Str grows to exactly what's asked for, the view appends a line at a
+// time so grow it geometrically instead
+static void reserve_concatenated_log(StrLen additional)
+{
+    StrLen required = str_length(concatenated) + additional + 1;
+    StrLen capacity = str_capacity(concatenated);
+    if (capacity < required)
+    {
+        str_ensure_capacity(&concatenated, max(required, capacity * 2));
+    }
+}
+
+
+// Appends text plus a newline and indexes the lines in it
+static void append_view_lines(const char *text, u32 length)
 {
-    for (DynArrayCount i = start_index; (capacity > STR_LENGTH_MAX) && (i < entries->count); ++i)
+    if (!line_starts.data)
     {
-        capacity -= (*entries)[i].length;
-        ++start_index;
+        dynarray::init(&line_starts, 1024);
+    }
+
+    StrLen view_length = str_length(concatenated);
+    reserve_concatenated_log(length + 1);
+    str_append(&concatenated, str_slice(text, length));
+    str_append(&concatenated, '\n');
+
+    dynarray::append(&line_starts, view_length);
+    for (u32 i = 0; i < length; ++i)
+    {
+        if (text[i] == '\n')
+        {
+            dynarray::append(&line_starts, view_length + i + 1);
+        }
     }
-    return start_index;
 }
 
 
-void write_catlog_from_index(Str *catlog, const DynArray<Str> *entries, DynArrayCount start_index)
+// Undo append_view_lines when the record turned out to be torn
+static void truncate_view(StrLen length)
 {
-    str_clear(catlog);
-    for (DynArrayCount i = start_index; i < entries->count; ++i)
+    str_set_length(&concatenated, length);
+    while (line_starts.count && *dynarray::last(&line_starts) >= length)
     {
-        Str entry = entries->at(i);
-        str_append(catlog, entry);
-        str_append(catlog, '\n');
+        dynarray::pop(&line_starts);
     }
 }
 
 
-Str *concatenated_log()
+// Drops the oldest half of the view, cut at a line boundary
+static void trim_concatenated_log()
 {
-    if (concatenated_dirty)
+    char *data = str_data(&concatenated);
+    StrLen length = str_length(concatenated);
+    StrLen cut = length / 2;
+
+    while (cut < length && data[cut - 1] != '\n')
+    {
+        ++cut;
+    }
+
+    std::memmove(data, data + cut, length - cut);
+    str_set_length(&concatenated, length - cut);
+
+    DynArrayCount first_kept = 0;
+    while (first_kept < line_starts.count && line_starts[first_kept] < cut)
     {
-        size_t min_capacity = concatenated.length;
-        for (DynArrayCount i = next_log_entry_to_concat; i < log_entries.count; ++i)
+        ++first_kept;
+    }
+
+    DynArrayCount kept = line_starts.count - first_kept;
+    for (DynArrayCount i = 0; i < kept; ++i)
+    {
+        line_starts[i] = line_starts[first_kept + i] - cut;
+    }
+    line_starts.count = kept;
+}
+
+
+// Pulls every record committed since the last read into the view. Stops
+// at the first record that's reserved but not yet published.
+static void read_new_log_records()
+{
+    u64 write_cursor = atomic::load_acquire(&log_ring.write_cursor);
+    if (log_ring.read_cursor == write_cursor)
+    {
+        return;
+    }
+    ++view_generation;
+
+    while (log_ring.read_cursor < write_cursor)
+    {
+        if (write_cursor - log_ring.read_cursor > LOG_RING_SIZE)
         {
-            min_capacity += log_entries[i].length + 1;
+            // Writers lapped us, there's no way to find record
+            // boundaries in what's left, so skip to the front
+            ++log_ring.dropped_count;
+            log_ring.read_cursor = write_cursor;
+            append_view_lines("[log lines dropped]", 19);
+            break;
         }
 
-        start_log_entry_index = advance_start_index_to_fit_strlen(
-            start_log_entry_index, min_capacity, &log_entries);
+        LogRecordHeader *header = record_header_at(log_ring.read_cursor);
+        if (atomic::load_acquire(&header->tag) != (u32)log_ring.read_cursor)
+        {
+            break;
+        }
 
-        write_catlog_from_index(&concatenated, &log_entries, start_log_entry_index);
+        u32 length = header->length;
+        if (length == LogRecordPadding)
+        {
+            log_ring.read_cursor += LOG_RING_SIZE - (log_ring.read_cursor & (LOG_RING_SIZE - 1));
+            continue;
+        }
 
+        StrLen length_before = str_length(concatenated);
+        append_view_lines(reinterpret_cast<const char *>(header + 1), length);
+
+        // A writer may have overwritten the record while we copied it
+        if (atomic::load_acquire(&log_ring.write_cursor) - log_ring.read_cursor > LOG_RING_SIZE)
+        {
+            truncate_view(length_before);
+            write_cursor = atomic::load_acquire(&log_ring.write_cursor);
+            continue;
+        }
+
+        log_ring.read_cursor += record_size(length);
+    }
 
-        concatenated_dirty = false;
-        next_log_entry_to_concat = log_entries.count;
+    if (str_length(concatenated) > LOG_VIEW_MAX_SIZE)
+    {
+        trim_concatenated_log();
     }
+}
 
+
+Str *concatenated_log()
+{
+    read_new_log_records();
     return &concatenated;
 }
 
 
 void clear_concatenated_log()
 {
+    read_new_log_records();
     str_clear(&concatenated);
-    next_log_entry_to_concat = log_entries.count;
-    start_log_entry_index = next_log_entry_to_concat;
+    dynarray::clear(&line_starts);
+    ++view_generation;
+}
+
+
+u32 log_view_line_count()
+{
+    read_new_log_records();
+    return line_starts.count;
+}
+
+
+StrSlice log_view_lines(u32 first, u32 last)
+{
+    assert(first <= last && last < line_starts.count);
+    u32 begin = line_starts[first];
+    // every line ends with a newline, leave the last one off
+    u32 end = (last + 1 < line_starts.count ? line_starts[last + 1] : str_length(concatenated)) - 1;
+    return str_slice(str_data(concatenated) + begin, end - begin);
+}
+
+
+StrSlice log_view_line(u32 index)
+{
+    return log_view_lines(index, index);
+}
+
+
+u64 log_view_generation()
+{
+    return view_generation;
 }
 
 #ifdef __clang__
@@ -14,18 +14,40 @@
 #endif
 
 
-// returns number of log entries
-u32 log_count();
+/*
+Log lines go into a fixed-size byte ring. Any thread can append without
+taking a lock: writers reserve space with a CAS on the write cursor,
+copy their bytes in, then publish the record header. If the reader falls
+a whole ring behind, the overwritten lines are dropped from the view
+(stdout still gets everything).
 
-// returns log entry at index
-Str *get_log(u32 i);
+The concatenated log is the view of the ring for the console. It is
+only touched from the main thread, and each call just appends whatever
+was committed since the last call.
+*/
 
-// Access to the global concatenation of all log entries that can fit in a Str
+// Number of lines that were overwritten before the view read them
+u64 log_dropped_count();
+
+// Everything logged so far (up to a size cap, oldest lines are trimmed),
+// one entry per line.
 Str *concatenated_log();
 void clear_concatenated_log();
 
-// append to the log entries directly without writing to stdout
+// Line index over the concatenated log, kept up to date as records are
+// read in so the console only has to touch the lines it shows.
+// log_view_line_count() reads new records, the others don't, so line
+// numbers are stable between calls to it.
+u32 log_view_line_count();
+StrSlice log_view_line(u32 index);
+// Contiguous text of lines first..last inclusive, newlines between
+StrSlice log_view_lines(u32 first, u32 last);
+// Changes whenever lines are added to or removed from the view
+u64 log_view_generation();
+
+// append to the log directly without writing to stdout
 void append_log(const char *string);
+void append_log(const char *string, size_t length);
 
 // printf-like functions that prints to stdout and adds to global log_entries
 void log_write_with_userdata(void *userdata, const char *buffer, size_t length);
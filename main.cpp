@@ -25,8 +25,14 @@
 
 #include "tokenizer.h"
 #include "clicommands.h"
+#include "console.h"
+#include "profiler.h"
 #include "programstate.h"
+#include "allocstats.h"
+#include "jobs.h"
+#include "numbers.h"
 #include <algorithm>
+#include <cstring>
 
 #include "typesys_json.h"
 
@@ -52,10 +58,10 @@ void test_json_import(ProgramState *prgstate, int filename_count, char **filenam
     {
         const char *filename = filenames[i];
         Str jsonstr = read_file(filename);
-        ASSERT(jsonstr.data);
+        ASSERT(str_length(jsonstr));
 
         json_parse_result_s jp_result = {};
-        json_value_s *jv = json_parse_ex(jsonstr.data, jsonstr.length,
+        json_value_s *jv = json_parse_ex(str_data(jsonstr), str_length(jsonstr),
                                          jsonflags, &jp_result);
 
         if (!jv)
@@ -90,116 +96,6 @@ void test_json_import(ProgramState *prgstate, int filename_count, char **filenam
 }
 
 
-void log_parse_error(JsonParseResult pr, StrSlice input, size_t input_offset_from_src)
-{
-    FormatBuffer fmt_buf;
-    fmt_buf.flush_on_destruct();
-
-    fmt_buf.writef("Json parse error: %s\nAt %lu:%lu\n%s\n",
-                   pr.error_desc.data,
-                   pr.error_line,
-                   pr.error_column + (pr.error_line > 1 ? 0 : input_offset_from_src),
-                   input.data);
-
-    size_t buffer_offset = pr.error_offset + input_offset_from_src;
-    for (size_t i = 0; i < buffer_offset - 1; ++i) fmt_buf.write("~");
-    fmt_buf.write("^");
-}
-
-
-void process_console_input(ProgramState *prgstate, StrSlice input_buf)
-{
-    // mem::ALLOC_STACKTRACE = true;
-
-    tokenizer::State tokstate;
-    tokenizer::init(&tokstate, input_buf.data);
-
-    tokenizer::Token first_token = tokenizer::read_string(&tokstate);
-
-    DynArray<Value> cmd_args;
-    dynarray::init(&cmd_args, 10);
-
-    bool error = false;
-
-    for (;;)
-    {
-        size_t offset_from_input = (size_t)(tokstate.current - input_buf.data);
-
-        Value parsed_value;
-        StrSlice parse_slice = str_slice(tokstate);
-        JsonParseResult parse_result = try_parse_json_as_value(OUTPARAM &parsed_value, prgstate,
-                                                               parse_slice.data, parse_slice.length);
-
-        switch (parse_result.status)
-        {
-            case JsonParseResult::Failed:
-                log_parse_error(parse_result, parse_slice, offset_from_input);
-                error = true;
-                goto AfterArgParseLoop;
-            case JsonParseResult::Succeeded:
-                dynarray::append(&cmd_args, parsed_value);
-                break;
-            case JsonParseResult::Eof:
-                goto AfterArgParseLoop;
-        }
-
-        tokstate.current += parse_result.parse_offset;
-
-        if (tokenizer::past_end(&tokstate))
-        {
-            goto AfterArgParseLoop;
-        }
-
-    }
-AfterArgParseLoop:
-
-    if (!error)
-    {
-        exec_command(prgstate, first_token.text, cmd_args);
-    }
-
-    dynarray::deinit(&cmd_args);
-
-    // mem::ALLOC_STACKTRACE = false;
-}
-
-
-void run_terminal_json_cli(ProgramState *prgstate)
-{
-    for (;;)
-    {
-        char *input = linenoise(">> ");
-
-        if (!input)
-        {
-            break;
-        }
-
-        // void *alloc_probe = mem::default_allocator()->probe();
-        append_log(input);
-
-        tokenizer::State tokstate;
-        tokenizer::init(&tokstate, input);
-
-        tokenizer::Token first_token = tokenizer::read_string(&tokstate);
-
-        if (first_token.type == tokenizer::TokenType::Eof)
-        {
-            std::free(input);
-            continue;
-        }
-
-        process_console_input(prgstate, str_slice(input));
-
-        // mem::default_allocator()->log_allocs_since_probe(alloc_probe);
-
-        std::free(input);
-    }
-}
-
-
-
-
 class CliHistory
 {
 public:
@@ -231,10 +127,7 @@ public:
 
 void CliHistory::to_front()
 {
-    if (this->saved_input_buf.capacity)
-    {
-        str_free(&this->saved_input_buf);
-    }
+    str_free(&this->saved_input_buf);
     this->pos = -1;
 }
 
@@ -258,9 +151,10 @@ void CliHistory::restore(s64 position, ImGuiTextEditCallbackData* data)
     }
 
     Str *new_input = &this->input_entries[DYNARRAY_COUNT(position)];
-    memcpy(data->Buf, new_input->data, new_input->length);
-    data->Buf[new_input->length] = '\0';
-    data->BufTextLen = data->SelectionStart = data->SelectionEnd = data->CursorPos = new_input->length;
+    StrLen new_input_length = str_length(*new_input);
+    memcpy(data->Buf, str_data(new_input), new_input_length);
+    data->Buf[new_input_length] = '\0';
+    data->BufTextLen = data->SelectionStart = data->SelectionEnd = data->CursorPos = S32(new_input_length);
     data->BufDirty = true;
 }
 
@@ -300,9 +194,10 @@ void CliHistory::forward(ImGuiTextEditCallbackData* data)
 
     if (prev_pos == this->input_entries.count - 1)
     {
-        memcpy(data->Buf, this->saved_input_buf.data, this->saved_input_buf.length);
-        data->Buf[this->saved_input_buf.length] = '\0';
-        data->BufTextLen = this->saved_input_buf.length;
+        StrLen saved_length = str_length(this->saved_input_buf);
+        memcpy(data->Buf, str_data(&this->saved_input_buf), saved_length);
+        data->Buf[saved_length] = '\0';
+        data->BufTextLen = S32(saved_length);
         data->CursorPos = this->saved_cursor_pos;
         data->SelectionStart = this->saved_selection_start;
         data->SelectionEnd = this->saved_selection_end;
@@ -339,10 +234,119 @@ int imgui_cli_history_callback(ImGuiTextEditCallbackData *data)
 }
 
 
+// Selected range of log lines, -1 when nothing is selected
+struct LogViewSelection
+{
+    s64 anchor;
+    s64 end;
+
+    bool contains(s64 line) const
+    {
+        return anchor >= 0
+            && line >= min(anchor, end)
+            && line <= max(anchor, end);
+    }
+};
+
+
+void copy_log_lines_to_clipboard(u32 first, u32 last)
+{
+    StrSlice text = log_view_lines(first, last);
+    Str clipboard_text = str(text);
+    ImGui::SetClipboardText(str_data(clipboard_text));
+    str_free(&clipboard_text);
+}
+
+
+// Only the visible lines are laid out, so the cost doesn't grow with the log
+void draw_log_view()
+{
+    PROF_FUNCTION();
+
+    static LogViewSelection selection = {-1, -1};
+    static u32 prev_line_count = 0;
+
+    u32 line_count = log_view_line_count();
+    if (selection.anchor >= line_count || selection.end >= line_count)
+    {
+        // lines were trimmed or cleared out from under the selection
+        selection.anchor = selection.end = -1;
+    }
+
+    bool was_at_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+    float line_height = ImGui::GetTextLineHeightWithSpacing();
+    float row_width = max(ImGui::GetContentRegionAvailWidth(), ImGui::GetWindowContentRegionWidth());
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    ImU32 selected_color = ImGui::GetColorU32(ImGuiCol_Header);
+
+    ImGuiListClipper clipper(S32(line_count), line_height);
+    while (clipper.Step())
+    {
+        for (s32 i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+            ImVec2 row_min = ImGui::GetCursorScreenPos();
+            ImVec2 row_max(row_min.x + row_width, row_min.y + line_height);
+
+            if (selection.contains(i))
+            {
+                draw_list->AddRectFilled(row_min, row_max, selected_color);
+            }
+
+            StrSlice line = log_view_line(U32(i));
+            ImGui::TextUnformatted(line.data, line.data + line.length);
+
+            if (ImGui::IsMouseClicked(0) && ImGui::IsMouseHoveringRect(row_min, row_max))
+            {
+                if (ImGui::GetIO().KeyShift && selection.anchor >= 0)
+                {
+                    selection.end = i;
+                }
+                else
+                {
+                    selection.anchor = selection.end = i;
+                }
+            }
+        }
+    }
+
+    if (ImGui::IsWindowFocused() && ImGui::GetIO().KeyCtrl && ImGui::IsKeyPressed(SDLK_c, false)
+        && selection.anchor >= 0)
+    {
+        copy_log_lines_to_clipboard(U32(min(selection.anchor, selection.end)),
+                                    U32(max(selection.anchor, selection.end)));
+    }
+
+    if (ImGui::BeginPopupContextWindow())
+    {
+        if (ImGui::MenuItem("Copy selected lines", "Ctrl+C", false, selection.anchor >= 0))
+        {
+            copy_log_lines_to_clipboard(U32(min(selection.anchor, selection.end)),
+                                        U32(max(selection.anchor, selection.end)));
+        }
+        if (ImGui::MenuItem("Copy all", nullptr, false, line_count > 0))
+        {
+            copy_log_lines_to_clipboard(0, line_count - 1);
+        }
+        if (ImGui::MenuItem("Clear selection", nullptr, false, selection.anchor >= 0))
+        {
+            selection.anchor = selection.end = -1;
+        }
+        ImGui::EndPopup();
+    }
+
+    // Follow new output, unless the user scrolled up to read something
+    if (line_count != prev_line_count && was_at_bottom)
+    {
+        ImGui::SetScrollHere(1.0f);
+    }
+    prev_line_count = line_count;
+}
+
+
 void draw_imgui_json_cli(ProgramState *prgstate, SDL_Window *window)
 {
-    static float scroll_y = 0;
-    static bool highlight_output_mode = false;
+    PROF_FUNCTION();
+
     static bool first_draw = true;
     static CliHistory history;
 
@@ -366,31 +370,7 @@ void draw_imgui_json_cli(ProgramState *prgstate, SDL_Window *window)
                       ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_AlwaysHorizontalScrollbar);
 
 
-    ImGuiInputTextFlags output_flags = ImGuiInputTextFlags_ReadOnly;
-    Str *biglog = concatenated_log();
-
-    if (highlight_output_mode)
-    {
-        ImGui::InputTextMultiline("##log-output", biglog->data, biglog->length, ImVec2(-1, -1), output_flags);
-
-        if ((! (ImGui::IsWindowHovered() || ImGui::IsItemHovered()) && ImGui::IsMouseReleased(0))
-            || ImGui::IsKeyReleased(SDLK_TAB))
-        {
-            highlight_output_mode = false;
-        }
-    }
-    else
-    {
-        ImGui::TextUnformatted(biglog->data, biglog->data + biglog->length);
-        scroll_y = ImGui::GetItemRectSize().y;
-        if (ImGui::IsItemHovered() && ImGui::IsMouseReleased(0))
-        {
-            highlight_output_mode = true;
-        }
-        ImGui::SetScrollY(scroll_y);
-    }
-
-
+    draw_log_view();
 
     ImGui::EndChild();
 
@@ -423,7 +403,50 @@ void draw_imgui_json_cli(ProgramState *prgstate, SDL_Window *window)
 
 
 
-void draw_value_editor(ProgramState *prgstate, Value *value, const char *label);
+bool draw_value_editor(ProgramState *prgstate, Value *value, const char *label);
+
+
+// Set for the whole window while drawing a collection or a flat view of it
+static Collection *editor_collection = nullptr;
+static bool editor_read_only = false;
+
+
+// A record's string name or id member, to tell rows apart
+static const char *record_label(ProgramState *prgstate, Value *record)
+{
+    if (!vIS_COMPOUND(record))
+    {
+        return nullptr;
+    }
+
+    NameRef name_name = nametable::find_or_add(&prgstate->names, "name");
+    NameRef name_id = nametable::find_or_add(&prgstate->names, "id");
+
+    CompoundValueMember *identifier_mem = find_member(record, name_name);
+    if (identifier_mem && vIS_STRING(&identifier_mem->value))
+    {
+        return str_data(identifier_mem->value.str_val);
+    }
+
+    identifier_mem = find_member(record, name_id);
+    if (identifier_mem && vIS_STRING(&identifier_mem->value))
+    {
+        return str_data(identifier_mem->value.str_val);
+    }
+    return nullptr;
+}
+
+
+// Nested arrays open as a table of their own rather than a tree in the cell
+static void draw_flat_view_button(ProgramState *prgstate, FlatView *parent_view, Value *array, NameRef member)
+{
+    char label[32];
+    snprintf(label, sizeof(label), "%u rows", array->array_value.elements.count);
+    if (ImGui::SmallButton(label))
+    {
+        open_flat_view(prgstate, editor_collection, parent_view, member);
+    }
+}
 
 
 float ImGui_GetVertSpacing()
@@ -436,10 +459,11 @@ float ImGui_GetHorizSpacing()
     return GImGui->Style.ItemSpacing.x;
 }
 
-void draw_array_list_editor(ProgramState *prgstate, Value *value, const char *label)
+bool draw_array_list_editor(ProgramState *prgstate, Value *value, const char *label)
 {
     ASSERT(vIS_ARRAY(value));
 
+    bool changed = false;
     if (ImGui::TreeNode("Array##array_list_editor"))
     {
         DynArray<Value> *elems = &value->array_value.elements;
@@ -449,7 +473,7 @@ void draw_array_list_editor(ProgramState *prgstate, Value *value, const char *la
             Value *val = elems->data + i;
             if (ImGui::TreeNode("##array_elem", "[%i]", i))
             {
-                draw_value_editor(prgstate, val, label);
+                changed |= draw_value_editor(prgstate, val, label);
                 ImGui::TreePop();
             }
             ImGui::PopID();
@@ -457,9 +481,15 @@ void draw_array_list_editor(ProgramState *prgstate, Value *value, const char *la
 
         ImGui::TreePop();
     }
+
+    if (changed)
+    {
+        value_hash_changed(value);
+    }
+    return changed;
 }
 
-void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *label)
+bool draw_array_table_editor(ProgramState *prgstate, Value *value, const char *label)
 {
     ASSERT(vIS_ARRAY(value));
 
@@ -471,7 +501,7 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
     if (!is_compound_ish)
     {
         ImGui::Text("i dunno man");
-        return;
+        return false;
     }
 
     DynArray<NameRef> element_member_names = dynarray::init<NameRef>(16);
@@ -522,13 +552,14 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
     ImGui::Separator();
     ImGui::EndChild();
 
-    NameRef name_name = nametable::find_or_add(&prgstate->names, "name");
-    NameRef name_id = nametable::find_or_add(&prgstate->names, "id");
+    // Only the collection's own records are parents of flat views
+    bool is_collection_records = editor_collection && value == &editor_collection->value;
 
     ImGui::BeginChild("Array columns data", ImVec2(0, 0), false, 0);
 
     ImGui::Separator();
     ImGui::Columns(S32(element_member_names.count), "column_rows");
+    bool changed = false;
     // ImGui::Columns(S32(element_member_names.count + 1), "column_rows");
 
     for (DynArrayCount i = 0, ie = value->array_value.elements.count; i < ie; ++i)
@@ -542,22 +573,10 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
         const char *use_label = label;
         if (!use_label)
         {
-            CompoundValueMember *identifier_mem = find_member(elem_value, name_name);
-            if (identifier_mem && vIS_STRING(&identifier_mem->value))
-            {
-                use_label = identifier_mem->value.str_val.data;
-            }
-            else
+            use_label = record_label(prgstate, elem_value);
+            if (!use_label)
             {
-                identifier_mem = find_member(elem_value, name_id);
-                if (identifier_mem && vIS_STRING(&identifier_mem->value))
-                {
-                    use_label = identifier_mem->value.str_val.data;
-                }
-                else
-                {
-                    use_label = "UNKNOWN_LABEL";
-                }
+                use_label = "UNKNOWN_LABEL";
             }
         }
 
@@ -568,6 +587,7 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
         // ImGui::PopID();
         // ImGui::NextColumn();
 
+        bool elem_changed = false;
         for (DynArrayCount j = 0, je = element_member_names.count; j < je; ++j)
         {
             ImGui::PushID(S32(j));
@@ -578,15 +598,25 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
             {
                 ImGui::Text("NOPE");
             }
+            else if (is_collection_records && vIS_ARRAY(&memval->value))
+            {
+                draw_flat_view_button(prgstate, nullptr, &memval->value, element_member_names[j]);
+            }
             else
             {
-                draw_value_editor(prgstate, &memval->value, use_label);
+                elem_changed |= draw_value_editor(prgstate, &memval->value, use_label);
             }
 
             ImGui::PopID();
             ImGui::NextColumn();
         }
 
+        if (elem_changed)
+        {
+            value_hash_changed(elem_value);
+            changed = true;
+        }
+
         // if (i + 1 < ie) ImGui::Separator();
         ImGui::PopID();
     }
@@ -604,13 +634,21 @@ void draw_array_table_editor(ProgramState *prgstate, Value *value, const char *l
     ImGui::PopID();
 
     dynarray::deinit(&element_member_names);
+
+    if (changed)
+    {
+        value_hash_changed(value);
+    }
+    return changed;
 }
 
 
-void draw_compound_value_editor(ProgramState *prgstate, Value *value)
+bool draw_compound_value_editor(ProgramState *prgstate, Value *value)
 {
     ASSERT(vIS_COMPOUND(value));
 
+    bool changed = false;
+
     float max_width = 0;
     float horiz_spacing = ImGui_GetHorizSpacing();
 
@@ -648,68 +686,160 @@ void draw_compound_value_editor(ProgramState *prgstate, Value *value)
             }
 
             ImGui::SameLine(pos_x, horiz_spacing);
-            draw_value_editor(prgstate, &member->value, namelabel.data);
+            changed |= draw_value_editor(prgstate, &member->value, namelabel.data);
         }
         ImGui::PopID();
     }
+
+    if (changed)
+    {
+        value_hash_changed(value);
+    }
+    return changed;
 }
 
 
-static int array_depth = 0;
+// ImGui has no 64-bit inputs, so edit the text and read it back. Text
+// that isn't a number of the value's type is ignored.
+static bool draw_number_editor(Value *value)
+{
+    char text[64];
+    ImGuiInputTextFlags flags;
+    if (tIS_INT(value->typedesc))
+    {
+        snprintf(text, sizeof(text), "%lli", (long long)value->s64_val);
+        flags = ImGuiInputTextFlags_CharsDecimal;
+    }
+    else
+    {
+        numbers::format_float(text, sizeof(text), value->f64_val);
+        flags = ImGuiInputTextFlags_CharsNoBlank;
+    }
+
+    if (!ImGui::InputText("##field_value", text, sizeof(text), flags))
+    {
+        return false;
+    }
+
+    size_t length = strlen(text);
+    ParsedNumber number;
+    if (numbers::parse(&number, text, length) != length || number.kind == NumberKind::OutOfRange)
+    {
+        return false;
+    }
 
-void draw_value_editor(ProgramState *prgstate, Value *value, const char *label)
+    if (tIS_INT(value->typedesc) && number.kind == NumberKind::Int)
+    {
+        value->s64_val = number.int_val;
+        return true;
+    }
+    else if (tIS_FLOAT(value->typedesc))
+    {
+        value->f64_val = number.kind == NumberKind::Int ? (f64)number.int_val : number.float_val;
+        return true;
+    }
+    return false;
+}
+
+
+// Leaf values that can't change, ImGui has no read-only widgets
+static void draw_value_text(Value *value)
 {
     switch ((TypeID::Tag)(value->typedesc->type_id))
     {
-        case TypeID::None:
-            ImGui::Text("%s NONE", label);
-            break;
-
         case TypeID::String:
-            ImGui_InputText("##field_value", &value->str_val);
+            ImGui::Text("%s", str_data(value->str_val));
             break;
 
         case TypeID::Int:
-            ImGui::InputInt("##field_value", &value->s32_val);
+            ImGui::Text("%lli", (long long)value->s64_val);
             break;
 
         case TypeID::Float:
-            ImGui::InputFloat("##field_value", &value->f32_val);
+        {
+            char text[64];
+            numbers::format_float(text, sizeof(text), value->f64_val);
+            ImGui::Text("%s", text);
+            break;
+        }
+
+        case TypeID::Bool:
+            ImGui::Text("%s", value->bool_val ? "true" : "false");
+            break;
+
+        default:
+            ASSERT_MSG("not a leaf value");
+            break;
+    }
+}
+
+
+static int array_depth = 0;
+
+bool draw_value_editor(ProgramState *prgstate, Value *value, const char *label)
+{
+    // Containers clear their cached hash when something in them changed
+    bool changed = false;
+    switch ((TypeID::Tag)(value->typedesc->type_id))
+    {
+        case TypeID::None:
+            ImGui::Text("%s NONE", label);
             break;
 
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
         case TypeID::Bool:
-            ImGui::Checkbox("##field_value", &value->bool_val);
+            if (editor_read_only)
+            {
+                draw_value_text(value);
+            }
+            else if (tIS_STRING(value->typedesc))
+            {
+                changed = ImGui_InputText("##field_value", &value->str_val);
+            }
+            else if (tIS_BOOL(value->typedesc))
+            {
+                changed = ImGui::Checkbox("##field_value", &value->bool_val);
+            }
+            else
+            {
+                changed = draw_number_editor(value);
+            }
             break;
 
         case TypeID::Array:
             if (array_depth == 0)
             {
                 ++array_depth;
-                draw_array_table_editor(prgstate, value, label);
+                changed = draw_array_table_editor(prgstate, value, label);
                 --array_depth;
             }
             else
             {
                 ++array_depth;
-                draw_array_list_editor(prgstate, value, label);
+                changed = draw_array_list_editor(prgstate, value, label);
                 --array_depth;
             }
             break;
 
         case TypeID::Compound:
             // ImGui::Text("TODO: Compound tree");
-            draw_compound_value_editor(prgstate, value);//, label);
+            changed = draw_compound_value_editor(prgstate, value);//, label);
             break;
 
         case TypeID::Union:
             ASSERT_MSG("can't render a union");
             break;
     }
+    return changed;
 }
 
 
 bool draw_window_value_editor(ProgramState *prgstate, Collection *collection)
 {
+    PROF_FUNCTION();
+
     ImGuiWindowFlags wndflags = 0
         | ImGuiWindowFlags_NoSavedSettings
         // | ImGuiWindowFlags_NoMove
@@ -719,9 +849,13 @@ bool draw_window_value_editor(ProgramState *prgstate, Collection *collection)
     ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiSetCond_Once);
     ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0);
     bool window_open = true;
-    ImGui::Begin(collection->load_path.data, &window_open, wndflags);
+    ImGui::Begin(str_data(collection->load_path), &window_open, wndflags);
 
+    editor_collection = collection;
+    editor_read_only = collection->read_only;
     draw_value_editor(prgstate, &collection->value, nullptr);
+    editor_collection = nullptr;
+    editor_read_only = false;
 
     ImGui::Columns(1);
     // ImGui::Separator();
@@ -733,70 +867,414 @@ bool draw_window_value_editor(ProgramState *prgstate, Collection *collection)
 }
 
 
-bool draw_typelist_window(ProgramState *prgstate)
+// The member path down from the collection, e.g. "path/to/dir.costumes"
+static void format_flat_view_path(char *buffer, size_t buffer_size, FlatView *view)
 {
-    ImGuiWindowFlags wndflags = 0
-        | ImGuiWindowFlags_NoSavedSettings
-        // | ImGuiWindowFlags_NoMove
-        // | ImGuiWindowFlags_NoResize
-        ;
+    if (view->parent_view)
+    {
+        format_flat_view_path(buffer, buffer_size, view->parent_view);
+    }
+    else
+    {
+        snprintf(buffer, buffer_size, "%s", str_data(view->collection->load_path));
+    }
 
-    ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiSetCond_Once);
-    bool window_open = true;
+    size_t length = strlen(buffer);
+    StrSlice member = nameref::str_slice(view->member);
+    snprintf(buffer + length, buffer_size - length, ".%.*s", (int)member.length, member.data);
+}
 
-    if (! ImGui::Begin("Type Descriptors", &window_open, wndflags))
+
+// Arrays open another view, compounds would need rows of their own so
+// they only show their size
+static bool draw_flat_view_cell(ProgramState *prgstate, FlatView *view, Value *value, NameRef member,
+                                const char *label)
+{
+    if (vIS_ARRAY(value))
     {
-        goto EndWindow;
+        draw_flat_view_button(prgstate, view, value, member);
+        return false;
+    }
+    if (vIS_COMPOUND(value))
+    {
+        ImGui::Text("{%u members}", value->compound_value.members.count);
+        return false;
     }
+    return draw_value_editor(prgstate, value, label);
+}
 
-    ImGui::Text("There are %i type descriptors loaded", prgstate->type_descriptors.count);
 
-    if (ImGui::BeginChild("Here they are..."))
-    {
-        FormatBuffer fmtbuf;
-        for (BucketItemCount i = 0, ei = prgstate->type_descriptors.capacity; i < ei; ++i)
-        {
-            TypeDescriptor *typedesc;
-            if (! bucketarray::get_if_not_empty(&typedesc, &prgstate->type_descriptors, i))
-                continue;
+/*
+Rows are looked up as they're drawn, through a clipper, so only the
+visible ones are ever touched. The first column is the parent's name or
+id member, or its row, the second is the index in its array.
+*/
+bool draw_window_flat_view(ProgramState *prgstate, FlatView *view)
+{
+    PROF_FUNCTION();
 
-            DynArray<NameRef> *names = find_names_of_typedesc(prgstate, typedesc);
+    char path[200];
+    format_flat_view_path(path, sizeof(path), view);
+    // ### keeps the window the same when the title is cut short
+    char title[256];
+    snprintf(title, sizeof(title), "%s###flat_view_%p", path, (void *)view);
 
-            fmtbuf.clear();
-            fmtbuf.write('[');
-            if (names)
-            {
-                for (DynArrayCount j = 0, ej = names->count; j < ej; ++j)
-                {
-                    StrSlice name = nameref::str_slice((*names)[j]);
-                    if (j > 0)
-                    {
-                        fmtbuf.write(", ");
-                    }
-                    fmtbuf.write(name.data);
+    ImGui::SetNextWindowSize(ImVec2(500, 400), ImGuiSetCond_Once);
+    ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0);
+    bool window_open = true;
+    ImGui::Begin(title, &window_open, ImGuiWindowFlags_NoSavedSettings);
+
+    // Reads each parent's array length once, after that it's cached
+    u32 row_count = flatview::row_count(view);
+    ImGui::Text("%u rows from %u parents", row_count, view->row_starts.count);
+
+    s32 column_count = S32(2 + view->columns.count + (view->has_plain_elements ? 1 : 0));
+    ImGui::Columns(column_count, "flat_view_headers");
+    ImGui::Separator();
+    ImGui::Text("parent");
+    ImGui::NextColumn();
+    ImGui::Text("#");
+    ImGui::NextColumn();
+    for (DynArrayCount i = 0; i < view->columns.count; ++i)
+    {
+        ImGui::Text("%s", nameref::str_slice(view->columns[i]).data);
+        ImGui::NextColumn();
+    }
+    if (view->has_plain_elements)
+    {
+        ImGui::Text("value");
+        ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    ImGui::Columns(1);
+
+    editor_collection = view->collection;
+    editor_read_only = view->collection->read_only;
+
+    ImGui::BeginChild("flat_view_rows");
+    ImGui::Columns(column_count, "flat_view_rows");
+
+    ImGuiListClipper clipper(S32(row_count), ImGui::GetItemsLineHeightWithSpacing());
+    while (clipper.Step())
+    {
+        for (s32 i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+            FlatRow row;
+            bool found = flatview::locate(&row, view, (u32)i);
+            ASSERT(found);
+
+            ImGui::PushID(i);
+
+            const char *parent_label = record_label(prgstate, flatview::parent_record(view, row.parent));
+            if (parent_label)
+            {
+                ImGui::Text("%s", parent_label);
+            }
+            else
+            {
+                ImGui::Text("[%u]", row.parent);
+            }
+            ImGui::NextColumn();
+
+            ImGui::Text("%u", row.index);
+            ImGui::NextColumn();
+
+            Value *elem = flatview::element(view, row);
+            const char *label = parent_label ? parent_label : "";
+            bool changed = false;
+            for (DynArrayCount j = 0; j < view->columns.count; ++j)
+            {
+                ImGui::PushID(S32(j));
+                CompoundValueMember *memval = vIS_COMPOUND(elem) ? find_member(elem, view->columns[j]) : nullptr;
+                if (!memval)
+                {
+                    ImGui::Text("NOPE");
+                }
+                else
+                {
+                    changed |= draw_flat_view_cell(prgstate, view, &memval->value, view->columns[j], label);
                 }
+                ImGui::PopID();
+                ImGui::NextColumn();
             }
-            fmtbuf.write(']');
 
-            ImGui::PushID(S32(i));
+            if (view->has_plain_elements)
+            {
+                if (vIS_COMPOUND(elem))
+                {
+                    ImGui::Text("NOPE");
+                }
+                else if (vIS_ARRAY(elem))
+                {
+                    ImGui::Text("%u elements", elem->array_value.elements.count);
+                }
+                else
+                {
+                    changed |= draw_value_editor(prgstate, elem, label);
+                }
+                ImGui::NextColumn();
+            }
+
+            if (changed)
+            {
+                flatview::element_changed(view, row);
+            }
+
+            ImGui::PopID();
+        }
+    }
+
+    ImGui::Columns(1);
+    ImGui::EndChild();
 
-            bool tree_open = ImGui::TreeNode("##typedesc_list_entry", "%-8s @ %p, %s",
-                                             TypeID::to_string(typedesc->type_id), typedesc, fmtbuf.buffer);
+    editor_collection = nullptr;
+    editor_read_only = false;
+
+    ImGui::End();
+    ImGui::PopStyleVar();
 
-            if (tree_open)
+    return window_open;
+}
+
+
+/*
+The type list is rebuilt only when prgstate->types_generation moves.
+Labels are formatted once per rebuild. Pretty-printed text is made the
+first time an entry is opened. Each row (an entry's header or one line
+of its pretty text) is the same height, so the list goes through a
+clipper and only visible rows are drawn.
+*/
+struct TypeListEntry
+{
+    TypeDescriptor *typedesc;
+    Str label;
+    bool open;
+
+    bool pretty_valid;
+    Str pretty;
+    DynArray<u32> pretty_line_starts;
+};
+
+
+struct TypeListRow
+{
+    DynArrayCount entry;
+    // -1 for the entry's header, otherwise a line of its pretty text
+    s32 line;
+};
+
+
+struct TypeListCache
+{
+    bool built;
+    u64 types_generation;
+    DynArray<TypeListEntry> entries;
+    DynArray<TypeListRow> rows;
+};
+
+
+void typelist_entry_free(TypeListEntry *entry)
+{
+    str_free(&entry->label);
+    str_free(&entry->pretty);
+    if (entry->pretty_line_starts.data)
+    {
+        dynarray::deinit(&entry->pretty_line_starts);
+    }
+}
+
+
+void typelist_entry_ensure_pretty(TypeListEntry *entry)
+{
+    if (entry->pretty_valid)
+    {
+        return;
+    }
+
+    FormatBuffer fmtbuf;
+    pretty_print(entry->typedesc, &fmtbuf);
+    entry->pretty = str(fmtbuf.buffer, STRLEN(fmtbuf.cursor));
+
+    // drop trailing newlines so there's no blank row at the end
+    while (str_length(entry->pretty) > 0 && str_data(entry->pretty)[str_length(entry->pretty) - 1] == '\n')
+    {
+        str_popchar(&entry->pretty);
+    }
+
+    dynarray::init(&entry->pretty_line_starts, 8);
+    dynarray::append(&entry->pretty_line_starts, 0u);
+    const char *text = str_data(entry->pretty);
+    for (StrLen i = 0, e = str_length(entry->pretty); i < e; ++i)
+    {
+        if (text[i] == '\n')
+        {
+            dynarray::append(&entry->pretty_line_starts, u32(i + 1));
+        }
+    }
+
+    entry->pretty_valid = true;
+}
+
+
+StrSlice typelist_entry_pretty_line(const TypeListEntry *entry, s32 line)
+{
+    DynArrayCount idx = DYNARRAY_COUNT(line);
+    u32 begin = entry->pretty_line_starts[idx];
+    u32 end = idx + 1 < entry->pretty_line_starts.count
+        ? entry->pretty_line_starts[idx + 1] - 1
+        : str_length(entry->pretty);
+    return str_slice(str_data(entry->pretty) + begin, end - begin);
+}
+
+
+void typelist_rebuild_rows(TypeListCache *cache)
+{
+    dynarray::clear(&cache->rows);
+    for (DynArrayCount i = 0; i < cache->entries.count; ++i)
+    {
+        TypeListEntry *entry = &cache->entries[i];
+        TypeListRow header = {i, -1};
+        dynarray::append(&cache->rows, header);
+
+        if (entry->open)
+        {
+            typelist_entry_ensure_pretty(entry);
+            for (DynArrayCount j = 0; j < entry->pretty_line_starts.count; ++j)
             {
-                fmtbuf.clear();
-                pretty_print(typedesc, &fmtbuf);
+                TypeListRow line_row = {i, S32(j)};
+                dynarray::append(&cache->rows, line_row);
+            }
+        }
+    }
+}
 
-                ImGui::TreeNodeEx("##typedesc_pprint",
-                                  ImGuiTreeNodeFlags_Leaf|ImGuiTreeNodeFlags_NoTreePushOnOpen,
-                                  "%s", fmtbuf.buffer);
 
-                ImGui::TreePop();
+void typelist_rebuild(TypeListCache *cache, ProgramState *prgstate)
+{
+    if (!cache->built)
+    {
+        dynarray::init(&cache->entries, 64);
+        dynarray::init(&cache->rows, 64);
+        cache->built = true;
+    }
+
+    // Keep open state across rebuilds, types don't move in their BucketArray
+    DynArray<TypeDescriptor *> was_open = dynarray::init<TypeDescriptor *>(0);
+    for (DynArrayCount i = 0; i < cache->entries.count; ++i)
+    {
+        if (cache->entries[i].open)
+        {
+            dynarray::append(&was_open, cache->entries[i].typedesc);
+        }
+        typelist_entry_free(&cache->entries[i]);
+    }
+    dynarray::clear(&cache->entries);
+
+    FormatBuffer fmtbuf;
+    for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(&prgstate->type_descriptors);
+         bucketarray::next(&it);)
+    {
+        TypeDescriptor *typedesc = it.elem;
+        DynArray<NameRef> *names = find_names_of_typedesc(prgstate, typedesc);
+
+        fmtbuf.clear();
+        fmtbuf.writef("%-8s @ %p, [", TypeID::to_string(typedesc->type_id), (void *)typedesc);
+        if (names)
+        {
+            for (DynArrayCount j = 0, ej = names->count; j < ej; ++j)
+            {
+                StrSlice name = nameref::str_slice((*names)[j]);
+                if (j > 0)
+                {
+                    fmtbuf.write(", ");
+                }
+                fmtbuf.write(name.data, name.length);
             }
-            ImGui::PopID();
         }
+        fmtbuf.write(']');
+
+        TypeListEntry *entry = dynarray::append(&cache->entries);
+        mem::zero_ptr(entry);
+        entry->typedesc = typedesc;
+        entry->label = str(fmtbuf.buffer, STRLEN(fmtbuf.cursor));
+        entry->open = dynarray::find(&was_open, typedesc) != nullptr;
+    }
+
+    dynarray::deinit(&was_open);
+
+    typelist_rebuild_rows(cache);
+    cache->types_generation = prgstate->types_generation;
+}
+
+
+bool draw_typelist_window(ProgramState *prgstate)
+{
+    PROF_FUNCTION();
+
+    static TypeListCache cache = {};
+
+    ImGuiWindowFlags wndflags = 0
+        | ImGuiWindowFlags_NoSavedSettings
+        // | ImGuiWindowFlags_NoMove
+        // | ImGuiWindowFlags_NoResize
+        ;
+
+    ImGui::SetNextWindowSize(ImVec2(400, 400), ImGuiSetCond_Once);
+    bool window_open = true;
+
+    if (! ImGui::Begin("Type Descriptors", &window_open, wndflags))
+    {
+        goto EndWindow;
+    }
 
+    if (!cache.built || cache.types_generation != prgstate->types_generation)
+    {
+        typelist_rebuild(&cache, prgstate);
+    }
+
+    ImGui::Text("There are %i type descriptors loaded", prgstate->type_descriptors.count);
+
+    if (ImGui::BeginChild("Here they are..."))
+    {
+        bool rows_dirty = false;
+
+        ImGuiListClipper clipper(S32(cache.rows.count), ImGui::GetTextLineHeightWithSpacing());
+        while (clipper.Step())
+        {
+            for (s32 i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+            {
+                TypeListRow row = cache.rows[DYNARRAY_COUNT(i)];
+                TypeListEntry *entry = &cache.entries[row.entry];
+
+                if (row.line < 0)
+                {
+                    ImGui::PushID(S32(row.entry));
+                    ImGui::SetNextTreeNodeOpen(entry->open);
+                    bool tree_open = ImGui::TreeNodeEx("##typedesc_list_entry",
+                                                       ImGuiTreeNodeFlags_NoTreePushOnOpen,
+                                                       "%s", str_data(entry->label));
+                    ImGui::PopID();
+
+                    if (tree_open != entry->open)
+                    {
+                        entry->open = tree_open;
+                        rows_dirty = true;
+                    }
+                }
+                else
+                {
+                    StrSlice line = typelist_entry_pretty_line(entry, row.line);
+                    ImGui::Indent();
+                    ImGui::TextUnformatted(line.data, line.data + line.length);
+                    ImGui::Unindent();
+                }
+            }
+        }
+
+        if (rows_dirty)
+        {
+            typelist_rebuild_rows(&cache);
+        }
     }
     ImGui::EndChild();
 
@@ -807,6 +1285,361 @@ EndWindow:
 }
 
 
+#define PROFILER_FRAME_HISTORY 120
+#define PROFILER_COMMAND_HISTORY 32
+
+
+struct ProfilerZoneTotal
+{
+    const char *name;
+    u16 depth;
+    u32 calls;
+    double total_ms;
+};
+
+
+struct ProfilerCommandTiming
+{
+    const char *name;
+    double ms;
+};
+
+
+/*
+Reads this thread's new profiler events once per frame and keeps just
+what the window shows: a history of frame times, the zones of the last
+finished frame, and the last few commands.
+*/
+struct ProfilerView
+{
+    u64 last_seen_end;
+    DynArray<ProfEvent> new_events;
+
+    float frame_ms[PROFILER_FRAME_HISTORY];
+    u32 frame_cursor;
+    u32 frame_count;
+
+    double last_frame_ms;
+    DynArray<ProfilerZoneTotal> last_frame_zones;
+
+    ProfilerCommandTiming commands[PROFILER_COMMAND_HISTORY];
+    u32 command_cursor;
+    u32 command_count;
+};
+
+
+struct ProfEventBeginLess
+{
+    bool operator()(const ProfEvent &a, const ProfEvent &b) const
+    {
+        return a.begin < b.begin;
+    }
+};
+
+
+void profiler_view_update(ProfilerView *view)
+{
+    dynarray::clear(&view->new_events);
+    profiler::copy_thread_events(&view->new_events, profiler::current_thread_index(), view->last_seen_end);
+
+    const ProfEvent *last_frame = nullptr;
+    for (DynArrayCount i = 0; i < view->new_events.count; ++i)
+    {
+        const ProfEvent *event = &view->new_events[i];
+        view->last_seen_end = max(view->last_seen_end, event->end);
+
+        if (event->category == ProfCategory::Frame)
+        {
+            view->frame_ms[view->frame_cursor] = (float)milliseconds_since(event->end, event->begin);
+            view->frame_cursor = (view->frame_cursor + 1) % PROFILER_FRAME_HISTORY;
+            view->frame_count = min(view->frame_count + 1, (u32)PROFILER_FRAME_HISTORY);
+            last_frame = event;
+        }
+        else if (event->category == ProfCategory::Command)
+        {
+            ProfilerCommandTiming timing = {event->name, milliseconds_since(event->end, event->begin)};
+            view->commands[view->command_cursor] = timing;
+            view->command_cursor = (view->command_cursor + 1) % PROFILER_COMMAND_HISTORY;
+            view->command_count = min(view->command_count + 1, (u32)PROFILER_COMMAND_HISTORY);
+        }
+    }
+
+    if (!last_frame)
+    {
+        return;
+    }
+
+    // Zones inside the frame, merged by name and depth, in the order they started
+    view->last_frame_ms = milliseconds_since(last_frame->end, last_frame->begin);
+    dynarray::clear(&view->last_frame_zones);
+    dynarray::sort_unstable(&view->new_events, ProfEventBeginLess());
+
+    for (DynArrayCount i = 0; i < view->new_events.count; ++i)
+    {
+        const ProfEvent *event = &view->new_events[i];
+        if (event->category == ProfCategory::Frame
+            || event->begin < last_frame->begin || event->end > last_frame->end)
+        {
+            continue;
+        }
+
+        ProfilerZoneTotal *total = nullptr;
+        for (DynArrayCount j = 0; j < view->last_frame_zones.count; ++j)
+        {
+            ProfilerZoneTotal *candidate = &view->last_frame_zones[j];
+            if (candidate->depth == event->depth && 0 == std::strcmp(candidate->name, event->name))
+            {
+                total = candidate;
+                break;
+            }
+        }
+
+        if (!total)
+        {
+            ProfilerZoneTotal new_total = {event->name, event->depth, 0, 0.0};
+            total = dynarray::append(&view->last_frame_zones, new_total);
+        }
+
+        ++total->calls;
+        total->total_ms += milliseconds_since(event->end, event->begin);
+    }
+}
+
+
+bool draw_profiler_window(ProfilerView *view)
+{
+    profiler_view_update(view);
+
+    ImGui::SetNextWindowSize(ImVec2(420, 400), ImGuiSetCond_Once);
+    bool window_open = true;
+
+    if (! ImGui::Begin("Profiler", &window_open, ImGuiWindowFlags_NoSavedSettings))
+    {
+        ImGui::End();
+        return window_open;
+    }
+
+    float max_ms = 0;
+    float sum_ms = 0;
+    for (u32 i = 0; i < view->frame_count; ++i)
+    {
+        max_ms = max(max_ms, view->frame_ms[i]);
+        sum_ms += view->frame_ms[i];
+    }
+    float avg_ms = view->frame_count ? sum_ms / (float)view->frame_count : 0;
+
+    ImGui::Text("Last frame %.2f ms, avg %.2f ms, max %.2f ms", view->last_frame_ms, (double)avg_ms, (double)max_ms);
+    // oldest sample is at the cursor once the history is full
+    ImGui::PlotLines("##frame_ms", view->frame_ms, S32(view->frame_count),
+                     view->frame_count == PROFILER_FRAME_HISTORY ? S32(view->frame_cursor) : 0,
+                     nullptr, 0.0f, max(max_ms, 16.7f), ImVec2(0, 60));
+
+    if (ImGui::CollapsingHeader("Last frame", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        ImGui::Columns(3, "##zones");
+        ImGui::Text("zone");     ImGui::NextColumn();
+        ImGui::Text("calls");    ImGui::NextColumn();
+        ImGui::Text("total ms"); ImGui::NextColumn();
+        ImGui::Separator();
+        for (DynArrayCount i = 0; i < view->last_frame_zones.count; ++i)
+        {
+            const ProfilerZoneTotal *total = &view->last_frame_zones[i];
+            ImGui::Text("%*s%s", (int)total->depth * 2, "", total->name); ImGui::NextColumn();
+            ImGui::Text("%u", total->calls);                               ImGui::NextColumn();
+            ImGui::Text("%.3f", total->total_ms);                          ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
+    if (ImGui::CollapsingHeader("Commands", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        // newest first
+        for (u32 i = 0; i < view->command_count; ++i)
+        {
+            u32 index = (view->command_cursor + PROFILER_COMMAND_HISTORY - 1 - i) % PROFILER_COMMAND_HISTORY;
+            ImGui::Text("%10.3f ms  %s", view->commands[index].ms, view->commands[index].name);
+        }
+    }
+
+    ImGui::Text("profdump \"<file>\" writes a Chrome trace of everything recorded");
+
+    ImGui::End();
+    return window_open;
+}
+
+
+/*
+Live allocations grouped by call site or category. The snapshot is
+retaken a few times a second while the window is drawn, and the
+"change" columns are against prgstate->alloc_baseline, the same one
+memsnap sets.
+*/
+#define ALLOCATIONS_REFRESH_MS 250.0
+
+struct AllocationsView
+{
+    AllocSnapshot current;
+    DynArray<AllocStatsRow> rows;
+    int group;
+    int rows_group;
+    u64 baseline_abstime;
+    s32 selected;
+};
+
+
+bool draw_allocations_window(ProgramState *prgstate, AllocationsView *view)
+{
+    ImGui::SetNextWindowSize(ImVec2(720, 480), ImGuiSetCond_Once);
+    bool window_open = true;
+
+    if (! ImGui::Begin("Allocations", &window_open, ImGuiWindowFlags_NoSavedSettings))
+    {
+        ImGui::End();
+        return window_open;
+    }
+
+    if (!view->rows.allocator)
+    {
+        dynarray::init(&view->rows, 64);
+        view->selected = -1;
+    }
+
+    bool refresh = !allocstats::has_snapshot(&view->current)
+        || milliseconds_since(view->current.abstime) > ALLOCATIONS_REFRESH_MS
+        || view->group != view->rows_group
+        || view->baseline_abstime != prgstate->alloc_baseline.abstime;
+
+    if (ImGui::Button("Snapshot"))
+    {
+        allocstats::take_snapshot(&prgstate->alloc_baseline);
+        refresh = true;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear snapshot"))
+    {
+        allocstats::free_snapshot(&prgstate->alloc_baseline);
+        refresh = true;
+    }
+    ImGui::SameLine();
+    ImGui::RadioButton("By call site", &view->group, AllocGroup::Site);
+    ImGui::SameLine();
+    ImGui::RadioButton("By category", &view->group, AllocGroup::Category);
+
+    if (refresh)
+    {
+        allocstats::take_snapshot(&view->current);
+        allocstats::build_rows(&view->rows, &view->current, &prgstate->alloc_baseline,
+                               (AllocGroup::Tag)view->group);
+        if (view->group != view->rows_group || view->selected >= S32(view->rows.count))
+        {
+            view->selected = -1;
+        }
+        view->rows_group = view->group;
+        view->baseline_abstime = prgstate->alloc_baseline.abstime;
+    }
+
+    bool have_baseline = allocstats::has_snapshot(&prgstate->alloc_baseline);
+    const mem::AllocatorStats *totals = &view->current.totals;
+    char live[32];
+    char peak[32];
+    allocstats::format_bytes(live, sizeof(live), (s64)totals->bytes_allocated);
+    allocstats::format_bytes(peak, sizeof(peak), (s64)totals->peak_bytes_allocated);
+    ImGui::Text("%s live in %llu blocks, peak %s", live, (unsigned long long)totals->live_allocations, peak);
+    if (have_baseline)
+    {
+        char delta[32];
+        allocstats::format_bytes(delta, sizeof(delta),
+                                 (s64)totals->bytes_allocated - (s64)prgstate->alloc_baseline.totals.bytes_allocated,
+                                 true);
+        ImGui::SameLine();
+        ImGui::Text("  %s since the snapshot %.1fs ago", delta,
+                    seconds_since(view->current.abstime, prgstate->alloc_baseline.abstime));
+    }
+
+    // The selected row's live blocks by size
+    if (view->selected >= 0)
+    {
+        const AllocStatsRow *row = &view->rows[DYNARRAY_COUNT(view->selected)];
+        float histogram[ALLOC_HISTOGRAM_BUCKETS];
+        for (size_t b = 0; b < ALLOC_HISTOGRAM_BUCKETS; ++b)
+        {
+            histogram[b] = (float)row->size_histogram[b];
+        }
+        ImGui::PlotHistogram("##sizes", histogram, ALLOC_HISTOGRAM_BUCKETS, 0,
+                             "live blocks by size, 16 B to 256 KB and up", 0.0f, FLT_MAX, ImVec2(0, 60));
+    }
+
+    ImGui::Separator();
+    ImGui::Columns(6, "##allocations");
+    ImGui::Text("live");                                ImGui::NextColumn();
+    ImGui::Text("blocks");                              ImGui::NextColumn();
+    ImGui::Text("%s", have_baseline ? "change" : "");   ImGui::NextColumn();
+    ImGui::Text("allocs");                              ImGui::NextColumn();
+    ImGui::Text("%s", have_baseline ? "allocs/s" : ""); ImGui::NextColumn();
+    ImGui::Text("%s", view->group == AllocGroup::Site ? "call site" : "category");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    ImGui::Columns(1);
+
+    ImGui::BeginChild("##allocation_rows");
+    ImGui::Columns(6, "##allocations");
+
+    ImGuiListClipper clipper(S32(view->rows.count), ImGui::GetTextLineHeightWithSpacing());
+    while (clipper.Step())
+    {
+        for (s32 i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+            const AllocStatsRow *row = &view->rows[DYNARRAY_COUNT(i)];
+            char bytes_text[32];
+            allocstats::format_bytes(bytes_text, sizeof(bytes_text), (s64)row->live_bytes);
+
+            ImGui::PushID(i);
+            if (ImGui::Selectable(bytes_text, view->selected == i, ImGuiSelectableFlags_SpanAllColumns))
+            {
+                view->selected = view->selected == i ? -1 : i;
+            }
+            ImGui::PopID();
+            ImGui::NextColumn();
+
+            ImGui::Text("%llu", (unsigned long long)row->live_count);
+            ImGui::NextColumn();
+
+            if (have_baseline)
+            {
+                allocstats::format_bytes(bytes_text, sizeof(bytes_text), row->delta_bytes, true);
+                ImGui::Text("%s", bytes_text);
+            }
+            ImGui::NextColumn();
+
+            ImGui::Text("%llu", (unsigned long long)row->allocations);
+            ImGui::NextColumn();
+
+            if (have_baseline)
+            {
+                ImGui::Text("%.0f", row->allocs_per_sec);
+            }
+            ImGui::NextColumn();
+
+            if (row->sourceline)
+            {
+                ImGui::Text("%s [%s]", row->sourceline, allocstats::category_label(row->category));
+            }
+            else
+            {
+                ImGui::Text("%s", allocstats::category_label(row->category));
+            }
+            ImGui::NextColumn();
+        }
+    }
+
+    ImGui::Columns(1);
+    ImGui::EndChild();
+
+    ImGui::End();
+    return window_open;
+}
+
+
 void log_display_info()
 {
     int num_displays = SDL_GetNumVideoDisplays();
@@ -822,15 +1655,180 @@ void log_display_info()
 }
 
 
-s32 run_nametable_tests();
+/*
+Frames are only drawn when something could have changed on screen:
+input arrived, the log or the program's types moved to a new generation,
+the mouse is held (dragging), or a text field's caret needs to blink.
+Otherwise the loop sleeps in SDL_WaitEventTimeout.
+*/
+
+// ImGui needs a couple of frames after input to settle hover/active state
+#define FRAMES_AFTER_INPUT 3
+#define MIN_FRAME_MS 16
+// how often to wake and check generations with no input at all
+#define IDLE_WAKE_MS 250
+// ImGui's caret blinks on a 1.2s cycle, 0.8s on and 0.4s off
+#define CARET_BLINK_WAKE_MS 400
+
+struct FramePacer
+{
+    s32 frames_pending;
+    u64 last_log_generation;
+    u64 last_types_generation;
+    u32 last_frame_ticks;
+};
+
+
+void frame_pacer_request(FramePacer *pacer, s32 frame_count)
+{
+    pacer->frames_pending = max(pacer->frames_pending, frame_count);
+}
+
+
+// Folds in anything that changes the picture without an SDL event
+void frame_pacer_check_damage(FramePacer *pacer, ProgramState *prgstate)
+{
+    u64 log_generation = log_view_generation();
+    if (log_generation != pacer->last_log_generation)
+    {
+        pacer->last_log_generation = log_generation;
+        // one to show it, one more for the scroll-to-bottom to land
+        frame_pacer_request(pacer, 2);
+    }
+
+    if (prgstate->types_generation != pacer->last_types_generation)
+    {
+        pacer->last_types_generation = prgstate->types_generation;
+        frame_pacer_request(pacer, 1);
+    }
+
+    ImGuiIO &io = ImGui::GetIO();
+    for (s32 i = 0; i < S32(COUNTOF(io.MouseDown)); ++i)
+    {
+        if (io.MouseDown[i])
+        {
+            frame_pacer_request(pacer, 1);
+        }
+    }
+}
+
+
+// Milliseconds to wait for an event before the next check, 0 to not wait
+u32 frame_pacer_wait_ms(FramePacer *pacer)
+{
+    if (pacer->frames_pending > 0)
+    {
+        return 0;
+    }
+
+    return ImGui::GetIO().WantTextInput ? CARET_BLINK_WAKE_MS : IDLE_WAKE_MS;
+}
+
+
+// Keeps drawing from outrunning MIN_FRAME_MS when vsync isn't available
+void frame_pacer_begin_frame(FramePacer *pacer)
+{
+    u32 now = SDL_GetTicks();
+    u32 elapsed = now - pacer->last_frame_ticks;
+    if (elapsed < MIN_FRAME_MS)
+    {
+        SDL_Delay(MIN_FRAME_MS - elapsed);
+        now = SDL_GetTicks();
+    }
+    pacer->last_frame_ticks = now;
+
+    if (pacer->frames_pending > 0)
+    {
+        --pacer->frames_pending;
+    }
+}
+
+
+// Pinned along the bottom while any job is running
+void draw_jobs_status_bar(ProgramState *prgstate, SDL_Window *window)
+{
+    if (prgstate->jobs.count == 0)
+    {
+        return;
+    }
+
+    ImVec2 window_size = ImGui_SDLWindowSize(window);
+    float height = ImGui::GetItemsLineHeightWithSpacing() * (float)prgstate->jobs.count
+        + ImGui::GetStyle().WindowPadding.y * 2;
+    ImGui::SetNextWindowPos(ImVec2(0, window_size.y - height));
+    ImGui::SetNextWindowSize(ImVec2(window_size.x, height));
+
+    ImGuiWindowFlags flags = 0
+        | ImGuiWindowFlags_NoTitleBar
+        | ImGuiWindowFlags_NoResize
+        | ImGuiWindowFlags_NoMove
+        | ImGuiWindowFlags_NoScrollbar
+        | ImGuiWindowFlags_NoSavedSettings
+        ;
+    ImGui::Begin("##jobs-status", nullptr, flags);
+
+    char status[256];
+    for (DynArrayCount i = 0; i < prgstate->jobs.count; ++i)
+    {
+        Job *job = prgstate->jobs[i];
+        ImGui::PushID((int)job->id);
+        if (ImGui::SmallButton("Cancel"))
+        {
+            jobs::cancel(job);
+        }
+        ImGui::SameLine();
+        jobs::format_status(status, sizeof(status), job);
+        ImGui::TextUnformatted(status);
+        ImGui::PopID();
+    }
+
+    ImGui::End();
+}
+
+
+// Publishing gets this much of each frame while jobs are finishing
+#define JOBS_PUBLISH_BUDGET_MS 4.0
+
+s32 run_tests();
+
+
+static void print_usage(const char *program)
+{
+    printf_ln("usage: %s [options] [directory...]\n"
+              "  Each directory's json files are loaded in the background as a collection\n"
+              "      --test           run the self tests and exit\n"
+              "  -h, --help           show this message",
+              program);
+}
+
 
 int main(int argc, char **argv)
 {
+    u64 start_time = query_abstime();
+
     mem::memory_init(logf_with_userdata, nullptr);
     FormatBuffer::set_default_flush_fn(log_write_with_userdata, nullptr);
 
-    s32 fails = run_nametable_tests();
-    ASSERT(fails == 0);
+    // Anything that isn't an option is a directory to load
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (0 == std::strcmp(arg, "-h") || 0 == std::strcmp(arg, "--help"))
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (0 == std::strcmp(arg, "--test"))
+        {
+            return run_tests() == 0 ? 0 : 1;
+        }
+        else if (arg[0] == '-')
+        {
+            printf_ln("Unknown option '%s'", arg);
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
 
     ProgramState prgstate;
     prgstate_init(&prgstate);
@@ -838,9 +1836,14 @@ int main(int argc, char **argv)
     load_base_type_descriptors(&prgstate);
     init_cli_commands(&prgstate);
 
+    // Loads run as jobs while SDL makes the window and GL context
+    prgstate.async_commands = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        start_loadjson_job(&prgstate, str_slice(argv[i]), true);
+    }
+
     // mem::default_allocator()->log_allocations();
-    UNUSED(argc);
-    UNUSED(argv);
     // test_json_import(&prgstate, argc - 1, argv + 1);
 
     // TTY console
@@ -849,6 +1852,7 @@ int main(int argc, char **argv)
     if (0 != SDL_Init(SDL_INIT_VIDEO))
     {
         logf_ln("Failed to initialize SDL: %s", SDL_GetError());
+        jobs::cancel_all(&prgstate);
         end_of_program();
         return 1;
     }
@@ -871,26 +1875,45 @@ int main(int argc, char **argv)
 
     u32 window_id = SDL_GetWindowID(window);
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
+    SDL_GL_SetSwapInterval(1);
 
     ImVec4 clear_color = ImColor(114, 144, 154);
     ImGui_ImplSdl_Init(window);
-
-
-    /////////// TESTING ///////////
-    process_console_input(&prgstate, str_slice("loadjson \"test/nested\""));
-    process_console_input(&prgstate, str_slice("edit 0"));
-    ///////////////////////////////
+    bool first_frame = true;
 
     bool show_imgui_testwindow = false;
+    bool show_profiler_window = false;
+    ProfilerView profiler_view = {};
+    bool show_allocations_window = false;
+    AllocationsView allocations_view = {};
+    FramePacer pacer = {};
+    frame_pacer_request(&pacer, FRAMES_AFTER_INPUT);
+
     SDL_Event event;
-    bool running = SDL_PollEvent(&event);
+    bool have_event = SDL_PollEvent(&event);
+    bool running = true;
     while (running)
     {
-        do {
+        while (have_event)
+        {
+            frame_pacer_request(&pacer, FRAMES_AFTER_INPUT);
+
             if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)
             {
                 running = false;
             }
+            else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12)
+            {
+                show_imgui_testwindow = !show_imgui_testwindow;
+            }
+            else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F11)
+            {
+                show_profiler_window = !show_profiler_window;
+            }
+            else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10)
+            {
+                show_allocations_window = !show_allocations_window;
+            }
             else if (!ImGui_ImplSdl_ProcessEvent(&event))
             {
                 // event not handled by imgui
@@ -909,11 +1932,42 @@ int main(int argc, char **argv)
                         break;
                 }
             }
-        } while (SDL_PollEvent(&event));
 
+            have_event = SDL_PollEvent(&event);
+        }
+
+        if (!running)
+        {
+            break;
+        }
+
+        frame_pacer_check_damage(&pacer, &prgstate);
+
+        if (pacer.frames_pending == 0)
+        {
+            u32 wait_ms = frame_pacer_wait_ms(&pacer);
+            have_event = SDL_WaitEventTimeout(&event, S32(wait_ms));
+
+            // Woke up for the caret with nothing else going on, it still needs a frame
+            if (!have_event && ImGui::GetIO().WantTextInput)
+            {
+                frame_pacer_request(&pacer, 1);
+            }
+            continue;
+        }
+
+        frame_pacer_begin_frame(&pacer);
+        ProfZoneMark frame_zone = profiler::begin_zone();
 
         ImGui_ImplSdl_NewFrame(window);
 
+        // Between frames is the one place job results enter the program state
+        jobs::update(&prgstate, JOBS_PUBLISH_BUDGET_MS);
+        if (prgstate.jobs.count > 0)
+        {
+            frame_pacer_request(&pacer, 1);
+        }
+
         draw_imgui_json_cli(&prgstate, window);
 
         for (DynArrayCount i = 0, e = prgstate.editing_collections.count; i < e; ++i)
@@ -928,9 +1982,37 @@ int main(int argc, char **argv)
             }
         }
 
+        FlatView *closed_view = nullptr;
+        for (DynArrayCount i = 0; i < prgstate.flat_views.count; ++i)
+        {
+            if (!draw_window_flat_view(&prgstate, prgstate.flat_views[i]))
+            {
+                closed_view = prgstate.flat_views[i];
+            }
+        }
+        // Takes the views opened from it along, so not while drawing them
+        if (closed_view)
+        {
+            close_flat_view(&prgstate, closed_view);
+        }
+
         draw_typelist_window(&prgstate);
+        draw_jobs_status_bar(&prgstate, window);
 
-        ImGui::ShowTestWindow(&show_imgui_testwindow);
+        if (show_imgui_testwindow)
+        {
+            ImGui::ShowTestWindow(&show_imgui_testwindow);
+        }
+
+        if (show_profiler_window)
+        {
+            show_profiler_window = draw_profiler_window(&profiler_view);
+        }
+
+        if (show_allocations_window)
+        {
+            show_allocations_window = draw_allocations_window(&prgstate, &allocations_view);
+        }
 
         glViewport(0, 0,
                    (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y);
@@ -939,17 +2021,19 @@ int main(int argc, char **argv)
         glClear(GL_COLOR_BUFFER_BIT);
         ImGui::Render();
         SDL_GL_SwapWindow(window);
-        if (ImGui::GetIO().WantCaptureMouse)
-        {
-            mem::zero_obj(event);
-        }
-        else
+        profiler::end_zone(&frame_zone, "frame", ProfCategory::Frame);
+
+        if (first_frame)
         {
-            int sdl_wait_event_ok = SDL_WaitEvent(&event);
-            ASSERT(sdl_wait_event_ok);
+            logf_ln("First frame %.1f ms after starting", milliseconds_since(start_time));
+            first_frame = false;
         }
+
+        have_event = SDL_PollEvent(&event);
     }
 
+    jobs::cancel_all(&prgstate);
+
     ImGui_ImplSdl_Shutdown();
     SDL_GL_DeleteContext(gl_context);
     SDL_DestroyWindow(window);
@@ -1,4 +1,5 @@
 #include "memory.h"
+#include "hashtable.h"
 #include "numeric_types.h"
 #include "common.h"
 #include "platform.h"
@@ -58,14 +59,19 @@ void *FallbackAllocator::realloc(void *ptr, size_t size, size_t align, Allocatio
     else
     {
         ptr = std::malloc(size);
+        ++alloc_count;
     }
+    ++total_alloc_count;
     bytecount += size;
+    peak_bytecount = max(peak_bytecount, bytecount);
     return ptr;
 }
 
 void FallbackAllocator::dealloc(void *ptr) OVERRIDE
 {
+    if (!ptr) return;
     bytecount -= payload_size_of(ptr);
+    --alloc_count;
     std::free(ptr);
 }
 
@@ -74,6 +80,24 @@ size_t FallbackAllocator::bytes_allocated() OVERRIDE
     return bytecount;
 }
 
+AllocatorStats FallbackAllocator::stats() OVERRIDE
+{
+    AllocatorStats result = {bytecount, peak_bytecount, alloc_count, total_alloc_count};
+    return result;
+}
+
+void FallbackAllocator::reset_peak() OVERRIDE
+{
+    peak_bytecount = bytecount;
+}
+
+size_t FallbackAllocator::site_stats(AllocationSiteStats *sites, size_t capacity) OVERRIDE
+{
+    UNUSED(sites);
+    UNUSED(capacity);
+    return 0;
+}
+
 size_t FallbackAllocator::payload_size_of(void *ptr) OVERRIDE
 {
     return MALLOC_GET_SIZE(ptr);
@@ -89,6 +113,93 @@ void FallbackAllocator::log_allocations() OVERRIDE
 ////////////////// Mallocator //////////////////
 ////////////////////////////////////////////////
 
+// The macros pass string literals, so sites are told apart by pointer
+struct SiteKey
+{
+    const char *sourceline;
+    const char *category;
+};
+
+inline bool hashtable_keys_equal(const SiteKey &lhs, const SiteKey &rhs)
+{
+    return lhs.sourceline == rhs.sourceline && lhs.category == rhs.category;
+}
+
+
+// Allocates from malloc directly so counting a site never recurses
+struct Mallocator::SiteTable
+{
+    FallbackAllocator allocator;
+    OAHashtable<SiteKey, AllocationSiteStats> table;
+};
+
+
+void Mallocator::count_site_alloc(const char *sourceline, const char *category, size_t total_size, size_t payload_size)
+{
+    if (!sites)
+    {
+        sites = new (std::malloc(sizeof(SiteTable))) SiteTable();
+        ht_init(&sites->table, 509, &sites->allocator);
+    }
+
+    SiteKey key = {sourceline, category};
+    OAHashtable<SiteKey, AllocationSiteStats>::Entry *entry;
+    if (!ht_find_or_add_entry(&entry, &sites->table, key))
+    {
+        entry->value.sourceline = sourceline;
+        entry->value.category = category;
+    }
+
+    AllocationSiteStats *site = &entry->value;
+    site->live_bytes += total_size;
+    ++site->live_count;
+    site->total_bytes += total_size;
+    ++site->total_count;
+    ++site->size_histogram[histogram_bucket(payload_size)];
+}
+
+
+void Mallocator::count_site_free(MemBlockHeader *header)
+{
+    SiteKey key = {header->sourceline, header->category};
+    AllocationSiteStats *site = ht_find(&sites->table, key);
+    assert(site && site->live_count > 0);
+
+    site->live_bytes -= header->total_size;
+    --site->live_count;
+    --site->size_histogram[histogram_bucket(header->payload_size())];
+}
+
+
+size_t Mallocator::site_stats(AllocationSiteStats *out_sites, size_t capacity) OVERRIDE
+{
+    typedef OAHashtable<SiteKey, AllocationSiteStats> SiteMap;
+
+    SpinLockGuard guard(&lock);
+
+    if (!sites)
+    {
+        return 0;
+    }
+
+    SiteMap *table = &sites->table;
+    size_t count = 0;
+    for (u32 i = 0; i < table->bucket_count; ++i)
+    {
+        if (table->buckets[i].state != SiteMap::BucketState::Filled)
+        {
+            continue;
+        }
+        if (count < capacity)
+        {
+            out_sites[count] = table->entries[i].value;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
 void Mallocator::log_allocations() OVERRIDE
 {
     struct AllocLogInfo
@@ -239,6 +350,8 @@ void *Mallocator::realloc(void *ptr, size_t size, size_t align, AllocationMetada
     assert(size > 0);
     assert(align < UINT8_MAX);
 
+    SpinLockGuard guard(&lock);
+
     if (ALLOC_STACKTRACE) {
         std::printf("Allocated bytecount before: %lu", bytecount);
     }
@@ -259,6 +372,9 @@ void *Mallocator::realloc(void *ptr, size_t size, size_t align, AllocationMetada
     char *memblock = (char *)std::malloc(alloc_size);
 
     bytecount += alloc_size;
+    // counted before the old block is freed, both exist during the copy
+    peak_bytecount = max(peak_bytecount, bytecount);
+    ++allocation_count;
 
     MemBlockHeader *preexisting_hdr = nullptr;
     if (ptr)
@@ -293,6 +409,7 @@ void *Mallocator::realloc(void *ptr, size_t size, size_t align, AllocationMetada
     // Set metadata
     hdr->sourceline = meta.sourceline;
     hdr->category = meta.category;
+    count_site_alloc(meta.sourceline, meta.category, alloc_size, hdr->payload_size());
 
     // Update allocation list
     hdr->next = alloclist_head;
@@ -313,6 +430,7 @@ void *Mallocator::realloc(void *ptr, size_t size, size_t align, AllocationMetada
         size_t copy_size = std::min(preexisting_hdr->payload_size(), hdr->payload_size());
         std::memcpy(result, ptr, copy_size);
         bytecount -= preexisting_hdr->total_size;
+        count_site_free(preexisting_hdr);
         assert(preexisting_hdr != alloclist_head);
         std::free(preexisting_hdr);
         assert(!alloclist_contains(preexisting_hdr));
@@ -346,11 +464,14 @@ void Mallocator::dealloc(void *ptr) OVERRIDE
 
     if (!ptr) return;
 
+    SpinLockGuard guard(&lock);
+
     MemBlockHeader *hdr = get_header(ptr);
 
     size_t freed = hdr->total_size;
 
     bytecount -= hdr->total_size;
+    count_site_free(hdr);
     if (hdr->next)
     {
         hdr->next->prev = hdr->prev;
@@ -427,6 +548,104 @@ size_t Mallocator::bytes_allocated() OVERRIDE
 }
 
 
+AllocatorStats Mallocator::stats() OVERRIDE
+{
+    SpinLockGuard guard(&lock);
+    AllocatorStats result = {bytecount, peak_bytecount, alloc_count, allocation_count};
+    return result;
+}
+
+
+void Mallocator::reset_peak() OVERRIDE
+{
+    SpinLockGuard guard(&lock);
+    peak_bytecount = bytecount;
+}
+
+
+size_t histogram_bucket(size_t payload_size)
+{
+    size_t bucket = 0;
+    size_t limit = 16;
+    while (payload_size > limit && bucket < ALLOC_HISTOGRAM_BUCKETS - 1)
+    {
+        limit <<= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+
+size_t histogram_bucket_limit(size_t bucket)
+{
+    return bucket < ALLOC_HISTOGRAM_BUCKETS - 1 ? size_t(16) << bucket : 0;
+}
+
+
+////////////////////////////////////////////////////////
+/////////////////// Prefix Allocator ///////////////////
+////////////////////////////////////////////////////////
+
+void *PrefixAllocator::realloc(void *ptr, size_t size, size_t align, AllocationMetadata meta) OVERRIDE
+{
+    // The payload has to stay aligned after the prefix
+    assert(prefix_size % align == 0);
+    u8 *block = ptr ? (u8 *)prefix(ptr, prefix_size) : nullptr;
+    block = (u8 *)inner->realloc(block, prefix_size + size, align, meta);
+    if (!ptr)
+    {
+        zero_range(block, prefix_size);
+    }
+    return block + prefix_size;
+}
+
+void PrefixAllocator::dealloc(void *ptr) OVERRIDE
+{
+    if (!ptr) return;
+    inner->dealloc(prefix(ptr, prefix_size));
+}
+
+size_t PrefixAllocator::bytes_allocated() OVERRIDE
+{
+    return inner->bytes_allocated();
+}
+
+size_t PrefixAllocator::payload_size_of(void *ptr) OVERRIDE
+{
+    return inner->payload_size_of(prefix(ptr, prefix_size)) - prefix_size;
+}
+
+void PrefixAllocator::log_allocations() OVERRIDE
+{
+    inner->log_allocations();
+}
+
+AllocatorStats PrefixAllocator::stats() OVERRIDE
+{
+    return inner->stats();
+}
+
+void PrefixAllocator::reset_peak() OVERRIDE
+{
+    inner->reset_peak();
+}
+
+size_t PrefixAllocator::site_stats(AllocationSiteStats *sites, size_t capacity) OVERRIDE
+{
+    return inner->site_stats(sites, capacity);
+}
+
+void *PrefixAllocator::probe() OVERRIDE
+{
+    return inner->probe();
+}
+
+void PrefixAllocator::log_allocs_since_probe(void *probe) OVERRIDE
+{
+    inner->log_allocs_since_probe(probe);
+}
+
+
 static char mallocator_storage[sizeof(Mallocator)];
 static Mallocator *mallocator_inst = 0;
 
@@ -4,6 +4,7 @@
 
 #include "numeric_types.h"
 #include "common.h"
+#include "atomics.h"
 #include <cstring>
 
 #define DEFAULT_ALIGN 8
@@ -98,6 +99,37 @@ public:
 };
 
 
+// Bucket i counts blocks of up to 16 << i bytes, the last one everything bigger
+#define ALLOC_HISTOGRAM_BUCKETS 16
+
+
+struct AllocatorStats
+{
+    size_t bytes_allocated;
+    // high water mark of bytes_allocated since startup or the last reset_peak
+    size_t peak_bytes_allocated;
+    size_t live_allocations;
+    // every call that made a new block, including reallocs that moved
+    size_t total_allocations;
+};
+
+
+// Totals for one call site, the sourceline and category pair an
+// allocation was made with.
+struct AllocationSiteStats
+{
+    const char *sourceline;
+    const char *category;
+    size_t live_bytes;
+    size_t live_count;
+    // every block made here since startup, including reallocs that moved
+    size_t total_bytes;
+    size_t total_count;
+    // live blocks by payload size
+    size_t size_histogram[ALLOC_HISTOGRAM_BUCKETS];
+};
+
+
 class IAllocator
 {
 public:
@@ -106,6 +138,11 @@ public:
     virtual size_t bytes_allocated() = 0;
     virtual size_t payload_size_of(void *ptr) = 0;
     virtual void log_allocations() = 0;
+    virtual AllocatorStats stats() = 0;
+    virtual void reset_peak() = 0;
+    // Copies up to capacity call sites into sites and returns how many
+    // there are in all, 0 if the allocator doesn't track them
+    virtual size_t site_stats(AllocationSiteStats *sites, size_t capacity) = 0;
 
     virtual void* probe() = 0;
     virtual void log_allocs_since_probe(void *probe) = 0;
@@ -125,9 +162,15 @@ class FallbackAllocator : public IAllocator
 {
 public:
     size_t bytecount;
+    size_t peak_bytecount;
+    size_t alloc_count;
+    size_t total_alloc_count;
 
     FallbackAllocator()
         : bytecount(0)
+        , peak_bytecount(0)
+        , alloc_count(0)
+        , total_alloc_count(0)
     {
     }
 
@@ -136,6 +179,9 @@ public:
     virtual size_t  bytes_allocated() OVERRIDE;
     virtual size_t  payload_size_of(void *ptr) OVERRIDE;
     virtual void    log_allocations() OVERRIDE;
+    virtual AllocatorStats stats() OVERRIDE;
+    virtual void    reset_peak() OVERRIDE;
+    virtual size_t  site_stats(AllocationSiteStats *sites, size_t capacity) OVERRIDE;
 
     virtual void* probe() OVERRIDE
     {
@@ -181,11 +227,18 @@ public:
     };
 
     size_t bytecount;
+    size_t peak_bytecount;
+    // every block made, alloc_count is the live ones
     size_t allocation_count;
     bool logging_allocations;
     int callcount;
     size_t alloc_count;
     MemBlockHeader *alloclist_head;
+    // per call site counters, made on first use
+    struct SiteTable;
+    SiteTable *sites;
+    // guards the alloclist and counters, allocation happens off the main thread
+    SpinLock lock;
 
     static const size_t HeaderSize = sizeof(MemBlockHeader);
     STATIC_ASSERT(memblock_header_size_fits_in_byte, (16 + sizeof(MemBlockHeader)) <= UINT8_MAX);
@@ -194,11 +247,14 @@ public:
 
 Mallocator()
         : bytecount(0)
+        , peak_bytecount(0)
         , allocation_count(0)
         , logging_allocations(false)
         , callcount(0)
         , alloc_count(0)
         , alloclist_head(nullptr)
+        , sites(nullptr)
+        , lock()
     {
     }
 
@@ -208,16 +264,59 @@ Mallocator()
     virtual void *realloc(void *ptr, size_t size, size_t align, AllocationMetadata meta) OVERRIDE;
     virtual void dealloc(void *ptr) OVERRIDE;
     virtual size_t bytes_allocated() OVERRIDE;
+    virtual AllocatorStats stats() OVERRIDE;
+    virtual void reset_peak() OVERRIDE;
+    virtual size_t site_stats(AllocationSiteStats *sites, size_t capacity) OVERRIDE;
 
     virtual void* probe() OVERRIDE;
     virtual void log_allocs_since_probe(void *probe) OVERRIDE;
 
     MemBlockHeader *get_header(void *ptr);
     void validate_alloclist();
+    void count_site_alloc(const char *sourceline, const char *category, size_t total_size, size_t payload_size);
+    void count_site_free(MemBlockHeader *header);
     bool alloclist_contains(void *ptr);
 };
 
 
+// Hands out blocks from another allocator with prefix_size bytes in
+// front of each that belong to whoever asked for the block, prefix(ptr)
+// finds them. New blocks get a zeroed prefix, reallocs carry it along.
+class PrefixAllocator : public IAllocator
+{
+public:
+    IAllocator *inner;
+    size_t prefix_size;
+
+    PrefixAllocator(IAllocator *inner_, size_t prefix_size_)
+        : inner(inner_)
+        , prefix_size(prefix_size_)
+    {
+    }
+
+    static void *prefix(void *ptr, size_t prefix_size)
+    {
+        return (u8 *)ptr - prefix_size;
+    }
+
+    virtual void *realloc(void *ptr, size_t size, size_t align, AllocationMetadata meta) OVERRIDE;
+    virtual void dealloc(void *ptr) OVERRIDE;
+    virtual size_t bytes_allocated() OVERRIDE;
+    virtual size_t payload_size_of(void *ptr) OVERRIDE;
+    virtual void log_allocations() OVERRIDE;
+    virtual AllocatorStats stats() OVERRIDE;
+    virtual void reset_peak() OVERRIDE;
+    virtual size_t site_stats(AllocationSiteStats *sites, size_t capacity) OVERRIDE;
+
+    virtual void* probe() OVERRIDE;
+    virtual void log_allocs_since_probe(void *probe) OVERRIDE;
+};
+
+
+size_t histogram_bucket(size_t payload_size);
+// Upper bound of a histogram bucket, 0 for the last (unbounded) one
+size_t histogram_bucket_limit(size_t bucket);
+
 IAllocator *default_allocator();
 void log_memcalls();
 IAllocator *make_mallocator();
@@ -0,0 +1,474 @@
+#include "benchutil.h"
+#include "hashtable.h"
+#include "nametable.h"
+#include "bucketarray.h"
+#include "dynarray.h"
+#include "str.h"
+#include "logging.h"
+#include "memory.h"
+#include "common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+/*
+Micro-benchmarks for the containers under every hot path.
+
+  jsoneditor_microbench [--size N] [--iterations N] [--filter TEXT] [--json]
+
+OAHashtable runs over StrSlice, NameRef and pointer keys at a few load
+factors (tables are sized up front so the load holds for the run).
+--json prints one object per line, for diffing container variants.
+*/
+
+
+struct MicroOptions
+{
+    u32 size;
+    u32 iterations;
+    const char *filter;
+    BenchFormat::Tag format;
+};
+
+
+// Run with --filter to pick benchmarks by name or variant
+static bool selected(const MicroOptions *options, const char *name, const char *variant)
+{
+    return !options->filter
+        || std::strstr(name, options->filter)
+        || std::strstr(variant, options->filter);
+}
+
+
+static void report(const MicroOptions *options, BenchRun *run, const char *name, const char *variant, u64 items)
+{
+    BenchResult result = bench::finish_run(run, name, variant, items, 0);
+    bench::print_result(&result, options->format);
+}
+
+
+// Fed into every timed loop so lookups can't be optimized out
+static volatile u32 g_sink;
+
+
+template <typename TKey, typename FKeysEqual, typename FKeyHash>
+static void bench_hashtable(const MicroOptions *options, const char *key_name,
+                            const TKey *keys, const TKey *miss_keys, u32 count)
+{
+    typedef OAHashtable<TKey, u32, FKeysEqual, FKeyHash> Table;
+
+    // Tables grow past 2/3 full, so stay under that
+    static const float load_factors[] = {0.25f, 0.5f, 0.65f};
+
+    for (size_t ilf = 0; ilf < COUNTOF(load_factors); ++ilf)
+    {
+        float load = load_factors[ilf];
+        u32 bucket_count = (u32)((float)count / load) + 1;
+        char variant[64];
+        snprintf(variant, sizeof(variant), "%s load=%.2f", key_name, (double)load);
+
+        BenchRun run;
+
+        if (selected(options, "ht_insert", variant))
+        {
+            bench::begin_run(&run);
+            for (u32 iter = 0; iter < options->iterations; ++iter)
+            {
+                Table ht;
+                ht_init(&ht, bucket_count);
+                bench::begin_iteration(&run);
+                for (u32 i = 0; i < count; ++i)
+                {
+                    ht_set(&ht, keys[i], i);
+                }
+                bench::end_iteration(&run);
+                ASSERT(ht.count == count);
+                ht_deinit(&ht);
+            }
+            report(options, &run, "ht_insert", variant, count);
+        }
+
+        Table ht;
+        ht_init(&ht, bucket_count);
+        for (u32 i = 0; i < count; ++i)
+        {
+            ht_set(&ht, keys[i], i);
+        }
+
+        if (selected(options, "ht_find_hit", variant))
+        {
+            bench::begin_run(&run);
+            for (u32 iter = 0; iter < options->iterations; ++iter)
+            {
+                u32 sum = 0;
+                bench::begin_iteration(&run);
+                for (u32 i = 0; i < count; ++i)
+                {
+                    sum += *ht_find(&ht, keys[i]);
+                }
+                bench::end_iteration(&run);
+                g_sink = sum;
+            }
+            report(options, &run, "ht_find_hit", variant, count);
+        }
+
+        if (selected(options, "ht_find_miss", variant))
+        {
+            bench::begin_run(&run);
+            for (u32 iter = 0; iter < options->iterations; ++iter)
+            {
+                u32 found = 0;
+                bench::begin_iteration(&run);
+                for (u32 i = 0; i < count; ++i)
+                {
+                    found += ht_find(&ht, miss_keys[i]) != nullptr;
+                }
+                bench::end_iteration(&run);
+                ASSERT(found == 0);
+                g_sink = found;
+            }
+            report(options, &run, "ht_find_miss", variant, count);
+        }
+
+        // Swap every key out for a miss key and back, leaving a tombstone
+        // behind each remove. Items are removes plus inserts.
+        if (selected(options, "ht_churn", variant))
+        {
+            bench::begin_run(&run);
+            for (u32 iter = 0; iter < options->iterations; ++iter)
+            {
+                bench::begin_iteration(&run);
+                for (u32 i = 0; i < count; ++i)
+                {
+                    ht_remove(&ht, keys[i]);
+                    ht_set(&ht, miss_keys[i], i);
+                }
+                for (u32 i = 0; i < count; ++i)
+                {
+                    ht_remove(&ht, miss_keys[i]);
+                    ht_set(&ht, keys[i], i);
+                }
+                bench::end_iteration(&run);
+                ASSERT(ht.count == count);
+            }
+            report(options, &run, "ht_churn", variant, (u64)count * 4);
+        }
+
+        if (selected(options, "ht_rehash", variant))
+        {
+            bench::begin_run(&run);
+            for (u32 iter = 0; iter < options->iterations; ++iter)
+            {
+                Table copy;
+                ht_init(&copy, bucket_count);
+                for (u32 i = 0; i < count; ++i)
+                {
+                    ht_set(&copy, keys[i], i);
+                }
+                bench::begin_iteration(&run);
+                ht_rehash(&copy, copy.bucket_count * 2 + 1);
+                bench::end_iteration(&run);
+                ht_deinit(&copy);
+            }
+            report(options, &run, "ht_rehash", variant, count);
+        }
+
+        ht_deinit(&ht);
+    }
+}
+
+
+static void bench_nametable(const MicroOptions *options, const StrSlice *names, u32 count)
+{
+    BenchRun run;
+    NameTable nt;
+
+    if (selected(options, "nametable_find_or_add", "new names"))
+    {
+        bench::begin_run(&run);
+        for (u32 iter = 0; iter < options->iterations; ++iter)
+        {
+            nametable::init(&nt, MEGABYTES(2));
+            bench::begin_iteration(&run);
+            for (u32 i = 0; i < count; ++i)
+            {
+                nametable::find_or_add(&nt, names[i]);
+            }
+            bench::end_iteration(&run);
+            nametable::deinit(&nt);
+        }
+        report(options, &run, "nametable_find_or_add", "new names", count);
+    }
+
+    if (selected(options, "nametable_find_or_add", "existing names"))
+    {
+        nametable::init(&nt, MEGABYTES(2));
+        for (u32 i = 0; i < count; ++i)
+        {
+            nametable::find_or_add(&nt, names[i]);
+        }
+
+        bench::begin_run(&run);
+        for (u32 iter = 0; iter < options->iterations; ++iter)
+        {
+            u32 sum = 0;
+            bench::begin_iteration(&run);
+            for (u32 i = 0; i < count; ++i)
+            {
+                sum += nametable::find_or_add(&nt, names[i]).handle;
+            }
+            bench::end_iteration(&run);
+            g_sink = sum;
+        }
+        report(options, &run, "nametable_find_or_add", "existing names", count);
+        nametable::deinit(&nt);
+    }
+}
+
+
+// About the size of the things kept in bucket arrays in practice
+struct MicroItem
+{
+    u64 payload[8];
+};
+
+
+static void bench_bucketarray(const MicroOptions *options, u32 count)
+{
+    BenchRun run;
+    BenchRun iterate_full_run;
+    BenchRun remove_run;
+    BenchRun iterate_holes_run;
+    BenchRun refill_run;
+    bench::begin_run(&run);
+    bench::begin_run(&iterate_full_run);
+    bench::begin_run(&remove_run);
+    bench::begin_run(&iterate_holes_run);
+    bench::begin_run(&refill_run);
+
+    DynArray<s32> indices = dynarray::init<s32>(count);
+
+    for (u32 iter = 0; iter < options->iterations; ++iter)
+    {
+        BucketArray<MicroItem> ba;
+        bucketarray::init(&ba);
+        dynarray::clear(&indices);
+
+        bench::begin_iteration(&run);
+        for (u32 i = 0; i < count; ++i)
+        {
+            IndexElemPair<MicroItem> added = bucketarray::add(&ba);
+            added.elem->payload[0] = i;
+            dynarray::append(&indices, added.index);
+        }
+        bench::end_iteration(&run);
+
+        u64 sum = 0;
+        bench::begin_iteration(&iterate_full_run);
+        for (BucketArray<MicroItem>::Iterator it = bucketarray::iterate(&ba); bucketarray::next(&it);)
+        {
+            sum += it.elem->payload[0];
+        }
+        bench::end_iteration(&iterate_full_run);
+
+        // Every other item, so each bucket is left half full
+        bench::begin_iteration(&remove_run);
+        for (u32 i = 0; i < count; i += 2)
+        {
+            bucketarray::remove_at(&ba, indices[i]);
+        }
+        bench::end_iteration(&remove_run);
+
+        bench::begin_iteration(&iterate_holes_run);
+        for (BucketArray<MicroItem>::Iterator it = bucketarray::iterate(&ba); bucketarray::next(&it);)
+        {
+            sum += it.elem->payload[0];
+        }
+        bench::end_iteration(&iterate_holes_run);
+
+        bench::begin_iteration(&refill_run);
+        for (u32 i = 0; i < count; i += 2)
+        {
+            bucketarray::add(&ba).elem->payload[0] = i;
+        }
+        bench::end_iteration(&refill_run);
+
+        ASSERT(ba.count == count);
+        g_sink = (u32)sum;
+        bucketarray::deinit(&ba);
+    }
+
+    dynarray::deinit(&indices);
+
+    u32 removed = (count + 1) / 2;
+    if (selected(options, "bucketarray_add", "empty"))
+    {
+        report(options, &run, "bucketarray_add", "empty", count);
+    }
+    if (selected(options, "bucketarray_iterate", "full"))
+    {
+        report(options, &iterate_full_run, "bucketarray_iterate", "full", count);
+    }
+    if (selected(options, "bucketarray_remove", "every other"))
+    {
+        report(options, &remove_run, "bucketarray_remove", "every other", removed);
+    }
+    if (selected(options, "bucketarray_iterate", "half full"))
+    {
+        report(options, &iterate_holes_run, "bucketarray_iterate", "half full", count - removed);
+    }
+    if (selected(options, "bucketarray_add", "into holes"))
+    {
+        report(options, &refill_run, "bucketarray_add", "into holes", removed);
+    }
+}
+
+
+// Distinct names of varied length, like json keys. The slices point into
+// *storage, which the caller frees.
+static void make_names(DynArray<StrSlice> *names, Str *storage, const char *prefix, u32 count, u32 seed)
+{
+    str_overwrite(storage, str_slice(""));
+    DynArray<StrLen> offsets = dynarray::init<StrLen>(count);
+
+    char buffer[64];
+    u32 x = seed;
+    for (u32 i = 0; i < count; ++i)
+    {
+        x = x * 1664525u + 1013904223u;
+        // the index keeps them distinct, the rest varies the length
+        int length = snprintf(buffer, sizeof(buffer), "%s%u_%.*s", prefix, i,
+                              (int)(x >> 28), "abcdefghijklmnop");
+        dynarray::append(&offsets, str_length(*storage));
+        str_append(storage, str_slice(buffer, (StrLen)length));
+    }
+
+    dynarray::clear(names);
+    for (u32 i = 0; i < count; ++i)
+    {
+        StrLen end = i + 1 < count ? offsets[i + 1] : str_length(*storage);
+        dynarray::append(names, str_slice(str_data(*storage) + offsets[i], end - offsets[i]));
+    }
+
+    dynarray::deinit(&offsets);
+}
+
+
+static void run_microbenchmarks(const MicroOptions *options)
+{
+    u32 count = options->size;
+
+    bench::print_header(options->format);
+
+    Str hit_storage = {};
+    Str miss_storage = {};
+    DynArray<StrSlice> hit_names = dynarray::init<StrSlice>(count);
+    DynArray<StrSlice> miss_names = dynarray::init<StrSlice>(count);
+    make_names(&hit_names, &hit_storage, "key_", count, 1);
+    make_names(&miss_names, &miss_storage, "missing_", count, 2);
+
+    bench_hashtable<StrSlice, StrSliceEqual, StrSliceHash>(
+        options, "StrSlice", hit_names.data, miss_names.data, count);
+
+    {
+        NameTable nt;
+        nametable::init(&nt, MEGABYTES(2));
+        DynArray<NameRef> hit_refs = dynarray::init<NameRef>(count);
+        DynArray<NameRef> miss_refs = dynarray::init<NameRef>(count);
+        for (u32 i = 0; i < count; ++i)
+        {
+            dynarray::append(&hit_refs, nametable::find_or_add(&nt, hit_names[i]));
+            dynarray::append(&miss_refs, nametable::find_or_add(&nt, miss_names[i]));
+        }
+
+        bench_hashtable<NameRef, OAHashtable_DefaultKeysEqual<NameRef>, OAHashtable_DefaultHash<NameRef> >(
+            options, "NameRef", hit_refs.data, miss_refs.data, count);
+
+        dynarray::deinit(&hit_refs);
+        dynarray::deinit(&miss_refs);
+        nametable::deinit(&nt);
+    }
+
+    {
+        // Real heap addresses, with their alignment
+        DynArray<MicroItem *> items = dynarray::init<MicroItem *>(count * 2);
+        for (u32 i = 0; i < count * 2; ++i)
+        {
+            dynarray::append(&items, MAKE_OBJ(mem::default_allocator(), MicroItem));
+        }
+
+        bench_hashtable<MicroItem *, OAHashtable_DefaultKeysEqual<MicroItem *>, OAHashtable_DefaultHash<MicroItem *> >(
+            options, "pointer", items.data, items.data + count, count);
+
+        for (u32 i = 0; i < items.count; ++i)
+        {
+            mem::default_allocator()->dealloc(items[i]);
+        }
+        dynarray::deinit(&items);
+    }
+
+    bench_nametable(options, hit_names.data, count);
+    bench_bucketarray(options, count);
+
+    dynarray::deinit(&hit_names);
+    dynarray::deinit(&miss_names);
+    str_free(&hit_storage);
+    str_free(&miss_storage);
+}
+
+
+static bool parse_u32(const char *text, u32 *out)
+{
+    char *end = nullptr;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0' || value == 0 || value > UINT32_MAX / 4)
+    {
+        return false;
+    }
+    *out = (u32)value;
+    return true;
+}
+
+
+int main(int argc, char **argv)
+{
+    mem::memory_init(logf_with_userdata, nullptr);
+
+    MicroOptions options = {};
+    options.size = 100000;
+    options.iterations = 5;
+    options.format = BenchFormat::Text;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (0 == std::strcmp(arg, "--json"))
+        {
+            options.format = BenchFormat::Json;
+        }
+        else if (value && 0 == std::strcmp(arg, "--size") && parse_u32(value, &options.size))
+        {
+            ++i;
+        }
+        else if (value && 0 == std::strcmp(arg, "--iterations") && parse_u32(value, &options.iterations))
+        {
+            ++i;
+        }
+        else if (value && 0 == std::strcmp(arg, "--filter"))
+        {
+            options.filter = value;
+            ++i;
+        }
+        else
+        {
+            std::printf("usage: %s [--size N] [--iterations N] [--filter TEXT] [--json]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    run_microbenchmarks(&options);
+    return 0;
+}
@@ -1,11 +1,89 @@
 #include "nametable.h"
 
-static ptrdiff_t allocated_size(StrLen len)
+// Every chunk starts with padding so that handle == 0 can mean not-found
+static const u32 InitialStorageOffset = 8;
+static const u32 MinChunkSize = 64;
+static const u32 InitialIndexCapacity = 16;
+
+static NameTable *volatile registered_tables[NAMETABLE_MAX_TABLES];
+
+
+static u32 allocated_size(StrLen len)
 {
-    size_t needed_size = len + 1 + sizeof(StrLen);
+    size_t needed_size = sizeof(u32) + sizeof(StrLen) + len + 1;
     size_t result_size = sizeof(StrLen) * ((needed_size + sizeof(StrLen) - 1) /  sizeof(StrLen));
     assert((result_size % sizeof(StrLen)) == 0);
-    ptrdiff_t result = PTRDIFF_T(result_size);
+    assert(result_size < NAMETABLE_MAX_CHUNK_SIZE);
+    return (u32)result_size;
+}
+
+
+static u32 make_handle(u32 table_index, u32 shard, u32 chunk, u32 offset)
+{
+    assert(table_index < NAMETABLE_MAX_TABLES);
+    assert(shard < NAMETABLE_SHARD_COUNT);
+    assert(chunk < NAMETABLE_MAX_CHUNKS);
+    assert(offset % sizeof(StrLen) == 0);
+    u32 units = offset / sizeof(StrLen);
+    assert(units < (1u << NAMETABLE_OFFSET_BITS));
+    return (table_index << (32 - NAMETABLE_TABLE_BITS))
+        | (shard << (NAMETABLE_CHUNK_BITS + NAMETABLE_OFFSET_BITS))
+        | (chunk << NAMETABLE_OFFSET_BITS)
+        | units;
+}
+
+static u32 handle_table(u32 handle)
+{
+    return handle >> (32 - NAMETABLE_TABLE_BITS);
+}
+
+static u32 handle_shard(u32 handle)
+{
+    return (handle >> (NAMETABLE_CHUNK_BITS + NAMETABLE_OFFSET_BITS)) & (NAMETABLE_SHARD_COUNT - 1);
+}
+
+static u32 handle_chunk(u32 handle)
+{
+    return (handle >> NAMETABLE_OFFSET_BITS) & (NAMETABLE_MAX_CHUNKS - 1);
+}
+
+static u32 handle_offset(u32 handle)
+{
+    return (handle & ((1u << NAMETABLE_OFFSET_BITS) - 1)) * (u32)sizeof(StrLen);
+}
+
+static u32 shard_of_hash(u32 hash)
+{
+    return hash >> (32 - NAMETABLE_SHARD_BITS);
+}
+
+
+static NameTable *table_of_handle(u32 handle)
+{
+    NameTable *nt = atomic::load_acquire(&registered_tables[handle_table(handle)]);
+    assert(nt);
+    return nt;
+}
+
+
+// The memory at an entry starts with the u32 hash of the name, then a
+// length of size StrLen, then the null-terminated character string.
+static const char *entry_location(const NameTable *nt, u32 handle)
+{
+    const NameTableShard *shard = &nt->shards[handle_shard(handle)];
+    return shard->chunks[handle_chunk(handle)] + handle_offset(handle);
+}
+
+static u32 entry_hash(const char *location)
+{
+    return *reinterpret_cast<const u32 *>(location);
+}
+
+static StrSlice entry_slice(const char *location)
+{
+    StrSlice result;
+    result.length = *reinterpret_cast<const StrLen *>(location + sizeof(u32));
+    result.data = location + sizeof(u32) + sizeof(StrLen);
     return result;
 }
 
@@ -16,126 +94,345 @@ namespace nameref
 StrSlice str_slice(NameRef nameref)
 {
     StrSlice result;
-    assert((size_t)nameref.offset < nameref.table->storage_capacity);
-    assert((size_t)nameref.offset % sizeof(StrLen) == 0);
 
-    if (!nameref.offset || !nameref.table)
+    if (!nameref.handle)
     {
         result = empty_str_slice();
     }
     else
     {
-        ptrdiff_t offset = nameref.offset;
-        char *storage = nameref.table->storage;
-        result.length = *reinterpret_cast<StrLen *>(storage + nameref.offset);
-        result.data = (static_cast<char *>(storage) + offset + sizeof(StrLen));
+        result = entry_slice(entry_location(table_of_handle(nameref.handle), nameref.handle));
     }
 
     return result;
 }
 
+u32 hash(NameRef nameref)
+{
+    if (!nameref.handle)
+    {
+        return StrSliceHash()(empty_str_slice());
+    }
+    return entry_hash(entry_location(table_of_handle(nameref.handle), nameref.handle));
+}
+
 bool identical(const NameRef &lhs, const NameRef &rhs)
 {
-    return lhs.offset == rhs.offset
-        && lhs.table == rhs.table;
+    return lhs.handle == rhs.handle;
 }
 
 }
 
-namespace nametable
+
+static NameTableIndex *make_index(mem::IAllocator *allocator, u32 capacity)
+{
+    assert((capacity & (capacity - 1)) == 0);
+    NameTableIndex *index = MAKE_OBJ_CAT(allocator, "names", NameTableIndex);
+    index->capacity = capacity;
+    index->slots = MAKE_ZEROED_ARRAY_CAT(allocator, capacity, "names", NameTableSlot);
+    index->retired_next = nullptr;
+    return index;
+}
+
+static void free_index(mem::IAllocator *allocator, NameTableIndex *index)
 {
+    allocator->dealloc(index->slots);
+    allocator->dealloc(index);
+}
+
+
+// Safe without the shard lock. The index is never more than half
+// full so there's always an empty slot to stop on.
+static u32 index_find(const NameTable *nt, const NameTableIndex *index, u32 hash, StrSlice name)
+{
+    u32 mask = index->capacity - 1;
+    for (u32 i = hash & mask; ; i = (i + 1) & mask)
+    {
+        const NameTableSlot *slot = &index->slots[i];
+        u32 handle = atomic::load_acquire(&slot->handle);
+        if (!handle)
+        {
+            return 0;
+        }
+
+        if (slot->hash == hash && str_equal(entry_slice(entry_location(nt, handle)), name))
+        {
+            return handle;
+        }
+    }
+}
 
-static const size_t InitialStorageOffset = 8;
+// Caller holds the shard lock
+static void index_insert(NameTableIndex *index, u32 hash, u32 handle)
+{
+    u32 mask = index->capacity - 1;
+    u32 i = hash & mask;
+    while (index->slots[i].handle)
+    {
+        i = (i + 1) & mask;
+    }
+
+    index->slots[i].hash = hash;
+    atomic::store_release(&index->slots[i].handle, handle);
+}
+
+// Caller holds the shard lock
+static void grow_index(NameTable *nt, NameTableShard *shard)
+{
+    NameTableIndex *old_index = shard->index;
+    NameTableIndex *new_index = make_index(nt->allocator, old_index->capacity * 2);
+
+    for (u32 i = 0; i < old_index->capacity; ++i)
+    {
+        NameTableSlot *slot = &old_index->slots[i];
+        if (slot->handle)
+        {
+            index_insert(new_index, slot->hash, slot->handle);
+        }
+    }
+
+    atomic::store_release(&shard->index, new_index);
+
+    // Readers may still be probing the old index, so it lives until deinit
+    old_index->retired_next = shard->retired;
+    shard->retired = old_index;
+}
+
+
+// Caller holds the shard lock
+static void add_chunk(NameTable *nt, NameTableShard *shard, size_t min_capacity)
+{
+    u32 chunk = shard->chunk_count;
+    assert(chunk < NAMETABLE_MAX_CHUNKS);
+
+    size_t capacity = chunk == 0
+        ? nt->initial_chunk_size
+        : min(size_t(shard->chunk_capacities[chunk - 1]) * 2, NAMETABLE_MAX_CHUNK_SIZE);
+    capacity = max(capacity, min_capacity);
+    assert(capacity <= NAMETABLE_MAX_CHUNK_SIZE);
+
+    // Not zeroed, entries are written before chunk_used covers them and
+    // the pages of a big chunk are only touched as names fill it
+    char *storage = MAKE_ARRAY_CAT(nt->allocator, capacity, "names", char);
+    *reinterpret_cast<u64 *>(storage) = 0xdeadbeefdeadbeef;
+
+    shard->chunks[chunk] = storage;
+    shard->chunk_capacities[chunk] = (u32)capacity;
+    shard->chunk_used[chunk] = InitialStorageOffset;
+    atomic::store_release(&shard->chunk_count, chunk + 1);
+}
+
+
+// Caller holds the shard lock
+static u32 add_entry(NameTable *nt, u32 shard_number, u32 hash, StrSlice name)
+{
+    NameTableShard *shard = &nt->shards[shard_number];
+
+    // calculated total size to allocate, includes room for hash and
+    // length at front, chars, null terminator, and pads to align with StrLen
+    u32 alloc_size = allocated_size(name.length);
+
+    // Shards get their first chunk on the first insert
+    u32 chunk = shard->chunk_count;
+    if (chunk == 0 || shard->chunk_capacities[chunk - 1] - shard->chunk_used[chunk - 1] < alloc_size)
+    {
+        add_chunk(nt, shard, InitialStorageOffset + alloc_size);
+        ++chunk;
+    }
+    --chunk;
+
+    u32 offset = shard->chunk_used[chunk];
+    char *storage_location = shard->chunks[chunk] + offset;
+
+    u32 *hash_storage = reinterpret_cast<u32 *>(storage_location);
+    *hash_storage = hash;
+
+    StrLen *length_storage = reinterpret_cast<StrLen *>(storage_location + sizeof(u32));
+    *length_storage = name.length;
+
+    char *str_storage = storage_location + sizeof(u32) + sizeof(StrLen);
+    std::memcpy(str_storage, name.data, name.length);
+    str_storage[name.length] = '\0';
+
+    atomic::store_release(&shard->chunk_used[chunk], offset + alloc_size);
+
+    return make_handle(nt->table_index, shard_number, chunk, offset);
+}
+
+
+namespace nametable
+{
 
 void init(NameTable *nt, size_t storage_size, mem::IAllocator *allocator)
 {
-    // There should be 8 bytes of padding at the beginning of the
-    // storage, so minimum storage size is 8. But, like, don't do that. It's weird.
-    // The padding is so that ptrdiff_t == 0 can mean not-found.
-    size_t capacity = storage_size < InitialStorageOffset ? InitialStorageOffset : storage_size;
-    nt->storage_capacity = capacity;
+    mem::zero_ptr(nt);
 
     if (!allocator)
     {
         allocator = mem::default_allocator();
     }
+    nt->allocator = allocator;
 
-    nt->storage = MAKE_ZEROED_ARRAY(allocator, capacity, char);
+    bool registered = false;
+    for (u32 i = 0; i < NAMETABLE_MAX_TABLES && !registered; ++i)
+    {
+        if (atomic::compare_exchange(&registered_tables[i], (NameTable *)nullptr, nt))
+        {
+            nt->table_index = i;
+            registered = true;
+        }
+    }
+    assert(registered && "Too many NameTables live at once");
 
-    *reinterpret_cast<u64 *>(nt->storage) = 0xdeadbeefdeadbeef;
+    size_t chunk_size = storage_size / NAMETABLE_SHARD_COUNT;
+    chunk_size = sizeof(StrLen) * ((chunk_size + sizeof(StrLen) - 1) / sizeof(StrLen));
+    nt->initial_chunk_size = min(max(chunk_size, size_t(MinChunkSize)), NAMETABLE_MAX_CHUNK_SIZE);
 
-    nt->next_storage_offset = InitialStorageOffset;
-    ht_init(&nt->lookup, 29, allocator);
+    for (u32 i = 0; i < NAMETABLE_SHARD_COUNT; ++i)
+    {
+        NameTableShard *shard = &nt->shards[i];
+        shard->index = make_index(allocator, InitialIndexCapacity);
+    }
 }
 
 
-NameRef first(NameTable *nt)
+void deinit(NameTable *nt)
+{
+    for (u32 i = 0; i < NAMETABLE_SHARD_COUNT; ++i)
+    {
+        NameTableShard *shard = &nt->shards[i];
+
+        for (u32 c = 0; c < shard->chunk_count; ++c)
+        {
+            nt->allocator->dealloc(shard->chunks[c]);
+        }
+
+        if (shard->index)
+        {
+            free_index(nt->allocator, shard->index);
+        }
+
+        NameTableIndex *retired = shard->retired;
+        while (retired)
+        {
+            NameTableIndex *next_retired = retired->retired_next;
+            free_index(nt->allocator, retired);
+            retired = next_retired;
+        }
+    }
+
+    assert(registered_tables[nt->table_index] == nt);
+    atomic::store_release(&registered_tables[nt->table_index], (NameTable *)nullptr);
+
+    mem::zero_ptr(nt);
+}
+
+
+// First entry at or after the start of the given chunk
+static NameRef first_from(NameTable *nt, u32 shard_number, u32 chunk)
 {
     NameRef result;
-    result.table = nt;
-    result.offset = InitialStorageOffset;
+    result.handle = 0;
+
+    for (; shard_number < NAMETABLE_SHARD_COUNT; ++shard_number, chunk = 0)
+    {
+        NameTableShard *shard = &nt->shards[shard_number];
+        u32 chunk_count = atomic::load_acquire(&shard->chunk_count);
+
+        for (; chunk < chunk_count; ++chunk)
+        {
+            if (atomic::load_acquire(&shard->chunk_used[chunk]) > InitialStorageOffset)
+            {
+                result.handle = make_handle(nt->table_index, shard_number, chunk, InitialStorageOffset);
+                return result;
+            }
+        }
+    }
+
     return result;
 }
 
 
+NameRef first(NameTable *nt)
+{
+    return first_from(nt, 0, 0);
+}
+
+
 NameRef next(NameRef nameref)
 {
-    StrLen namelen = *reinterpret_cast<StrLen *>(nameref.table->storage + nameref.offset);
-    NameRef result;
-    result.table = nameref.table;
-    ptrdiff_t new_offset = (nameref.offset + allocated_size(namelen));
-    result.offset = (new_offset < nameref.table->next_storage_offset)
-        ? new_offset
-        : 0;
-    return result;
+    NameTable *nt = table_of_handle(nameref.handle);
+    u32 shard_number = handle_shard(nameref.handle);
+    u32 chunk = handle_chunk(nameref.handle);
+    NameTableShard *shard = &nt->shards[shard_number];
+
+    StrLen namelen = entry_slice(entry_location(nt, nameref.handle)).length;
+    u32 new_offset = handle_offset(nameref.handle) + allocated_size(namelen);
+
+    if (new_offset < atomic::load_acquire(&shard->chunk_used[chunk]))
+    {
+        NameRef result;
+        result.handle = make_handle(nt->table_index, shard_number, chunk, new_offset);
+        return result;
+    }
+
+    return first_from(nt, shard_number, chunk + 1);
+}
+
+
+NameTable *table_of(NameRef nameref)
+{
+    return nameref.handle ? table_of_handle(nameref.handle) : nullptr;
 }
 
 
 NameRef find(NameTable *nt, StrSlice name)
 {
+    u32 hash = StrSliceHash()(name);
+    NameTableShard *shard = &nt->shards[shard_of_hash(hash)];
+
     NameRef result;
-    result.table = nt;
-    ptrdiff_t *offset = ht_find(&nt->lookup, name);
-    result.offset = offset ? *offset : 0;
+    result.handle = index_find(nt, atomic::load_acquire(&shard->index), hash, name);
     return result;
 }
 
 
+NameRef find(NameTable *nt, const char *name)
+{
+    return find(nt, str_slice(name));
+}
+
+
 NameRef find_or_add(NameTable *nt, StrSlice name)
 {
-    NameRef result = find(nt, name);
-    if (result.offset)
+    u32 hash = StrSliceHash()(name);
+    u32 shard_number = shard_of_hash(hash);
+    NameTableShard *shard = &nt->shards[shard_number];
+
+    NameRef result;
+    result.handle = index_find(nt, atomic::load_acquire(&shard->index), hash, name);
+    if (result.handle)
     {
         return result;
     }
 
-    // calculated total size to allocate, includes room for length at
-    // front, chars, null terminator, and pads to align with StrLen
-    ptrdiff_t alloc_size = allocated_size(name.length);
-
-    assert(PTRDIFF_T(nt->storage_capacity) - nt->next_storage_offset > alloc_size);
-
-    // Nameref stores offset into nametable storage.
-    // The memory starts with a length of size StrLen (u16 at the time this was written)
-    // After the StrLen, the null-terminated character string folows
-    // The offset is always aligned with StrLen
-    result.offset = nt->next_storage_offset;
-    char *storage_location = nt->storage + nt->next_storage_offset;
+    SpinLockGuard guard(&shard->lock);
 
-    StrLen *length_storage = reinterpret_cast<StrLen *>(storage_location);
-    *length_storage = name.length;
-
-    char *str_storage = storage_location + sizeof(StrLen);
-    std::strncpy(str_storage, name.data, name.length + 1);
-
-    StrSlice key;
-    key.length = name.length;
-    key.data = str_storage;
+    // Another thread may have added it while we were waiting
+    result.handle = index_find(nt, shard->index, hash, name);
+    if (result.handle)
+    {
+        return result;
+    }
 
-    // bump next_storage_offset by the calculated alloc_size
-    nt->next_storage_offset += alloc_size;
+    if ((shard->count + 1) * 2 > shard->index->capacity)
+    {
+        grow_index(nt, shard);
+    }
 
-    ht_set(&nt->lookup, name, result.offset);
+    result.handle = add_entry(nt, shard_number, hash, name);
+    index_insert(shard->index, hash, result.handle);
+    ++shard->count;
 
     return result;
 }
@@ -4,26 +4,82 @@
 #include "str.h"
 #include "hashtable.h"
 #include "memory.h"
+#include "atomics.h"
+
+/*
+The NameTable owns the memory for interned strings. Each string lives
+in a chunk of storage that never moves, next to its hash and length.
+A NameRef is a 32-bit handle encoding where: which table, shard, chunk
+within the shard, and offset into the chunk (in StrLen-sized units).
+Growing just adds a chunk, so handles stay valid.
+
+Tables register themselves in a small global list on init, which is
+how a bare handle finds its table.
+
+Names are sharded by hash. Lookups are lock-free: each shard publishes
+its hash index with release semantics, and a superseded index is kept
+alive until deinit so a reader holding it still sees valid memory.
+Inserts take only the shard's lock.
+*/
+
+#define NAMETABLE_TABLE_BITS 2
+#define NAMETABLE_SHARD_BITS 4
+#define NAMETABLE_CHUNK_BITS 5
+#define NAMETABLE_OFFSET_BITS (32 - NAMETABLE_TABLE_BITS - NAMETABLE_SHARD_BITS - NAMETABLE_CHUNK_BITS)
+
+#define NAMETABLE_MAX_TABLES (1u << NAMETABLE_TABLE_BITS)
+#define NAMETABLE_SHARD_COUNT (1u << NAMETABLE_SHARD_BITS)
+#define NAMETABLE_MAX_CHUNKS (1u << NAMETABLE_CHUNK_BITS)
+#define NAMETABLE_MAX_CHUNK_SIZE ((size_t(1) << NAMETABLE_OFFSET_BITS) * sizeof(StrLen))
+
+
+struct NameTableSlot
+{
+    u32 hash;
+    // 0 means empty, written last with release semantics
+    volatile u32 handle;
+};
+
+
+struct NameTableIndex
+{
+    u32 capacity;
+    NameTableSlot *slots;
+    NameTableIndex *retired_next;
+};
+
+
+struct NameTableShard
+{
+    SpinLock lock;
+    NameTableIndex *volatile index;
+    u32 count;
+
+    volatile u32 chunk_count;
+    char *chunks[NAMETABLE_MAX_CHUNKS];
+    u32 chunk_capacities[NAMETABLE_MAX_CHUNKS];
+    // bytes in use, published after the entry is written, for iteration
+    volatile u32 chunk_used[NAMETABLE_MAX_CHUNKS];
+
+    NameTableIndex *retired;
+};
 
 
 struct NameTable
 {
-    // This will own the memory for strings
-    // And a hashtable mapping keys back to an offset from that memory
-    // That offset is the symbol, the handle.
-    char *storage;
-    size_t storage_capacity;
-    ptrdiff_t next_storage_offset;
-
-    OAHashtable<StrSlice, std::ptrdiff_t, StrSliceEqual, StrSliceHash> lookup;
+    u32 table_index;
+    mem::IAllocator *allocator;
+    size_t initial_chunk_size;
+    NameTableShard shards[NAMETABLE_SHARD_COUNT];
 };
 
 
+// 0 is the null handle
 struct NameRef
 {
-    ptrdiff_t offset;
-    NameTable *table;
+    u32 handle;
 };
+STATIC_ASSERT(nameref_is_a_bare_handle, sizeof(NameRef) == 4);
 
 
 namespace nameref
@@ -43,6 +99,9 @@ struct Identical
 
 StrSlice str_slice(NameRef nameref);
 
+// The hash computed when the name was interned, same as StrSliceHash
+u32 hash(NameRef nameref);
+
 
 inline Str str(NameRef nameref)
 {
@@ -58,12 +117,34 @@ inline bool hashtable_keys_equal(const NameRef &lhs, const NameRef &rhs)
 }
 
 
+// Names carry their hash with them, no need to hash again
+template<>
+struct OAHashtable_DefaultHash<NameRef>
+{
+    u32 operator()(const NameRef &value)
+    {
+        return fn(value);
+    }
+
+    static u32 fn(const NameRef &value)
+    {
+        return nameref::hash(value);
+    }
+};
+
+
 
 namespace nametable
 {
 
+// storage_size is a hint for how big the first chunk in each shard is,
+// the table grows past it as needed. Nothing is allocated for a shard
+// until a name goes in. At most NAMETABLE_MAX_TABLES can be live.
 void init(NameTable *nt, size_t storage_size, mem::IAllocator *allocator = nullptr);
 
+void deinit(NameTable *nt);
+
+// These are safe to call from any thread concurrently with each other
 NameRef find(NameTable *nt, StrSlice name);
 
 NameRef find(NameTable *nt, const char *name);
@@ -72,10 +153,13 @@ NameRef find_or_add(NameTable *nt, StrSlice name);
 
 NameRef find_or_add(NameTable *nt, const char *name);
 
+// Iteration goes shard by shard, not in insertion order
 NameRef first(NameTable *nt);
 
 NameRef next(NameRef nameref);
 
+NameTable *table_of(NameRef nameref);
+
 
 inline NameRef find_or_add(NameTable *nt, const char *name, size_t length)
 {
@@ -2,6 +2,7 @@
 #include "str.h"
 #include "common.h"
 #include "dynarray.h"
+#include "platform.h"
 
 
 
@@ -98,6 +99,33 @@ struct NameTableTest
 };
 
 
+#define CONCURRENT_TEST_THREADS 4
+#define CONCURRENT_TEST_NAMES 12000
+
+
+struct ConcurrentInternTest
+{
+    NameTable *nt;
+    // Each thread starts somewhere else in the names and wraps around,
+    // so every name gets raced for by all of them
+    u32 first;
+    NameRef refs[CONCURRENT_TEST_NAMES];
+};
+
+
+static void concurrent_intern(void *userdata)
+{
+    ConcurrentInternTest *test = (ConcurrentInternTest *)userdata;
+    char namebuf[32];
+    for (u32 n = 0; n < CONCURRENT_TEST_NAMES; ++n)
+    {
+        u32 i = (test->first + n) % CONCURRENT_TEST_NAMES;
+        std::snprintf(namebuf, sizeof(namebuf), "concurrent_name_%u", i);
+        test->refs[i] = nametable::find_or_add(test->nt, namebuf);
+    }
+}
+
+
 s32 run_nametable_tests()
 {
     NameTable nt;
@@ -123,7 +151,7 @@ s32 run_nametable_tests()
             NameTableTest *test = &tests[i];
             test->ref = nametable::find_or_add(&nt, test->name);
 
-            if (!test->ref.offset)
+            if (!test->ref.handle)
             {
                 printf_ln("Failed to add '%s' to NameTable", test->name.data);
                 ++add_fails;
@@ -159,7 +187,7 @@ s32 run_nametable_tests()
 
             test->ref = nametable::find(&nt, test->name);
 
-            if (!test->ref.offset)
+            if (!test->ref.handle)
             {
                 printf_ln("Test %i Failed to find '%s' in NameTable", i, test->name.data);
                 ++find_fails;
@@ -184,5 +212,133 @@ s32 run_nametable_tests()
         }
     }
 
-    return add_fails + find_fails;
+    s32 growth_fails = 0;
+
+    {
+        // Enough names to force every shard through several chunks
+        // and index resizes, earlier refs have to survive all of it
+        const DynArrayCount growth_count = 20000;
+        DynArray<NameRef> refs;
+        dynarray::init(&refs, growth_count);
+        char namebuf[32];
+
+        for (DynArrayCount i = 0; i < growth_count; ++i)
+        {
+            std::snprintf(namebuf, sizeof(namebuf), "growth_name_%u", (u32)i);
+            dynarray::append(&refs, nametable::find_or_add(&nt, namebuf));
+        }
+
+        for (DynArrayCount i = 0; i < growth_count; ++i)
+        {
+            std::snprintf(namebuf, sizeof(namebuf), "growth_name_%u", (u32)i);
+            NameRef found = nametable::find(&nt, namebuf);
+
+            if (!nameref::identical(found, refs[i])
+                || !str_equal(nameref::str_slice(refs[i]), namebuf)
+                || nameref::hash(refs[i]) != StrSliceHash()(str_slice(namebuf)))
+            {
+                printf_ln("Test %i Failed to find '%s' after NameTable growth", i, namebuf);
+                ++growth_fails;
+            }
+        }
+
+        DynArrayCount iterated_count = 0;
+        for (NameRef name = nametable::first(&nt); name.handle; name = nametable::next(name))
+        {
+            ++iterated_count;
+        }
+
+        if (iterated_count != growth_count + test_count)
+        {
+            printf_ln("Iterated %u names in NameTable, expected %u", iterated_count, growth_count + test_count);
+            ++growth_fails;
+        }
+
+        dynarray::deinit(&refs);
+
+        if (growth_fails != 0)
+        {
+            printf_ln("There were %i failures while growing NameTable", growth_fails);
+        }
+        else
+        {
+            println("No failures growing NameTable");
+        }
+    }
+
+    nametable::deinit(&nt);
+
+    s32 concurrent_fails = 0;
+
+    {
+        // Small, so the shards grow while the threads race
+        NameTable concurrent_nt;
+        nametable::init(&concurrent_nt, 1024);
+
+        ConcurrentInternTest *tests = MAKE_ZEROED_ARRAY(mem::default_allocator(), CONCURRENT_TEST_THREADS,
+                                                        ConcurrentInternTest);
+        PlatformThread threads[CONCURRENT_TEST_THREADS];
+        for (u32 t = 0; t < CONCURRENT_TEST_THREADS; ++t)
+        {
+            tests[t].nt = &concurrent_nt;
+            tests[t].first = t * (CONCURRENT_TEST_NAMES / CONCURRENT_TEST_THREADS);
+            if (!start_thread(&threads[t], concurrent_intern, &tests[t]))
+            {
+                concurrent_intern(&tests[t]);
+            }
+        }
+        for (u32 t = 0; t < CONCURRENT_TEST_THREADS; ++t)
+        {
+            if (threads[t].handle)
+            {
+                join_thread(&threads[t]);
+            }
+        }
+
+        char namebuf[32];
+        for (u32 i = 0; i < CONCURRENT_TEST_NAMES; ++i)
+        {
+            std::snprintf(namebuf, sizeof(namebuf), "concurrent_name_%u", i);
+            NameRef found = nametable::find(&concurrent_nt, namebuf);
+            bool same = found.handle && str_equal(nameref::str_slice(found), namebuf);
+            for (u32 t = 0; t < CONCURRENT_TEST_THREADS; ++t)
+            {
+                same = same && nameref::identical(tests[t].refs[i], found);
+            }
+
+            if (!same)
+            {
+                printf_ln("Test %u '%s' didn't intern to a single NameRef from %i threads",
+                          i, namebuf, CONCURRENT_TEST_THREADS);
+                ++concurrent_fails;
+            }
+        }
+
+        DynArrayCount iterated_count = 0;
+        for (NameRef name = nametable::first(&concurrent_nt); name.handle; name = nametable::next(name))
+        {
+            ++iterated_count;
+        }
+
+        if (iterated_count != CONCURRENT_TEST_NAMES)
+        {
+            printf_ln("Iterated %u names after concurrent interning, expected %u",
+                      iterated_count, CONCURRENT_TEST_NAMES);
+            ++concurrent_fails;
+        }
+
+        mem::default_allocator()->dealloc(tests);
+        nametable::deinit(&concurrent_nt);
+
+        if (concurrent_fails != 0)
+        {
+            printf_ln("There were %i failures interning from several threads", concurrent_fails);
+        }
+        else
+        {
+            println("No failures interning from several threads");
+        }
+    }
+
+    return add_fails + find_fails + growth_fails + concurrent_fails;
 }
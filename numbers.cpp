@@ -0,0 +1,248 @@
+#include "numbers.h"
+#include "memory.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace numbers
+{
+
+// Every one of these is exact in a double
+static const f64 exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const s32 max_exact_power = 22;
+static const u64 max_exact_mantissa = (u64)1 << 53;
+// More digits than this may not fit in a u64
+static const s32 max_mantissa_digits = 19;
+
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Clinger: with both operands exact, one multiply or divide rounds correctly
+static bool fast_float(OUTPARAM f64 *result, u64 mantissa, s32 exponent)
+{
+    if (mantissa > max_exact_mantissa)
+    {
+        return false;
+    }
+
+    if (exponent < 0)
+    {
+        if (exponent < -max_exact_power)
+        {
+            return false;
+        }
+        *result = (f64)mantissa / exact_powers_of_ten[-exponent];
+        return true;
+    }
+
+    // 123e25 is 123000e22, the extra zeros can move into the mantissa
+    // while it stays exact
+    while (exponent > max_exact_power && mantissa <= max_exact_mantissa / 10)
+    {
+        mantissa *= 10;
+        --exponent;
+    }
+    if (exponent > max_exact_power)
+    {
+        return false;
+    }
+
+    *result = (f64)mantissa * exact_powers_of_ten[exponent];
+    return true;
+}
+
+
+static f64 slow_float(const char *text, size_t length)
+{
+    char stack_buffer[128];
+    char *buffer = stack_buffer;
+    if (length >= sizeof(stack_buffer))
+    {
+        buffer = MAKE_ARRAY_CAT(mem::default_allocator(), length + 1, "numbers", char);
+    }
+
+    std::memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    f64 result = std::strtod(buffer, nullptr);
+
+    if (buffer != stack_buffer)
+    {
+        mem::default_allocator()->dealloc(buffer);
+    }
+    return result;
+}
+
+
+size_t parse(OUTPARAM ParsedNumber *result, const char *text, size_t length)
+{
+    const char *cursor = text;
+    const char *end = text + length;
+    result->kind = NumberKind::Invalid;
+
+    bool negative = false;
+    if (cursor < end && *cursor == '-')
+    {
+        negative = true;
+        ++cursor;
+    }
+
+    // Leading zeros don't count toward the 19 digits. Digits past those
+    // are dropped, which only loses anything if one of them isn't a zero.
+    u64 mantissa = 0;
+    s32 mantissa_digits = 0;
+    s32 exponent = 0;
+    bool truncated = false;
+
+    const char *int_start = cursor;
+    for (; cursor < end && is_digit(*cursor); ++cursor)
+    {
+        u32 digit = (u32)(*cursor - '0');
+        if (mantissa_digits < max_mantissa_digits)
+        {
+            mantissa = mantissa * 10 + digit;
+            mantissa_digits += mantissa != 0;
+        }
+        else
+        {
+            ++exponent;
+            truncated |= digit != 0;
+        }
+    }
+
+    size_t int_digits = (size_t)(cursor - int_start);
+    if (int_digits == 0)
+    {
+        return 0;
+    }
+    if (*int_start == '0' && int_digits > 1)
+    {
+        return 0;
+    }
+
+    bool is_float = false;
+    if (cursor < end && *cursor == '.')
+    {
+        ++cursor;
+        is_float = true;
+
+        const char *frac_start = cursor;
+        for (; cursor < end && is_digit(*cursor); ++cursor)
+        {
+            u32 digit = (u32)(*cursor - '0');
+            if (mantissa_digits < max_mantissa_digits)
+            {
+                mantissa = mantissa * 10 + digit;
+                mantissa_digits += mantissa != 0;
+                --exponent;
+            }
+            else
+            {
+                truncated |= digit != 0;
+            }
+        }
+
+        if (cursor == frac_start)
+        {
+            return 0;
+        }
+    }
+
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+    {
+        ++cursor;
+        is_float = true;
+
+        bool exponent_negative = false;
+        if (cursor < end && (*cursor == '+' || *cursor == '-'))
+        {
+            exponent_negative = *cursor == '-';
+            ++cursor;
+        }
+
+        const char *exp_start = cursor;
+        s32 written_exponent = 0;
+        for (; cursor < end && is_digit(*cursor); ++cursor)
+        {
+            // Way past what a double can hold, stop before it overflows
+            if (written_exponent < 100000)
+            {
+                written_exponent = written_exponent * 10 + (*cursor - '0');
+            }
+        }
+        if (cursor == exp_start)
+        {
+            return 0;
+        }
+
+        exponent += exponent_negative ? -written_exponent : written_exponent;
+    }
+
+    size_t read = (size_t)(cursor - text);
+
+    if (!is_float && exponent == 0)
+    {
+        u64 limit = negative ? (u64)INT64_MAX + 1 : (u64)INT64_MAX;
+        if (mantissa <= limit)
+        {
+            result->kind = NumberKind::Int;
+            result->int_val = negative ? (s64)(0 - mantissa) : (s64)mantissa;
+            return read;
+        }
+    }
+
+    f64 value = 0.0;
+    if (mantissa != 0 && (truncated || !fast_float(&value, mantissa, exponent)))
+    {
+        // strtod reads the sign itself
+        value = slow_float(text, read);
+    }
+    else if (negative)
+    {
+        value = -value;
+    }
+
+    // Only strtod can overflow, the fast path's operands are too small
+    result->kind = value - value == 0.0 ? NumberKind::Float : NumberKind::OutOfRange;
+    result->float_val = value;
+    return read;
+}
+
+
+size_t format_float(char *buffer, size_t buffer_size, f64 value)
+{
+    // 17 significant digits always read back the same, fewer often do
+    int length = 0;
+    for (int precision = 15; precision <= 17; ++precision)
+    {
+        length = snprintf(buffer, buffer_size, "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value)
+        {
+            break;
+        }
+    }
+
+    if (length < 0 || (size_t)length >= buffer_size)
+    {
+        return buffer_size > 0 ? buffer_size - 1 : 0;
+    }
+
+    // Also covers inf and nan, which have no way back anyway
+    if (!std::strpbrk(buffer, ".eEn") && (size_t)length + 2 < buffer_size)
+    {
+        buffer[length++] = '.';
+        buffer[length++] = '0';
+        buffer[length] = '\0';
+    }
+    return (size_t)length;
+}
+
+}
@@ -0,0 +1,67 @@
+// -*- c++ -*-
+
+#ifndef NUMBERS_H
+
+#include "common.h"
+#include "numeric_types.h"
+#include <cstddef>
+
+
+/*
+Reading numbers straight out of the text they're in, without copying
+them into a Str first. Integers are accumulated into 64 bits. Floats take
+Clinger's fast path, an exact multiply or divide by a power of ten, when
+the digits and exponent are small enough for that to round correctly,
+which is almost always. The rest go to strtod from a stack buffer, or
+from the heap for the odd number over 127 chars long.
+
+An integer too big for an s64 comes back as a Float, so what a number is
+depends on its digits and its magnitude, the same rule inference uses.
+A float too big for a double is OutOfRange instead of infinity, json has
+no way to write that. One too small to tell from zero is just zero.
+*/
+
+namespace NumberKind
+{
+
+enum Tag
+{
+    Invalid,
+    Int,
+    Float,
+    // Read, but its magnitude is past DBL_MAX
+    OutOfRange
+};
+
+}
+
+
+struct ParsedNumber
+{
+    NumberKind::Tag kind;
+    union
+    {
+        s64 int_val;
+        f64 float_val;
+    };
+};
+
+
+namespace numbers
+{
+
+// Reads the json number at the start of text, returns the number of chars
+// read or 0 if there isn't one
+size_t parse(OUTPARAM ParsedNumber *result, const char *text, size_t length);
+
+// The fewest significant digits from 15 to 17 that read back as the same
+// double, which isn't always the shortest text that does. Always has a
+// '.' or an exponent so it reads back as a Float. Infinities and NaN,
+// which only arithmetic makes, come out as inf and nan. Returns the length.
+size_t format_float(char *buffer, size_t buffer_size, f64 value);
+
+}
+
+
+#define NUMBERS_H
+#endif
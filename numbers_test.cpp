@@ -0,0 +1,134 @@
+#include "numbers.h"
+#include "common.h"
+#include <cstring>
+
+
+struct NumberTestCase
+{
+    const char *text;
+    NumberKind::Tag kind;
+    // chars read, 0 if it shouldn't parse
+    size_t read;
+};
+
+
+static const NumberTestCase number_test_cases[] = {
+    {"0", NumberKind::Int, 1},
+    {"-0", NumberKind::Int, 2},
+    {"42,", NumberKind::Int, 2},
+    {"9223372036854775807", NumberKind::Int, 19},
+    {"-9223372036854775808", NumberKind::Int, 20},
+    {"9223372036854775808", NumberKind::Float, 19},
+    {"123456789012345678901234567890", NumberKind::Float, 30},
+    {"1.5", NumberKind::Float, 3},
+    {"-0.0", NumberKind::Float, 4},
+    {"1e3", NumberKind::Float, 3},
+    {"2.5E-3]", NumberKind::Float, 6},
+    {"0.1", NumberKind::Float, 3},
+    {"3.141592653589793238462643383279", NumberKind::Float, 32},
+    {"1e23", NumberKind::Float, 4},
+    {"123e25", NumberKind::Float, 6},
+    {"4.9406564584124654e-324", NumberKind::Float, 23},
+    {"1.7976931348623157e308", NumberKind::Float, 22},
+    {"9007199254740993", NumberKind::Int, 16},
+    {"9007199254740993.0", NumberKind::Float, 18},
+    {"0.000000000000000000000000000001", NumberKind::Float, 32},
+    {"1e-400", NumberKind::Float, 6},
+    {"1e309", NumberKind::OutOfRange, 5},
+    {"-1e309", NumberKind::OutOfRange, 6},
+    {"1.8e308", NumberKind::OutOfRange, 7},
+    {"1e99999999999", NumberKind::OutOfRange, 13},
+    {"01", NumberKind::Invalid, 0},
+    {"1.", NumberKind::Invalid, 0},
+    {".5", NumberKind::Invalid, 0},
+    {"-", NumberKind::Invalid, 0},
+    {"+1", NumberKind::Invalid, 0},
+    {"1e", NumberKind::Invalid, 0},
+    {"1e+", NumberKind::Invalid, 0},
+};
+
+
+static s32 check_case(const NumberTestCase *test)
+{
+    ParsedNumber number;
+    size_t read = numbers::parse(&number, test->text, strlen(test->text));
+
+    if (read != test->read || (read && number.kind != test->kind))
+    {
+        printf_ln("Parsing '%s': read %i chars as kind %i, expected %i chars as kind %i", test->text,
+                  (s32)read, (s32)number.kind, (s32)test->read, (s32)test->kind);
+        return 1;
+    }
+
+    if (!read)
+    {
+        return 0;
+    }
+
+    char text[64];
+    memcpy(text, test->text, read);
+    text[read] = '\0';
+
+    if (number.kind == NumberKind::Int && number.int_val != strtoll(text, nullptr, 10))
+    {
+        printf_ln("Parsing '%s' gave %lli", text, (long long)number.int_val);
+        return 1;
+    }
+
+    // Has to be exactly what strtod rounds to, not just close
+    f64 expected = strtod(text, nullptr);
+    if (number.kind == NumberKind::Float && memcmp(&number.float_val, &expected, sizeof(expected)) != 0)
+    {
+        printf_ln("Parsing '%s' gave %.17g, strtod gives %.17g", text, number.float_val, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+s32 run_numbers_tests()
+{
+    s32 fails = 0;
+
+    for (size_t i = 0; i < COUNTOF(number_test_cases); ++i)
+    {
+        fails += check_case(&number_test_cases[i]);
+    }
+
+    // Formatting then parsing any finite double gives it back exactly
+    u64 bits = 0x9E3779B97F4A7C15ull;
+    for (s32 i = 0; i < 10000; ++i)
+    {
+        bits = bits * 6364136223846793005ull + 1442695040888963407ull;
+        f64 value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value != value || value - value != 0.0)
+        {
+            continue;
+        }
+
+        char text[64];
+        size_t length = numbers::format_float(text, sizeof(text), value);
+
+        ParsedNumber number;
+        size_t read = numbers::parse(&number, text, length);
+        if (read != length || number.kind != NumberKind::Float
+            || memcmp(&number.float_val, &value, sizeof(value)) != 0)
+        {
+            printf_ln("%.17g formatted as '%s' didn't read back the same", value, text);
+            ++fails;
+        }
+    }
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i number parsing test failures", fails);
+    }
+    else
+    {
+        println("No failures in number parsing tests");
+    }
+
+    return fails;
+}
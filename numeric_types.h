@@ -7,6 +7,7 @@
 #include <cstddef>
 
 typedef float f32;
+typedef double f64;
 
 typedef uint8_t u8;
 typedef uint16_t u16;
@@ -194,5 +195,36 @@ T narrow( U u ) //NOEXCEPT
 
 
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// value must be nonzero
+inline u32 count_trailing_zeros(u64 value)
+{
+    assert(value != 0);
+#if defined(__clang__) || defined(__GNUC__)
+    return (u32)__builtin_ctzll(value);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    #error Need count_trailing_zeros for compiler
+#endif
+}
+
+inline u32 popcount(u64 value)
+{
+#if defined(__clang__) || defined(__GNUC__)
+    return (u32)__builtin_popcountll(value);
+#elif defined(_MSC_VER)
+    return (u32)__popcnt64(value);
+#else
+    #error Need popcount for compiler
+#endif
+}
+
+
 #define NUMERIC_TYPES_H
 #endif
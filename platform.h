@@ -29,7 +29,7 @@ struct PlatformError
 
     void release()
     {
-        if (message.data) str_free(&message);
+        str_free(&message);
     }
 
     static PlatformError from_code(ErrorCode code);
@@ -82,10 +82,13 @@ PlatformError change_dir(const char *path);
 
 PlatformError resolve_path(OUTPARAM Str *dest, const char *path);
 
+// Not an error if the directory already exists
+PlatformError make_dir(const char *path);
+
 
 inline PlatformError change_dir(const Str path)
 {
-    return change_dir(path.data);
+    return change_dir(str_data(path));
 }
 
 
@@ -98,6 +101,23 @@ inline PlatformError change_dir(StrSlice path)
 }
 
 
+// Runs fn(userdata) on a new thread, which must be joined exactly once
+struct PlatformThread
+{
+    void *handle;
+};
+
+typedef void PlatformThreadFn(void *userdata);
+
+// False if the thread couldn't be started
+bool start_thread(OUTPARAM PlatformThread *thread, PlatformThreadFn *fn, void *userdata);
+
+void join_thread(PlatformThread *thread);
+
+// Logical processors online, at least 1
+u32 processor_count();
+
+
 void end_of_program();
 
 void waitkey();
@@ -3,12 +3,14 @@
 #include "platform.h"
 #include "formatbuffer.h"
 #include "logging.h"
+#include "profiler.h"
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <mach/mach_time.h>
 #include <cerrno>
 #include <dirent.h>
 #include <unistd.h>
+#include <pthread.h>
 
 
 #include <execinfo.h>
@@ -22,7 +24,8 @@
 PlatformError current_dir(OUTPARAM Str *result)
 {
     str_ensure_capacity(result, MAXPATHLEN);
-    char *ok = getcwd(result->data, result->capacity);
+    char *ok = getcwd(str_data(result), str_capacity(*result));
+    str_set_length(result, ok ? STRLEN(std::strlen(ok)) : 0);
 
     PlatformError error_result = ok
         ? PlatformError::from_code(0)
@@ -50,17 +53,85 @@ PlatformError resolve_path(Str *dest, const char *path)
     PlatformError error = {};
     str_ensure_capacity(dest, MAXPATHLEN);
 
-    bool ok = realpath(path, dest->data);
+    bool ok = realpath(path, str_data(dest));
 
     if (!ok)
     {
         error = PlatformError::from_code(errno);
+        str_set_length(dest, 0);
+    }
+    else
+    {
+        str_set_length(dest, STRLEN(std::strlen(str_data(dest))));
     }
 
     return error;
 }
 
 
+PlatformError make_dir(const char *path)
+{
+    PlatformError result = {};
+    if (0 != mkdir(path, 0755) && errno != EEXIST)
+    {
+        result = PlatformError::from_code(errno);
+    }
+    return result;
+}
+
+
+struct PThreadStart
+{
+    pthread_t pthread;
+    PlatformThreadFn *fn;
+    void *userdata;
+};
+
+
+static void *pthread_start(void *arg)
+{
+    PThreadStart *start = (PThreadStart *)arg;
+    start->fn(start->userdata);
+    profiler::thread_finished();
+    return nullptr;
+}
+
+
+bool start_thread(PlatformThread *thread, PlatformThreadFn *fn, void *userdata)
+{
+    PThreadStart *start = MAKE_OBJ_CAT(mem::default_allocator(), "thread", PThreadStart);
+    start->fn = fn;
+    start->userdata = userdata;
+
+    if (0 != pthread_create(&start->pthread, nullptr, pthread_start, start))
+    {
+        mem::default_allocator()->dealloc(start);
+        thread->handle = nullptr;
+        return false;
+    }
+
+    thread->handle = start;
+    return true;
+}
+
+
+void join_thread(PlatformThread *thread)
+{
+    PThreadStart *start = (PThreadStart *)thread->handle;
+    assert(start);
+    pthread_join(start->pthread, nullptr);
+    mem::default_allocator()->dealloc(start);
+    thread->handle = nullptr;
+}
+
+
+u32 processor_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+
 void end_of_program()
 {
     // noop
@@ -102,15 +173,15 @@ Str read_file(const char *filename)
     PlatformError err = read_filesize(&read_filesize_result, filename);
     if (err.is_error())
     {
-        logf("Failed to stat file: %s\nReason: %s", filename, err.message.data);
+        logf("Failed to stat file: %s\nReason: %s", filename, str_data(err.message));
     }
 
-    u16 filesize = STRLEN(read_filesize_result);
+    StrLen filesize = STRLEN(read_filesize_result);
     result = str_alloc(filesize);
     std::FILE *f = std::fopen(filename, "r");
     assert(f);
-    size_t bytes_read = fread(result.data, 1, filesize, f);
-    result.length = filesize;
+    size_t bytes_read = fread(str_data(&result), 1, filesize, f);
+    str_set_length(&result, filesize);
     fclose(f);
 
     assert(bytes_read == filesize);
@@ -155,7 +226,8 @@ FileReadResult read_text_file(Str *dest, const char *filename)
     // other PlatformError instances do the same thing
 
     StrLen filesize = STRLEN(filesize_outparam);
-    str_ensure_capacity(dest, filesize);
+    // room for the null terminator too
+    str_ensure_capacity(dest, filesize + 1);
     std::FILE *f = std::fopen(filename, "r");
 
     if (!f)
@@ -164,7 +236,7 @@ FileReadResult read_text_file(Str *dest, const char *filename)
         return FileReadResult::from_error_code(errno);
     }
 
-    size_t bytes_read = fread(dest->data, 1, filesize, f);
+    size_t bytes_read = fread(str_data(dest), 1, filesize, f);
 
     if (bytes_read != filesize)
     {
@@ -177,7 +249,7 @@ FileReadResult read_text_file(Str *dest, const char *filename)
         return error_result;
     }
 
-    dest->length = filesize;
+    str_set_length(dest, filesize);
 
     int fcloseerr = fclose(f);
     assert(fcloseerr == 0);
@@ -217,7 +289,7 @@ PlatformError PlatformError::from_code(ErrorCode error_code)
     else
     {
         errormsg = str_alloc(MaxMessageLen);
-        int strerror_error = strerror_r(error_code, errormsg.data, errormsg.capacity);
+        int strerror_error = strerror_r(error_code, str_data(&errormsg), str_capacity(errormsg));
         if (strerror_error == ERANGE)
         {
             logln("WARNING: error message truncated");
@@ -305,7 +377,7 @@ static void DirLister_init(DirLister *dl, Str path)
 {
     mem::zero_ptr(dl);
 
-    DIR *dirp = opendir(path.data);
+    DIR *dirp = opendir(str_data(path));
 
     if (!dirp)
     {
@@ -316,13 +388,13 @@ static void DirLister_init(DirLister *dl, Str path)
 
     // Assumes ownership of path
     // Always end in a path separator
-    if (path.data[path.length - 1] != '/')
+    if (str_data(path)[str_length(path) - 1] != '/')
     {
         str_append(&path, '/');
     }
     else
     {
-        while (path.length > 2 && path.data[path.length - 2] == '/')
+        while (str_length(path) > 2 && str_data(path)[str_length(path) - 2] == '/')
         {
             str_popchar(&path);
         }
@@ -334,7 +406,7 @@ static void DirLister_init(DirLister *dl, Str path)
 
     // current.access_path will always be prefixed by path
     str_overwrite(&dl->current.access_path, str_slice(dl->path));
-    dl->current.name = str_slice(dl->current.access_path.data + dl->current.access_path.length, size_t(0));
+    dl->current.name = str_slice(str_data(dl->current.access_path) + str_length(dl->current.access_path), size_t(0));
 }
 
 
@@ -441,8 +513,8 @@ bool DirLister::next()
                 this->current.is_directory = true;
 
                 StrSlice nameslice = str_slice(entry.d_name);
-                str_copy_truncate(&this->current.access_path, this->path.length, nameslice, 0, nameslice.length);
-                this->current.name = str_slice(this->current.access_path.data + this->path.length);
+                str_copy_truncate(&this->current.access_path, str_length(this->path), nameslice, 0, nameslice.length);
+                this->current.name = str_slice(str_data(this->current.access_path) + str_length(this->path));
                 break;
             }
 
@@ -454,13 +526,13 @@ bool DirLister::next()
         this->stream_loc = telldir(dirp);
 
         StrSlice nameslice = str_slice(entry.d_name);
-        str_copy_truncate(&this->current.access_path, this->path.length, nameslice, 0, nameslice.length);
-        this->current.name = str_slice(this->current.access_path.data + this->path.length);
+        str_copy_truncate(&this->current.access_path, str_length(this->path), nameslice, 0, nameslice.length);
+        this->current.name = str_slice(str_data(this->current.access_path) + str_length(this->path));
 
         if (this->current.is_file)
         {
             size_t filesize_result;
-            PlatformError staterror = read_filesize(OUTPARAM &filesize_result, this->current.access_path.data);
+            PlatformError staterror = read_filesize(OUTPARAM &filesize_result, str_data(this->current.access_path));
             if (staterror.is_error())
             {
                 this->error = staterror;
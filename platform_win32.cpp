@@ -33,11 +33,11 @@ Str read_file(const char *filename)
     }
 
     assert(statbuf.st_size > 0);
-    u16 filesize = (u16)statbuf.st_size;
+    StrLen filesize = STRLEN(statbuf.st_size);
     result = str_alloc(filesize);
     std::FILE *f = std::fopen(filename, "r");
-    size_t bytes_read = fread(result.data, 1, filesize, f);
-    result.length = filesize;
+    size_t bytes_read = fread(str_data(&result), 1, filesize, f);
+    str_set_length(&result, filesize);
     fclose(f);
 
     assert(bytes_read == filesize);
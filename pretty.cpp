@@ -1,5 +1,6 @@
 #include "pretty.h"
 #include "logging.h"
+#include "numbers.h"
 #include "common.h"
 
 
@@ -127,16 +128,20 @@ void pretty_print(const Value *value, FormatBuffer *fmt_buf, int indent)
             break;
 
         case TypeID::String:
-            fmt_buf->writef_ln("'%s'", value->str_val.data);
+            fmt_buf->writef_ln("'%s'", str_data(value->str_val));
             break;
 
         case TypeID::Int:
-            fmt_buf->writef_ln("%i", value->s32_val);
+            fmt_buf->writef_ln("%lli", (long long)value->s64_val);
             break;
 
         case TypeID::Float:
-            fmt_buf->writef_ln("%f", value->f32_val);
+        {
+            char text[32];
+            numbers::format_float(text, sizeof(text), value->f64_val);
+            fmt_buf->writeln(text);
             break;
+        }
 
         case TypeID::Bool:
             fmt_buf->writef_ln("%s", (value->bool_val ? "True" : "False"));
@@ -0,0 +1,301 @@
+#include "profiler.h"
+#include "platform.h"
+#include "atomics.h"
+#include "memory.h"
+#include "common.h"
+#include "formatbuffer.h"
+#include <cstdio>
+#include <cstring>
+
+// Must be a power of two
+#define PROF_EVENTS_PER_THREAD 65536
+#define PROF_EVENT_INDEX_MASK (PROF_EVENTS_PER_THREAD - 1)
+// Threads past this many at once don't get a buffer and their zones
+// aren't recorded
+#define PROF_MAX_THREADS 64
+
+#if defined(_MSC_VER)
+#define PROF_THREAD_LOCAL __declspec(thread)
+#else
+#define PROF_THREAD_LOCAL __thread
+#endif
+
+
+struct ProfThreadBuffer
+{
+    // total events written, never wraps
+    volatile u64 write_count;
+
+    // owning thread only
+    u16 thread_index;
+    u16 depth;
+
+    ProfEvent events[PROF_EVENTS_PER_THREAD];
+};
+
+
+static ProfThreadBuffer *volatile thread_buffers[PROF_MAX_THREADS] = {};
+static volatile u32 thread_buffer_count = 0;
+static volatile u64 profiler_epoch = 0;
+
+// Buffers of threads that finished, new threads take these first
+static SpinLock free_buffers_lock = {};
+static ProfThreadBuffer *free_buffers[PROF_MAX_THREADS];
+static u32 free_buffer_count = 0;
+
+static PROF_THREAD_LOCAL ProfThreadBuffer *this_thread_buffer = 0;
+static PROF_THREAD_LOCAL bool this_thread_out_of_buffers = false;
+
+
+static ProfThreadBuffer *get_thread_buffer()
+{
+    if (this_thread_buffer || this_thread_out_of_buffers)
+    {
+        return this_thread_buffer;
+    }
+
+    if (atomic::load_acquire(&profiler_epoch) == 0)
+    {
+        atomic::compare_exchange(&profiler_epoch, 0, query_abstime());
+    }
+
+    ProfThreadBuffer *reused = nullptr;
+    {
+        SpinLockGuard guard(&free_buffers_lock);
+        if (free_buffer_count)
+        {
+            reused = free_buffers[--free_buffer_count];
+        }
+    }
+    if (reused)
+    {
+        this_thread_buffer = reused;
+        return reused;
+    }
+
+    // Only with PROF_MAX_THREADS other threads holding buffers is this out
+    u32 index = atomic::fetch_add(&thread_buffer_count, 1u);
+    if (index >= PROF_MAX_THREADS)
+    {
+        this_thread_out_of_buffers = true;
+        return nullptr;
+    }
+
+    ProfThreadBuffer *buffer = MAKE_ZEROED_ARRAY_CAT(mem::default_allocator(), 1, "profiler", ProfThreadBuffer);
+    buffer->thread_index = (u16)index;
+    atomic::store_release(&thread_buffers[index], buffer);
+
+    this_thread_buffer = buffer;
+    return buffer;
+}
+
+
+// Buffer for a thread index, or null if that thread hasn't published it yet
+static ProfThreadBuffer *thread_buffer_at(u32 index)
+{
+    return atomic::load_acquire(&thread_buffers[index]);
+}
+
+
+static u32 published_thread_count()
+{
+    u32 count = atomic::load_acquire(&thread_buffer_count);
+    return min(count, (u32)PROF_MAX_THREADS);
+}
+
+
+namespace profiler
+{
+
+ProfZoneMark begin_zone()
+{
+    ProfZoneMark result = {};
+    ProfThreadBuffer *buffer = get_thread_buffer();
+    if (buffer)
+    {
+        ++buffer->depth;
+        result.recording = true;
+        result.begin = query_abstime();
+    }
+    return result;
+}
+
+
+void end_zone(ProfZoneMark *mark, const char *name, ProfCategory::Tag category)
+{
+    if (!mark->recording)
+    {
+        return;
+    }
+
+    u64 end = query_abstime();
+    ProfThreadBuffer *buffer = this_thread_buffer;
+    assert(buffer && buffer->depth > 0);
+    --buffer->depth;
+
+    u64 count = buffer->write_count;
+    ProfEvent *event = &buffer->events[count & PROF_EVENT_INDEX_MASK];
+    event->name = name;
+    event->begin = mark->begin;
+    event->end = end;
+    event->thread_index = buffer->thread_index;
+    event->depth = buffer->depth;
+    event->category = (u8)category;
+
+    atomic::store_release(&buffer->write_count, count + 1);
+    mark->recording = false;
+}
+
+
+u16 current_thread_index()
+{
+    ProfThreadBuffer *buffer = get_thread_buffer();
+    return buffer ? buffer->thread_index : UINT16_MAX;
+}
+
+
+void thread_finished()
+{
+    ProfThreadBuffer *buffer = this_thread_buffer;
+    this_thread_buffer = nullptr;
+    this_thread_out_of_buffers = false;
+    if (!buffer)
+    {
+        return;
+    }
+
+    assert(buffer->depth == 0);
+    SpinLockGuard guard(&free_buffers_lock);
+    assert(free_buffer_count < PROF_MAX_THREADS);
+    free_buffers[free_buffer_count++] = buffer;
+}
+
+
+void copy_thread_events(DynArray<ProfEvent> *dest, u16 thread_index, u64 since_abstime)
+{
+    if (thread_index >= published_thread_count())
+    {
+        return;
+    }
+
+    ProfThreadBuffer *buffer = thread_buffer_at(thread_index);
+    if (!buffer)
+    {
+        return;
+    }
+
+    u64 count = atomic::load_acquire(&buffer->write_count);
+    u64 oldest = count > PROF_EVENTS_PER_THREAD ? count - PROF_EVENTS_PER_THREAD : 0;
+
+    // Events are written as zones end, so end times only go up
+    u64 first = count;
+    while (first > oldest && buffer->events[(first - 1) & PROF_EVENT_INDEX_MASK].end > since_abstime)
+    {
+        --first;
+    }
+
+    DynArrayCount dest_start = dest->count;
+    dynarray::ensure_capacity(dest, dest->count + (DynArrayCount)(count - first));
+    for (u64 i = first; i < count; ++i)
+    {
+        dynarray::append(dest, buffer->events[i & PROF_EVENT_INDEX_MASK]);
+    }
+
+    // Drop whatever the writer lapped while we were copying, including the
+    // slot it may be writing right now
+    atomic::fence_acquire();
+    u64 count_after = atomic::load_acquire(&buffer->write_count) + 1;
+    u64 still_valid = count_after > PROF_EVENTS_PER_THREAD ? count_after - PROF_EVENTS_PER_THREAD : 0;
+    if (still_valid > first)
+    {
+        DynArrayCount lapped = (DynArrayCount)min(still_valid - first, count - first);
+        std::memmove(&dest->data[dest_start], &dest->data[dest_start + lapped],
+                     (dest->count - dest_start - lapped) * sizeof(ProfEvent));
+        dest->count -= lapped;
+    }
+}
+
+
+void copy_events(DynArray<ProfEvent> *dest, u64 since_abstime)
+{
+    for (u32 i = 0, e = published_thread_count(); i < e; ++i)
+    {
+        copy_thread_events(dest, (u16)i, since_abstime);
+    }
+}
+
+
+u64 epoch()
+{
+    return atomic::load_acquire(&profiler_epoch);
+}
+
+
+static void write_json_string(FormatBuffer *fmtbuf, const char *string)
+{
+    fmtbuf->write('"');
+    for (const char *c = string; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fmtbuf->write('\\');
+            fmtbuf->write(*c);
+        }
+        else if ((u8)*c < 0x20)
+        {
+            fmtbuf->writef("\\u%04x", (u32)(u8)*c);
+        }
+        else
+        {
+            fmtbuf->write(*c);
+        }
+    }
+    fmtbuf->write('"');
+}
+
+
+s64 write_chrome_trace(const char *filename)
+{
+    std::FILE *file = std::fopen(filename, "wb");
+    if (!file)
+    {
+        return -1;
+    }
+
+    DynArray<ProfEvent> events = dynarray::init<ProfEvent>(0);
+    copy_events(&events, 0);
+
+    u64 start = epoch();
+    FormatBuffer fmtbuf;
+    fmtbuf.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (DynArrayCount i = 0; i < events.count; ++i)
+    {
+        const ProfEvent *event = &events[i];
+
+        fmtbuf.write(i == 0 ? "{\"name\":" : ",\n{\"name\":");
+        write_json_string(&fmtbuf, event->name);
+        fmtbuf.writef(",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                      ProfCategory::to_string(event->category),
+                      event->begin > start ? microseconds_since(event->begin, start) : 0.0,
+                      microseconds_since(event->end, event->begin),
+                      (u32)event->thread_index);
+
+        // FormatBuffer can't grow past 64K, so write out as we go
+        if (fmtbuf.cursor > KILOBYTES(32))
+        {
+            std::fwrite(fmtbuf.buffer, 1, fmtbuf.cursor, file);
+            fmtbuf.clear();
+        }
+    }
+
+    fmtbuf.write("\n]}\n");
+    std::fwrite(fmtbuf.buffer, 1, fmtbuf.cursor, file);
+    std::fclose(file);
+
+    s64 result = (s64)events.count;
+    dynarray::deinit(&events);
+    return result;
+}
+
+}
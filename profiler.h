@@ -0,0 +1,132 @@
+// -*- c++ -*-
+
+#ifndef PROFILER_H
+
+#include "numeric_types.h"
+#include "dynarray.h"
+
+
+/*
+Scoped timing zones. Each thread writes finished zones into its own
+fixed-size ring of events, so recording never takes a lock. Readers
+(the profiler window, profdump) copy events out of every thread's ring
+and drop any that the writer lapped while they were copying.
+
+A thread that exits hands its ring to the next thread that records, so
+a thread index is a ring, and short-lived threads one after another
+share one.
+
+Times are in query_abstime() units.
+*/
+
+namespace ProfCategory
+{
+
+enum Tag
+{
+    Zone,
+    Frame,
+    Command
+};
+
+inline const char *to_string(Tag tag)
+{
+    switch (tag)
+    {
+        case Zone:    return "zone";
+        case Frame:   return "frame";
+        case Command: return "command";
+    }
+}
+
+inline const char *to_string(u32 tag)
+{
+    return to_string((Tag)tag);
+}
+
+}
+
+
+struct ProfEvent
+{
+    // Must outlive the profiler, use literals or interned names
+    const char *name;
+    u64 begin;
+    u64 end;
+    u16 thread_index;
+    u16 depth;
+    u8 category;
+};
+
+
+struct ProfZoneMark
+{
+    u64 begin;
+    // false if this thread has no event buffer (too many threads)
+    bool recording;
+};
+
+
+namespace profiler
+{
+
+ProfZoneMark begin_zone();
+void end_zone(ProfZoneMark *mark, const char *name, ProfCategory::Tag category = ProfCategory::Zone);
+
+// Index of the calling thread's event buffer, as in ProfEvent::thread_index
+u16 current_thread_index();
+
+// The calling thread is exiting and has no open zones, its buffer goes
+// back for reuse. start_thread calls this, other threads have to.
+void thread_finished();
+
+// Appends events that ended after since_abstime, oldest first within
+// each thread. Pass 0 to copy everything still in the buffers.
+void copy_events(DynArray<ProfEvent> *dest, u64 since_abstime);
+void copy_thread_events(DynArray<ProfEvent> *dest, u16 thread_index, u64 since_abstime);
+
+// Abstime when the profiler started, trace timestamps are relative to it
+u64 epoch();
+
+// Writes everything still in the buffers as Chrome trace-event json
+// (load it in chrome://tracing or Perfetto). Returns the number of
+// events written, or -1 if the file couldn't be opened.
+s64 write_chrome_trace(const char *filename);
+
+}
+
+
+class ProfZone
+{
+public:
+    explicit ProfZone(const char *name_, ProfCategory::Tag category_ = ProfCategory::Zone)
+        : mark(profiler::begin_zone())
+        , name(name_)
+        , category(category_)
+    {
+    }
+
+    ~ProfZone()
+    {
+        profiler::end_zone(&mark, name, category);
+    }
+
+private:
+    ProfZoneMark mark;
+    const char *name;
+    ProfCategory::Tag category;
+
+    ProfZone(const ProfZone &);
+    ProfZone &operator=(const ProfZone &);
+};
+
+
+#define PROF_CONCAT_(a, b) a ## b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+#define PROF_ZONE(name) ProfZone PROF_CONCAT(prof_zone_, __LINE__)(name)
+#define PROF_FUNCTION() PROF_ZONE(__FUNCTION__)
+
+
+#define PROFILER_H
+#endif
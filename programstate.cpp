@@ -22,6 +22,9 @@ void prgstate_init(ProgramState *prgstate)
     bucketarray::init(&prgstate->type_descriptors);
     ht_init(&prgstate->typedesc_bindings);
     ht_init(&prgstate->typedesc_reverse_bindings);
+    prgstate->types_generation = 0;
+    prgstate->type_scratch = nullptr;
+    prgstate->type_collection_requested = false;
 
     bucketarray::init(&prgstate->collections);
 
@@ -29,6 +32,13 @@ void prgstate_init(ProgramState *prgstate)
     ht_init(&prgstate->value_map);
 
     dynarray::init(&prgstate->editing_collections, 0);
+    dynarray::init(&prgstate->flat_views, 0);
+
+    mem::zero_obj(prgstate->alloc_baseline);
+
+    prgstate->async_commands = false;
+    dynarray::init(&prgstate->jobs, 0);
+    prgstate->last_job_id = 0;
 }
 
 
@@ -44,6 +54,67 @@ void drop_collection(ProgramState *prgstate, BucketIndex bucket_index)
         dynarray::swappop(&prgstate->editing_collections, edit_index);
     }
 
+    // Closing one can close others, so start over each time
+    for (DynArrayCount i = 0; i < prgstate->flat_views.count;)
+    {
+        if (prgstate->flat_views[i]->collection == coll)
+        {
+            close_flat_view(prgstate, prgstate->flat_views[i]);
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
     bool removed = bucketarray::remove_at(&prgstate->collections, bucket_index);
     ASSERT(removed);
+
+    // Not right away, the caller may still have values of its types around
+    request_type_collection(prgstate);
+}
+
+
+FlatView *open_flat_view(ProgramState *prgstate, Collection *collection, FlatView *parent_view, NameRef member)
+{
+    for (DynArrayCount i = 0; i < prgstate->flat_views.count; ++i)
+    {
+        FlatView *view = prgstate->flat_views[i];
+        if (view->collection == collection && view->parent_view == parent_view
+            && nameref::identical(view->member, member))
+        {
+            return view;
+        }
+    }
+
+    FlatView *view = MAKE_OBJ_CAT(mem::default_allocator(), "flatview", FlatView);
+    flatview::init(view, collection, parent_view, member);
+    dynarray::append(&prgstate->flat_views, view);
+    return view;
+}
+
+
+void close_flat_view(ProgramState *prgstate, FlatView *view)
+{
+    for (DynArrayCount i = 0; i < prgstate->flat_views.count;)
+    {
+        if (prgstate->flat_views[i]->parent_view == view)
+        {
+            close_flat_view(prgstate, prgstate->flat_views[i]);
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    DynArrayCount index;
+    bool found = dynarray::try_find_index(&index, &prgstate->flat_views, view);
+    ASSERT(found);
+    dynarray::remove_at(&prgstate->flat_views, index);
+
+    flatview::deinit(view);
+    mem::default_allocator()->dealloc(view);
 }
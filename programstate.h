@@ -9,6 +9,9 @@
 #include "typesys.h"
 #include "clicommands.h"
 #include "typesys_json.h"
+#include "allocstats.h"
+#include "jobs.h"
+#include "flatview.h"
 
 
 typedef OAHashtable<StrSlice, Value, StrSliceEqual, StrSliceHash> StrToValueMap;
@@ -33,6 +36,10 @@ struct Collection
     // Will be an array of top_typedesc
     Value value;
     DynArray<RecordInfo> info;
+
+    // Derived from another collection, like groupby's, so edits would
+    // just be thrown away
+    bool read_only;
 };
 
 
@@ -47,8 +54,14 @@ struct ProgramState
 {
     NameTable names;
     BucketArray<TypeDescriptor> type_descriptors;
-    OAHashtable<NameRef, TypeDescriptor *> typedesc_bindings;
+    OAHashtable<NameRef, TypeBinding> typedesc_bindings;
     OAHashtable<TypeDescriptor *, DynArray<NameRef> > typedesc_reverse_bindings;
+    // Bumped whenever a type descriptor or name binding is added or
+    // removed, so views of the type table know when to rebuild
+    u64 types_generation;
+    // Where new types go instead while it's set, see TypeScratch
+    TypeScratch *type_scratch;
+    bool type_collection_requested;
 
     TypeDescriptor *prim_string;
     TypeDescriptor *prim_int;
@@ -63,6 +76,17 @@ struct ProgramState
 
     bool colection_editor_active;
     DynArray<Collection *> editing_collections;
+    // Nested arrays opened from an editor as tables of their own
+    DynArray<FlatView *> flat_views;
+
+    // set by memsnap, memstats and the allocations window report changes since it
+    AllocSnapshot alloc_baseline;
+
+    // Only front ends with a frame loop calling jobs::update set this,
+    // otherwise long commands like loadjson finish before returning
+    bool async_commands;
+    DynArray<Job *> jobs;
+    u32 last_job_id;
 };
 
 
@@ -79,5 +103,10 @@ void prgstate_init(ProgramState *prgstate);
 
 void drop_collection(ProgramState *prgstate, BucketIndex bucket_index);
 
+// Returns the one already open if there is one
+FlatView *open_flat_view(ProgramState *prgstate, Collection *collection, FlatView *parent_view, NameRef member);
+// Also closes the views opened from it
+void close_flat_view(ProgramState *prgstate, FlatView *view);
+
 #define PROGRAMSTATE_H
 #endif
@@ -0,0 +1,892 @@
+#include "schema.h"
+#include "numbers.h"
+#include "hashtable.h"
+#include "atomics.h"
+#include "memory.h"
+#include "profiler.h"
+#include "common.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+
+namespace schema
+{
+
+static u32 compile_node(CompiledSchema *compiled, OAHashtable<TypeDescriptor *, u32> *compiled_nodes,
+                        TypeDescriptor *typedesc)
+{
+    u32 *existing = ht_find(compiled_nodes, typedesc);
+    if (existing)
+    {
+        return *existing;
+    }
+
+    u32 index = compiled->nodes.count;
+    SchemaNode node = {typedesc->type_id, 0, 0};
+    dynarray::append(&compiled->nodes, node);
+    ht_set(compiled_nodes, typedesc, index);
+
+    // Children are compiled first so this node's members and cases end
+    // up next to each other
+    TYPESWITCH (typedesc->type_id)
+    {
+        case TypeID::None:
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+            break;
+
+        case TypeID::Array:
+            node.first = compile_node(compiled, compiled_nodes, typedesc->array_type.elem_type);
+            break;
+
+        case TypeID::Compound:
+        {
+            const DynArray<CompoundTypeMember> *members = &typedesc->compound_type.members;
+            DynArray<u32> member_nodes = dynarray::init<u32>(members->count);
+            for (DynArrayCount i = 0; i < members->count; ++i)
+            {
+                dynarray::append(&member_nodes, compile_node(compiled, compiled_nodes, (*members)[i].typedesc));
+            }
+
+            node.first = compiled->members.count;
+            node.count = members->count;
+            for (DynArrayCount i = 0; i < members->count; ++i)
+            {
+                SchemaMember member = {nameref::str_slice((*members)[i].name), member_nodes[i]};
+                dynarray::append(&compiled->members, member);
+            }
+            dynarray::deinit(&member_nodes);
+            break;
+        }
+
+        case TypeID::Union:
+        {
+            const DynArray<TypeDescriptor *> *type_cases = &typedesc->union_type.type_cases;
+            DynArray<u32> case_nodes = dynarray::init<u32>(type_cases->count);
+            for (DynArrayCount i = 0; i < type_cases->count; ++i)
+            {
+                dynarray::append(&case_nodes, compile_node(compiled, compiled_nodes, (*type_cases)[i]));
+            }
+
+            node.first = compiled->cases.count;
+            node.count = type_cases->count;
+            dynarray::append_from(&compiled->cases, &case_nodes);
+            dynarray::deinit(&case_nodes);
+            break;
+        }
+    }
+
+    compiled->nodes[index] = node;
+    return index;
+}
+
+
+void compile(OUTPARAM CompiledSchema *compiled, TypeDescriptor *typedesc)
+{
+    PROF_FUNCTION();
+
+    dynarray::init(&compiled->nodes, 16);
+    dynarray::init(&compiled->members, 32);
+    dynarray::init(&compiled->cases, 8);
+
+    // Types are shared, so are their nodes
+    OAHashtable<TypeDescriptor *, u32> compiled_nodes;
+    ht_init(&compiled_nodes);
+    compiled->root = compile_node(compiled, &compiled_nodes, typedesc);
+    ht_deinit(&compiled_nodes);
+}
+
+
+void deinit(CompiledSchema *compiled)
+{
+    dynarray::deinit(&compiled->nodes);
+    dynarray::deinit(&compiled->members);
+    dynarray::deinit(&compiled->cases);
+}
+
+
+void init_validator(SchemaValidator *validator, const CompiledSchema *compiled)
+{
+    mem::zero_ptr(validator);
+    validator->compiled = compiled;
+    // + 1 so a schema without members still gets a block
+    DynArrayCount stamp_count = compiled->members.count + 1;
+    validator->member_stamps = MAKE_ZEROED_ARRAY_CAT(mem::default_allocator(), stamp_count, "schema", u32);
+    validator->next_stamp = 1;
+}
+
+
+void deinit_validator(SchemaValidator *validator)
+{
+    mem::default_allocator()->dealloc(validator->member_stamps);
+    validator->member_stamps = nullptr;
+}
+
+
+// Where to go back to when a union case doesn't match
+struct ValidatorPosition
+{
+    const char *cursor;
+    size_t line;
+    const char *line_start;
+};
+
+
+static ValidatorPosition save_position(const SchemaValidator *v)
+{
+    ValidatorPosition pos = {v->cursor, v->line, v->line_start};
+    return pos;
+}
+
+
+static void restore_position(SchemaValidator *v, ValidatorPosition pos)
+{
+    v->cursor = pos.cursor;
+    v->line = pos.line;
+    v->line_start = pos.line_start;
+}
+
+
+static bool fail(SchemaValidator *v, const char *at, const char *fmt, ...)
+{
+    SchemaError *error = v->error;
+    error->offset = (size_t)(at - v->input);
+    error->line = v->line;
+    error->column = (size_t)(at - v->line_start) + 1;
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(error->message, sizeof(error->message), fmt, args);
+    va_end(args);
+    return false;
+}
+
+
+static const char *describe(u32 type_id)
+{
+    TYPESWITCH ((TypeID::Tag)type_id)
+    {
+        case TypeID::None:     return "null";
+        case TypeID::String:   return "a string";
+        case TypeID::Int:      return "an integer";
+        case TypeID::Float:    return "a float";
+        case TypeID::Bool:     return "true or false";
+        case TypeID::Array:    return "an array";
+        case TypeID::Compound: return "an object";
+        case TypeID::Union:    return "a union";
+    }
+    return "<invalid>";
+}
+
+
+static bool skip_space(SchemaValidator *v)
+{
+    while (v->cursor < v->end)
+    {
+        char c = *v->cursor;
+        if (c == '\n')
+        {
+            ++v->cursor;
+            ++v->line;
+            v->line_start = v->cursor;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r')
+        {
+            ++v->cursor;
+        }
+        else if (c == '/' && v->cursor + 1 < v->end && v->cursor[1] == '/')
+        {
+            while (v->cursor < v->end && *v->cursor != '\n')
+            {
+                ++v->cursor;
+            }
+        }
+        else if (c == '/' && v->cursor + 1 < v->end && v->cursor[1] == '*')
+        {
+            const char *comment = v->cursor;
+            v->cursor += 2;
+            for (;;)
+            {
+                if (v->cursor + 1 >= v->end)
+                {
+                    v->cursor = v->end;
+                    return fail(v, comment, "unterminated comment");
+                }
+                if (v->cursor[0] == '*' && v->cursor[1] == '/')
+                {
+                    v->cursor += 2;
+                    break;
+                }
+                if (v->cursor[0] == '\n')
+                {
+                    ++v->line;
+                    v->line_start = v->cursor + 1;
+                }
+                ++v->cursor;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+
+static bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+
+static u32 hex_value(char c)
+{
+    return c <= '9' ? (u32)(c - '0') : (u32)((c | 0x20) - 'a' + 10);
+}
+
+
+// Leaves the cursor after the closing quote, contents are what's between
+// the quotes, escapes and all
+static bool scan_string(SchemaValidator *v, OUTPARAM StrSlice *contents, OUTPARAM bool *has_escapes)
+{
+    const char *open_quote = v->cursor++;
+    *has_escapes = false;
+
+    for (;;)
+    {
+        if (v->cursor >= v->end)
+        {
+            return fail(v, open_quote, "unterminated string");
+        }
+
+        char c = *v->cursor;
+        if (c == '"')
+        {
+            *contents = str_slice(open_quote + 1, v->cursor);
+            ++v->cursor;
+            return true;
+        }
+        if ((u8)c < 0x20)
+        {
+            return fail(v, v->cursor, "control character in a string");
+        }
+        if (c == '\\')
+        {
+            *has_escapes = true;
+            ++v->cursor;
+            if (v->cursor >= v->end || !std::strchr("\"\\/bfnrtu", *v->cursor))
+            {
+                return fail(v, v->cursor - 1, "invalid escape in a string");
+            }
+            if (*v->cursor == 'u')
+            {
+                for (int i = 1; i <= 4; ++i)
+                {
+                    if (v->cursor + i >= v->end || !is_hex(v->cursor[i]))
+                    {
+                        return fail(v, v->cursor - 1, "invalid \\u escape in a string");
+                    }
+                }
+                v->cursor += 4;
+            }
+        }
+        ++v->cursor;
+    }
+}
+
+
+// Decodes the escape at raw[*i], already validated, into up to 4 bytes
+static size_t decode_escape(StrSlice raw, size_t *i, char *out)
+{
+    char c = raw.data[*i + 1];
+    *i += 2;
+    switch (c)
+    {
+        case 'b': out[0] = '\b'; return 1;
+        case 'f': out[0] = '\f'; return 1;
+        case 'n': out[0] = '\n'; return 1;
+        case 'r': out[0] = '\r'; return 1;
+        case 't': out[0] = '\t'; return 1;
+        case 'u': break;
+        default:  out[0] = c;    return 1;
+    }
+
+    u32 code = 0;
+    for (int k = 0; k < 4; ++k)
+    {
+        code = (code << 4) | hex_value(raw.data[*i + k]);
+    }
+    *i += 4;
+
+    // A surrogate pair is two escapes
+    if (code >= 0xD800 && code < 0xDC00 && *i + 6 <= raw.length
+        && raw.data[*i] == '\\' && raw.data[*i + 1] == 'u')
+    {
+        u32 low = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            low = (low << 4) | hex_value(raw.data[*i + 2 + k]);
+        }
+        if (low >= 0xDC00 && low < 0xE000)
+        {
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            *i += 6;
+        }
+    }
+
+    if (code < 0x80)
+    {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+
+static bool key_matches(StrSlice raw, bool has_escapes, StrSlice name)
+{
+    if (!has_escapes)
+    {
+        return raw.length == name.length && 0 == std::memcmp(raw.data, name.data, name.length);
+    }
+
+    size_t matched = 0;
+    for (size_t i = 0; i < raw.length;)
+    {
+        char decoded[4];
+        size_t decoded_length = 1;
+        if (raw.data[i] == '\\')
+        {
+            decoded_length = decode_escape(raw, &i, decoded);
+        }
+        else
+        {
+            decoded[0] = raw.data[i++];
+        }
+
+        if (matched + decoded_length > name.length
+            || 0 != std::memcmp(decoded, name.data + matched, decoded_length))
+        {
+            return false;
+        }
+        matched += decoded_length;
+    }
+    return matched == name.length;
+}
+
+
+// Int or Float by the same rule as loading, an integer too big for an
+// s64 is a Float
+static bool scan_number(SchemaValidator *v, OUTPARAM bool *is_float)
+{
+    ParsedNumber number;
+    size_t read = numbers::parse(&number, v->cursor, (size_t)(v->end - v->cursor));
+    if (!read)
+    {
+        return fail(v, v->cursor, "invalid number");
+    }
+    if (number.kind == NumberKind::OutOfRange)
+    {
+        return fail(v, v->cursor, "number too big for a double");
+    }
+    v->cursor += read;
+    *is_float = number.kind == NumberKind::Float;
+    return true;
+}
+
+
+static bool scan_literal(SchemaValidator *v, const char *literal)
+{
+    size_t length = std::strlen(literal);
+    if ((size_t)(v->end - v->cursor) < length || 0 != std::memcmp(v->cursor, literal, length))
+    {
+        return fail(v, v->cursor, "invalid literal, expected %s", literal);
+    }
+    v->cursor += length;
+    return true;
+}
+
+
+// Whether an empty array fits, checktype sees its element type as None
+static bool accepts_none(const CompiledSchema *compiled, u32 node_index)
+{
+    const SchemaNode *node = &compiled->nodes[node_index];
+    if (node->type_id == TypeID::None)
+    {
+        return true;
+    }
+    if (node->type_id == TypeID::Union)
+    {
+        for (u32 i = 0; i < node->count; ++i)
+        {
+            if (compiled->nodes[compiled->cases[node->first + i]].type_id == TypeID::None)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+static bool check_value(SchemaValidator *v, u32 node_index);
+
+
+static bool check_object(SchemaValidator *v, const SchemaNode *node)
+{
+    const CompiledSchema *compiled = v->compiled;
+    const char *open_brace = v->cursor++;
+
+    u32 stamp = v->next_stamp++;
+    if (v->next_stamp == 0)
+    {
+        std::memset(v->member_stamps, 0, sizeof(u32) * compiled->members.count);
+        v->next_stamp = 1;
+        stamp = v->next_stamp++;
+    }
+
+    u32 matched = 0;
+    if (!skip_space(v))
+    {
+        return false;
+    }
+    if (v->cursor < v->end && *v->cursor == '}')
+    {
+        ++v->cursor;
+    }
+    else for (;;)
+    {
+        if (v->cursor >= v->end || *v->cursor != '"')
+        {
+            return fail(v, v->cursor < v->end ? v->cursor : open_brace, "expected a member name");
+        }
+
+        const char *key_at = v->cursor;
+        StrSlice key;
+        bool has_escapes;
+        if (!scan_string(v, &key, &has_escapes) || !skip_space(v))
+        {
+            return false;
+        }
+        if (v->cursor >= v->end || *v->cursor != ':')
+        {
+            return fail(v, v->cursor < v->end ? v->cursor : key_at, "expected ':' after a member name");
+        }
+        ++v->cursor;
+        if (!skip_space(v))
+        {
+            return false;
+        }
+
+        // Usually the members come in the type's order
+        u32 member = node->first + matched;
+        if (matched >= node->count || !key_matches(key, has_escapes, compiled->members[member].name))
+        {
+            member = node->first;
+            while (member < node->first + node->count
+                   && !key_matches(key, has_escapes, compiled->members[member].name))
+            {
+                ++member;
+            }
+        }
+
+        if (member == node->first + node->count)
+        {
+            return fail(v, key_at, "'%.*s' isn't a member of the type", (int)key.length, key.data);
+        }
+        if (v->member_stamps[member] == stamp)
+        {
+            return fail(v, key_at, "'%.*s' appears more than once", (int)key.length, key.data);
+        }
+        v->member_stamps[member] = stamp;
+        ++matched;
+
+        if (!check_value(v, compiled->members[member].node) || !skip_space(v))
+        {
+            return false;
+        }
+
+        if (v->cursor < v->end && *v->cursor == ',')
+        {
+            ++v->cursor;
+            if (!skip_space(v))
+            {
+                return false;
+            }
+            // trailing commas are allowed, as when loading
+            if (v->cursor < v->end && *v->cursor == '}')
+            {
+                ++v->cursor;
+                break;
+            }
+        }
+        else if (v->cursor < v->end && *v->cursor == '}')
+        {
+            ++v->cursor;
+            break;
+        }
+        else
+        {
+            return fail(v, v->cursor < v->end ? v->cursor : open_brace, "expected ',' or '}' in an object");
+        }
+    }
+
+    if (matched != node->count)
+    {
+        for (u32 member = node->first; member < node->first + node->count; ++member)
+        {
+            if (v->member_stamps[member] != stamp)
+            {
+                StrSlice name = compiled->members[member].name;
+                return fail(v, open_brace, "missing member '%.*s'", (int)name.length, name.data);
+            }
+        }
+    }
+    return true;
+}
+
+
+static bool check_array(SchemaValidator *v, const SchemaNode *node)
+{
+    const char *open_bracket = v->cursor++;
+
+    if (!skip_space(v))
+    {
+        return false;
+    }
+    if (v->cursor < v->end && *v->cursor == ']')
+    {
+        ++v->cursor;
+        if (!accepts_none(v->compiled, node->first))
+        {
+            return fail(v, open_bracket, "empty array, the element type doesn't allow null");
+        }
+        return true;
+    }
+
+    for (;;)
+    {
+        if (!check_value(v, node->first) || !skip_space(v))
+        {
+            return false;
+        }
+
+        if (v->cursor < v->end && *v->cursor == ',')
+        {
+            ++v->cursor;
+            if (!skip_space(v))
+            {
+                return false;
+            }
+            if (v->cursor < v->end && *v->cursor == ']')
+            {
+                ++v->cursor;
+                return true;
+            }
+        }
+        else if (v->cursor < v->end && *v->cursor == ']')
+        {
+            ++v->cursor;
+            return true;
+        }
+        else
+        {
+            return fail(v, v->cursor < v->end ? v->cursor : open_bracket, "expected ',' or ']' in an array");
+        }
+    }
+}
+
+
+static bool check_union(SchemaValidator *v, const SchemaNode *node)
+{
+    const CompiledSchema *compiled = v->compiled;
+    ValidatorPosition start = save_position(v);
+
+    // The case that got furthest has the most useful error
+    SchemaError best = {};
+    SchemaError *outer_error = v->error;
+    SchemaError attempt;
+    v->error = &attempt;
+
+    bool matched = false;
+    for (u32 i = 0; i < node->count && !matched; ++i)
+    {
+        restore_position(v, start);
+        matched = check_value(v, compiled->cases[node->first + i]);
+        if (!matched && (i == 0 || attempt.offset > best.offset))
+        {
+            best = attempt;
+        }
+    }
+
+    v->error = outer_error;
+    if (!matched)
+    {
+        *v->error = best;
+    }
+    return matched;
+}
+
+
+static bool check_value(SchemaValidator *v, u32 node_index)
+{
+    const SchemaNode *node = &v->compiled->nodes[node_index];
+
+    if (v->cursor >= v->end)
+    {
+        return fail(v, v->cursor, "unexpected end of input, expected %s", describe(node->type_id));
+    }
+
+    if (node->type_id == TypeID::Union)
+    {
+        return check_union(v, node);
+    }
+
+    const char *at = v->cursor;
+    char c = *at;
+    u32 found;
+
+    if (c == '{')
+    {
+        if (node->type_id != TypeID::Compound)
+        {
+            return fail(v, at, "expected %s, found an object", describe(node->type_id));
+        }
+        return check_object(v, node);
+    }
+    else if (c == '[')
+    {
+        if (node->type_id != TypeID::Array)
+        {
+            return fail(v, at, "expected %s, found an array", describe(node->type_id));
+        }
+        return check_array(v, node);
+    }
+    else if (c == '"')
+    {
+        StrSlice contents;
+        bool has_escapes;
+        if (!scan_string(v, &contents, &has_escapes))
+        {
+            return false;
+        }
+        found = TypeID::String;
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        bool is_float;
+        if (!scan_number(v, &is_float))
+        {
+            return false;
+        }
+        found = is_float ? TypeID::Float : TypeID::Int;
+    }
+    else if (c == 't' || c == 'f')
+    {
+        if (!scan_literal(v, c == 't' ? "true" : "false"))
+        {
+            return false;
+        }
+        found = TypeID::Bool;
+    }
+    else if (c == 'n')
+    {
+        if (!scan_literal(v, "null"))
+        {
+            return false;
+        }
+        found = TypeID::None;
+    }
+    else
+    {
+        return fail(v, at, "unexpected character '%c'", c);
+    }
+
+    if (found != node->type_id)
+    {
+        return fail(v, at, "expected %s, found %s", describe(node->type_id), describe(found));
+    }
+    return true;
+}
+
+
+SchemaStatus::Tag validate(SchemaValidator *validator, const char *json, size_t length, OUTPARAM SchemaError *error)
+{
+    SchemaValidator *v = validator;
+    v->input = json;
+    v->cursor = json;
+    v->end = json + length;
+    v->line = 1;
+    v->line_start = json;
+    v->error = error;
+    mem::zero_ptr(error);
+
+    if (!skip_space(v))
+    {
+        return SchemaStatus::Failed;
+    }
+    if (v->cursor == v->end)
+    {
+        return SchemaStatus::Empty;
+    }
+
+    if (!check_value(v, v->compiled->root) || !skip_space(v))
+    {
+        return SchemaStatus::Failed;
+    }
+    if (v->cursor != v->end)
+    {
+        fail(v, v->cursor, "unexpected characters after the value");
+        return SchemaStatus::Failed;
+    }
+    return SchemaStatus::Passed;
+}
+
+
+struct ValidateDirWork
+{
+    const CompiledSchema *compiled;
+    SchemaDirResult *result;
+    volatile u32 next_file;
+};
+
+
+static void validate_dir_files(void *userdata)
+{
+    ValidateDirWork *work = (ValidateDirWork *)userdata;
+    DynArray<SchemaFileResult> *files = &work->result->files;
+
+    SchemaValidator validator;
+    init_validator(&validator, work->compiled);
+    // Reused, it grows to the largest file
+    Str contents = {};
+
+    for (;;)
+    {
+        u32 index = atomic::fetch_add(&work->next_file, 1u);
+        if (index >= files->count)
+        {
+            break;
+        }
+
+        SchemaFileResult *file = &(*files)[index];
+        FileReadResult read_result = read_text_file(&contents, str_data(file->access_path));
+        if (read_result.error_kind != FileReadResult::NoError)
+        {
+            file->status = SchemaStatus::ReadFailed;
+            mem::zero_obj(file->error);
+            snprintf(file->error.message, sizeof(file->error.message), "%s",
+                     str_data(read_result.platform_error.message));
+            read_result.release();
+            continue;
+        }
+        read_result.release();
+
+        file->status = validate(&validator, str_data(contents), str_length(contents), &file->error);
+    }
+
+    str_free(&contents);
+    deinit_validator(&validator);
+}
+
+
+bool validate_dir(OUTPARAM SchemaDirResult *result, PlatformError *list_error,
+                  const CompiledSchema *compiled, const char *path, size_t path_length, u32 thread_count)
+{
+    PROF_FUNCTION();
+
+    mem::zero_ptr(result);
+    dynarray::init(&result->files, 32);
+
+    u64 list_start = query_abstime();
+    {
+        DirLister dirlist(path, path_length);
+        if (dirlist.has_error())
+        {
+            *list_error = dirlist.error;
+            mem::zero_obj(dirlist.error);
+            return false;
+        }
+
+        while (dirlist.next())
+        {
+            if (!(dirlist.current.is_file && str_endswith_ignorecase(dirlist.current.name, ".json")))
+            {
+                continue;
+            }
+
+            SchemaFileResult *file = dynarray::append(&result->files);
+            mem::zero_ptr(file);
+            file->access_path = str(dirlist.current.access_path);
+            file->size = dirlist.current.filesize;
+            result->bytes += file->size;
+        }
+    }
+    result->list_ns = nanoseconds_since(list_start);
+
+    u64 validate_start = query_abstime();
+    ValidateDirWork work = {compiled, result, 0};
+
+    thread_count = min(max(thread_count, 1u), max(result->files.count, 1u));
+    DynArray<PlatformThread> threads = dynarray::init<PlatformThread>(thread_count);
+    // This thread is one of them
+    for (u32 i = 1; i < thread_count; ++i)
+    {
+        PlatformThread thread;
+        if (start_thread(&thread, validate_dir_files, &work))
+        {
+            dynarray::append(&threads, thread);
+        }
+    }
+    validate_dir_files(&work);
+    for (DynArrayCount i = 0; i < threads.count; ++i)
+    {
+        join_thread(&threads[i]);
+    }
+    result->thread_count = threads.count + 1;
+    dynarray::deinit(&threads);
+    result->validate_ns = nanoseconds_since(validate_start);
+
+    for (DynArrayCount i = 0; i < result->files.count; ++i)
+    {
+        SchemaStatus::Tag status = result->files[i].status;
+        if (status == SchemaStatus::Failed || status == SchemaStatus::ReadFailed)
+        {
+            ++result->failed;
+        }
+    }
+    return true;
+}
+
+
+void dir_result_free(SchemaDirResult *result)
+{
+    for (DynArrayCount i = 0; i < result->files.count; ++i)
+    {
+        str_free(&result->files[i].access_path);
+    }
+    dynarray::deinit(&result->files);
+}
+
+}
@@ -0,0 +1,137 @@
+// -*- c++ -*-
+
+#ifndef SCHEMA_H
+
+#include "typesys.h"
+#include "dynarray.h"
+#include "str.h"
+#include "platform.h"
+#include "numeric_types.h"
+
+
+/*
+Checking json against a type without making any Values. The type is
+compiled to flat tables of nodes, members and union cases. The validator
+then reads the raw bytes, checking syntax and type in the same pass, and
+allocates nothing while it does. A compiled schema is read-only, so any
+number of threads can validate against it at once.
+
+It agrees with checktype except for arrays. Elements are checked one by
+one against the element type here. checktype compares the union of the
+elements' types instead, so an array mixing shapes that each pass would
+fail there.
+*/
+
+struct SchemaNode
+{
+    // a TypeID::Tag
+    u32 type_id;
+    // Array: first is the element's node. Compound: members
+    // [first, first + count). Union: cases [first, first + count).
+    u32 first;
+    u32 count;
+};
+
+
+struct SchemaMember
+{
+    // points into the name table
+    StrSlice name;
+    u32 node;
+};
+
+
+struct CompiledSchema
+{
+    DynArray<SchemaNode> nodes;
+    DynArray<SchemaMember> members;
+    DynArray<u32> cases;
+    u32 root;
+};
+
+
+struct SchemaError
+{
+    // offset from 0, line and column from 1
+    size_t offset;
+    size_t line;
+    size_t column;
+    char message[128];
+};
+
+
+namespace SchemaStatus
+{
+
+enum Tag
+{
+    Passed,
+    Failed,
+    // nothing but whitespace and comments, loading skips these
+    Empty,
+    ReadFailed
+};
+
+}
+
+
+// One per thread, it has the scratch space for matching members
+struct SchemaValidator
+{
+    const CompiledSchema *compiled;
+    // per member, the object it was last seen in
+    u32 *member_stamps;
+    u32 next_stamp;
+
+    const char *input;
+    const char *cursor;
+    const char *end;
+    size_t line;
+    const char *line_start;
+    SchemaError *error;
+};
+
+
+struct SchemaFileResult
+{
+    Str access_path;
+    u64 size;
+    SchemaStatus::Tag status;
+    SchemaError error;
+};
+
+
+struct SchemaDirResult
+{
+    DynArray<SchemaFileResult> files;
+    u32 failed;
+    u32 thread_count;
+    u64 bytes;
+    u64 list_ns;
+    u64 validate_ns;
+};
+
+
+namespace schema
+{
+
+void compile(OUTPARAM CompiledSchema *compiled, TypeDescriptor *typedesc);
+void deinit(CompiledSchema *compiled);
+
+void init_validator(SchemaValidator *validator, const CompiledSchema *compiled);
+void deinit_validator(SchemaValidator *validator);
+
+// Syntax and type errors both fail, with the first one in error
+SchemaStatus::Tag validate(SchemaValidator *validator, const char *json, size_t length, OUTPARAM SchemaError *error);
+
+// Every .json file directly in path, spread over thread_count threads. The
+// result's files are in listing order. False if the directory can't be listed.
+bool validate_dir(OUTPARAM SchemaDirResult *result, PlatformError *list_error,
+                  const CompiledSchema *compiled, const char *path, size_t path_length, u32 thread_count);
+void dir_result_free(SchemaDirResult *result);
+
+}
+
+
+#define SCHEMA_H
+#endif
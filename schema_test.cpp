@@ -0,0 +1,142 @@
+#include "schema.h"
+#include "programstate.h"
+#include "typesys_json.h"
+#include "common.h"
+#include <cstring>
+
+
+// The types are inferred from these, the same way loading would
+static const char *schema_test_samples[] = {
+    "{\"id\": 1, \"name\": \"x\", \"score\": 1.5, \"tags\": [\"a\"]}",
+    "{\"v\": [1, \"x\"]}",
+    "[{\"a\": 1}, {\"b\": \"x\"}]",
+    "{\"m\": [null, 1]}",
+};
+
+
+struct SchemaTestCase
+{
+    u32 sample;
+    const char *json;
+    SchemaStatus::Tag status;
+    // part of the error, and where it is, when it fails
+    const char *message;
+    size_t line;
+    size_t column;
+};
+
+
+static const SchemaTestCase schema_test_cases[] = {
+    {0, "{\"id\": 2, \"name\": \"y\", \"score\": 2.5, \"tags\": [\"b\", \"c\"]}", SchemaStatus::Passed, nullptr, 0, 0},
+    {0, "{\"tags\": [\"b\"], \"score\": 2.5, \"id\": 2, \"name\": \"y\"}", SchemaStatus::Passed, nullptr, 0, 0},
+
+    // Trailing commas and comments
+    {0, "// first\n{\"id\": 2, /* second */ \"name\": \"y\",\n \"score\": 2.5, \"tags\": [\"b\",],}\n// last",
+     SchemaStatus::Passed, nullptr, 0, 0},
+    {0, "{\"id\": 2,\n /* no end", SchemaStatus::Failed, "unterminated comment", 2, 2},
+    {0, "  // nothing\n /* here */\n", SchemaStatus::Empty, nullptr, 0, 0},
+
+    // Missing, extra and duplicate members
+    {0, "\n{\"id\": 2, \"name\": \"y\", \"score\": 2.5}", SchemaStatus::Failed, "missing member 'tags'", 2, 1},
+    {0, "{\"id\": 2,\n \"oops\": 1}", SchemaStatus::Failed, "'oops' isn't a member of the type", 2, 2},
+    {0, "{\"id\": 2,\n \"id\": 3}", SchemaStatus::Failed, "'id' appears more than once", 2, 2},
+
+    // Int vs Float, by the same rule as loading
+    {0, "{\"id\": 2.0}", SchemaStatus::Failed, "expected an integer, found a float", 1, 8},
+    {0, "{\"id\": 2e3}", SchemaStatus::Failed, "expected an integer, found a float", 1, 8},
+    {0, "{\"id\": 9223372036854775808}", SchemaStatus::Failed, "expected an integer, found a float", 1, 8},
+    {0, "{\"id\": -9223372036854775808, \"name\": \"y\", \"score\": 2E-3, \"tags\": [\"b\"]}",
+     SchemaStatus::Passed, nullptr, 0, 0},
+    {0, "{\"id\": 2, \"name\": \"y\", \"score\": 2}", SchemaStatus::Failed, "expected a float, found an integer", 1, 33},
+    {0, "{\"id\": 2, \"name\": \"y\", \"score\": -1e309}", SchemaStatus::Failed, "too big for a double", 1, 33},
+
+    // Empty arrays fit only where null does
+    {0, "{\"id\": 2, \"name\": \"y\", \"score\": 2.5,\n \"tags\": []}", SchemaStatus::Failed,
+     "empty array, the element type doesn't allow null", 2, 10},
+    {3, "{\"m\": []}", SchemaStatus::Passed, nullptr, 0, 0},
+    {3, "{\"m\": [null, 3, null]}", SchemaStatus::Passed, nullptr, 0, 0},
+
+    // Unions report the case that got furthest
+    {1, "{\"v\": [2, \"y\", 3]}", SchemaStatus::Passed, nullptr, 0, 0},
+    {1, "{\"v\": [2, true]}", SchemaStatus::Failed, "found true or false", 1, 11},
+    {3, "{\"m\": [1, \"x\"]}", SchemaStatus::Failed, "found a string", 1, 11},
+    {2, "[{\"b\": \"y\"}, {\"a\": 3}]", SchemaStatus::Passed, nullptr, 0, 0},
+    {2, "[{\"b\": 2}]", SchemaStatus::Failed, "expected a string, found an integer", 1, 8},
+    {2, "[{\"a\": 1, \"b\": \"y\"}]", SchemaStatus::Failed, "'b' isn't a member of the type", 1, 11},
+
+    // Trailing content
+    {3, "{\"m\": [1]} // done\n", SchemaStatus::Passed, nullptr, 0, 0},
+    {3, "{\"m\": [1]}\n  x", SchemaStatus::Failed, "unexpected characters after the value", 2, 3},
+    {3, "{\"m\": [1]} {}", SchemaStatus::Failed, "unexpected characters after the value", 1, 12},
+    {3, "{\"m\": [1", SchemaStatus::Failed, "expected ',' or ']' in an array", 1, 7},
+};
+
+
+static s32 check_case(const SchemaTestCase *test, const CompiledSchema *compiled)
+{
+    SchemaValidator validator;
+    schema::init_validator(&validator, compiled);
+
+    SchemaError error;
+    SchemaStatus::Tag status = schema::validate(&validator, test->json, strlen(test->json), &error);
+    schema::deinit_validator(&validator);
+
+    if (status != test->status)
+    {
+        printf_ln("Validating '%s' against sample %i: status %i, expected %i (%s)",
+                  test->json, (s32)test->sample, (s32)status, (s32)test->status, error.message);
+        return 1;
+    }
+
+    if (test->message
+        && (!strstr(error.message, test->message) || error.line != test->line || error.column != test->column))
+    {
+        printf_ln("Validating '%s' against sample %i: failed at %i:%i with '%s', expected %i:%i with '%s'",
+                  test->json, (s32)test->sample, (s32)error.line, (s32)error.column, error.message,
+                  (s32)test->line, (s32)test->column, test->message);
+        return 1;
+    }
+    return 0;
+}
+
+
+s32 run_schema_tests()
+{
+    static ProgramState prgstate;
+    prgstate_init(&prgstate);
+    load_base_type_descriptors(&prgstate);
+
+    CompiledSchema compiled[COUNTOF(schema_test_samples)];
+    for (u32 i = 0; i < COUNTOF(schema_test_samples); ++i)
+    {
+        Value sample;
+        JsonParseResult parse_result = try_parse_json_as_value(&sample, &prgstate, schema_test_samples[i],
+                                                               strlen(schema_test_samples[i]));
+        ASSERT(parse_result.status == JsonParseResult::Succeeded);
+        schema::compile(&compiled[i], sample.typedesc);
+        value_free_components(&sample);
+    }
+
+    s32 fail_count = 0;
+    for (u32 i = 0; i < COUNTOF(schema_test_cases); ++i)
+    {
+        const SchemaTestCase *test = &schema_test_cases[i];
+        fail_count += check_case(test, &compiled[test->sample]);
+    }
+
+    for (u32 i = 0; i < COUNTOF(schema_test_samples); ++i)
+    {
+        schema::deinit(&compiled[i]);
+    }
+
+    if (fail_count)
+    {
+        printf_ln("There were %i schema validator test failures", fail_count);
+    }
+    else
+    {
+        println("No failures in schema validator tests");
+    }
+
+    return fail_count;
+}
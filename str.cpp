@@ -18,32 +18,58 @@ StrSlice empty_str_slice()
 
 Str str_alloc(StrLen str_size)
 {
-    assert(str_size < UINT16_MAX);
-    Str result;
-    result.data = MAKE_ARRAY(mem::default_allocator(), str_size + 1, char);
-    result.data[0] = 0;
-    result.length = 0;
-    result.capacity = (StrLen)str_size + 1;
+    assert(str_size < STR_LENGTH_MAX);
+    Str result = {};
+
+    // small strings live inline, no allocation needed
+    if (str_size < STR_SMALL_CAPACITY)
+    {
+        return result;
+    }
+
+    result.heap.data = MAKE_ARRAY_CAT(mem::default_allocator(), str_size + 1, "str", char);
+    result.heap.data[0] = 0;
+    result.heap.length = 0;
+    result.heap.capacity = (StrLen)str_size + 1;
+    result.small[STR_REP_SIZE - 1] = (char)STR_HEAP_FLAG;
     return result;
 }
 
 
 void str_ensure_capacity(Str *str, StrLen capacity)
 {
-    if (str->capacity < capacity)
+    if (str_capacity(*str) >= capacity)
+    {
+        return;
+    }
+
+    if (str_is_small(*str))
+    {
+        // spill the inline characters to the heap
+        StrLen length = str_length(*str);
+        char *data = MAKE_ARRAY_CAT(mem::default_allocator(), capacity, "str", char);
+        std::memcpy(data, str->small, length + 1);
+
+        str->heap.data = data;
+        str->heap.length = length;
+        str->heap.capacity = capacity;
+        str->small[STR_REP_SIZE - 1] = (char)STR_HEAP_FLAG;
+    }
+    else
     {
-        str->capacity = capacity;
-        RESIZE_ARRAY(mem::default_allocator(), str->data, str->capacity, char);
+        str->heap.capacity = capacity;
+        RESIZE_ARRAY_CAT(mem::default_allocator(), str->heap.data, str->heap.capacity, "str", char);
     }
 }
 
 
 Str str_make_copy(const Str &str)
 {
-    assert(str.capacity >= str.length + 1);
-    Str result = str_alloc(str.capacity);
-    std::strncpy(result.data, str.data, str.length + 1);
-    result.data[result.length] = 0;
+    StrLen length = str_length(str);
+    assert(str_capacity(str) >= length + 1);
+    Str result = str_alloc(str_capacity(str) - 1);
+    std::memcpy(str_data(&result), str_data(str), length);
+    str_set_length(&result, length);
     return result;
 }
 
@@ -51,11 +77,10 @@ Str str_make_copy(const Str &str)
 Str str(const char *cstr, StrLen len)
 {
     Str result = str_alloc(len);
-    result.length = len;
 
     // careful: https://randomascii.wordpress.com/2013/04/03/stop-using-strncpy-already/
-    std::strncpy(result.data, cstr, len + 1);
-    result.data[result.length] = 0;
+    std::memcpy(str_data(&result), cstr, len);
+    str_set_length(&result, len);
 
     return result;
 }
@@ -70,52 +95,48 @@ Str str(const char *cstr)
 
 void str_free(Str *str)
 {
-    assert(str->capacity);
-    mem::default_allocator()->dealloc(str->data);
-    str->data = empty_string;
-    str->capacity = 0;
-    str->length = 0;
+    if (!str_is_small(*str))
+    {
+        mem::default_allocator()->dealloc(str->heap.data);
+    }
+    mem::zero_ptr(str);
 }
 
 
-// TODO(mike): unit test
 void str_copy(Str *dest, size_t dest_start, StrSlice src, size_t src_start, size_t count)
 {
     StrLen sl_src_start = STRLEN(src_start);
     StrLen sl_count = STRLEN(count);
     assert(sl_src_start + sl_count <= src.length);
 
+    StrLen dest_length = str_length(*dest);
     StrLen sl_dest_start = STRLEN(dest_start);
-    StrLen final_length = max<StrLen>(sl_dest_start + sl_count, dest->length);
+    StrLen final_length = max<StrLen>(sl_dest_start + sl_count, dest_length);
     assert(final_length > sl_dest_start || sl_count == 0);
 
 
     StrLen capacity_required = sl_dest_start + sl_count + 1;
     str_ensure_capacity(dest, capacity_required);
-    std::strncpy(dest->data + sl_dest_start, src.data + sl_src_start, sl_count);
-
+    std::memmove(str_data(dest) + sl_dest_start, src.data + sl_src_start, sl_count);
 
-    if (final_length > dest->length)
+    if (final_length > dest_length)
     {
-        dest->data[final_length] = '\0';
+        str_set_length(dest, final_length);
     }
-
-    dest->length = final_length;
 }
 
 
 void str_copy_truncate(Str *dest, size_t dest_start, StrSlice src, size_t src_start, size_t count)
 {
     str_copy(dest, dest_start, src, src_start, count);
-    *(dest->data + dest_start + count) = '\0';
+    str_set_length(dest, STRLEN(dest_start + count));
 }
 
 
 void str_overwrite(Str *dest, StrSlice src)
 {
     str_copy(dest, 0, src, 0, src.length);
-    dest->data[src.length] = '\0';
-    dest->length = src.length;
+    str_set_length(dest, src.length);
 }
 
 
@@ -148,22 +169,21 @@ Str str_concated_v_impl(StrSlice first_slice...)
     va_end(args);
 
     Str result = str_alloc(len);
-    result.length = len;
-    char *location = result.data;
-    std::strncpy(location, first_slice.data, first_slice.length);
+    char *location = str_data(&result);
+    std::memcpy(location, first_slice.data, first_slice.length);
     location += first_slice.length;
     va_start(args, first_slice);
     for (int i = 0; i < count; ++i)
     {
         SliceOrZero arg = va_arg(args, SliceOrZero);
         StrSlice slice = arg.slice;
-        std::strncpy(location, slice.data, slice.length);
+        std::memcpy(location, slice.data, slice.length);
 
         location += slice.length;
     }
     va_end(args);
 
-    result.data[result.length] = 0;
+    str_set_length(&result, len);
 
     return result;
 }
@@ -194,7 +214,7 @@ bool str_equal_ignorecase(const StrSlice &a, const StrSlice &b)
 
     const char *ca = a.data;
     const char *cb = b.data;
-    for (int i = 0, len = a.length; i < len; ++i)
+    for (StrLen i = 0, len = a.length; i < len; ++i)
     {
         char achar = to_ascii_lower(ca[i]);
         char bchar = to_ascii_lower(cb[i]);
@@ -218,7 +238,7 @@ bool str_equal(const StrSlice &a, const StrSlice &b)
 
     const char *ca = a.data;
     const char *cb = b.data;
-    for (int i = 0, len = a.length; i < len; ++i)
+    for (StrLen i = 0, len = a.length; i < len; ++i)
     {
         if (ca[i] != cb[i])
         {
@@ -11,8 +11,8 @@
 #include <cassert>
 #include <cstring>
 
-typedef u16 StrLen;
-#define STR_LENGTH_MAX UINT16_MAX
+typedef u32 StrLen;
+#define STR_LENGTH_MAX UINT32_MAX
 
 
 
@@ -32,9 +32,18 @@ struct StrSlice
 };
 
 
-// For owning string memory
-// TODO(mike): 'length' should probably be 'size' because utf8
-struct Str
+// Size of a Str. Strings whose length plus null terminator fit in
+// STR_SMALL_CAPACITY are stored inline (small), everything else spills
+// to the heap. The last byte of the representation is a tag: either
+// STR_HEAP_FLAG, or the length of the small string.
+#define STR_REP_SIZE 24
+#define STR_SMALL_CAPACITY (STR_REP_SIZE - 1)
+#define STR_HEAP_FLAG 0x80
+
+
+// Heap representation. Same layout as StrSlice for the first two
+// fields, so a heap Str and a slice of it agree on data and length.
+struct StrHeapRep
 {
     char *data;
     StrLen length;   // length does not include null terminator
@@ -42,6 +51,78 @@ struct Str
 };
 
 
+// For owning string memory
+// Don't touch the union directly, use str_data/str_length/str_capacity.
+// A zeroed Str is a valid empty string, and a Str can be copied around
+// by value like any other POD, as long as only one copy gets freed.
+// TODO(mike): 'length' should probably be 'size' because utf8
+struct Str
+{
+    union
+    {
+        StrHeapRep heap;
+        char small[STR_REP_SIZE];
+    };
+};
+
+STATIC_ASSERT(str_rep_size, sizeof(Str) == STR_REP_SIZE);
+STATIC_ASSERT(str_small_tag_fits, STR_SMALL_CAPACITY < STR_HEAP_FLAG);
+
+
+inline u8 str_tag(const Str &str)
+{
+    return (u8)str.small[STR_REP_SIZE - 1];
+}
+
+
+inline bool str_is_small(const Str &str)
+{
+    return (str_tag(str) & STR_HEAP_FLAG) == 0;
+}
+
+
+inline StrLen str_length(const Str &str)
+{
+    return str_is_small(str) ? (StrLen)str_tag(str) : str.heap.length;
+}
+
+
+inline StrLen str_capacity(const Str &str)
+{
+    return str_is_small(str) ? (StrLen)STR_SMALL_CAPACITY : str.heap.capacity;
+}
+
+
+inline char *str_data(Str *str)
+{
+    return str_is_small(*str) ? str->small : str->heap.data;
+}
+
+
+inline const char *str_data(const Str &str)
+{
+    return str_is_small(str) ? str.small : str.heap.data;
+}
+
+
+// Sets length and writes the null terminator, capacity must already fit it
+inline void str_set_length(Str *str, StrLen length)
+{
+    assert(length < str_capacity(*str));
+
+    if (str_is_small(*str))
+    {
+        str->small[length] = '\0';
+        str->small[STR_REP_SIZE - 1] = (char)length;
+    }
+    else
+    {
+        str->heap.data[length] = '\0';
+        str->heap.length = length;
+    }
+}
+
+
 Str str_alloc(StrLen str_size);
 Str str(const char *cstr, StrLen len);
 Str str(const char *cstr);
@@ -63,7 +144,7 @@ inline Str str(StrSlice strslice)
 
 inline Str str(const Str &src)
 {
-    return str(src.data, src.length);
+    return str(str_data(src), str_length(src));
 }
 
 
@@ -104,15 +185,15 @@ inline StrSlice str_slice(const char *cstr)
 inline StrSlice str_slice(const Str &str)
 {
     StrSlice result;
-    result.data = str.data;
-    result.length = str.length;
+    result.data = str_data(str);
+    result.length = str_length(str);
     return result;
 }
 
 
 inline void str_append(Str *str, StrSlice strslice)
 {
-    str_copy(str, str->length, strslice, 0, strslice.length);
+    str_copy(str, str_length(*str), strslice, 0, strslice.length);
 }
 
 
@@ -133,24 +214,20 @@ inline void str_append(Str *str, char c)
 
 inline void str_clear(Str *str)
 {
-    if (str->data)
-    {
-        str->length = 0;
-        str->data[0] = '\0';
-    }
+    str_set_length(str, 0);
 }
 
 
 inline char str_popchar(Str *str)
 {
-    if (!str->data || str->length == 0)
+    StrLen length = str_length(*str);
+    if (length == 0)
     {
         return '\0';
     }
 
-    --str->length;
-    char result = str->data[str->length];
-    str->data[str->length] = '\0';
+    char result = str_data(str)[length - 1];
+    str_set_length(str, length - 1);
     return result;
 }
 
@@ -287,7 +364,7 @@ struct StrSliceHash
     {
         const u32 seed = 541;
         u32 result;
-        MurmurHash3_x86_32(slice.data, slice.length, seed, &result);
+        MurmurHash3_x86_32(slice.data, (int)slice.length, seed, &result);
         return result;
     }
 };
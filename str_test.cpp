@@ -0,0 +1,198 @@
+#include "str.h"
+#include "common.h"
+#include <cstdlib>
+#include <cstring>
+
+
+// The longest string that still fits inline, and one past it
+static const char *str_test_small = "abcdefghijklmnopqrstuv";
+static const char *str_test_spilled = "abcdefghijklmnopqrstuvw";
+
+// Past what a u16 length could hold
+static const u32 str_test_long_length = 70000;
+
+
+static s32 check_str(const Str &str, const char *test_name, const char *expected, bool expected_small)
+{
+    StrLen expected_length = STRLEN(std::strlen(expected));
+
+    if (str_length(str) != expected_length || !str_equal(str_slice(str), str_slice(expected)))
+    {
+        printf_ln("%s: got '%s' (%u), expected '%s' (%u)", test_name, str_data(str), str_length(str),
+                  expected, expected_length);
+        return 1;
+    }
+    if (str_data(str)[expected_length] != '\0')
+    {
+        printf_ln("%s: the string isn't null terminated", test_name);
+        return 1;
+    }
+    if (str_is_small(str) != expected_small)
+    {
+        printf_ln("%s: the string should be %s", test_name, expected_small ? "inline" : "on the heap");
+        return 1;
+    }
+    return 0;
+}
+
+
+static s32 test_small_boundary()
+{
+    s32 fails = 0;
+
+    Str small = str(str_test_small);
+    Str spilled = str(str_test_spilled);
+    fails += check_str(small, "22 chars", str_test_small, true);
+    fails += check_str(spilled, "23 chars", str_test_spilled, false);
+
+    Str copy = str_make_copy(spilled);
+    fails += check_str(copy, "Copying 23 chars", str_test_spilled, false);
+
+    str_free(&small);
+    str_free(&spilled);
+    str_free(&copy);
+    return fails;
+}
+
+
+static s32 test_spilling()
+{
+    s32 fails = 0;
+
+    Str ensured = str("abc");
+    str_ensure_capacity(&ensured, STR_SMALL_CAPACITY);
+    fails += check_str(ensured, "Ensuring the inline capacity", "abc", true);
+    str_ensure_capacity(&ensured, STR_SMALL_CAPACITY + 1);
+    fails += check_str(ensured, "Ensuring past the inline capacity", "abc", false);
+    str_free(&ensured);
+
+    Str appended = str(str_test_small);
+    str_append(&appended, 'w');
+    fails += check_str(appended, "Appending a char", str_test_spilled, false);
+    str_append(&appended, str_slice("xyz"));
+    fails += check_str(appended, "Appending to the heap", "abcdefghijklmnopqrstuvwxyz", false);
+    str_free(&appended);
+
+    Str overwritten = str("abc");
+    str_overwrite(&overwritten, str_slice(str_test_spilled));
+    fails += check_str(overwritten, "Overwriting", str_test_spilled, false);
+    str_overwrite(&overwritten, str_slice("abc"));
+    fails += check_str(overwritten, "Overwriting a heap string", "abc", false);
+    str_free(&overwritten);
+
+    // Popping never moves the characters back inline
+    Str popped = str(str_test_small);
+    str_append(&popped, 'w');
+    char c = str_popchar(&popped);
+    if (c != 'w')
+    {
+        printf_ln("Popping across the inline boundary gave '%c'", c);
+        ++fails;
+    }
+    fails += check_str(popped, "Popping across the inline boundary", str_test_small, false);
+    while (str_length(popped) > 0)
+    {
+        str_popchar(&popped);
+    }
+    if (str_popchar(&popped) != '\0')
+    {
+        println("Popping an empty string didn't give a null");
+        ++fails;
+    }
+    fails += check_str(popped, "Popping everything", "", false);
+    str_free(&popped);
+
+    return fails;
+}
+
+
+static s32 test_copy()
+{
+    s32 fails = 0;
+
+    Str small = str("abc");
+    Str heap = str(str_test_spilled);
+
+    str_copy(&small, 1, str_slice(heap), 0, str_length(heap));
+    fails += check_str(small, "Copying a heap string into a small one", "aabcdefghijklmnopqrstuvw", false);
+
+    str_copy(&heap, 2, str_slice("12"), 0, 2);
+    fails += check_str(heap, "Copying a small string into a heap one", "ab12efghijklmnopqrstuvw", false);
+
+    Str dest = str_make_zeroed();
+    str_copy(&dest, 0, str_slice(heap), 20, 3);
+    fails += check_str(dest, "Copying part of a heap string", "uvw", true);
+
+    str_copy_truncate(&heap, 1, str_slice(dest), 0, 3);
+    fails += check_str(heap, "Truncating a heap string", "auvw", false);
+
+    str_free(&small);
+    str_free(&heap);
+    str_free(&dest);
+    return fails;
+}
+
+
+static s32 test_zeroed()
+{
+    s32 fails = 0;
+
+    Str zeroed = str_make_zeroed();
+    fails += check_str(zeroed, "A zeroed string", "", true);
+    str_free(&zeroed);
+    fails += check_str(zeroed, "Freeing a zeroed string", "", true);
+
+    // and it's still usable
+    str_append(&zeroed, str_slice(str_test_spilled));
+    fails += check_str(zeroed, "Appending to a freed string", str_test_spilled, false);
+    str_free(&zeroed);
+    fails += check_str(zeroed, "Freeing a heap string", "", true);
+
+    return fails;
+}
+
+
+static s32 test_long()
+{
+    s32 fails = 0;
+
+    char *text = (char *)std::malloc(str_test_long_length + 2);
+    for (u32 i = 0; i < str_test_long_length; ++i)
+    {
+        text[i] = (char)('a' + i % 26);
+    }
+    text[str_test_long_length] = '\0';
+
+    Str long_str = str(text, str_test_long_length);
+    fails += check_str(long_str, "A long string", text, false);
+
+    text[str_test_long_length] = '!';
+    text[str_test_long_length + 1] = '\0';
+    str_append(&long_str, '!');
+    fails += check_str(long_str, "Appending to a long string", text, false);
+
+    str_free(&long_str);
+    std::free(text);
+    return fails;
+}
+
+
+s32 run_str_tests()
+{
+    s32 fails = test_small_boundary();
+    fails += test_spilling();
+    fails += test_copy();
+    fails += test_zeroed();
+    fails += test_long();
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i string test failures", fails);
+    }
+    else
+    {
+        println("No failures in string tests");
+    }
+
+    return fails;
+}
@@ -1,15 +1,30 @@
 #include "numeric_types.h"
 #include "common.h"
 
+s32 run_str_tests();
 s32 run_hashtable_tests();
 s32 run_nametable_tests();
+s32 run_bucketarray_tests();
+s32 run_numbers_tests();
+s32 run_schema_tests();
+s32 run_typesys_tests();
+s32 run_groupby_tests();
+s32 run_flatview_tests();
 
 
-void run_tests()
+s32 run_tests()
 {
     s32 fail_count = 0;
+    fail_count += run_str_tests();
     fail_count += run_hashtable_tests();
     fail_count += run_nametable_tests();
+    fail_count += run_bucketarray_tests();
+    fail_count += run_numbers_tests();
+    fail_count += run_schema_tests();
+    fail_count += run_typesys_tests();
+    fail_count += run_groupby_tests();
+    fail_count += run_flatview_tests();
 
     printf_ln("%i tests failed", fail_count);
+    return fail_count;
 }
@@ -1,5 +1,10 @@
 #include "typesys.h"
 #include "programstate.h"
+#include "profiler.h"
+#include "logging.h"
+#include "MurmurHash3.h"
+#include <cstring>
+#include <new>
 
 
 bool all_typecases_compound(UnionType *union_type)
@@ -20,6 +25,9 @@ void load_base_type_descriptors(ProgramState *prgstate)
 {
     ASSERT(prgstate);
 
+    // Made here, before any loader thread asks for it
+    value_storage_allocator();
+
     TypeDescriptor *none_type = add_typedescriptor(prgstate);
     none_type->type_id = TypeID::None;
     bind_typedesc_name(prgstate, TypeID::to_string(none_type->type_id),
@@ -55,6 +63,8 @@ void load_base_type_descriptors(ProgramState *prgstate)
 // TODO(mike): Guarantee no structural duplicates, and do it fast. Hashtable.
 TypeDescriptor *find_equiv_typedesc(ProgramState *prgstate, TypeDescriptor *type_desc)
 {
+    PROF_FUNCTION();
+
     TypeDescriptor *result = nullptr;
     BucketArray<TypeDescriptor> *typedesc_storage = &prgstate->type_descriptors;
 
@@ -72,15 +82,26 @@ TypeDescriptor *find_equiv_typedesc(ProgramState *prgstate, TypeDescriptor *type
         case TypeID::Array:
         case TypeID::Compound:
         case TypeID::Union:
-            for (BucketItemCount i = 0, e = prgstate->type_descriptors.capacity;
-                 i < e; ++i)
+            for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(typedesc_storage);
+                 bucketarray::next(&it);)
             {
-                TypeDescriptor *predefined;
-                if (bucketarray::get_if_not_empty(&predefined, typedesc_storage, i))
+                if (typedesc_equal(type_desc, it.elem))
                 {
-                    if (typedesc_equal(type_desc, predefined))
+                    result = it.elem;
+                    break;
+                }
+            }
+
+            if (!result && prgstate->type_scratch)
+            {
+                for (BucketArray<TypeDescriptor>::Iterator it =
+                         bucketarray::iterate(&prgstate->type_scratch->type_descriptors);
+                     bucketarray::next(&it);)
+                {
+                    if (typedesc_equal(type_desc, it.elem))
                     {
-                        result = predefined;
+                        result = it.elem;
+                        break;
                     }
                 }
             }
@@ -110,8 +131,23 @@ TypeDescriptor *find_equiv_typedesc_or_add(ProgramState *prgstate, TypeDescripto
 
 TypeDescriptor *add_typedescriptor(ProgramState *prgstate, TypeDescriptor type_desc)
 {
-    TypeDescriptor *result = bucketarray::add(&prgstate->type_descriptors).elem;
-    *result = type_desc;
+    TypeDescriptor *result;
+    if (prgstate->type_scratch)
+    {
+        // Nothing outside the scratch sees these, no need to bump the generation
+        result = bucketarray::add(&prgstate->type_scratch->type_descriptors).elem;
+        *result = type_desc;
+        result->in_scratch = true;
+        result->marked = false;
+    }
+    else
+    {
+        result = bucketarray::add(&prgstate->type_descriptors).elem;
+        *result = type_desc;
+        result->in_scratch = false;
+        result->marked = false;
+        ++prgstate->types_generation;
+    }
     return result;
 }
 
@@ -123,13 +159,57 @@ TypeDescriptor *add_typedescriptor(ProgramState *prgstate)
 }
 
 
-void bind_typedesc_name(ProgramState *prgstate, NameRef name, TypeDescriptor *typedesc)
+static void remove_reverse_binding(ProgramState *prgstate, TypeDescriptor *typedesc, NameRef name)
 {
-    ht_set(&prgstate->typedesc_bindings, name, typedesc);
+    DynArray<NameRef> *names = ht_find(&prgstate->typedesc_reverse_bindings, typedesc);
+    if (!names)
+    {
+        return;
+    }
 
-    DynArray<NameRef> *names = nullptr;
-    ht_set_if_unset(&names, &prgstate->typedesc_reverse_bindings, typedesc, dynarray::init<NameRef>(0));
-    dynarray::append(names, name);
+    for (DynArrayCount i = 0; i < names->count; ++i)
+    {
+        if (nameref::identical((*names)[i], name))
+        {
+            dynarray::swappop(names, i);
+            break;
+        }
+    }
+
+    if (names->count == 0)
+    {
+        dynarray::deinit(names);
+        ht_remove(&prgstate->typedesc_reverse_bindings, typedesc);
+    }
+}
+
+
+static void bind_name(ProgramState *prgstate, NameRef name, TypeDescriptor *typedesc, bool weak)
+{
+    TypeBinding *previous = ht_find(&prgstate->typedesc_bindings, name);
+    bool rebinding = previous && previous->typedesc == typedesc;
+    if (previous && !rebinding)
+    {
+        remove_reverse_binding(prgstate, previous->typedesc, name);
+    }
+
+    // Loading the same path again mustn't weaken a name the user bound
+    TypeBinding binding = {typedesc, weak && (!rebinding || previous->weak)};
+    ht_set(&prgstate->typedesc_bindings, name, binding);
+    ++prgstate->types_generation;
+
+    if (!rebinding)
+    {
+        DynArray<NameRef> *names = nullptr;
+        ht_set_if_unset(&names, &prgstate->typedesc_reverse_bindings, typedesc, dynarray::init<NameRef>(0));
+        dynarray::append(names, name);
+    }
+}
+
+
+void bind_typedesc_name(ProgramState *prgstate, NameRef name, TypeDescriptor *typedesc)
+{
+    bind_name(prgstate, name, typedesc, false);
 }
 
 
@@ -152,6 +232,19 @@ void bind_typedesc_name(ProgramState *prgstate, Str name, TypeDescriptor *typede
 }
 
 
+void bind_typedesc_name_weak(ProgramState *prgstate, StrSlice name, TypeDescriptor *typedesc)
+{
+    NameRef nameref = nametable::find_or_add(&prgstate->names, name);
+    bind_name(prgstate, nameref, typedesc, true);
+}
+
+
+void bind_typedesc_name_weak(ProgramState *prgstate, Str name, TypeDescriptor *typedesc)
+{
+    bind_typedesc_name_weak(prgstate, str_slice(name), typedesc);
+}
+
+
 DynArray<NameRef> *find_names_of_typedesc(ProgramState *prgstate, TypeDescriptor *typedesc)
 {
     return ht_find(&prgstate->typedesc_reverse_bindings, typedesc);
@@ -169,10 +262,10 @@ DynArrayCount find_names_of_typedesc(OUTPARAM DynArray<NameRef> *result_list, Pr
 TypeDescriptor *find_typedesc_by_name(ProgramState *prgstate, NameRef name)
 {
     TypeDescriptor *result = nullptr;
-    TypeDescriptor **ptrptr_typedesc = ht_find(&prgstate->typedesc_bindings, name);
-    if (ptrptr_typedesc)
+    TypeBinding *binding = ht_find(&prgstate->typedesc_bindings, name);
+    if (binding)
     {
-        result = *ptrptr_typedesc;
+        result = binding->typedesc;
     }
     return result;
 }
@@ -181,7 +274,7 @@ TypeDescriptor *find_typedesc_by_name(ProgramState *prgstate, StrSlice name)
 {
     TypeDescriptor *result = nullptr;
     NameRef nameref = nametable::find(&prgstate->names, name);
-    if (nameref.offset)
+    if (nameref.handle)
     {
         result = find_typedesc_by_name(prgstate, nameref);
     }
@@ -355,7 +448,7 @@ TypeDescriptor *make_union(ProgramState *prgstate, TypeDescriptor *a_desc, TypeD
             bool already_contains_type = false;
             for (DynArrayCount j = 0; j < a_num_cases; ++j)
             {
-                if (b_case != (*a_typecases)[j])
+                if (b_case == (*a_typecases)[j])
                 {
                     already_contains_type = true;
                     break;
@@ -407,6 +500,8 @@ TypeDescriptor *merge_types(ProgramState *prgstate, /*const*/ TypeDescriptor *a_
 
 TypeDescriptor *merge_each_type(ProgramState *prgstate, const DynArray<TypeDescriptor *> &types)
 {
+    PROF_FUNCTION();
+
     ASSERT(types.count > 0);
     // if (types.count == 0) {
     //     return nullptr;
@@ -428,6 +523,8 @@ TypeDescriptor *merge_each_type(ProgramState *prgstate, const DynArray<TypeDescr
 
 TypeDescriptor *merge_each_type(ProgramState *prgstate, const DynArray<Value> &values)
 {
+    PROF_FUNCTION();
+
     ASSERT(values.count > 0);
     // if (types.count == 0) {
     //     return nullptr;
@@ -510,6 +607,297 @@ void free_typedescriptor_components(TypeDescriptor *typedesc)
 }
 
 
+void begin_type_scratch(ProgramState *prgstate, TypeScratch *scratch)
+{
+    assert(!prgstate->type_scratch);
+    bucketarray::init(&scratch->type_descriptors);
+    prgstate->type_scratch = scratch;
+}
+
+
+void end_type_scratch(ProgramState *prgstate, TypeScratch *scratch)
+{
+    assert(prgstate->type_scratch == scratch);
+    UNUSED(scratch);
+    prgstate->type_scratch = nullptr;
+}
+
+
+void discard_type_scratch(TypeScratch *scratch)
+{
+    for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(&scratch->type_descriptors);
+         bucketarray::next(&it);)
+    {
+        free_typedescriptor_components(it.elem);
+    }
+    bucketarray::deinit(&scratch->type_descriptors);
+}
+
+
+TypeDescriptor *promote_typedesc(ProgramState *prgstate, TypeDescriptor *typedesc)
+{
+    assert(!prgstate->type_scratch);
+    if (!typedesc->in_scratch)
+    {
+        return typedesc;
+    }
+
+    // Global types are only equal when their parts are the same pointers,
+    // so the parts go first
+    TypeDescriptor promoted = copy_typedesc(typedesc);
+    TYPESWITCH (promoted.type_id)
+    {
+        case TypeID::None:
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+            break;
+
+        case TypeID::Array:
+            promoted.array_type.elem_type = promote_typedesc(prgstate, promoted.array_type.elem_type);
+            break;
+
+        case TypeID::Compound:
+            for (DynArrayCount i = 0; i < promoted.compound_type.members.count; ++i)
+            {
+                CompoundTypeMember *member = &promoted.compound_type.members[i];
+                member->typedesc = promote_typedesc(prgstate, member->typedesc);
+            }
+            break;
+
+        case TypeID::Union:
+            for (DynArrayCount i = 0; i < promoted.union_type.type_cases.count; ++i)
+            {
+                TypeDescriptor **type_case = &promoted.union_type.type_cases[i];
+                *type_case = promote_typedesc(prgstate, *type_case);
+            }
+            break;
+    }
+
+    bool new_type_added;
+    TypeDescriptor *result = find_equiv_typedesc_or_add(prgstate, &promoted, &new_type_added);
+    if (!new_type_added)
+    {
+        free_typedescriptor_components(&promoted);
+    }
+    return result;
+}
+
+
+void promote_value_types(ProgramState *prgstate, Value *value)
+{
+    value->typedesc = promote_typedesc(prgstate, value->typedesc);
+
+    TYPESWITCH (value->typedesc->type_id)
+    {
+        case TypeID::None:
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+        case TypeID::Union:
+            break;
+
+        case TypeID::Array:
+            for (DynArrayCount i = 0; i < value->array_value.elements.count; ++i)
+            {
+                promote_value_types(prgstate, &value->array_value.elements[i]);
+            }
+            break;
+
+        case TypeID::Compound:
+            for (DynArrayCount i = 0; i < value->compound_value.members.count; ++i)
+            {
+                promote_value_types(prgstate, &value->compound_value.members[i].value);
+            }
+            break;
+    }
+}
+
+
+void request_type_collection(ProgramState *prgstate)
+{
+    prgstate->type_collection_requested = true;
+}
+
+
+bool collect_types_if_requested(ProgramState *prgstate)
+{
+    if (!prgstate->type_collection_requested || prgstate->type_scratch || prgstate->jobs.count > 0)
+    {
+        return false;
+    }
+
+    TypeCollectionStats stats = collect_types(prgstate);
+    logf_ln("Freed %u of %u types and %u names bound to them, %u type buckets released, in %.2f ms",
+            stats.types_freed, stats.types_before, stats.names_unbound, stats.buckets_released,
+            (double)stats.ns / 1000000.0);
+    return true;
+}
+
+
+static void mark_type(TypeDescriptor *typedesc)
+{
+    if (typedesc->marked)
+    {
+        return;
+    }
+    typedesc->marked = true;
+
+    TYPESWITCH (typedesc->type_id)
+    {
+        case TypeID::None:
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+            break;
+
+        case TypeID::Array:
+            mark_type(typedesc->array_type.elem_type);
+            break;
+
+        case TypeID::Compound:
+            for (DynArrayCount i = 0; i < typedesc->compound_type.members.count; ++i)
+            {
+                mark_type(typedesc->compound_type.members[i].typedesc);
+            }
+            break;
+
+        case TypeID::Union:
+            for (DynArrayCount i = 0; i < typedesc->union_type.type_cases.count; ++i)
+            {
+                mark_type(typedesc->union_type.type_cases[i]);
+            }
+            break;
+    }
+}
+
+
+// An array's elements needn't have its element type, merging can make a
+// type none of them have, so every value gets visited
+static void mark_value_types(const Value *value)
+{
+    mark_type(value->typedesc);
+
+    TYPESWITCH (value->typedesc->type_id)
+    {
+        case TypeID::None:
+        case TypeID::String:
+        case TypeID::Int:
+        case TypeID::Float:
+        case TypeID::Bool:
+        case TypeID::Union:
+            break;
+
+        case TypeID::Array:
+            for (DynArrayCount i = 0; i < value->array_value.elements.count; ++i)
+            {
+                mark_value_types(&value->array_value.elements[i]);
+            }
+            break;
+
+        case TypeID::Compound:
+            for (DynArrayCount i = 0; i < value->compound_value.members.count; ++i)
+            {
+                mark_value_types(&value->compound_value.members[i].value);
+            }
+            break;
+    }
+}
+
+
+TypeCollectionStats collect_types(ProgramState *prgstate)
+{
+    PROF_FUNCTION();
+    ASSERT(!prgstate->type_scratch);
+
+    u64 start_time = query_abstime();
+    TypeCollectionStats stats = {};
+    stats.types_before = prgstate->type_descriptors.count;
+    prgstate->type_collection_requested = false;
+
+    mark_type(prgstate->prim_string);
+    mark_type(prgstate->prim_int);
+    mark_type(prgstate->prim_float);
+    mark_type(prgstate->prim_bool);
+    mark_type(prgstate->prim_none);
+
+    OAHashtable<NameRef, TypeBinding> *bindings = &prgstate->typedesc_bindings;
+    for (u32 i = 0; i < bindings->bucket_count; ++i)
+    {
+        if (bindings->buckets[i].state == OAHashtable<NameRef, TypeBinding>::BucketState::Filled
+            && !bindings->entries[i].value.weak)
+        {
+            mark_type(bindings->entries[i].value.typedesc);
+        }
+    }
+
+    for (BucketArray<Collection>::Iterator it = bucketarray::iterate(&prgstate->collections);
+         bucketarray::next(&it);)
+    {
+        mark_type(it.elem->top_typedesc);
+        mark_value_types(&it.elem->value);
+    }
+
+    StrToValueMap *values = &prgstate->value_map;
+    for (u32 i = 0; i < values->bucket_count; ++i)
+    {
+        if (values->buckets[i].state == StrToValueMap::BucketState::Filled)
+        {
+            mark_value_types(&values->entries[i].value);
+        }
+    }
+
+    for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(&prgstate->type_descriptors);
+         bucketarray::next(&it);)
+    {
+        TypeDescriptor *typedesc = it.elem;
+        if (typedesc->marked)
+        {
+            typedesc->marked = false;
+            continue;
+        }
+
+        // Only weak names are left bound to it
+        DynArray<NameRef> *names = ht_find(&prgstate->typedesc_reverse_bindings, typedesc);
+        if (names)
+        {
+            for (DynArrayCount i = 0; i < names->count; ++i)
+            {
+                ht_remove(&prgstate->typedesc_bindings, (*names)[i]);
+                ++stats.names_unbound;
+            }
+            dynarray::deinit(names);
+            ht_remove(&prgstate->typedesc_reverse_bindings, typedesc);
+        }
+
+        free_typedescriptor_components(typedesc);
+        bucketarray::remove_at(&prgstate->type_descriptors, it.bidx);
+        ++stats.types_freed;
+    }
+
+    if (stats.types_freed)
+    {
+        // Lookups scan the table, empty buckets would still cost them
+        stats.buckets_released = bucketarray::release_empty_buckets(&prgstate->type_descriptors);
+        if (prgstate->typedesc_bindings.removed_count)
+        {
+            ht_rehash(&prgstate->typedesc_bindings, prgstate->typedesc_bindings.bucket_count);
+        }
+        if (prgstate->typedesc_reverse_bindings.removed_count)
+        {
+            ht_rehash(&prgstate->typedesc_reverse_bindings, prgstate->typedesc_reverse_bindings.bucket_count);
+        }
+        ++prgstate->types_generation;
+    }
+
+    stats.ns = nanoseconds_since(start_time);
+    return stats;
+}
+
+
 TypeCheckInfo check_type_compatible(TypeDescriptor *input, TypeDescriptor *validator)
 {
     TypeCheckInfo result = {};
@@ -782,6 +1170,69 @@ CompoundValueMember *find_member(const Value *value, NameRef name)
 }
 
 
+static char value_storage_allocator_storage[sizeof(mem::PrefixAllocator)];
+static mem::PrefixAllocator *value_storage_allocator_inst = 0;
+
+
+mem::IAllocator *value_storage_allocator()
+{
+    if (!value_storage_allocator_inst)
+    {
+        value_storage_allocator_inst = new (value_storage_allocator_storage)
+            mem::PrefixAllocator(mem::default_allocator(), sizeof(u64));
+    }
+    return value_storage_allocator_inst;
+}
+
+
+// nullptr if value isn't a container, or its storage has no room for a
+// hash: there is none yet, or it came from some other allocator
+static u64 *cached_hash_slot(const Value *value)
+{
+    void *data;
+    mem::IAllocator *allocator;
+    if (tIS_ARRAY(value->typedesc))
+    {
+        data = value->array_value.elements.data;
+        allocator = value->array_value.elements.allocator;
+    }
+    else if (tIS_COMPOUND(value->typedesc))
+    {
+        data = value->compound_value.members.data;
+        allocator = value->compound_value.members.allocator;
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    if (!data || allocator != value_storage_allocator_inst)
+    {
+        return nullptr;
+    }
+    return (u64 *)mem::PrefixAllocator::prefix(data, sizeof(u64));
+}
+
+
+static void copy_cached_hash(Value *dest, const Value *src)
+{
+    u64 *dest_slot = cached_hash_slot(dest);
+    u64 *src_slot = cached_hash_slot(src);
+    if (dest_slot)
+    {
+        *dest_slot = src_slot ? *src_slot : 0;
+    }
+}
+
+
+static bool cached_hashes_differ(const Value *lhs, const Value *rhs)
+{
+    u64 *lhs_slot = cached_hash_slot(lhs);
+    u64 *rhs_slot = cached_hash_slot(rhs);
+    return lhs_slot && rhs_slot && *lhs_slot && *rhs_slot && *lhs_slot != *rhs_slot;
+}
+
+
 Value clone(const Value *src)
 {
     value_assertions(src);
@@ -801,11 +1252,11 @@ Value clone(const Value *src)
             break;
 
         case TypeID::Int:
-            result.s32_val = src->s32_val;
+            result.s64_val = src->s64_val;
             break;
 
         case TypeID::Float:
-            result.f32_val = src->f32_val;
+            result.f64_val = src->f64_val;
             break;
 
         case TypeID::Bool:
@@ -813,17 +1264,20 @@ Value clone(const Value *src)
             break;
 
         case TypeID::Array:
-            dynarray::init(&result.array_value.elements, src->array_value.elements.count);
+            dynarray::init(&result.array_value.elements, src->array_value.elements.count,
+                           value_storage_allocator());
             for (DynArrayCount i = 0; i < src->array_value.elements.count; ++i)
             {
                 Value *src_element = &src->array_value.elements[i];
                 Value *dest_element = dynarray::append(&result.array_value.elements);
                 *dest_element = clone(src_element);
             }
+            copy_cached_hash(&result, src);
             break;
 
         case TypeID::Compound:
-            dynarray::init(&result.compound_value.members, src->compound_value.members.count);
+            dynarray::init(&result.compound_value.members, src->compound_value.members.count,
+                           value_storage_allocator());
             for (DynArrayCount i = 0; i < src->compound_value.members.count; ++i)
             {
                 CompoundValueMember *src_member = &src->compound_value.members[i];
@@ -831,6 +1285,7 @@ Value clone(const Value *src)
                 dest_member->name = src_member->name;
                 dest_member->value = clone(&src_member->value);
             }
+            copy_cached_hash(&result, src);
             break;
 
         case TypeID::Union:
@@ -858,14 +1313,20 @@ bool value_equal(const Value &lhs, const Value &rhs)
     {
         case TypeID::None:     return true;
         case TypeID::String:   return str_equal(lhs.str_val, rhs.str_val);
-        case TypeID::Int:      return lhs.s32_val == rhs.s32_val;
-        case TypeID::Float:    return 0.0f == (lhs.f32_val - rhs.f32_val);
+        case TypeID::Int:      return lhs.s64_val == rhs.s64_val;
+        case TypeID::Float:    return 0.0 == (lhs.f64_val - rhs.f64_val);
         case TypeID::Bool:     return lhs.bool_val == rhs.bool_val;
 
         case TypeID::Array:
         {
-            DynArrayCount num_elems = lhs.array_value.elements.count; 
-            if (num_elems != lhs.array_value.elements.count)
+            // Only hashes already worked out, it isn't worth a walk here
+            if (cached_hashes_differ(&lhs, &rhs))
+            {
+                return false;
+            }
+
+            DynArrayCount num_elems = lhs.array_value.elements.count;
+            if (num_elems != rhs.array_value.elements.count)
             {
                 return false;
             }
@@ -882,17 +1343,30 @@ bool value_equal(const Value &lhs, const Value &rhs)
         }
 
         case TypeID::Compound:
-            for (u32 i = 0; i < type_desc->compound_type.members.count; ++i)
+        {
+            if (cached_hashes_differ(&lhs, &rhs))
             {
-                CompoundTypeMember *type_member = &type_desc->compound_type.members[i];
-                CompoundValueMember *lh_member = find_member(&lhs, type_member->name);
-                CompoundValueMember *rh_member = find_member(&rhs, type_member->name);
+                return false;
+            }
+
+            // Members are nearly always in the same order on both sides
+            const DynArray<CompoundValueMember> *rh_members = &rhs.compound_value.members;
+            for (DynArrayCount i = 0; i < lhs.compound_value.members.count; ++i)
+            {
+                CompoundValueMember *lh_member = &lhs.compound_value.members[i];
+                CompoundValueMember *rh_member = &(*rh_members)[i];
+                if (!nameref::identical(lh_member->name, rh_member->name))
+                {
+                    rh_member = find_member(&rhs, lh_member->name);
+                }
 
                 if (!value_equal(lh_member->value, rh_member->value))
                 {
                     return false;
                 }
             }
+            break;
+        }
 
         case TypeID::Union:
             assert(!(bool)"There must never be a value of type Union");
@@ -903,6 +1377,117 @@ bool value_equal(const Value &lhs, const Value &rhs)
 }
 
 
+static u64 mix_hash(u64 h)
+{
+    // splitmix64's finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+
+static u64 bytes_hash(StrSlice bytes)
+{
+    u64 out[2];
+    MurmurHash3_x64_128(bytes.data, (int)bytes.length, 0, out);
+    return out[0];
+}
+
+
+u64 value_hash(Value *value)
+{
+    value_assertions(value);
+    TypeDescriptor *type_desc = value->typedesc;
+    u64 *hash_slot = cached_hash_slot(value);
+
+    u64 contents = 0;
+
+    TYPESWITCH (type_desc->type_id)
+    {
+        case TypeID::None:
+            break;
+
+        case TypeID::String:
+            contents = bytes_hash(str_slice(value->str_val));
+            break;
+
+        case TypeID::Int:
+            contents = (u64)value->s64_val;
+            break;
+
+        case TypeID::Float:
+        {
+            // -0.0 equals 0.0, so they have to hash the same
+            f64 f = value->f64_val == 0.0 ? 0.0 : value->f64_val;
+            std::memcpy(&contents, &f, sizeof(contents));
+            break;
+        }
+
+        case TypeID::Bool:
+            contents = value->bool_val;
+            break;
+
+        case TypeID::Array:
+        {
+            if (hash_slot && *hash_slot)
+            {
+                return *hash_slot;
+            }
+            contents = value->array_value.elements.count;
+            for (DynArrayCount i = 0; i < value->array_value.elements.count; ++i)
+            {
+                contents = mix_hash(contents + value_hash(&value->array_value.elements[i]));
+            }
+            break;
+        }
+
+        case TypeID::Compound:
+        {
+            if (hash_slot && *hash_slot)
+            {
+                return *hash_slot;
+            }
+            // Summed so member order doesn't count, as in value_equal.
+            // Names go in by their text, handles differ between runs.
+            contents = value->compound_value.members.count;
+            for (DynArrayCount i = 0; i < value->compound_value.members.count; ++i)
+            {
+                CompoundValueMember *member = &value->compound_value.members[i];
+                contents += mix_hash(bytes_hash(nameref::str_slice(member->name)) ^ value_hash(&member->value));
+            }
+            break;
+        }
+
+        case TypeID::Union:
+            ASSERT_MSG("There must never be a value of type Union");
+            break;
+    }
+
+    u64 result = mix_hash(contents ^ ((u64)type_desc->type_id * 0x9e3779b97f4a7c15ull));
+    // 0 means not worked out yet
+    result += result == 0;
+
+    if (hash_slot)
+    {
+        *hash_slot = result;
+    }
+    return result;
+}
+
+
+void value_hash_changed(Value *value)
+{
+    u64 *hash_slot = cached_hash_slot(value);
+    if (hash_slot)
+    {
+        *hash_slot = 0;
+    }
+}
+
+
 void value_free_components(Value *value)
 {
     value_assertions(value);
@@ -949,6 +1534,7 @@ void init_array_value(Value *array_value, TypeDescriptor *typedesc, DynArray<Val
 {
     array_value->array_value.elements = values;
     array_value->typedesc = typedesc;
+    value_hash_changed(array_value);
 }
 
 
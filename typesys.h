@@ -21,6 +21,7 @@ parse_type <type descriptor syntax>
 #include "numeric_types.h"
 #include "str.h"
 #include "dynarray.h"
+#include "bucketarray.h"
 #include "nametable.h"
 #include "common.h"
 
@@ -28,6 +29,7 @@ parse_type <type descriptor syntax>
 #define TYPESWITCH(type_id) switch ((TypeID::Tag)(type_id))
 
 #define tIS_INT(typedesc)      ((typedesc)->type_id == TypeID::Int)
+#define tIS_FLOAT(typedesc)    ((typedesc)->type_id == TypeID::Float)
 #define tIS_STRING(typedesc)   ((typedesc)->type_id == TypeID::String)
 #define tIS_BOOL(typedesc)     ((typedesc)->type_id == TypeID::Bool)
 #define tIS_ARRAY(typedesc)    ((typedesc)->type_id == TypeID::Array)
@@ -35,6 +37,7 @@ parse_type <type descriptor syntax>
 #define tIS_UNION(typedesc)    ((typedesc)->type_id == TypeID::Union)
 
 #define vIS_INT(val)           tIS_INT((val)->typedesc)
+#define vIS_FLOAT(val)         tIS_FLOAT((val)->typedesc)
 #define vIS_STRING(val)        tIS_STRING((val)->typedesc)
 #define vIS_BOOL(val)          tIS_BOOL((val)->typedesc)
 #define vIS_ARRAY(val)         tIS_ARRAY((val)->typedesc)
@@ -117,6 +120,10 @@ struct CompoundType
 struct TypeDescriptor
 {
     u32 type_id;
+    // set by add_typedescriptor while a TypeScratch is active
+    bool in_scratch;
+    // only meaningful during collect_types
+    bool marked;
     union
     {
         CompoundType compound_type;
@@ -127,6 +134,14 @@ struct TypeDescriptor
 };
 
 
+struct TypeBinding
+{
+    TypeDescriptor *typedesc;
+    // see bind_typedesc_name_weak
+    bool weak;
+};
+
+
 enum TypeCheckResult
 {
     TypeCheckResult_Invalid,
@@ -182,6 +197,9 @@ struct CompoundValueMember;
 struct Value;
 
 
+// value_hash caches the hash of these in front of their storage, when
+// it comes from value_storage_allocator. Anything that changes a value
+// inside one of them clears it with value_hash_changed.
 struct ArrayValue
 {
     DynArray<Value> elements;
@@ -200,8 +218,8 @@ struct Value
     union
     {
         Str str_val;
-        f32 f32_val;
-        s32 s32_val;
+        f64 f64_val;
+        s64 s64_val;
         bool bool_val;
         CompoundValue compound_value;
         ArrayValue array_value;
@@ -227,15 +245,6 @@ inline void value_assertions(const Value *value)
     assert(value->typedesc->type_id != TypeID::Union);
 }
 
-// struct ValueHash
-// {
-//     u32 operator()(const Value &value)
-//     {
-//         TypeDescriptor
-//     }
-// };
-
-
 inline DynArrayCount union_num_cases(TypeDescriptor *typedesc)
 {
     ASSERT(tIS_UNION(typedesc));
@@ -268,6 +277,10 @@ void bind_typedesc_name(ProgramState *prgstate, NameRef name, TypeDescriptor *ty
 void bind_typedesc_name(ProgramState *prgstate, StrSlice name, TypeDescriptor *typedesc);
 void bind_typedesc_name(ProgramState *prgstate, Str name, TypeDescriptor *typedesc);
 void bind_typedesc_name(ProgramState *prgstate, const char *name, TypeDescriptor *typedesc);
+// For names that only describe a type, like a loaded file's path. They
+// don't keep the type alive and go away with it.
+void bind_typedesc_name_weak(ProgramState *prgstate, StrSlice name, TypeDescriptor *typedesc);
+void bind_typedesc_name_weak(ProgramState *prgstate, Str name, TypeDescriptor *typedesc);
 
 DynArray<NameRef> *find_names_of_typedesc(ProgramState *prgstate, TypeDescriptor *typedesc);
 DynArrayCount find_names_of_typedesc(OUTPARAM DynArray<NameRef> *result_list, ProgramState *prgstate, TypeDescriptor *typedesc);
@@ -288,6 +301,55 @@ TypeDescriptor *merge_each_type(ProgramState *prgstate, const DynArray<Value> &v
 void free_typedescriptor_components(TypeDescriptor *typedesc);
 
 
+/*
+While a TypeScratch is active, new types go into it instead of the global
+table, and lookups see both. Discarding it frees only its own types, so
+throwaway values like command arguments don't grow the global table.
+Anything that outlives the scratch, a bound name or a stored value, has
+to have its types promoted first.
+*/
+struct TypeScratch
+{
+    BucketArray<TypeDescriptor> type_descriptors;
+};
+
+void begin_type_scratch(ProgramState *prgstate, TypeScratch *scratch);
+// New types go to the global table again, the scratch's types stay valid
+void end_type_scratch(ProgramState *prgstate, TypeScratch *scratch);
+void discard_type_scratch(TypeScratch *scratch);
+
+// The equivalent global type, added if there isn't one. Global types
+// come back as they are.
+TypeDescriptor *promote_typedesc(ProgramState *prgstate, TypeDescriptor *typedesc);
+void promote_value_types(ProgramState *prgstate, Value *value);
+
+
+/*
+Types are shared and nothing counts references to them, so dropping a
+collection leaves its types, and every intermediate merge_types made on
+the way, in the table. Collecting marks what the collections, the stored
+values and the strong name bindings reach and frees the rest, along with
+their weak bindings and any type buckets left empty.
+
+It only happens at points where nothing else can be holding types, see
+collect_types_if_requested.
+*/
+struct TypeCollectionStats
+{
+    u32 types_before;
+    u32 types_freed;
+    u32 names_unbound;
+    DynArrayCount buckets_released;
+    u64 ns;
+};
+
+void request_type_collection(ProgramState *prgstate);
+// Collects if it was requested, unless command arguments or a job that
+// hasn't published yet could still be using types. Returns whether it did.
+bool collect_types_if_requested(ProgramState *prgstate);
+TypeCollectionStats collect_types(ProgramState *prgstate);
+
+
 inline void add_member(TypeDescriptor *typedesc, const CompoundTypeMember &member)
 {
     CompoundTypeMember *new_member = dynarray::append(&typedesc->compound_type.members);
@@ -300,10 +362,21 @@ CompoundValueMember *find_member(const Value *value, NameRef name);
 
 Value clone(const Value *src);
 
+// Same typedesc and same contents, member order doesn't matter
 bool value_equal(const Value &lhs, const Value &rhs);
 
+// Structural, so equal values hash the same in any run. Arrays and
+// compounds keep theirs until value_hash_changed.
+u64 value_hash(Value *value);
+// Forgets value's cached hash. Its containers need the same.
+void value_hash_changed(Value *value);
+// Elements and members should come from here, so there's room for the
+// hash without every Value being bigger
+mem::IAllocator *value_storage_allocator();
+
 void value_free_components(Value *value);
 
+void init_array_value(Value *array_value, TypeDescriptor *typedesc, DynArray<Value> values);
 void init_array_value(Value *array_value, ProgramState *prgstate, DynArray<Value> values);
 
 
@@ -4,8 +4,13 @@
 #include "json_error.h"
 #include "logging.h"
 #include "programstate.h"
-#include "tokenizer.h"
+#include "numbers.h"
 #include "formatbuffer.h"
+#include "profiler.h"
+#include "jobs.h"
+#include "atomics.h"
+#include <cstdlib>
+#include <cstring>
 
 TypeDescriptor *typedesc_from_json_array(ProgramState *prgstate, json_value_s *jv)
 {
@@ -137,8 +142,22 @@ TypeDescriptor *typedesc_from_json_object(ProgramState *prgstate, json_value_s *
 }
 
 
+// json.c has checked the syntax and try_parse_json the range, so this
+// reads all of it
+static ParsedNumber parse_json_number(const json_number_s *jnum)
+{
+    ParsedNumber number;
+    size_t read = numbers::parse(&number, jnum->number, jnum->number_size);
+    ASSERT(read == jnum->number_size && number.kind != NumberKind::OutOfRange);
+    UNUSED(read);
+    return number;
+}
+
+
 TypeDescriptor *typedesc_from_json(ProgramState *prgstate, json_value_s *jv)
 {
+    PROF_FUNCTION();
+
     TypeDescriptor *result;
 
     json_type_e jvtype = (json_type_e)jv->type;
@@ -150,9 +169,8 @@ TypeDescriptor *typedesc_from_json(ProgramState *prgstate, json_value_s *jv)
 
         case json_type_number:
         {
-            json_number_s *jnum = (json_number_s *)jv->payload;
-            tokenizer::Token number_token = tokenizer::read_number(jnum->number, jnum->number_size);
-            result = number_token.type == tokenizer::TokenType::Int ? prgstate->prim_int : prgstate->prim_float;
+            ParsedNumber number = parse_json_number((json_number_s *)jv->payload);
+            result = number.kind == NumberKind::Int ? prgstate->prim_int : prgstate->prim_float;
             break;
         }
 
@@ -180,52 +198,18 @@ TypeDescriptor *typedesc_from_json(ProgramState *prgstate, json_value_s *jv)
 
 
 
-Value create_value_from_token(ProgramState *prgstate, tokenizer::Token token)
+static Value create_number_value(ProgramState *prgstate, const ParsedNumber &number)
 {
-    // good test: {"tulsi": "gabbard", "julian": { "frenchfries": 42.2, "spongebob": {}, "berniebro": 9001}}
-    // bindinfer "Candidate" {"tulsi": "gabbard", "julian": { "frenchfries": 42.2, "spongebob": {}, "berniebro": 9001}}
-    // checktype "Candidate" {"tulsi":"something else","julian":{"frenchfries":9999999.0,"spongebob":{},"berniebro":250000}}
-    Str token_copy = str(token.text);
     Value result = {};
-
-    switch (token.type)
+    if (number.kind == NumberKind::Int)
     {
-        case tokenizer::TokenType::Eof:
-        case tokenizer::TokenType::Unknown:
-            result.typedesc = prgstate->prim_none;
-            break;
-
-        case tokenizer::TokenType::String:
-            result.str_val = token_copy;
-            result.typedesc = prgstate->prim_string;
-            // indicate no need to free
-            token_copy.data = 0;
-            break;
-
-        case tokenizer::TokenType::Int:
-            result.s32_val = atoi(token_copy.data);
-            result.typedesc = prgstate->prim_int;
-            break;
-
-        case tokenizer::TokenType::Float:
-            result.f32_val = (float)atof(token_copy.data);
-            result.typedesc = prgstate->prim_float;
-            break;
-
-        case tokenizer::TokenType::True:
-            result.typedesc = prgstate->prim_bool;
-            result.bool_val = true;
-            break;
-
-        case tokenizer::TokenType::False:
-            result.typedesc = prgstate->prim_bool;
-            result.bool_val = false;
-            break;
+        result.typedesc = prgstate->prim_int;
+        result.s64_val = number.int_val;
     }
-
-    if (token_copy.data)
+    else
     {
-        str_free(&token_copy);
+        result.typedesc = prgstate->prim_float;
+        result.f64_val = number.float_val;
     }
     return result;
 }
@@ -236,7 +220,7 @@ Value create_array_with_type_from_json(ProgramState *prgstate, json_array_s *jar
     Value result;
     result.typedesc = typedesc;
 
-    dynarray::init(&result.array_value.elements, DYNARRAY_COUNT(jarray->length));
+    dynarray::init(&result.array_value.elements, DYNARRAY_COUNT(jarray->length), value_storage_allocator());
     TypeDescriptor *elem_typedesc = typedesc->array_type.elem_type;
 
     DynArrayCount member_idx = 0;
@@ -286,7 +270,8 @@ Value create_object_with_type_from_json(ProgramState *prgstate, json_object_s *j
     Value result;
 
     result.typedesc = typedesc;
-    dynarray::init(&result.compound_value.members, typedesc->compound_type.members.count);
+    dynarray::init(&result.compound_value.members, typedesc->compound_type.members.count,
+                   value_storage_allocator());
 
     DynArrayCount member_idx = 0;
     for (json_object_element_s *jelem = jobj->start;
@@ -353,10 +338,8 @@ Value create_value_from_json(ProgramState *prgstate, json_value_s *jv)
 
         case json_type_number:
         {
-            json_number_s *jnum = (json_number_s *)jv->payload;
-            tokenizer::Token number_token = tokenizer::read_number(jnum->number, jnum->number_size);
-
-            result = create_value_from_token(prgstate, number_token);
+            ParsedNumber number = parse_json_number((json_number_s *)jv->payload);
+            result = create_number_value(prgstate, number);
             break;
         }
 
@@ -397,10 +380,334 @@ Value create_value_from_json(ProgramState *prgstate, json_value_s *jv)
 
 
 
-JsonParseResult try_parse_json_as_value(OUTPARAM Value *output, ProgramState *prgstate,
-                                        const char *input, size_t input_length)
+static void free_partial_members(DynArray<CompoundValueMember> *members)
+{
+    for (DynArrayCount i = 0; i < members->count; ++i)
+    {
+        if ((*members)[i].value.typedesc)
+        {
+            value_free_components(&(*members)[i].value);
+        }
+    }
+    dynarray::deinit(members);
+}
+
+
+static void free_partial_elements(DynArray<Value> *elements)
+{
+    for (DynArrayCount i = 0; i < elements->count; ++i)
+    {
+        value_free_components(&(*elements)[i]);
+    }
+    dynarray::deinit(elements);
+}
+
+
+static bool create_object_expecting_type(OUTPARAM Value *output, ProgramState *prgstate,
+                                         json_object_s *jobj, TypeDescriptor *expected)
+{
+    const DynArray<CompoundTypeMember> *type_members = &expected->compound_type.members;
+    if (jobj->length != type_members->count)
+    {
+        return false;
+    }
+
+    // Slots in the type's order, filled as the json's members turn up
+    DynArray<CompoundValueMember> members;
+    dynarray::init(&members, type_members->count, value_storage_allocator());
+    for (DynArrayCount i = 0; i < type_members->count; ++i)
+    {
+        CompoundValueMember *member = dynarray::append(&members);
+        mem::zero_ptr(member);
+        member->name = (*type_members)[i].name;
+    }
+
+    DynArrayCount slot = 0;
+    for (json_object_element_s *jelem = jobj->start; jelem; jelem = jelem->next, ++slot)
+    {
+        NameRef name = nametable::find(&prgstate->names, str_slice(jelem->name->string, jelem->name->string_size));
+
+        // Usually the json has the members in the same order as the type
+        if (slot >= members.count || !nameref::identical(members[slot].name, name))
+        {
+            slot = 0;
+            while (slot < members.count && !nameref::identical(members[slot].name, name))
+            {
+                ++slot;
+            }
+        }
+
+        if (!name.handle || slot == members.count || members[slot].value.typedesc
+            || !create_value_expecting_type(&members[slot].value, prgstate, jelem->value,
+                                            (*type_members)[slot].typedesc))
+        {
+            free_partial_members(&members);
+            return false;
+        }
+    }
+
+    output->typedesc = expected;
+    output->compound_value.members = members;
+    return true;
+}
+
+
+static bool create_array_expecting_type(OUTPARAM Value *output, ProgramState *prgstate,
+                                        json_array_s *jarray, TypeDescriptor *expected)
+{
+    TypeDescriptor *elem_type = expected->array_type.elem_type;
+    if (jarray->length == 0 && elem_type != prgstate->prim_none)
+    {
+        return false;
+    }
+
+    // Inference makes a union of exactly the types the elements have, so
+    // every case has to be used for the type to be the same
+    const DynArray<TypeDescriptor *> *cases = nullptr;
+    u64 cases_used = 0;
+    if (tIS_UNION(elem_type))
+    {
+        cases = &elem_type->union_type.type_cases;
+        if (cases->count > 64)
+        {
+            return false;
+        }
+    }
+
+    DynArray<Value> elements;
+    dynarray::init(&elements, DYNARRAY_COUNT(jarray->length), value_storage_allocator());
+    for (json_array_element_s *jelem = jarray->start; jelem; jelem = jelem->next)
+    {
+        Value *element = dynarray::append(&elements);
+        bool matched = false;
+
+        if (!cases)
+        {
+            matched = create_value_expecting_type(element, prgstate, jelem->value, elem_type);
+        }
+        else
+        {
+            for (DynArrayCount i = 0; i < cases->count && !matched; ++i)
+            {
+                matched = create_value_expecting_type(element, prgstate, jelem->value, (*cases)[i]);
+                if (matched)
+                {
+                    cases_used |= u64(1) << i;
+                }
+            }
+        }
+
+        if (!matched)
+        {
+            dynarray::pop(&elements);
+            free_partial_elements(&elements);
+            return false;
+        }
+    }
+
+    if (cases && cases_used != (cases->count == 64 ? ~u64(0) : (u64(1) << cases->count) - 1))
+    {
+        free_partial_elements(&elements);
+        return false;
+    }
+
+    output->typedesc = expected;
+    output->array_value.elements = elements;
+    return true;
+}
+
+
+bool create_value_expecting_type(OUTPARAM Value *output, ProgramState *prgstate,
+                                 json_value_s *jv, TypeDescriptor *expected)
+{
+    switch ((json_type_e)jv->type)
+    {
+        case json_type_string:
+        {
+            if (expected != prgstate->prim_string)
+            {
+                return false;
+            }
+            json_string_s *jstr = (json_string_s *)jv->payload;
+            output->typedesc = expected;
+            output->str_val = str(jstr->string, STRLEN(jstr->string_size));
+            return true;
+        }
+
+        case json_type_number:
+        {
+            ParsedNumber number = parse_json_number((json_number_s *)jv->payload);
+            *output = create_number_value(prgstate, number);
+            return output->typedesc == expected;
+        }
+
+        case json_type_object:
+            return tIS_COMPOUND(expected)
+                && create_object_expecting_type(output, prgstate, (json_object_s *)jv->payload, expected);
+
+        case json_type_array:
+            return tIS_ARRAY(expected)
+                && create_array_expecting_type(output, prgstate, (json_array_s *)jv->payload, expected);
+
+        case json_type_true:
+        case json_type_false:
+            if (expected != prgstate->prim_bool)
+            {
+                return false;
+            }
+            output->typedesc = expected;
+            output->bool_val = jv->type == json_type_true;
+            return true;
+
+        case json_type_null:
+            if (expected != prgstate->prim_none)
+            {
+                return false;
+            }
+            mem::zero_ptr(output);
+            output->typedesc = expected;
+            return true;
+    }
+
+    return false;
+}
+
+
+// Only a number with an exponent or over 300 digits can be too big for a
+// double, so most aren't parsed here. Counts the numbers before the first
+// one that's too big, in document order.
+static bool find_out_of_range_number(const json_value_s *jv, size_t *numbers_before)
+{
+    switch ((json_type_e)jv->type)
+    {
+        case json_type_number:
+        {
+            const json_number_s *jnum = (const json_number_s *)jv->payload;
+            if (jnum->number_size > 300 || memchr(jnum->number, 'e', jnum->number_size)
+                || memchr(jnum->number, 'E', jnum->number_size))
+            {
+                ParsedNumber number;
+                numbers::parse(&number, jnum->number, jnum->number_size);
+                if (number.kind == NumberKind::OutOfRange)
+                {
+                    return true;
+                }
+            }
+            ++*numbers_before;
+            return false;
+        }
+
+        case json_type_object:
+            for (const json_object_element_s *elem = ((const json_object_s *)jv->payload)->start;
+                 elem; elem = elem->next)
+            {
+                if (find_out_of_range_number(elem->value, numbers_before))
+                {
+                    return true;
+                }
+            }
+            return false;
+
+        case json_type_array:
+            for (const json_array_element_s *elem = ((const json_array_s *)jv->payload)->start;
+                 elem; elem = elem->next)
+            {
+                if (find_out_of_range_number(elem->value, numbers_before))
+                {
+                    return true;
+                }
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+
+// json.c copies numbers out of the input, so finding one again means
+// counting number tokens, skipping strings and comments
+static size_t nth_number_offset(const char *input, size_t input_length, size_t n)
+{
+    const char *cursor = input;
+    const char *end = input + input_length;
+    while (cursor < end)
+    {
+        char c = *cursor;
+        if (c == '"')
+        {
+            for (++cursor; cursor < end && *cursor != '"'; ++cursor)
+            {
+                cursor += *cursor == '\\';
+            }
+            ++cursor;
+        }
+        else if (c == '/' && cursor + 1 < end && cursor[1] == '/')
+        {
+            while (cursor < end && *cursor != '\n')
+            {
+                ++cursor;
+            }
+        }
+        else if (c == '/' && cursor + 1 < end && cursor[1] == '*')
+        {
+            cursor += 2;
+            while (cursor + 1 < end && !(cursor[0] == '*' && cursor[1] == '/'))
+            {
+                ++cursor;
+            }
+            cursor += 2;
+        }
+        else if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            if (n-- == 0)
+            {
+                return (size_t)(cursor - input);
+            }
+            while (cursor < end && (*cursor == '-' || *cursor == '+' || *cursor == '.'
+                                    || *cursor == 'e' || *cursor == 'E' || (*cursor >= '0' && *cursor <= '9')))
+            {
+                ++cursor;
+            }
+        }
+        else
+        {
+            ++cursor;
+        }
+    }
+    return input_length;
+}
+
+
+static void fail_out_of_range_number(JsonParseResult *result, const char *input, size_t input_length,
+                                     size_t numbers_before)
 {
+    size_t offset = nth_number_offset(input, input_length, numbers_before);
+
+    result->error_line = 1;
+    size_t line_start = 0;
+    for (size_t i = 0; i < offset; ++i)
+    {
+        if (input[i] == '\n')
+        {
+            ++result->error_line;
+            line_start = i + 1;
+        }
+    }
+    // log_parse_error puts its caret one before error_offset
+    result->error_offset = offset + 1;
+    result->error_column = offset - line_start + 1;
+    result->error_desc = str("number too big for a double");
+    result->status = JsonParseResult::Failed;
+}
+
+
+JsonParseResult try_parse_json(OUTPARAM json_value_s **output, const char *input, size_t input_length)
+{
+    PROF_FUNCTION();
+
     JsonParseResult result = {};
+    *output = nullptr;
 
     if (input_length == 0)
     {
@@ -445,7 +752,17 @@ JsonParseResult try_parse_json_as_value(OUTPARAM Value *output, ProgramState *pr
     }
     else
     {
-        *output = create_value_from_json(prgstate, jv);
+        // json.h takes any number, an infinity would have no json to go
+        // back to
+        size_t numbers_before = 0;
+        if (find_out_of_range_number(jv, &numbers_before))
+        {
+            fail_out_of_range_number(&result, input, input_length, numbers_before);
+            free(jv);
+            return result;
+        }
+
+        *output = jv;
         result.status = JsonParseResult::Succeeded;
     }
 
@@ -453,6 +770,22 @@ JsonParseResult try_parse_json_as_value(OUTPARAM Value *output, ProgramState *pr
 }
 
 
+JsonParseResult try_parse_json_as_value(OUTPARAM Value *output, ProgramState *prgstate,
+                                        const char *input, size_t input_length)
+{
+    json_value_s *jv;
+    JsonParseResult result = try_parse_json(&jv, input, input_length);
+
+    if (result.status == JsonParseResult::Succeeded)
+    {
+        *output = create_value_from_json(prgstate, jv);
+        free(jv);
+    }
+
+    return result;
+}
+
+
 void JsonParseResult::release()
 {
     str_free(&error_desc);
@@ -477,104 +810,305 @@ void LoadJsonDirResult::release()
 }
 
 
-LoadJsonDirResult load_json_dir(ProgramState *prgstate, const char *path, size_t path_length)
+static void free_parsed_file(ParsedJsonFile *file)
 {
-    LoadJsonDirResult result = {};
+    str_free(&file->fullpath);
+    str_free(&file->access_path);
+    free(file->root);
+    file->root = nullptr;
+}
 
-    DynArray<RecordInfo> record_infos;
-    dynarray::init(&record_infos, 8);
 
-    DynArray<Value> values;
-    dynarray::init(&values, 8);
+void parsed_json_dir_free(ParsedJsonDir *parsed)
+{
+    str_free(&parsed->path);
 
-    DirLister dirlist(path, path_length);
+    for (DynArrayCount i = 0; i < parsed->files.count; ++i)
+    {
+        free_parsed_file(&parsed->files[i]);
+    }
+    dynarray::deinit(&parsed->files);
 
-    if (dirlist.has_error())
+    for (DynArrayCount i = 0; i < parsed->values.count; ++i)
     {
-        result = LoadJsonDirResult::from_fs_error(dirlist.error);
-        return result;
+        value_free_components(&parsed->values[i]);
     }
+    dynarray::deinit(&parsed->values);
+}
 
-    while (dirlist.next())
+
+static bool try_known_type(OUTPARAM Value *output, ProgramState *prgstate, json_value_s *root,
+                           TypeDescriptor *candidate, DynArray<TypeDescriptor *> *tried)
+{
+    if (!candidate || dynarray::find(tried, candidate))
     {
-        if ( ! (dirlist.current.is_file && str_endswith_ignorecase(dirlist.current.name, ".json")))
+        return false;
+    }
+    dynarray::append(tried, candidate);
+    return create_value_expecting_type(output, prgstate, root, candidate);
+}
+
+
+// Types the file is likely to have: its own from the last time it was
+// loaded, one bound to the directory's path (by that load, or by hand
+// with bindinfer), and the previous file's
+static bool create_value_with_known_type(OUTPARAM Value *output, ProgramState *prgstate,
+                                         ParsedJsonDir *parsed, ParsedJsonFile *file)
+{
+    PROF_FUNCTION();
+
+    TypeDescriptor *tried_storage[8];
+    DynArray<TypeDescriptor *> tried = {tried_storage, 0, COUNTOF(tried_storage), nullptr};
+    bool found = try_known_type(output, prgstate, file->root,
+                                find_typedesc_by_name(prgstate, file->access_path), &tried);
+
+    TypeDescriptor *dir_type = find_typedesc_by_name(prgstate, parsed->path);
+    if (!found && dir_type && tIS_UNION(dir_type))
+    {
+        const DynArray<TypeDescriptor *> *cases = &dir_type->union_type.type_cases;
+        for (DynArrayCount i = 0; !found && i < cases->count && tried.count < tried.capacity; ++i)
         {
-            continue;
+            found = try_known_type(output, prgstate, file->root, (*cases)[i], &tried);
+        }
+    }
+    else if (!found && tried.count < tried.capacity)
+    {
+        found = try_known_type(output, prgstate, file->root, dir_type, &tried);
+    }
+
+    if (!found && parsed->values.count > 0 && tried.count < tried.capacity)
+    {
+        found = try_known_type(output, prgstate, file->root, parsed->values[parsed->values.count - 1].typedesc, &tried);
+    }
+
+    return found;
+}
+
+
+static void make_parsed_file_value(ProgramState *prgstate, ParsedJsonDir *parsed)
+{
+    u64 start_time = query_abstime();
+
+    ParsedJsonFile *file = &parsed->files[parsed->values.count];
+    Value value;
+    if (create_value_with_known_type(&value, prgstate, parsed, file))
+    {
+        ++parsed->files_typed_by_known_type;
+    }
+    else
+    {
+        value = create_value_from_json(prgstate, file->root);
+    }
+    free(file->root);
+    file->root = nullptr;
+
+    dynarray::append(&parsed->values, value);
+    bind_typedesc_name_weak(prgstate, file->access_path, value.typedesc);
+
+    file->value_ns = nanoseconds_since(start_time);
+    parsed->timings.values_ns += file->value_ns;
+}
+
+
+// With make_values_with, each file becomes a value as soon as it's parsed
+// so only one file's json is held at a time
+static LoadJsonDirResult parse_json_dir(OUTPARAM ParsedJsonDir *parsed, const char *path, size_t path_length,
+                                        JobProgress *progress, ProgramState *make_values_with)
+{
+    PROF_FUNCTION();
+
+    LoadJsonDirResult result = {};
+
+    mem::zero_ptr(parsed);
+    parsed->path = str(path, STRLEN(path_length));
+    dynarray::init(&parsed->files, 8);
+    dynarray::init(&parsed->values, 8, value_storage_allocator());
+
+    JobProgress no_progress = {};
+    if (!progress)
+    {
+        progress = &no_progress;
+    }
+
+    // Listed first so the progress has totals to go by
+    u64 list_start = query_abstime();
+    DynArray<ParsedJsonFile> listed = dynarray::init<ParsedJsonFile>(8);
+    {
+        DirLister dirlist(path, path_length);
+
+        if (dirlist.has_error())
+        {
+            dynarray::deinit(&listed);
+            result = LoadJsonDirResult::from_fs_error(dirlist.error);
+            return result;
+        }
+
+        while (dirlist.next())
+        {
+            if ( ! (dirlist.current.is_file && str_endswith_ignorecase(dirlist.current.name, ".json")))
+            {
+                continue;
+            }
+
+            ParsedJsonFile file = {};
+            file.access_path = str(dirlist.current.access_path);
+            file.size = dirlist.current.filesize;
+            dynarray::append(&listed, file);
+
+            parsed->bytes_listed += file.size;
+            atomic::store_release(&progress->files_found, listed.count);
+            atomic::fetch_add(&progress->bytes_found, (u64)file.size);
         }
+    }
+    parsed->files_listed = listed.count;
+    parsed->timings.list_ns = nanoseconds_since(list_start);
+
+    DynArrayCount next = 0;
+    for (; next < listed.count && !atomic::load_acquire(&progress->cancel); ++next)
+    {
+        ParsedJsonFile *file = &listed[next];
 
         Str filecontents = {};
 
-        FileReadResult read_result = read_text_file(&filecontents, dirlist.current.access_path.data);
+        u64 read_start = query_abstime();
+        FileReadResult read_result = read_text_file(&filecontents, str_data(file->access_path));
+        file->read_ns = nanoseconds_since(read_start);
+        parsed->timings.read_ns += file->read_ns;
 
         if (read_result.error_kind != FileReadResult::NoError)
         {
             result = LoadJsonDirResult::from_fs_error(read_result.platform_error);
-            goto BreakWhile;
+            break;
         }
 
         read_result.release();
 
-        Value parsed_value;
-        JsonParseResult last_parse_result = try_parse_json_as_value(OUTPARAM &parsed_value, prgstate,
-                                                                    filecontents.data, filecontents.length);
+        u64 parse_start = query_abstime();
+        JsonParseResult parse_result = try_parse_json(OUTPARAM &file->root,
+                                                      str_data(filecontents), str_length(filecontents));
+        file->parse_ns = nanoseconds_since(parse_start);
+        parsed->timings.parse_ns += file->parse_ns;
 
         str_free(&filecontents);
 
-        switch (last_parse_result.status)
-        {
-            case JsonParseResult::Eof:
-                break;
+        atomic::fetch_add(&progress->files_done, 1u);
+        atomic::fetch_add(&progress->bytes_done, (u64)file->size);
 
-            case JsonParseResult::Failed:
-                result = LoadJsonDirResult::from_parse_error(last_parse_result);
-                goto BreakWhile;
+        if (parse_result.status == JsonParseResult::Failed)
+        {
+            result = LoadJsonDirResult::from_parse_error(parse_result);
+            break;
+        }
+        else if (parse_result.status == JsonParseResult::Eof)
+        {
+            free_parsed_file(file);
+            continue;
+        }
 
-            case JsonParseResult::Succeeded:
-            {
-                Str fullpath = {};
-                PlatformError abspath_err = resolve_path(&fullpath, dirlist.current.access_path.data);
-                if (abspath_err.is_error())
-                {
-                    result = LoadJsonDirResult::from_fs_error(abspath_err);
-                    goto BreakWhile;
-                }
-                else
-                {
-                    dynarray::append(&values, parsed_value);
+        PlatformError abspath_err = resolve_path(&file->fullpath, str_data(file->access_path));
+        if (abspath_err.is_error())
+        {
+            result = LoadJsonDirResult::from_fs_error(abspath_err);
+            break;
+        }
 
-                    RecordInfo record_info = {};
-                    record_info.fullpath = fullpath;
-                    dynarray::append(&record_infos, record_info);
+        // The file belongs to parsed now
+        dynarray::append(&parsed->files, *file);
+        mem::zero_ptr(file);
 
-                    bind_typedesc_name(prgstate, dirlist.current.access_path, parsed_value.typedesc);
-                }
-                break;
-            }
+        if (make_values_with)
+        {
+            make_parsed_file_value(make_values_with, parsed);
         }
     }
-BreakWhile: {}
 
-    Collection *collection = nullptr;
-    if (values.count > 0)
+    // Whatever didn't make it into parsed, including the one that failed
+    for (DynArrayCount i = 0; i < listed.count; ++i)
     {
-        collection = bucketarray::add(&prgstate->collections).elem;
-        mem::zero_ptr(collection);
+        free_parsed_file(&listed[i]);
+    }
+    dynarray::deinit(&listed);
+
+    return result;
+}
 
-        init_array_value(&collection->value, prgstate, values);
-        collection->top_typedesc = collection->value.typedesc->array_type.elem_type;
 
-        collection->info = record_infos;
-        collection->load_path = str(path, STRLEN(path_length));
+LoadJsonDirResult parse_json_dir(OUTPARAM ParsedJsonDir *parsed, const char *path, size_t path_length,
+                                 JobProgress *progress)
+{
+    return parse_json_dir(parsed, path, path_length, progress, nullptr);
+}
+
+
+bool make_parsed_json_values(ProgramState *prgstate, ParsedJsonDir *parsed, DynArrayCount max_files)
+{
+    PROF_FUNCTION();
 
-        bind_typedesc_name(prgstate, collection->load_path, collection->top_typedesc);
+    for (DynArrayCount i = 0; i < max_files && parsed->values.count < parsed->files.count; ++i)
+    {
+        make_parsed_file_value(prgstate, parsed);
     }
-    else
+
+    return parsed->values.count == parsed->files.count;
+}
+
+
+Collection *add_parsed_json_collection(ProgramState *prgstate, ParsedJsonDir *parsed)
+{
+    if (parsed->values.count == 0)
     {
-        dynarray::deinit(&values);
-        dynarray::deinit(&record_infos);
+        return nullptr;
     }
 
-    result.collection = collection;
+    u64 start_time = query_abstime();
+
+    DynArray<RecordInfo> record_infos;
+    dynarray::init(&record_infos, parsed->values.count);
+    for (DynArrayCount i = 0; i < parsed->values.count; ++i)
+    {
+        RecordInfo record_info = {};
+        record_info.fullpath = parsed->files[i].fullpath;
+        mem::zero_obj(parsed->files[i].fullpath);
+        dynarray::append(&record_infos, record_info);
+    }
+
+    Collection *collection = bucketarray::add(&prgstate->collections).elem;
+    mem::zero_ptr(collection);
+
+    init_array_value(&collection->value, prgstate, parsed->values);
+    collection->top_typedesc = collection->value.typedesc->array_type.elem_type;
+
+    collection->info = record_infos;
+    collection->load_path = str(parsed->path);
+
+    bind_typedesc_name_weak(prgstate, collection->load_path, collection->top_typedesc);
+
+    // The collection owns the values now
+    mem::zero_obj(parsed->values);
+
+    parsed->timings.collection_ns = nanoseconds_since(start_time);
+
+    return collection;
+}
+
+
+LoadJsonDirResult load_json_dir(ProgramState *prgstate, const char *path, size_t path_length,
+                                ParsedJsonDir *parsed)
+{
+    PROF_FUNCTION();
+
+    LoadJsonDirResult result = parse_json_dir(parsed, path, path_length, nullptr, prgstate);
+    result.collection = add_parsed_json_collection(prgstate, parsed);
+
+    return result;
+}
+
+
+LoadJsonDirResult load_json_dir(ProgramState *prgstate, const char *path, size_t path_length)
+{
+    ParsedJsonDir parsed;
+    LoadJsonDirResult result = load_json_dir(prgstate, path, path_length, &parsed);
+    parsed_json_dir_free(&parsed);
 
     return result;
 }
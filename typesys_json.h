@@ -5,6 +5,7 @@
 
 struct ProgramState;
 struct Collection;
+struct JobProgress;
 
 // Uses the json.h library
 struct json_value_s;
@@ -87,10 +88,82 @@ Value create_object_with_type_from_json(ProgramState *prgstate, json_object_s *j
 
 Value create_array_with_type_from_json(ProgramState *prgstate, json_array_s *jarray, TypeDescriptor *typedesc);
 
+// The value create_value_from_json would make, without inferring anything,
+// if jv's inferred type would be expected. False otherwise, and output is
+// left alone.
+bool create_value_expecting_type(OUTPARAM Value *output, ProgramState *prgstate,
+                                 json_value_s *jv, TypeDescriptor *expected);
+
+// output is json.h's tree, one malloc block for the caller to free
+JsonParseResult try_parse_json(OUTPARAM json_value_s **output, const char *input, size_t input_length);
+
 JsonParseResult try_parse_json_as_value(OUTPARAM Value *output, ProgramState *prgstate,
                                         const char *input, size_t input_length);
 
 LoadJsonDirResult load_json_dir(ProgramState *prgstate, const char *path, size_t path_length);
 
+
+// Loading a directory in two steps. Parsing needs no ProgramState so it
+// can happen on any thread, making values and the collection can't.
+
+struct ParsedJsonFile
+{
+    Str fullpath;
+    // as listed, the file's type is bound to it
+    Str access_path;
+    size_t size;
+    // null once its value is made
+    json_value_s *root;
+
+    u64 read_ns;
+    u64 parse_ns;
+    u64 value_ns;
+};
+
+
+// Summed over every file, for reporting where a load's time went
+struct LoadJsonDirTimings
+{
+    u64 list_ns;
+    u64 read_ns;
+    u64 parse_ns;
+    u64 values_ns;
+    u64 collection_ns;
+};
+
+
+struct ParsedJsonDir
+{
+    Str path;
+    // only files that parsed and weren't empty
+    DynArray<ParsedJsonFile> files;
+    // values[i] is made from files[i]
+    DynArray<Value> values;
+
+    u32 files_listed;
+    u64 bytes_listed;
+    // made from a type that was already known instead of inferring one
+    u32 files_typed_by_known_type;
+    LoadJsonDirTimings timings;
+};
+
+void parsed_json_dir_free(ParsedJsonDir *parsed);
+
+// Stops at the first error, keeping the files before it, or between files
+// once progress->cancel is set. progress may be null.
+LoadJsonDirResult parse_json_dir(OUTPARAM ParsedJsonDir *parsed, const char *path, size_t path_length,
+                                 JobProgress *progress);
+
+// Makes values for up to max_files more files, true once every file has one
+bool make_parsed_json_values(ProgramState *prgstate, ParsedJsonDir *parsed, DynArrayCount max_files);
+
+// Moves the values made so far into a new collection, null if there are none
+Collection *add_parsed_json_collection(ProgramState *prgstate, ParsedJsonDir *parsed);
+
+// load_json_dir, leaving the files and timings in parsed for a report.
+// The collection has the values, parsed still needs freeing.
+LoadJsonDirResult load_json_dir(ProgramState *prgstate, const char *path, size_t path_length,
+                                OUTPARAM ParsedJsonDir *parsed);
+
 #define TYPESYS_JSON_H
 #endif
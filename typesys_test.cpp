@@ -0,0 +1,275 @@
+#include "typesys.h"
+#include "typesys_json.h"
+#include "programstate.h"
+#include "common.h"
+#include <cstdlib>
+#include <cstring>
+
+
+// Both are in the repo's test directory, run from the repo root
+static const char *collect_test_dropped_dir = "test/nested";
+static const char *collect_test_kept_dir = "test/rpgitem";
+
+
+static void add_reachable_types(DynArray<TypeDescriptor *> *types, TypeDescriptor *typedesc)
+{
+    if (dynarray::find(types, typedesc))
+    {
+        return;
+    }
+    dynarray::append(types, typedesc);
+
+    if (tIS_ARRAY(typedesc))
+    {
+        add_reachable_types(types, typedesc->array_type.elem_type);
+    }
+    else if (tIS_COMPOUND(typedesc))
+    {
+        for (DynArrayCount i = 0; i < typedesc->compound_type.members.count; ++i)
+        {
+            add_reachable_types(types, typedesc->compound_type.members[i].typedesc);
+        }
+    }
+    else if (tIS_UNION(typedesc))
+    {
+        for (DynArrayCount i = 0; i < typedesc->union_type.type_cases.count; ++i)
+        {
+            add_reachable_types(types, typedesc->union_type.type_cases[i]);
+        }
+    }
+}
+
+
+static void add_value_types(DynArray<TypeDescriptor *> *types, const Value *value)
+{
+    add_reachable_types(types, value->typedesc);
+
+    if (vIS_ARRAY(value))
+    {
+        for (DynArrayCount i = 0; i < value->array_value.elements.count; ++i)
+        {
+            add_value_types(types, &value->array_value.elements[i]);
+        }
+    }
+    else if (vIS_COMPOUND(value))
+    {
+        for (DynArrayCount i = 0; i < value->compound_value.members.count; ++i)
+        {
+            add_value_types(types, &value->compound_value.members[i].value);
+        }
+    }
+}
+
+
+static bool type_in_table(ProgramState *prgstate, TypeDescriptor *typedesc)
+{
+    for (BucketArray<TypeDescriptor>::Iterator it = bucketarray::iterate(&prgstate->type_descriptors);
+         bucketarray::next(&it);)
+    {
+        if (it.elem == typedesc)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static Collection *load_test_dir(ProgramState *prgstate, const char *path)
+{
+    LoadJsonDirResult result = load_json_dir(prgstate, path, strlen(path));
+    Collection *collection = result.error_kind == LoadJsonDirResult::NoError ? result.collection : nullptr;
+    result.release();
+
+    if (!collection)
+    {
+        printf_ln("Couldn't load %s for the type collection test", path);
+    }
+    return collection;
+}
+
+
+// Drops one of two collections, keeping a type bound to a name and a
+// stored value that only the dropped one had, and collects
+static s32 test_collect_types()
+{
+    static ProgramState prgstate;
+    prgstate_init(&prgstate);
+    load_base_type_descriptors(&prgstate);
+
+    Collection *dropped = load_test_dir(&prgstate, collect_test_dropped_dir);
+    Collection *kept = load_test_dir(&prgstate, collect_test_kept_dir);
+    if (!dropped || !kept)
+    {
+        return 1;
+    }
+
+    // Types only the dropped collection has, one kept by a stored value
+    // and one by a name
+    Value *record = &dropped->value.array_value.elements[0];
+    CompoundValueMember *costumes = find_member(record, nametable::find(&prgstate.names, "costumes"));
+    CompoundValueMember *bbox = find_member(record, nametable::find(&prgstate.names, "bbox"));
+    ASSERT(costumes && bbox);
+    Value *stored = &costumes->value;
+    TypeDescriptor *bound = bbox->value.typedesc;
+
+    StrToValueMap::Entry *entry;
+    ht_find_or_add_entry(&entry, &prgstate.value_map, str_slice("stored"));
+    entry->key = nameref::str_slice(nametable::find_or_add(&prgstate.names, entry->key));
+    entry->value = clone(stored);
+    promote_value_types(&prgstate, &entry->value);
+    bind_typedesc_name(&prgstate, "Bound", bound);
+    Value expected_stored = clone(&entry->value);
+
+    DynArray<TypeDescriptor *> survivors;
+    dynarray::init(&survivors, 64);
+    add_reachable_types(&survivors, prgstate.prim_string);
+    add_reachable_types(&survivors, prgstate.prim_int);
+    add_reachable_types(&survivors, prgstate.prim_float);
+    add_reachable_types(&survivors, prgstate.prim_bool);
+    add_reachable_types(&survivors, prgstate.prim_none);
+    add_reachable_types(&survivors, kept->top_typedesc);
+    add_value_types(&survivors, &kept->value);
+    add_value_types(&survivors, &entry->value);
+    add_reachable_types(&survivors, bound);
+
+    DynArray<TypeDescriptor *> dropped_types;
+    dynarray::init(&dropped_types, 64);
+    add_reachable_types(&dropped_types, dropped->top_typedesc);
+    add_value_types(&dropped_types, &dropped->value);
+
+    // Only what nothing else reaches should go
+    DynArray<TypeDescriptor *> doomed;
+    dynarray::init(&doomed, dropped_types.count);
+    for (DynArrayCount i = 0; i < dropped_types.count; ++i)
+    {
+        if (!dynarray::find(&survivors, dropped_types[i]))
+        {
+            dynarray::append(&doomed, dropped_types[i]);
+        }
+    }
+
+    s32 fails = 0;
+    if (doomed.count == 0)
+    {
+        printf_ln("Nothing in %s has a type only it uses", collect_test_dropped_dir);
+        ++fails;
+    }
+
+    BucketIndex dropped_bidx = bucketarray::bucketindex_of(&prgstate.collections, dropped);
+    drop_collection(&prgstate, dropped_bidx);
+    TypeCollectionStats stats = collect_types(&prgstate);
+
+    if (stats.types_freed < doomed.count)
+    {
+        printf_ln("Collecting freed %u types, expected at least %u", stats.types_freed, doomed.count);
+        ++fails;
+    }
+
+    for (DynArrayCount i = 0; i < survivors.count; ++i)
+    {
+        if (!type_in_table(&prgstate, survivors[i]))
+        {
+            printf_ln("Collecting freed a %s type that's still used",
+                      TypeID::to_string(survivors[i]->type_id));
+            ++fails;
+        }
+    }
+
+    for (DynArrayCount i = 0; i < doomed.count; ++i)
+    {
+        if (type_in_table(&prgstate, doomed[i]))
+        {
+            printf_ln("Collecting kept a %s type only the dropped collection used",
+                      TypeID::to_string(doomed[i]->type_id));
+            ++fails;
+        }
+    }
+
+    if (find_typedesc_by_name(&prgstate, str_slice("Bound")) != bound)
+    {
+        println("Collecting unbound a strongly bound type");
+        ++fails;
+    }
+
+    Value *stored_after = ht_find(&prgstate.value_map, str_slice("stored"));
+    if (!stored_after || !value_equal(*stored_after, expected_stored))
+    {
+        println("The stored value changed after collecting");
+        ++fails;
+    }
+
+    value_free_components(&expected_stored);
+    dynarray::deinit(&survivors);
+    dynarray::deinit(&dropped_types);
+    dynarray::deinit(&doomed);
+    return fails;
+}
+
+
+struct RangeTestCase
+{
+    const char *json;
+    // where the number that's too big is, 0 if there isn't one
+    size_t line;
+    size_t column;
+};
+
+
+static const RangeTestCase range_test_cases[] = {
+    {"[1e308, -1.7976931348623157e308, 1e-400]", 0, 0},
+    {"1e309", 1, 1},
+    {"[1, 2e3, {\"a\": \"1e999\", /* 5e999 */ \"b\": [4,\n  -1e400]}]", 2, 3},
+};
+
+
+// Loading fails on numbers past a double's range instead of making
+// infinities
+static s32 test_out_of_range_numbers()
+{
+    s32 fails = 0;
+    for (size_t i = 0; i < COUNTOF(range_test_cases); ++i)
+    {
+        const RangeTestCase *test = &range_test_cases[i];
+        json_value_s *root;
+        JsonParseResult result = try_parse_json(&root, test->json, strlen(test->json));
+
+        if (test->line == 0 && result.status != JsonParseResult::Succeeded)
+        {
+            printf_ln("Parsing '%s' failed: %s", test->json, str_data(result.error_desc));
+            ++fails;
+        }
+        else if (test->line != 0
+                 && (result.status != JsonParseResult::Failed
+                     || result.error_line != test->line || result.error_column != test->column))
+        {
+            printf_ln("Parsing '%s' should fail at %u:%u", test->json, (u32)test->line, (u32)test->column);
+            ++fails;
+        }
+
+        if (result.status == JsonParseResult::Succeeded)
+        {
+            free(root);
+        }
+        result.release();
+    }
+    return fails;
+}
+
+
+s32 run_typesys_tests()
+{
+    s32 fails = test_collect_types();
+    fails += test_out_of_range_numbers();
+
+    if (fails != 0)
+    {
+        printf_ln("There were %i type system test failures", fails);
+    }
+    else
+    {
+        println("No failures in type system tests");
+    }
+
+    return fails;
+}